@@ -68,9 +68,44 @@ namespace Falcor
         }
     }
 
-    CopyContext::ReadTextureTask::SharedPtr CopyContext::asyncReadTextureSubresource(const Texture* pTexture, uint32_t subresourceIndex)
+    CopyContext::ReadTextureTask::SharedPtr CopyContext::asyncReadTextureSubresource(const Texture* pTexture, uint32_t subresourceIndex, const Buffer::SharedPtr& pStagingBuffer)
     {
-        return CopyContext::ReadTextureTask::create(this, pTexture, subresourceIndex);
+        return CopyContext::ReadTextureTask::create(this, pTexture, subresourceIndex, pStagingBuffer);
+    }
+
+    CopyContext::ReadTextureTask::SharedPtr CopyContext::ReadTextureTask::create(CopyContext* pCtx, const Texture* pTexture, uint32_t subresourceIndex, const Buffer::SharedPtr& pStagingBuffer)
+    {
+        return create(pCtx, std::vector<Subresource>{ { pTexture, subresourceIndex } }, pStagingBuffer);
+    }
+
+    std::vector<uint8_t> CopyContext::ReadTextureTask::getData()
+    {
+        const Layout& layout = mLayouts[0];
+        std::vector<uint8_t> result(size_t(layout.rowSize) * layout.rowCount * layout.depth);
+
+        // Remove the row padding of the staging buffer.
+        const uint8_t* pSrc = map() + layout.offset;
+        uint8_t* pDst = result.data();
+        for (uint32_t row = 0; row < layout.rowCount * layout.depth; row++)
+        {
+            std::memcpy(pDst, pSrc, layout.rowSize);
+            pSrc += layout.rowPitch;
+            pDst += layout.rowSize;
+        }
+        unmap();
+
+        return result;
+    }
+
+    const uint8_t* CopyContext::ReadTextureTask::map()
+    {
+        mpFence->syncCpu();
+        return reinterpret_cast<const uint8_t*>(mpBuffer->map(Buffer::MapType::Read));
+    }
+
+    void CopyContext::ReadTextureTask::unmap()
+    {
+        mpBuffer->unmap();
     }
 
     std::vector<uint8_t> CopyContext::readTextureSubresource(const Texture* pTexture, uint32_t subresourceIndex)
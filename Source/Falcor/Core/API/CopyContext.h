@@ -43,20 +43,74 @@ namespace Falcor
         {
         public:
             using SharedPtr = std::shared_ptr<ReadTextureTask>;
-            static SharedPtr create(CopyContext* pCtx, const Texture* pTexture, uint32_t subresourceIndex);
+
+            /** Texture subresource to read.
+            */
+            struct Subresource
+            {
+                const Texture* pTexture = nullptr;
+                uint32_t subresourceIndex = 0;
+            };
+
+            /** Location of a subresource in the staging buffer.
+            */
+            struct Layout
+            {
+                uint64_t offset = 0;                                ///< Offset of the first row in bytes from the start of the staging buffer.
+                uint32_t rowPitch = 0;                              ///< Offset between rows in bytes. Can be larger than the row size due to alignment requirements.
+                uint32_t rowSize = 0;                               ///< Size of a row of texels (blocks for compressed formats) in bytes.
+                uint32_t rowCount = 0;                              ///< Number of rows per depth slice.
+                uint32_t depth = 1;                                 ///< Number of depth slices.
+                ResourceFormat format = ResourceFormat::Unknown;    ///< Format of the texture.
+            };
+
+            /** Record a copy of a texture subresource to a staging buffer and submit it.
+                \param[in] pCtx Context to record the copy on.
+                \param[in] pTexture Texture to read.
+                \param[in] subresourceIndex Subresource to read.
+                \param[in] pStagingBuffer Optional readback buffer to reuse. It is used if it was created with CPU read access and is large enough, otherwise a new buffer is allocated.
+            */
+            static SharedPtr create(CopyContext* pCtx, const Texture* pTexture, uint32_t subresourceIndex, const Buffer::SharedPtr& pStagingBuffer = nullptr);
+
+            /** Record copies of several texture subresources to a single staging buffer and submit them with one fence.
+                \param[in] pCtx Context to record the copies on.
+                \param[in] subresources Subresources to read.
+                \param[in] pStagingBuffer Optional readback buffer to reuse, see above. Use getStagingBufferSize() to get the required size.
+            */
+            static SharedPtr create(CopyContext* pCtx, const std::vector<Subresource>& subresources, const Buffer::SharedPtr& pStagingBuffer = nullptr);
+
+            /** Get the size of the staging buffer needed to read the given subresources in one task.
+            */
+            static uint64_t getStagingBufferSize(const std::vector<Subresource>& subresources);
+
+            /** Wait for the copy to complete and return the tightly packed data of the first subresource.
+                Can be called from any thread.
+            */
             std::vector<uint8_t> getData();
+
+            /** Wait for the copy to complete and map the staging buffer. The subresources are located as described by getLayouts().
+                Can be called from any thread. Call unmap() when done reading.
+                \return Pointer to the start of the staging buffer.
+            */
+            const uint8_t* map();
+
+            /** Unmap the staging buffer.
+            */
+            void unmap();
+
+            /** Get the locations of the subresources in the staging buffer, in the order they were passed to create().
+            */
+            const std::vector<Layout>& getLayouts() const { return mLayouts; }
+
+            /** Get the staging buffer the data is read back through. Can be reused for another read once getData() or unmap() has returned.
+            */
+            const Buffer::SharedPtr& getStagingBuffer() const { return mpBuffer; }
         private:
             ReadTextureTask() = default;
             GpuFence::SharedPtr mpFence;
             Buffer::SharedPtr mpBuffer;
             CopyContext* mpContext;
-#ifdef FALCOR_D3D12
-            uint32_t mRowCount;
-            ResourceFormat mTextureFormat;
-            D3D12_PLACED_SUBRESOURCE_FOOTPRINT mFootprint;
-#elif defined(FALCOR_VK)
-            size_t mDataSize;
-#endif
+            std::vector<Layout> mLayouts;
         };
 
         virtual ~CopyContext();
@@ -126,8 +180,11 @@ namespace Falcor
         std::vector<uint8_t> readTextureSubresource(const Texture* pTexture, uint32_t subresourceIndex);
 
         /** Read texture data Asynchronously
+            \param[in] pTexture Texture to read.
+            \param[in] subresourceIndex Subresource to read.
+            \param[in] pStagingBuffer Optional readback buffer to reuse, see ReadTextureTask::create().
         */
-        ReadTextureTask::SharedPtr asyncReadTextureSubresource(const Texture* pTexture, uint32_t subresourceIndex);
+        ReadTextureTask::SharedPtr asyncReadTextureSubresource(const Texture* pTexture, uint32_t subresourceIndex, const Buffer::SharedPtr& pStagingBuffer = nullptr);
 
         /** Get the low-level context data
         */
@@ -142,67 +142,87 @@ namespace Falcor
         pBuffer->unmap();
     }
 
-    CopyContext::ReadTextureTask::SharedPtr CopyContext::ReadTextureTask::create(CopyContext* pCtx, const Texture* pTexture, uint32_t subresourceIndex)
+    /** Compute the placed footprints of subresources stored consecutively in a staging buffer.
+        \return Total size of the staging buffer in bytes.
+    */
+    static uint64_t getReadbackFootprints(const std::vector<CopyContext::ReadTextureTask::Subresource>& subresources, std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT>& footprints, std::vector<CopyContext::ReadTextureTask::Layout>& layouts)
     {
+        ID3D12Device* pDevice = gpDevice->getApiHandle();
+        uint64_t offset = 0;
+        for (const auto& subresource : subresources)
+        {
+            D3D12_RESOURCE_DESC texDesc = subresource.pTexture->getApiHandle()->GetDesc();
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+            uint32_t rowCount;
+            uint64_t rowSize;
+            uint64_t size;
+            offset = align_to(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, offset);
+            pDevice->GetCopyableFootprints(&texDesc, subresource.subresourceIndex, 1, offset, &footprint, &rowCount, &rowSize, &size);
+            offset = footprint.Offset + size;
+
+            // Calculate row size. GPU pitch can be different because it is aligned to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+            ResourceFormat format = subresource.pTexture->getFormat();
+            assert(footprint.Footprint.Width % getFormatWidthCompressionRatio(format) == 0); // Should divide evenly
+
+            CopyContext::ReadTextureTask::Layout layout;
+            layout.offset = footprint.Offset;
+            layout.rowPitch = footprint.Footprint.RowPitch;
+            layout.rowSize = (footprint.Footprint.Width / getFormatWidthCompressionRatio(format)) * getFormatBytesPerBlock(format);
+            layout.rowCount = rowCount;
+            layout.depth = footprint.Footprint.Depth;
+            layout.format = format;
+
+            footprints.push_back(footprint);
+            layouts.push_back(layout);
+        }
+        return offset;
+    }
+
+    uint64_t CopyContext::ReadTextureTask::getStagingBufferSize(const std::vector<Subresource>& subresources)
+    {
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+        std::vector<Layout> layouts;
+        return getReadbackFootprints(subresources, footprints, layouts);
+    }
+
+    CopyContext::ReadTextureTask::SharedPtr CopyContext::ReadTextureTask::create(CopyContext* pCtx, const std::vector<Subresource>& subresources, const Buffer::SharedPtr& pStagingBuffer)
+    {
+        assert(!subresources.empty());
         SharedPtr pThis = SharedPtr(new ReadTextureTask);
         pThis->mpContext = pCtx;
-        //Get footprint
-        D3D12_RESOURCE_DESC texDesc = pTexture->getApiHandle()->GetDesc();
-        D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = pThis->mFootprint;
-        uint64_t rowSize;
-        uint64_t size;
-        ID3D12Device* pDevice = gpDevice->getApiHandle();
-        pDevice->GetCopyableFootprints(&texDesc, subresourceIndex, 1, 0, &footprint, &pThis->mRowCount, &rowSize, &size);
+        //Get footprints
+        std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> footprints;
+        uint64_t size = getReadbackFootprints(subresources, footprints, pThis->mLayouts);
 
         //Create buffer
-        pThis->mpBuffer = Buffer::create(size, Buffer::BindFlags::None, Buffer::CpuAccess::Read, nullptr);
+        if (pStagingBuffer && pStagingBuffer->getCpuAccess() == Buffer::CpuAccess::Read && pStagingBuffer->getSize() >= size)
+        {
+            pThis->mpBuffer = pStagingBuffer;
+        }
+        else
+        {
+            pThis->mpBuffer = Buffer::create(size, Buffer::BindFlags::None, Buffer::CpuAccess::Read, nullptr);
+        }
 
-        //Copy from texture to buffer
-        D3D12_TEXTURE_COPY_LOCATION srcLoc = { pTexture->getApiHandle(), D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX, subresourceIndex };
-        D3D12_TEXTURE_COPY_LOCATION dstLoc = { pThis->mpBuffer->getApiHandle(), D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT, footprint };
-        pCtx->resourceBarrier(pTexture, Resource::State::CopySource);
-        pCtx->getLowLevelData()->getCommandList()->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
+        //Copy from textures to buffer
+        for (size_t i = 0; i < subresources.size(); i++)
+        {
+            const Texture* pTexture = subresources[i].pTexture;
+            D3D12_TEXTURE_COPY_LOCATION srcLoc = { pTexture->getApiHandle(), D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX, subresources[i].subresourceIndex };
+            D3D12_TEXTURE_COPY_LOCATION dstLoc = { pThis->mpBuffer->getApiHandle(), D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT, footprints[i] };
+            pCtx->resourceBarrier(pTexture, Resource::State::CopySource);
+            pCtx->getLowLevelData()->getCommandList()->CopyTextureRegion(&dstLoc, 0, 0, 0, &srcLoc, nullptr);
+        }
         pCtx->setPendingCommands(true);
 
         // Create a fence and signal
         pThis->mpFence = GpuFence::create();
         pCtx->flush(false);
         pThis->mpFence->gpuSignal(pCtx->getLowLevelData()->getCommandQueue());
-        pThis->mTextureFormat = pTexture->getFormat();
 
         return pThis;
     }
 
-    std::vector<uint8_t> CopyContext::ReadTextureTask::getData()
-    {
-        mpFence->syncCpu();
-        D3D12_PLACED_SUBRESOURCE_FOOTPRINT& footprint = mFootprint;
-
-        // Calculate row size. GPU pitch can be different because it is aligned to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
-        assert(footprint.Footprint.Width % getFormatWidthCompressionRatio(mTextureFormat) == 0); // Should divide evenly
-        uint32_t actualRowSize = (footprint.Footprint.Width / getFormatWidthCompressionRatio(mTextureFormat)) * getFormatBytesPerBlock(mTextureFormat);
-
-        // Get buffer data
-        std::vector<uint8_t> result;
-        result.resize(mRowCount * actualRowSize * footprint.Footprint.Depth);
-        uint8_t* pData = reinterpret_cast<uint8_t*>(mpBuffer->map(Buffer::MapType::Read));
-
-        for (uint32_t z = 0; z < footprint.Footprint.Depth; z++)
-        {
-            const uint8_t* pSrcZ = pData + z * footprint.Footprint.RowPitch * mRowCount;
-            uint8_t* pDstZ = result.data() + z * actualRowSize * mRowCount;
-            for (uint32_t y = 0; y < mRowCount; y++)
-            {
-                const uint8_t* pSrc = pSrcZ + y * footprint.Footprint.RowPitch;
-                uint8_t* pDst = pDstZ + y * actualRowSize;
-                memcpy(pDst, pSrc, actualRowSize);
-            }
-        }
-
-        mpBuffer->unmap();
-        return result;
-    }
-
     static void d3d12ResourceBarrier(const Resource* pResource, Resource::State newState, Resource::State oldState, uint32_t subresourceIndex, ID3D12GraphicsCommandList* pCmdList)
     {
         D3D12_RESOURCE_BARRIER barrier;
@@ -99,7 +99,9 @@ namespace Falcor
             mpActivePage->allocationsCount++;
         }
 
+        data.size = size;
         data.fenceValue = mpFence->getCpuValue();
+        mAllocatedSize += size;
         return data;
     }
 
@@ -137,6 +139,7 @@ namespace Falcor
                 }
                 // else it's a mega-page. Popping it will release the resource
             }
+            mAllocatedSize -= data.size;
             mDeferredReleases.pop();
         }
     }
@@ -26,6 +26,7 @@
  # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************/
 #pragma once
+#include <atomic>
 #include <queue>
 #include "Core/API/GpuFence.h"
 
@@ -55,6 +56,7 @@ namespace Falcor
         {
             uint64_t pageID = 0;
             uint64_t fenceValue = 0;
+            size_t size = 0;
 
             static const uint64_t kMegaPageId = -1;
             bool operator<(const Allocation& other)  const { return fenceValue > other.fenceValue; }
@@ -75,6 +77,11 @@ namespace Falcor
         size_t getPageSize() const { return mPageSize; }
         void executeDeferredReleases();
 
+        /** Get the total size of the allocations that have not been reclaimed yet.
+            This includes released allocations that may still be in use by the GPU. This function is thread-safe.
+        */
+        size_t getAllocatedSize() const { return mAllocatedSize; }
+
     private:
         GpuMemoryHeap(Type type, size_t pageSize, const GpuFence::SharedPtr& pFence);
 
@@ -90,6 +97,7 @@ namespace Falcor
         GpuFence::SharedPtr mpFence;
         size_t mPageSize = 0;
         size_t mCurrentPageId = 0;
+        std::atomic<size_t> mAllocatedSize{ 0 };
         PageData::UniquePtr mpActivePage;
 
         std::priority_queue<Allocation> mDeferredReleases;
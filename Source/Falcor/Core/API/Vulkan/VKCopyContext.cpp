@@ -165,7 +165,7 @@ namespace Falcor
     {
     }
 
-    static void initTexAccessParams(const Texture* pTexture, uint32_t subresourceIndex, VkBufferImageCopy& vkCopy, Buffer::SharedPtr& pStaging, const void* pSrcData, const uint3& offset, const uint3& size, size_t& dataSize)
+    static void initBufferImageCopy(const Texture* pTexture, uint32_t subresourceIndex, VkBufferImageCopy& vkCopy, const uint3& offset, const uint3& size)
     {
         assert(isDepthStencilFormat(pTexture->getFormat()) == false); // #VKTODO Nothing complicated here, just that Vulkan doesn't support writing to both depth and stencil, which may be confusing to the user
         uint32_t mipLevel = pTexture->getSubresourceMipLevel(subresourceIndex);
@@ -181,7 +181,11 @@ namespace Falcor
         vkCopy.imageExtent.width = (size.x == -1) ? pTexture->getWidth(mipLevel) - offset.x : size.x;
         vkCopy.imageExtent.height = (size.y == -1) ? pTexture->getHeight(mipLevel) - offset.y : size.y;
         vkCopy.imageExtent.depth = (size.z == -1) ? pTexture->getDepth(mipLevel) - offset.z : size.z;
+    }
 
+    static void initTexAccessParams(const Texture* pTexture, uint32_t subresourceIndex, VkBufferImageCopy& vkCopy, Buffer::SharedPtr& pStaging, const void* pSrcData, const uint3& offset, const uint3& size, size_t& dataSize)
+    {
+        initBufferImageCopy(pTexture, subresourceIndex, vkCopy, offset, size);
         dataSize = getMipLevelPackedDataSize(pTexture, vkCopy.imageExtent.width, vkCopy.imageExtent.height, vkCopy.imageExtent.depth, pTexture->getFormat());
 
         // Upload the data to a staging buffer
@@ -219,18 +223,71 @@ namespace Falcor
         }
     }
 
-    CopyContext::ReadTextureTask::SharedPtr CopyContext::ReadTextureTask::create(CopyContext* pCtx, const Texture* pTexture, uint32_t subresourceIndex)
+    /** Compute the locations of subresources stored tightly packed and consecutively in a staging buffer.
+        \return Total size of the staging buffer in bytes.
+    */
+    static uint64_t getReadbackLayouts(const std::vector<CopyContext::ReadTextureTask::Subresource>& subresources, std::vector<CopyContext::ReadTextureTask::Layout>& layouts)
     {
+        uint64_t offset = 0;
+        for (const auto& subresource : subresources)
+        {
+            const Texture* pTexture = subresource.pTexture;
+            ResourceFormat format = pTexture->getFormat();
+            uint32_t mipLevel = pTexture->getSubresourceMipLevel(subresource.subresourceIndex);
+            uint32_t perW = getFormatWidthCompressionRatio(format);
+            uint32_t perH = getFormatHeightCompressionRatio(format);
+
+            // Buffer offsets must be a multiple of the texel block size and of 4.
+            offset = align_to(16, offset);
+
+            CopyContext::ReadTextureTask::Layout layout;
+            layout.offset = offset;
+            layout.rowSize = align_to(perW, pTexture->getWidth(mipLevel)) / perW * getFormatBytesPerBlock(format);
+            layout.rowPitch = layout.rowSize;
+            layout.rowCount = align_to(perH, pTexture->getHeight(mipLevel)) / perH;
+            layout.depth = pTexture->getDepth(mipLevel);
+            layout.format = format;
+            layouts.push_back(layout);
+
+            offset += getMipLevelPackedDataSize(pTexture, pTexture->getWidth(mipLevel), pTexture->getHeight(mipLevel), layout.depth, format);
+        }
+        return offset;
+    }
+
+    uint64_t CopyContext::ReadTextureTask::getStagingBufferSize(const std::vector<Subresource>& subresources)
+    {
+        std::vector<Layout> layouts;
+        return getReadbackLayouts(subresources, layouts);
+    }
+
+    CopyContext::ReadTextureTask::SharedPtr CopyContext::ReadTextureTask::create(CopyContext* pCtx, const std::vector<Subresource>& subresources, const Buffer::SharedPtr& pStagingBuffer)
+    {
+        assert(!subresources.empty());
         SharedPtr pThis = SharedPtr(new ReadTextureTask);
         pThis->mpContext = pCtx;
 
-        VkBufferImageCopy vkCopy;
-        initTexAccessParams(pTexture, subresourceIndex, vkCopy, pThis->mpBuffer, nullptr, {}, uint3(-1, -1, -1), pThis->mDataSize);
+        uint64_t size = getReadbackLayouts(subresources, pThis->mLayouts);
+        if (pStagingBuffer && pStagingBuffer->getCpuAccess() == Buffer::CpuAccess::Read && pStagingBuffer->getSize() >= size)
+        {
+            pThis->mpBuffer = pStagingBuffer;
+        }
+        else
+        {
+            pThis->mpBuffer = Buffer::create(size, Buffer::BindFlags::None, Buffer::CpuAccess::Read, nullptr);
+        }
 
-        // Execute the copy
-        pCtx->resourceBarrier(pTexture, Resource::State::CopySource);
+        // Execute the copies
         pCtx->resourceBarrier(pThis->mpBuffer.get(), Resource::State::CopyDest);
-        vkCmdCopyImageToBuffer(pCtx->getLowLevelData()->getCommandList(), pTexture->getApiHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pThis->mpBuffer->getApiHandle(), 1, &vkCopy);
+        for (size_t i = 0; i < subresources.size(); i++)
+        {
+            const Texture* pTexture = subresources[i].pTexture;
+            VkBufferImageCopy vkCopy;
+            initBufferImageCopy(pTexture, subresources[i].subresourceIndex, vkCopy, {}, uint3(-1, -1, -1));
+            vkCopy.bufferOffset = pThis->mpBuffer->getGpuAddressOffset() + pThis->mLayouts[i].offset;
+
+            pCtx->resourceBarrier(pTexture, Resource::State::CopySource);
+            vkCmdCopyImageToBuffer(pCtx->getLowLevelData()->getCommandList(), pTexture->getApiHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pThis->mpBuffer->getApiHandle(), 1, &vkCopy);
+        }
 
         // Create a fence and signal
         pThis->mpFence = GpuFence::create();
@@ -240,16 +297,6 @@ namespace Falcor
         return pThis;
     }
 
-    std::vector<uint8_t> CopyContext::ReadTextureTask::getData()
-    {
-        mpFence->syncCpu();
-        // Map and read the results
-        std::vector<uint8> result(mDataSize);
-        uint8* pData = reinterpret_cast<uint8*>(mpBuffer->map(Buffer::MapType::Read));
-        std::memcpy(result.data(), pData, mDataSize);
-        return result;
-    }
-
     void CopyContext::uavBarrier(const Resource* pResource)
     {
         UNSUPPORTED_IN_VULKAN("uavBarrier");
@@ -494,6 +494,27 @@ namespace Falcor
         return s.st_mtime;
     }
 
+    uint64_t getProcessWorkingSetSize()
+    {
+        // The resident set size is reported in kB by /proc/self/status.
+        uint64_t workingSetSize = 0;
+        if (FILE* pFile = fopen("/proc/self/status", "r"))
+        {
+            char line[256];
+            while (fgets(line, sizeof(line), pFile))
+            {
+                unsigned long long sizeKB = 0;
+                if (sscanf(line, "VmRSS: %llu kB", &sizeKB) == 1)
+                {
+                    workingSetSize = (uint64_t)sizeKB * 1024;
+                    break;
+                }
+            }
+            fclose(pFile);
+        }
+        return workingSetSize;
+    }
+
     uint32_t bitScanReverse(uint32_t a)
     {
         // __builtin_clz counts 0's from the MSB, convert to index from the LSB
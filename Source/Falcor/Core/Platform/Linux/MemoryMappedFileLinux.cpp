@@ -0,0 +1,71 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "Core/Platform/MemoryMappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Falcor
+{
+    struct MemoryMappedFileData
+    {
+        int fd = -1;
+    };
+
+    bool MemoryMappedFile::platformMap(const std::string& path)
+    {
+        mpPlatformData = new MemoryMappedFileData();
+
+        mpPlatformData->fd = open(path.c_str(), O_RDONLY);
+        if (mpPlatformData->fd == -1) return false;
+
+        struct stat st;
+        if (fstat(mpPlatformData->fd, &st) != 0 || st.st_size == 0) return false;
+
+        void* pData = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, mpPlatformData->fd, 0);
+        if (pData == MAP_FAILED) return false;
+
+        mpData = static_cast<const uint8_t*>(pData);
+        mSize = (size_t)st.st_size;
+        return true;
+    }
+
+    void MemoryMappedFile::platformUnmap()
+    {
+        if (!mpPlatformData) return;
+
+        if (mpData) munmap(const_cast<uint8_t*>(mpData), mSize);
+        if (mpPlatformData->fd != -1) close(mpPlatformData->fd);
+        safe_delete(mpPlatformData);
+
+        mpData = nullptr;
+        mSize = 0;
+    }
+}
@@ -395,6 +395,10 @@ namespace Falcor
     */
     dlldecl uint64_t  getProcessUsedVirtualMemory();
 
+    /** Get the physical memory currently used by this process (resident set size).
+    */
+    dlldecl uint64_t getProcessWorkingSetSize();
+
     /** Returns index of most significant set bit, or 0 if no bits were set.
     */
     dlldecl uint32_t bitScanReverse(uint32_t a);
@@ -0,0 +1,72 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "Core/Platform/MemoryMappedFile.h"
+
+namespace Falcor
+{
+    struct MemoryMappedFileData
+    {
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+    };
+
+    bool MemoryMappedFile::platformMap(const std::string& path)
+    {
+        mpPlatformData = new MemoryMappedFileData();
+
+        // Allow other handles to write the file, so that small in-place updates are possible while the file is mapped.
+        mpPlatformData->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (mpPlatformData->file == INVALID_HANDLE_VALUE) return false;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(mpPlatformData->file, &size) || size.QuadPart == 0) return false;
+
+        mpPlatformData->mapping = CreateFileMappingA(mpPlatformData->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mpPlatformData->mapping) return false;
+
+        mpData = static_cast<const uint8_t*>(MapViewOfFile(mpPlatformData->mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!mpData) return false;
+
+        mSize = (size_t)size.QuadPart;
+        return true;
+    }
+
+    void MemoryMappedFile::platformUnmap()
+    {
+        if (!mpPlatformData) return;
+
+        if (mpData) UnmapViewOfFile(mpData);
+        if (mpPlatformData->mapping) CloseHandle(mpPlatformData->mapping);
+        if (mpPlatformData->file != INVALID_HANDLE_VALUE) CloseHandle(mpPlatformData->file);
+        safe_delete(mpPlatformData);
+
+        mpData = nullptr;
+        mSize = 0;
+    }
+}
@@ -804,6 +804,13 @@ namespace Falcor
         return virtualMemUsedByMe;
     }
 
+    uint64_t getProcessWorkingSetSize()
+    {
+        PROCESS_MEMORY_COUNTERS pmc;
+        GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+        return pmc.WorkingSetSize;
+    }
+
     uint32_t bitScanReverse(uint32_t a)
     {
         unsigned long index;
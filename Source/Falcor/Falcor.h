@@ -132,6 +132,7 @@
 #include "Utils/Algorithm/DirectedGraphTraversal.h"
 #include "Utils/Algorithm/ParallelReduction.h"
 #include "Utils/Image/Bitmap.h"
+#include "Utils/Image/ExrWriter.h"
 #include "Utils/Image/ImageIO.h"
 #include "Utils/Math/CubicSpline.h"
 #include "Utils/Math/FalcorMath.h"
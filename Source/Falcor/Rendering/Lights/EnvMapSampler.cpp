@@ -36,8 +36,8 @@ namespace Falcor
         const char kShaderFilenameSetup[] = "Rendering/Lights/EnvMapSamplerSetup.cs.slang";
 
         // The defaults are 512x512 @ 64spp in the resampling step.
-        const uint32_t kDefaultDimension = 512;
-        const uint32_t kDefaultSpp = 64;
+        const uint32_t kDefaultDimension = EnvMapImportanceMap::kDefaultDimension;
+        const uint32_t kDefaultSpp = EnvMapImportanceMap::kDefaultSamples;
     }
 
     EnvMapSampler::SharedPtr EnvMapSampler::create(RenderContext* pRenderContext, EnvMap::SharedPtr pEnvMap)
@@ -64,15 +64,21 @@ namespace Falcor
     {
         assert(pEnvMap);
 
-        // Create compute program for the setup phase.
-        mpSetupPass = ComputePass::create(kShaderFilenameSetup, "main");
-
         // Create sampler.
         Sampler::Desc samplerDesc;
         samplerDesc.setFilterMode(Sampler::Filter::Point, Sampler::Filter::Point, Sampler::Filter::Point);
         samplerDesc.setAddressingMode(Sampler::AddressMode::Clamp, Sampler::AddressMode::Clamp, Sampler::AddressMode::Clamp);
         mpImportanceSampler = Sampler::create(samplerDesc);
 
+        // Upload the importance map if it was built on the CPU.
+        if (const auto& pCpuImportanceMap = mpEnvMap->getImportanceMap())
+        {
+            uint32_t dimension = pCpuImportanceMap->getDimension();
+            assert(pCpuImportanceMap->getMipCount() <= 12);     // Shader constant limits max resolution.
+            mpImportanceMap = Texture::create2D(dimension, dimension, ResourceFormat::R32Float, 1, pCpuImportanceMap->getMipCount(), pCpuImportanceMap->getData().data(), Resource::BindFlags::ShaderResource);
+            return;
+        }
+
         // Create hierarchical importance map for sampling.
         if (!createImportanceMap(pRenderContext, kDefaultDimension, kDefaultSpp))
         {
@@ -94,6 +100,9 @@ namespace Falcor
         mpImportanceMap = Texture::create2D(dimension, dimension, ResourceFormat::R32Float, 1, mips, nullptr, Resource::BindFlags::ShaderResource | Resource::BindFlags::RenderTarget | Resource::BindFlags::UnorderedAccess);
         assert(mpImportanceMap);
 
+        // Create compute program for the setup phase.
+        if (!mpSetupPass) mpSetupPass = ComputePass::create(kShaderFilenameSetup, "main");
+
         mpSetupPass["gEnvMap"] = mpEnvMap->getEnvMap();
         mpSetupPass["gImportanceMap"] = mpImportanceMap;
 
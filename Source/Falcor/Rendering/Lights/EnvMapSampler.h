@@ -42,6 +42,8 @@ namespace Falcor
         virtual ~EnvMapSampler() = default;
 
         /** Create a new object.
+            If the environment map has an importance map built on the CPU (see EnvMap::buildImportanceMap()), it is uploaded as-is.
+            Otherwise the importance map is computed on the GPU.
             \param[in] pRenderContext A render-context that will be used for processing.
             \param[in] pEnvMap The environment map.
         */
@@ -63,7 +65,7 @@ namespace Falcor
 
         EnvMap::SharedPtr       mpEnvMap;           ///< Environment map.
 
-        ComputePass::SharedPtr  mpSetupPass;        ///< Compute pass for creating the importance map.
+        ComputePass::SharedPtr  mpSetupPass;        ///< Compute pass for creating the importance map. Only created if the env map has no importance map built on the CPU.
 
         Texture::SharedPtr      mpImportanceMap;    ///< Hierarchical importance map (luminance).
         Sampler::SharedPtr      mpImportanceSampler;
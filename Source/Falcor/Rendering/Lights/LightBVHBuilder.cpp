@@ -27,7 +27,10 @@
  **************************************************************************/
 #include "stdafx.h"
 #include "LightBVHBuilder.h"
+#include "Utils/Threading.h"
 #include <algorithm>
+#include <array>
+#include <emmintrin.h>
 
 namespace
 {
@@ -41,6 +44,153 @@ namespace
     const uint32_t kMaxLeafTriangleCount = 1 << PackedNode::kTriangleCountBits;
     const uint32_t kMaxLeafTriangleOffset = 1 << PackedNode::kTriangleOffsetBits;
 
+    // Parallel build settings.
+    // The chunk size used for reductions over triangles is fixed so that the serial and parallel builds produce identical results.
+    const uint32_t kReductionChunkSize = 16384;
+    const uint32_t kMinParallelReductionTriangleCount = 4 * kReductionChunkSize;
+    const uint32_t kMinParallelSubtreeTriangleCount = 4096;
+
+    /** Reduces the range [begin, end) in chunks of kReductionChunkSize elements, combining the partial results in order.
+        The result only depends on the chunk size and not on the number of threads, so the serial and parallel paths are bit-identical.
+        \param[in] rangeFunc Function returning the partial result for a sub-range: Value rangeFunc(uint32_t first, uint32_t last, Value identity).
+        \param[in] reduceFunc Function combining two partial results: Value reduceFunc(Value a, const Value& b).
+        \param[in] parallel Process the chunks in parallel.
+    */
+    template<typename Value, typename RangeFunc, typename ReduceFunc>
+    Value chunkedReduce(uint32_t begin, uint32_t end, const Value& identity, const RangeFunc& rangeFunc, const ReduceFunc& reduceFunc, bool parallel)
+    {
+        if (parallel) return Threading::parallelReduce(begin, end, identity, rangeFunc, reduceFunc, kReductionChunkSize);
+
+        Value result = identity;
+        for (uint32_t first = begin; first < end; first += kReductionChunkSize)
+        {
+            result = reduceFunc(result, rangeFunc(first, std::min(end, first + kReductionChunkSize), identity));
+        }
+        return result;
+    }
+
+    /** Bin accumulated by the SIMD binning path. The xyz lanes hold the vector components, the w lane is unused.
+    */
+    struct SIMDBin
+    {
+        __m128 minPoint = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        __m128 maxPoint = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        __m128 coneDirection = _mm_setzero_ps();
+        float flux = 0.f;
+        uint32_t triangleCount = 0;
+
+        // Note the operand order in min/max: the SSE instructions return the second operand on ties (e.g. -0 vs +0),
+        // which keeps the accumulated value just like AABB::include() does.
+        SIMDBin& operator|= (const SIMDBin& rhs)
+        {
+            minPoint = _mm_min_ps(rhs.minPoint, minPoint);
+            maxPoint = _mm_max_ps(rhs.maxPoint, maxPoint);
+            coneDirection = _mm_add_ps(coneDirection, rhs.coneDirection);
+            flux += rhs.flux;
+            triangleCount += rhs.triangleCount;
+            return *this;
+        }
+
+        AABB getBounds() const
+        {
+            return AABB(storeFloat3(minPoint), storeFloat3(maxPoint));
+        }
+
+        float3 getConeDirection() const
+        {
+            return storeFloat3(coneDirection);
+        }
+
+        static __m128 loadFloat3(const float3& v)
+        {
+            return _mm_set_ps(0.f, v.z, v.y, v.x);
+        }
+
+        static float3 storeFloat3(__m128 v)
+        {
+            alignas(16) float f[4];
+            _mm_store_ps(f, v);
+            return float3(f[0], f[1], f[2]);
+        }
+    };
+
+    /** Maps triangle centroids to bin ids along all three axes at once.
+        The arithmetic is the same as in the scalar getBinId() helpers of the binned split heuristics, so the bin ids match exactly.
+    */
+    struct SIMDBinMapping
+    {
+        __m128 origin;
+        __m128 scale;
+        uint32_t maxBinId;
+
+        SIMDBinMapping(const AABB& nodeBounds, uint32_t binCount)
+            : maxBinId(binCount - 1)
+        {
+            const float3 w = nodeBounds.extent();
+            auto getScale = [binCount](float w) { return w > FLT_MIN ? (float)binCount / w : 0.f; };
+            origin = SIMDBin::loadFloat3(nodeBounds.minPoint);
+            scale = _mm_set_ps(0.f, getScale(w.z), getScale(w.y), getScale(w.x));
+        }
+
+        void getBinIds(const __m128& minPoint, const __m128& maxPoint, uint32_t binIds[3]) const
+        {
+            const __m128 center = _mm_mul_ps(_mm_add_ps(minPoint, maxPoint), _mm_set1_ps(0.5f));
+            alignas(16) int32_t ids[4];
+            _mm_store_si128((__m128i*)ids, _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(center, origin), scale)));
+            for (uint32_t i = 0; i < 3; ++i) binIds[i] = std::min((uint32_t)ids[i], maxBinId);
+        }
+
+        void getBinIds(const AABB& bounds, uint32_t binIds[3]) const
+        {
+            getBinIds(SIMDBin::loadFloat3(bounds.minPoint), SIMDBin::loadFloat3(bounds.maxPoint), binIds);
+        }
+    };
+
+    /** Bins a range of triangles along all three axes in a single pass using SSE.
+        The result is bit-identical to binning each axis separately with the scalar code.
+        \param[in] triangles Triangle data (LightBVHBuilder::TriangleSortData).
+        \param[in] accumulateCones Accumulate the flux and cone directions, otherwise only the bounds and triangle counts.
+        \return Bins for all three axes, stored axis by axis (3 * binCount entries).
+    */
+    template<typename TriangleData>
+    std::vector<SIMDBin> binTrianglesSIMD(const std::vector<TriangleData>& triangles, uint32_t begin, uint32_t end, const SIMDBinMapping& mapping, bool accumulateCones, bool parallel)
+    {
+        const uint32_t binCount = mapping.maxBinId + 1;
+        return chunkedReduce(begin, end, std::vector<SIMDBin>(3 * binCount),
+            [&](uint32_t first, uint32_t last, std::vector<SIMDBin> result)
+            {
+                uint32_t binIds[3];
+                for (uint32_t i = first; i < last; ++i)
+                {
+                    const auto& td = triangles[i];
+                    const __m128 minPoint = SIMDBin::loadFloat3(td.bounds.minPoint);
+                    const __m128 maxPoint = SIMDBin::loadFloat3(td.bounds.maxPoint);
+                    const __m128 coneDirection = accumulateCones ? SIMDBin::loadFloat3(td.coneDirection) : _mm_setzero_ps();
+                    mapping.getBinIds(minPoint, maxPoint, binIds);
+
+                    for (uint32_t axis = 0; axis < 3; ++axis)
+                    {
+                        SIMDBin& bin = result[axis * binCount + binIds[axis]];
+                        bin.minPoint = _mm_min_ps(minPoint, bin.minPoint);
+                        bin.maxPoint = _mm_max_ps(maxPoint, bin.maxPoint);
+                        bin.triangleCount++;
+                        if (accumulateCones)
+                        {
+                            bin.coneDirection = _mm_add_ps(bin.coneDirection, coneDirection);
+                            bin.flux += td.flux;
+                        }
+                    }
+                }
+                return result;
+            },
+            [](std::vector<SIMDBin> a, const std::vector<SIMDBin>& b)
+            {
+                for (size_t i = 0; i < a.size(); ++i) a[i] |= b[i];
+                return a;
+            },
+            parallel);
+    }
+
     inline float safeACos(float v)
     {
         return std::acos(glm::clamp(v, -1.0f, 1.0f));
@@ -83,6 +233,32 @@ namespace
         return cosResult;
     }
 
+    /** SSE version of computeCosConeAngle() evaluating up to four cones at once, one per lane, against the same second cone.
+        The operations are the same as in the scalar version, so the results are bit-identical as long as the scalar code is not contracted into FMAs.
+        \param[in] coneDirX, coneDirY, coneDirZ Cone directions of the four cones.
+        \param[in] cosTheta Cosines of the spread angles of the four cones.
+        \param[in] otherConeDir Direction of the second cone.
+        \param[in] cosOtherTheta Cosine of the spread angle of the second cone.
+        \return The cosines of the spread angles of the new cones.
+    */
+    __m128 computeCosConeAngleSIMD(__m128 coneDirX, __m128 coneDirY, __m128 coneDirZ, __m128 cosTheta, const float3& otherConeDir, const float cosOtherTheta)
+    {
+        const __m128 invalid = _mm_set1_ps(kInvalidCosConeAngle);
+        if (cosOtherTheta == kInvalidCosConeAngle) return invalid;
+
+        const __m128 cosDiffTheta = _mm_add_ps(_mm_add_ps(_mm_mul_ps(coneDirX, _mm_set1_ps(otherConeDir.x)), _mm_mul_ps(coneDirY, _mm_set1_ps(otherConeDir.y))), _mm_mul_ps(coneDirZ, _mm_set1_ps(otherConeDir.z)));
+        const __m128 sinDiffTheta = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(1.f), _mm_mul_ps(cosDiffTheta, cosDiffTheta)), _mm_setzero_ps()));
+        const __m128 cosOther = _mm_set1_ps(cosOtherTheta);
+        const __m128 sinOther = _mm_set1_ps(sinFromCos(cosOtherTheta));
+
+        const __m128 cosTotalTheta = _mm_sub_ps(_mm_mul_ps(cosOther, cosDiffTheta), _mm_mul_ps(sinOther, sinDiffTheta));
+        const __m128 sinTotalTheta = _mm_add_ps(_mm_mul_ps(sinOther, cosDiffTheta), _mm_mul_ps(cosOther, sinDiffTheta));
+
+        const __m128 valid = _mm_and_ps(_mm_cmpneq_ps(cosTheta, invalid), _mm_cmpgt_ps(sinTotalTheta, _mm_setzero_ps()));
+        const __m128 cosResult = _mm_min_ps(cosTotalTheta, cosTheta);
+        return _mm_or_ps(_mm_and_ps(valid, cosResult), _mm_andnot_ps(valid, invalid));
+    }
+
     /** Given two cones specified by direction vectors and the cosine of
         their spread angles, returns a cone that bounds both of them. This
         is what was used previously; the cones it returns aren't as tight as
@@ -242,12 +418,32 @@ namespace Falcor
         // Get global list of emissive triangles.
         assert(bvh.mpLightCollection);
         const auto& triangles = bvh.mpLightCollection->getMeshLightTriangles();
-        if (triangles.empty()) return;
+
+        std::vector<uint32_t> triangleIndices;
+        std::vector<uint64_t> triangleBitmasks;
+        if (!buildNodes(triangles, bvh.mNodes, triangleIndices, triangleBitmasks)) return;
+
+        // The BVH is ready, mark it as valid and upload the data.
+        bvh.mIsValid = true;
+        bvh.mMaxTriangleCountPerLeaf = mOptions.maxTriangleCountPerLeaf;
+        bvh.uploadCPUBuffers(triangleIndices, triangleBitmasks);
+
+        // Computate metadata.
+        bvh.finalize();
+    }
+
+    bool LightBVHBuilder::buildNodes(const std::vector<LightCollection::MeshLightTriangle>& triangles, std::vector<PackedNode>& nodes, std::vector<uint32_t>& triangleIndices, std::vector<uint64_t>& triangleBitmasks)
+    {
+        nodes.clear();
+        triangleIndices.clear();
+        triangleBitmasks.clear();
+
+        if (triangles.empty()) return false;
 
         // Create list of triangles that should be included in BVH.
         // For each triangle, precompute data we need for the build.
-        BuildingData data(bvh.mNodes);
-        data.trianglesData.reserve(triangles.size());
+        std::vector<TriangleSortData> trianglesData;
+        trianglesData.reserve(triangles.size());
 
         for (size_t i = 0; i < triangles.size(); i++)
         {
@@ -264,19 +460,19 @@ namespace Falcor
                 tri.flux = triangles[i].flux;
                 tri.triangleIndex = static_cast<uint32_t>(i);
 
-                data.trianglesData.push_back(tri);
+                trianglesData.push_back(tri);
             }
         }
 
         // If there are no non-culled triangles, we're done.
-        if (data.trianglesData.empty()) return;
+        if (trianglesData.empty()) return false;
 
         // Validate options.
         if (mOptions.maxTriangleCountPerLeaf > kMaxLeafTriangleCount)
         {
             throw std::exception(("Max triangle count per leaf exceeds the maximum supported (" + std::to_string(kMaxLeafTriangleCount) + ")").c_str());
         }
-        if (data.trianglesData.size() > kMaxLeafTriangleOffset + kMaxLeafTriangleCount)
+        if (trianglesData.size() > kMaxLeafTriangleOffset + kMaxLeafTriangleCount)
         {
             throw std::exception(("Emissive triangle count exceeds the maximum supported (" + std::to_string(kMaxLeafTriangleOffset + kMaxLeafTriangleCount) + ")").c_str());
         }
@@ -285,13 +481,13 @@ namespace Falcor
         // To be grossly conservative, assume each triangle requires two nodes.
         // This is only system RAM and shouldn't be that much, so it's not worth being more careful about it.
         // TODO: Better estimate of how many nodes we will need.
-        data.nodes.clear();
+        const uint64_t invalidBitmask = std::numeric_limits<uint64_t>::max();
+        triangleBitmasks.resize(triangles.size(), invalidBitmask); // This is sized based on input triangle count, as it's indexed by global triangle index.
+
+        BuildingData data(nodes, trianglesData, triangleBitmasks);
         data.nodes.reserve(2 * data.trianglesData.size());
         data.triangleIndices.reserve(data.trianglesData.size());
 
-        const uint64_t invalidBitmask = std::numeric_limits<uint64_t>::max();
-        data.triangleBitmasks.resize(triangles.size(), invalidBitmask); // This is sized based on input triangle count, as it's indexed by global triangle index.
-
         // Build the tree.
         SplitHeuristicFunction splitFunc = getSplitFunction(mOptions.splitHeuristicSelection);
         buildInternal(mOptions, splitFunc, 0ull, 0, Range(0, static_cast<uint32_t>(data.trianglesData.size())), data);
@@ -306,13 +502,8 @@ namespace Falcor
         float cosConeAngle;
         computeLightingConesInternal(0, data, cosConeAngle);
 
-        // The BVH is ready, mark it as valid and upload the data.
-        bvh.mIsValid = true;
-        bvh.mMaxTriangleCountPerLeaf = mOptions.maxTriangleCountPerLeaf;
-        bvh.uploadCPUBuffers(data.triangleIndices, data.triangleBitmasks);
-
-        // Computate metadata.
-        bvh.finalize();
+        triangleIndices = std::move(data.triangleIndices);
+        return true;
     }
 
     bool LightBVHBuilder::renderUI(Gui::Widgets& widget)
@@ -338,6 +529,8 @@ namespace Falcor
                 optionsChanged |= splitGroup.var("Bin count", options.binCount);
             }
             optionsChanged |= splitGroup.checkbox("Split along largest dimension", options.splitAlongLargest);
+            optionsChanged |= splitGroup.checkbox("Parallel build", options.useParallelBuild);
+            optionsChanged |= splitGroup.checkbox("SIMD binning", options.useSIMDBinning);
             optionsChanged |= splitGroup.checkbox("Use volume instead of surface area", options.useVolumeOverSA);
             if (options.useVolumeOverSA)
             {
@@ -365,13 +558,22 @@ namespace Falcor
         assert(triangleRange.begin < triangleRange.end);
 
         // Compute the AABB and total flux of the node.
-        float nodeFlux = 0.f;
-        AABB nodeBounds;
-        for (uint32_t dataIndex = triangleRange.begin; dataIndex < triangleRange.end; ++dataIndex)
-        {
-            nodeBounds |= data.trianglesData[dataIndex].bounds;
-            nodeFlux += data.trianglesData[dataIndex].flux;
-        }
+        using BoundsAndFlux = std::pair<AABB, float>;
+        const bool parallelReduction = options.useParallelBuild && triangleRange.length() >= kMinParallelReductionTriangleCount;
+        const BoundsAndFlux boundsAndFlux = chunkedReduce(triangleRange.begin, triangleRange.end, BoundsAndFlux(AABB(), 0.f),
+            [&data](uint32_t first, uint32_t last, BoundsAndFlux result)
+            {
+                for (uint32_t dataIndex = first; dataIndex < last; ++dataIndex)
+                {
+                    result.first |= data.trianglesData[dataIndex].bounds;
+                    result.second += data.trianglesData[dataIndex].flux;
+                }
+                return result;
+            },
+            [](BoundsAndFlux a, const BoundsAndFlux& b) { return BoundsAndFlux(a.first | b.first, a.second + b.second); },
+            parallelReduction);
+        const AABB& nodeBounds = boundsAndFlux.first;
+        const float nodeFlux = boundsAndFlux.second;
         assert(nodeBounds.valid());
 
         data.currentNodeFlux = nodeFlux;
@@ -405,8 +607,38 @@ namespace Falcor
                 throw std::exception(("BVH depth of " + std::to_string(depth + 1) + " reached; maximum of " + std::to_string(kMaxBVHDepth) + " allowed.").c_str());
             }
 
-            uint32_t leftIndex = buildInternal(options, splitHeuristic, bitmask | (0ull << depth), depth + 1, Range(triangleRange.begin, splitResult.triangleIndex), data);
-            uint32_t rightIndex = buildInternal(options, splitHeuristic, bitmask | (1ull << depth), depth + 1, Range(splitResult.triangleIndex, triangleRange.end), data);
+            const Range leftRange(triangleRange.begin, splitResult.triangleIndex);
+            const Range rightRange(splitResult.triangleIndex, triangleRange.end);
+            uint32_t leftIndex, rightIndex;
+
+            if (options.useParallelBuild && std::min(leftRange.length(), rightRange.length()) >= kMinParallelSubtreeTriangleCount)
+            {
+                // Build the right subtree into separate storage on another thread while this thread builds the left subtree.
+                // The right subtree is then appended after the left one, which gives the same node order as the serial build.
+                std::vector<PackedNode> rightNodes;
+                BuildingData rightData(rightNodes, data.trianglesData, data.triangleBitmasks);
+                auto rightTask = Threading::dispatchTask([&] () {
+                    buildInternal(options, splitHeuristic, bitmask | (1ull << depth), depth + 1, rightRange, rightData);
+                });
+                try
+                {
+                    leftIndex = buildInternal(options, splitHeuristic, bitmask | (0ull << depth), depth + 1, leftRange, data);
+                }
+                catch (...)
+                {
+                    // The right task references rightData on this stack frame, so it has to finish before unwinding.
+                    // Its own exception (if any) is dropped in favor of the one from the left subtree.
+                    try { rightTask.finish(); } catch (...) {}
+                    throw;
+                }
+                rightTask.finish();
+                rightIndex = appendSubtree(rightData, data);
+            }
+            else
+            {
+                leftIndex = buildInternal(options, splitHeuristic, bitmask | (0ull << depth), depth + 1, leftRange, data);
+                rightIndex = buildInternal(options, splitHeuristic, bitmask | (1ull << depth), depth + 1, rightRange, data);
+            }
 
             assert(leftIndex == nodeIndex + 1); // The left node should always be placed immediately after the current node.
             node.rightChildIdx = rightIndex;
@@ -448,6 +680,32 @@ namespace Falcor
         }
     }
 
+    uint32_t LightBVHBuilder::appendSubtree(const BuildingData& subtree, BuildingData& data)
+    {
+        assert(data.nodes.size() + subtree.nodes.size() < std::numeric_limits<uint32_t>::max());
+        const uint32_t nodeOffset = (uint32_t)data.nodes.size();
+        const uint32_t triangleOffset = (uint32_t)data.triangleIndices.size();
+
+        // Relocate the nodes by patching the packed right child index or triangle offset directly.
+        // Unpacking and repacking the node would not be lossless as the node attributes are compressed.
+        for (PackedNode node : subtree.nodes)
+        {
+            if (node.isLeaf())
+            {
+                assert((node.data[0].x & (kMaxLeafTriangleOffset - 1)) + triangleOffset < kMaxLeafTriangleOffset);
+                node.data[0].x += triangleOffset;
+            }
+            else
+            {
+                node.data[0].x += nodeOffset;
+            }
+            data.nodes.push_back(node);
+        }
+
+        data.triangleIndices.insert(data.triangleIndices.end(), subtree.triangleIndices.begin(), subtree.triangleIndices.end());
+        return nodeOffset;
+    }
+
     float3 LightBVHBuilder::computeLightingConesInternal(const uint32_t nodeIndex, BuildingData& data, float& cosConeAngle)
     {
         if (!data.nodes[nodeIndex].isLeaf())
@@ -563,7 +821,26 @@ namespace Falcor
             The triangles are binned to n bins, storing only the aggregate parameters (triangle count and bounds).
             Then the cost metric is evaluated for each of the n-1 potential splits.
         */
-        const auto binAlongDimension = [&bins, &costs, &triangleRange, &data, &parameters, &overallBestSplit, &nodeBounds](uint32_t dimension)
+        const bool parallel = parameters.useParallelBuild && triangleRange.length() >= kMinParallelReductionTriangleCount;
+
+        // With SIMD binning, the bins for all three axes are filled in a single pass over the triangles up front.
+        std::array<std::vector<Bin>, 3> axisBins;
+        if (parameters.useSIMDBinning)
+        {
+            const auto simdBins = binTrianglesSIMD(data.trianglesData, triangleRange.begin, triangleRange.end, SIMDBinMapping(nodeBounds, parameters.binCount), false, parallel);
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                axisBins[axis].resize(parameters.binCount);
+                for (uint32_t i = 0; i < parameters.binCount; ++i)
+                {
+                    const SIMDBin& simdBin = simdBins[axis * parameters.binCount + i];
+                    axisBins[axis][i].bounds = simdBin.getBounds();
+                    axisBins[axis][i].triangleCount = simdBin.triangleCount;
+                }
+            }
+        }
+
+        const auto binAlongDimension = [&bins, &costs, &axisBins, &triangleRange, &data, &parameters, &overallBestSplit, &nodeBounds, parallel](uint32_t dimension)
         {
             // Helper to compute the bin id for a given triangle.
             auto getBinId = [&](const TriangleSortData& td)
@@ -576,14 +853,29 @@ namespace Falcor
                 return std::min((uint32_t)((p - bmin) * scale), parameters.binCount - 1);
             };
 
-            // Reset the bins.
-            for (Bin& bin : bins) bin = Bin();
-
             // Fill the bins with all triangles.
-            for (uint32_t i = triangleRange.begin; i < triangleRange.end; ++i)
+            if (parameters.useSIMDBinning)
             {
-                const auto& td = data.trianglesData[i];
-                bins[getBinId(td)] |= td;
+                bins = axisBins[dimension];
+            }
+            else
+            {
+                bins = chunkedReduce(triangleRange.begin, triangleRange.end, std::vector<Bin>(bins.size()),
+                    [&](uint32_t first, uint32_t last, std::vector<Bin> result)
+                    {
+                        for (uint32_t i = first; i < last; ++i)
+                        {
+                            const auto& td = data.trianglesData[i];
+                            result[getBinId(td)] |= td;
+                        }
+                        return result;
+                    },
+                    [](std::vector<Bin> a, const std::vector<Bin>& b)
+                    {
+                        for (size_t i = 0; i < a.size(); ++i) a[i] |= b[i];
+                        return a;
+                    },
+                    parallel);
             }
 
             // First, compute A_j(L) * N_j(L) by sweeping over the bins from left to right.
@@ -719,6 +1011,15 @@ namespace Falcor
                 // Note: cosConeAngle should be computed separately after the final cone direction is known
                 return *this;
             }
+
+            /** Normalizes the accumulated cone direction and resets the cone angle before growing it to include all lights in the bin.
+                If the vector is zero length (no lights or if all directions cancelled out), the cone is marked as invalid.
+            */
+            void initCone()
+            {
+                cosConeAngle = glm::length(coneDirection) < FLT_MIN ? kInvalidCosConeAngle : 1.0f;
+                coneDirection = glm::normalize(coneDirection);
+            }
         };
 
         assert(parameters.binCount > 1);
@@ -732,7 +1033,74 @@ namespace Falcor
             the bounding cones are approximates based on the bins' bounding cones. This is less expensive,
             but also less precise than computing them directly from the triangles.
         */
-        const auto binAlongDimension = [&bins, &costs, &triangleRange, &data, &parameters, &overallBestSplit, &nodeBounds, largestDimension, dimensions](uint32_t dimension)
+        const bool parallel = parameters.useParallelBuild && triangleRange.length() >= kMinParallelReductionTriangleCount;
+
+        // With SIMD binning, the bins and their lighting cones for all three axes are computed up front.
+        // Each of the two passes over the triangles handles all axes at once.
+        std::array<std::vector<Bin>, 3> axisBins;
+        if (parameters.useSIMDBinning)
+        {
+            const SIMDBinMapping mapping(nodeBounds, parameters.binCount);
+            const auto simdBins = binTrianglesSIMD(data.trianglesData, triangleRange.begin, triangleRange.end, mapping, true, parallel);
+
+            std::vector<float> binCosConeAngles(3 * parameters.binCount);
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                axisBins[axis].resize(parameters.binCount);
+                for (uint32_t i = 0; i < parameters.binCount; ++i)
+                {
+                    const SIMDBin& simdBin = simdBins[axis * parameters.binCount + i];
+                    Bin& bin = axisBins[axis][i];
+                    bin.bounds = simdBin.getBounds();
+                    bin.triangleCount = simdBin.triangleCount;
+                    bin.flux = simdBin.flux;
+                    bin.coneDirection = simdBin.getConeDirection();
+                    bin.initCone();
+                    binCosConeAngles[axis * parameters.binCount + i] = bin.cosConeAngle;
+                }
+            }
+
+            binCosConeAngles = chunkedReduce(triangleRange.begin, triangleRange.end, binCosConeAngles,
+                [&](uint32_t first, uint32_t last, std::vector<float> result)
+                {
+                    uint32_t binIds[3];
+                    for (uint32_t i = first; i < last; ++i)
+                    {
+                        const auto& td = data.trianglesData[i];
+                        mapping.getBinIds(td.bounds, binIds);
+
+                        const float3& d0 = axisBins[0][binIds[0]].coneDirection;
+                        const float3& d1 = axisBins[1][binIds[1]].coneDirection;
+                        const float3& d2 = axisBins[2][binIds[2]].coneDirection;
+                        float& c0 = result[binIds[0]];
+                        float& c1 = result[parameters.binCount + binIds[1]];
+                        float& c2 = result[2 * parameters.binCount + binIds[2]];
+
+                        // The lanes hold the bins of the three axes. The unused w lane is an invalid cone, which the update leaves unchanged.
+                        alignas(16) float cosConeAngles[4];
+                        _mm_store_ps(cosConeAngles, computeCosConeAngleSIMD(
+                            _mm_set_ps(0.f, d2.x, d1.x, d0.x), _mm_set_ps(0.f, d2.y, d1.y, d0.y), _mm_set_ps(0.f, d2.z, d1.z, d0.z),
+                            _mm_set_ps(kInvalidCosConeAngle, c2, c1, c0), td.coneDirection, td.cosConeAngle));
+                        c0 = cosConeAngles[0];
+                        c1 = cosConeAngles[1];
+                        c2 = cosConeAngles[2];
+                    }
+                    return result;
+                },
+                [](std::vector<float> a, const std::vector<float>& b)
+                {
+                    for (size_t i = 0; i < a.size(); ++i) a[i] = std::min(a[i], b[i]);
+                    return a;
+                },
+                parallel);
+
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                for (uint32_t i = 0; i < parameters.binCount; ++i) axisBins[axis][i].cosConeAngle = binCosConeAngles[axis * parameters.binCount + i];
+            }
+        }
+
+        const auto binAlongDimension = [&bins, &costs, &axisBins, &triangleRange, &data, &parameters, &overallBestSplit, &nodeBounds, largestDimension, dimensions, parallel](uint32_t dimension)
         {
             // Helper to compute the bin id for a given triangle.
             auto getBinId = [&](const TriangleSortData& td)
@@ -746,30 +1114,55 @@ namespace Falcor
                 return std::min((uint32_t)((p - bmin) * scale), parameters.binCount - 1);
             };
 
-            // Reset the bins.
-            for (Bin& bin : bins) bin = Bin();
-
-            // Fill the bins with all triangles.
-            for (uint32_t i = triangleRange.begin; i < triangleRange.end; ++i)
-            {
-                const auto& td = data.trianglesData[i];
-                bins[getBinId(td)] |= td;
-            }
-
-            // Compute the lighting cones for each bin.
-            // The cone direction is the average direction over all lights in the bin and the cone angle is grown to include all.
-            // If the vector is zero length (no lights or if all directions cancelled out), the cone is marked as invalid.
-            // TODO: Switch to a more sophisticated algorithm to get narrower cones.
-            for (Bin& bin : bins)
+            if (parameters.useSIMDBinning)
             {
-                bin.cosConeAngle = glm::length(bin.coneDirection) < FLT_MIN ? kInvalidCosConeAngle : 1.0f;
-                bin.coneDirection = glm::normalize(bin.coneDirection);
+                bins = axisBins[dimension];
             }
-            for (uint32_t i = triangleRange.begin; i < triangleRange.end; ++i)
+            else
             {
-                const auto& td = data.trianglesData[i];
-                Bin& bin = bins[getBinId(td)];
-                bin.cosConeAngle = computeCosConeAngle(bin.coneDirection, bin.cosConeAngle, td.coneDirection, td.cosConeAngle);
+                // Fill the bins with all triangles.
+                bins = chunkedReduce(triangleRange.begin, triangleRange.end, std::vector<Bin>(bins.size()),
+                    [&](uint32_t first, uint32_t last, std::vector<Bin> result)
+                    {
+                        for (uint32_t i = first; i < last; ++i)
+                        {
+                            const auto& td = data.trianglesData[i];
+                            result[getBinId(td)] |= td;
+                        }
+                        return result;
+                    },
+                    [](std::vector<Bin> a, const std::vector<Bin>& b)
+                    {
+                        for (size_t i = 0; i < a.size(); ++i) a[i] |= b[i];
+                        return a;
+                    },
+                    parallel);
+
+                // Compute the lighting cones for each bin.
+                // The cone direction is the average direction over all lights in the bin and the cone angle is grown to include all.
+                // TODO: Switch to a more sophisticated algorithm to get narrower cones.
+                for (Bin& bin : bins) bin.initCone();
+                // computeCosConeAngle() only ever lowers the cosine (kInvalidCosConeAngle is the smallest value), so partial results are combined with min.
+                std::vector<float> binCosConeAngles(bins.size());
+                for (size_t i = 0; i < bins.size(); ++i) binCosConeAngles[i] = bins[i].cosConeAngle;
+                binCosConeAngles = chunkedReduce(triangleRange.begin, triangleRange.end, binCosConeAngles,
+                    [&](uint32_t first, uint32_t last, std::vector<float> result)
+                    {
+                        for (uint32_t i = first; i < last; ++i)
+                        {
+                            const auto& td = data.trianglesData[i];
+                            uint32_t binId = getBinId(td);
+                            result[binId] = computeCosConeAngle(bins[binId].coneDirection, result[binId], td.coneDirection, td.cosConeAngle);
+                        }
+                        return result;
+                    },
+                    [](std::vector<float> a, const std::vector<float>& b)
+                    {
+                        for (size_t i = 0; i < a.size(); ++i) a[i] = std::min(a[i], b[i]);
+                        return a;
+                    },
+                    parallel);
+                for (size_t i = 0; i < bins.size(); ++i) bins[i].cosConeAngle = binCosConeAngles[i];
             }
 
             // First, compute A_j(L) * N_j(L) by sweeping over the bins from left to right.
@@ -913,6 +1306,8 @@ namespace Falcor
         options.field(allowRefitting);
         options.field(usePreintegration);
         options.field(useLightingCones);
+        options.field(useParallelBuild);
+        options.field(useSIMDBinning);
 #undef field
     }
 }
@@ -71,6 +71,8 @@ namespace Falcor
             bool           allowRefitting = true;                                ///< Rather than always rebuilding the BVH from scratch, keep the hierarchy but update the bounds and lighting cones.
             bool           usePreintegration = true;                             ///< Use pre-integration for culling out emissive triangles and use their flux when computing the splits. Only valid when using the BinnedSAOH split heuristic.
             bool           useLightingCones = true;                              ///< Use lighting cones when computing the splits. Only valid when using the BinnedSAOH split heuristic.
+            bool           useParallelBuild = true;                              ///< Build large subtrees as parallel tasks and bin the triangles of large nodes in parallel. The resulting BVH is identical to the serial build.
+            bool           useSIMDBinning = true;                                ///< Bin the triangles along all three axes in a single SSE pass when evaluating the BinnedSAH and BinnedSAOH splits. The resulting BVH is identical to the scalar binning.
         };
 
         /** Creates a new object.
@@ -83,6 +85,16 @@ namespace Falcor
         */
         void build(LightBVH& bvh);
 
+        /** Build the BVH nodes on the CPU without creating any GPU resources.
+            This is used by build() and allows testing and benchmarking the builder without a light collection.
+            \param[in] triangles Emissive triangles to build the BVH over.
+            \param[out] nodes BVH nodes in depth-first order.
+            \param[out] triangleIndices Triangle indices sorted by leaf node.
+            \param[out] triangleBitmasks Per triangle bit pattern retracing the tree traversal to reach the triangle. Indexed by global triangle index.
+            \return True if a BVH was built, false if no triangles were included.
+        */
+        bool buildNodes(const std::vector<LightCollection::MeshLightTriangle>& triangles, std::vector<PackedNode>& nodes, std::vector<uint32_t>& triangleIndices, std::vector<uint64_t>& triangleBitmasks);
+
         virtual bool renderUI(Gui::Widgets& widget);
 
         const Options& getOptions() const { return mOptions; }
@@ -123,12 +135,13 @@ namespace Falcor
         struct BuildingData
         {
             std::vector<PackedNode>& nodes;                 ///< BVH nodes generated by the builder.
-            std::vector<TriangleSortData> trianglesData;    ///< Compact list of triangles to include in build.
+            std::vector<TriangleSortData>& trianglesData;   ///< Compact list of triangles to include in build. Shared between subtrees built in parallel, which operate on disjoint ranges.
+            std::vector<uint64_t>& triangleBitmasks;        ///< Array containing the per triangle bit pattern retracing the tree traversal to reach the triangle: 0=left child, 1=right child; this array gets filled in during the build process. Indexed by global triangle index.
             std::vector<uint32_t> triangleIndices;          ///< Triangle indices sorted by leaf node. Each leaf node refers to a contiguous array of triangle indices.
-            std::vector<uint64_t> triangleBitmasks;         ///< Array containing the per triangle bit pattern retracing the tree traversal to reach the triangle: 0=left child, 1=right child; this array gets filled in during the build process. Indexed by global triangle index.
             float currentNodeFlux = 0.f;                    ///< Used by computeSAOHSplit() as the leaf creation cost.
 
-            BuildingData(std::vector<PackedNode>& bvhNodes) : nodes(bvhNodes) {}
+            BuildingData(std::vector<PackedNode>& bvhNodes, std::vector<TriangleSortData>& triangles, std::vector<uint64_t>& bitmasks)
+                : nodes(bvhNodes), trianglesData(triangles), triangleBitmasks(bitmasks) {}
         };
 
         /** Compute the split according to a specified heuristic.
@@ -155,6 +168,14 @@ namespace Falcor
         */
         uint32_t buildInternal(const Options& options, const SplitHeuristicFunction& splitHeuristic, uint64_t bitmask, uint32_t depth, const Range& triangleRange, BuildingData& data);
 
+        /** Append a subtree that was built into separate storage.
+            The node and triangle offsets of the subtree are relocated to the end of the destination.
+            \param[in] subtree Subtree data.
+            \param[in,out] data Destination data.
+            \return Index of the subtree root node in the destination.
+        */
+        static uint32_t appendSubtree(const BuildingData& subtree, BuildingData& data);
+
         /** Recursive computation of lighting cones for all internal nodes.
             \param[in] nodeIndex Index of the current node.
             \param[in,out] data Updated node data.
@@ -296,7 +296,7 @@ namespace Falcor
         return m;
     }
 
-    void AnimationController::createSkinningPass(const std::vector<PackedStaticVertexData>& staticVertexData, const std::vector<DynamicVertexData>& dynamicVertexData)
+    void AnimationController::createSkinningPass(const StaticVertexVector& staticVertexData, const DynamicVertexVector& dynamicVertexData)
     {
         // We always copy the static data, to initialize the non-skinned vertices.
         const Buffer::SharedPtr& pVB = mpScene->mpVao->getVertexBuffer(Scene::kStaticDataBufferIndex);
@@ -30,6 +30,7 @@
 #include "AnimatedVertexCache.h"
 #include "RenderGraph/BasePasses/ComputePass.h"
 #include "Scene/SceneTypes.slang"
+#include "Utils/ArrayView.h"
 
 namespace Falcor
 {
@@ -45,8 +46,8 @@ namespace Falcor
         static const uint32_t kInvalidBoneID = -1;
         ~AnimationController() = default;
 
-        using StaticVertexVector = std::vector<PackedStaticVertexData>;
-        using DynamicVertexVector = std::vector<DynamicVertexData>;
+        using StaticVertexVector = ArrayView<PackedStaticVertexData>;
+        using DynamicVertexVector = ArrayView<DynamicVertexData>;
 
         /** Create a new object.
             \return A new object, or throws an exception if creation failed.
@@ -142,7 +143,7 @@ namespace Falcor
 
         void bindBuffers();
 
-        void createSkinningPass(const std::vector<PackedStaticVertexData>& staticVertexData, const std::vector<DynamicVertexData>& dynamicVertexData);
+        void createSkinningPass(const StaticVertexVector& staticVertexData, const DynamicVertexVector& dynamicVertexData);
         void executeSkinningPass(RenderContext* pContext, bool initPrev = false);
 
         // Animation
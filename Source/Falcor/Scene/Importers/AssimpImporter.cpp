@@ -35,8 +35,7 @@
 #include "Utils/Timing/TimeReport.h"
 #include "Core/API/Device.h"
 #include "Scene/SceneBuilder.h"
-
-#include <execution>
+#include "Utils/Threading.h"
 
 namespace Falcor
 {
@@ -516,8 +515,7 @@ namespace Falcor
 
             // Pre-process meshes.
             std::vector<SceneBuilder::ProcessedMesh> processedMeshes(meshCount);
-            auto range = NumericRange<uint32_t>(0, meshCount);
-            std::for_each(std::execution::par, range.begin(), range.end(), [&] (uint32_t i) {
+            Threading::parallelFor(0u, meshCount, [&] (uint32_t i) {
                 const aiMesh* pAiMesh = pScene->mMeshes[i];
                 const uint32_t perFaceIndexCount = pAiMesh->mFaces[0].mNumIndices;
 
@@ -29,6 +29,7 @@
 #include "EnvMap.h"
 #include "glm/gtc/integer.hpp"
 #include "glm/gtx/euler_angles.hpp"
+#include <filesystem>
 
 namespace Falcor
 {
@@ -77,6 +78,31 @@ namespace Falcor
         mData.tint = tint;
     }
 
+    bool EnvMap::buildImportanceMap(uint32_t dimension, uint32_t samples)
+    {
+        if (mpImportanceMap && mpImportanceMap->getDimension() == dimension && mpImportanceMap->getSamples() == samples) return true;
+
+        const std::string& filename = getFilename();
+        if (filename.empty() || hasSuffix(filename, ".dds")) return false;
+
+        // Get the file stamp before reading the file, so a concurrent change is detected when validating the scene cache.
+        std::error_code ec;
+        const uint64_t fileSize = std::filesystem::file_size(filename, ec);
+        if (ec) return false;
+        const int64_t fileWriteTime = (int64_t)std::filesystem::last_write_time(filename, ec).time_since_epoch().count();
+        if (ec) return false;
+
+        auto contentHash = SHA1::computeFile(filename);
+        auto pBitmap = Bitmap::createFromFile(filename, true);
+        if (!contentHash || !pBitmap || !EnvMapImportanceMap::isFormatSupported(pBitmap->getFormat())) return false;
+
+        auto pImportanceMap = EnvMapImportanceMap::create(*pBitmap, dimension, samples);
+        pImportanceMap->setContentHash(*contentHash);
+        pImportanceMap->setFileStamp(fileSize, fileWriteTime);
+        mpImportanceMap = pImportanceMap;
+        return true;
+    }
+
     void EnvMap::setShaderData(const ShaderVar& var) const
     {
         assert(var.isValid());
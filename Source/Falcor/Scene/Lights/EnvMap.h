@@ -29,6 +29,7 @@
 
 #include "Falcor.h"
 #include "EnvMapData.slang"
+#include "EnvMapImportanceMap.h"
 
 namespace Falcor
 {
@@ -91,6 +92,19 @@ namespace Falcor
         const Texture::SharedPtr& getEnvMap() const { return mpEnvMap; }
         const Sampler::SharedPtr& getEnvSampler() const { return mpEnvSampler; }
 
+        /** Build the importance map for sampling the environment map on the CPU (see EnvMapImportanceMap).
+            The map is built from the source file of the environment map texture. It is stored in the scene cache
+            and used by EnvMapSampler instead of building the importance map on the GPU.
+            \param[in] dimension Resolution of the most detailed mip level. Must be a power of two.
+            \param[in] samples Number of samples per texel of the most detailed mip level. Must be a power of two.
+            \return True if the importance map is available, false if it can't be built from the source file (e.g. for DDS files).
+        */
+        bool buildImportanceMap(uint32_t dimension = EnvMapImportanceMap::kDefaultDimension, uint32_t samples = EnvMapImportanceMap::kDefaultSamples);
+
+        /** Get the importance map built on the CPU, or nullptr if it hasn't been built.
+        */
+        const EnvMapImportanceMap::SharedConstPtr& getImportanceMap() const { return mpImportanceMap; }
+
         /** Bind the environment map to a given shader variable.
             \param[in] var Shader variable.
         */
@@ -120,6 +134,7 @@ namespace Falcor
 
         Texture::SharedPtr      mpEnvMap;           ///< Loaded environment map (RGB).
         Sampler::SharedPtr      mpEnvSampler;
+        EnvMapImportanceMap::SharedConstPtr mpImportanceMap;    ///< Importance map built on the CPU, or nullptr.
 
         EnvMapData              mData;
         EnvMapData              mPrevData;
@@ -0,0 +1,340 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "EnvMapImportanceMap.h"
+#include "Utils/Threading.h"
+#include <emmintrin.h>
+
+namespace Falcor
+{
+    namespace
+    {
+        // Luminance weights used by luminance() in ColorHelpers.slang.
+        const float kLumR = 0.2126f;
+        const float kLumG = 0.7152f;
+        const float kLumB = 0.0722f;
+
+        float luminance(float r, float g, float b)
+        {
+            return r * kLumR + g * kLumG + b * kLumB;
+        }
+
+        /** Convert a row of texels to luminance.
+            Channels that are missing in the format read as zero, as they do in texture fetches on the GPU.
+        */
+        void computeLuminanceRow(ResourceFormat format, const uint8_t* pSrc, uint32_t width, float* pDst)
+        {
+            switch (format)
+            {
+            case ResourceFormat::RGBA32Float:
+            {
+                // Transpose 4 texels at a time to compute 4 luminance values per instruction.
+                const float* pTexels = reinterpret_cast<const float*>(pSrc);
+                const __m128 wr = _mm_set1_ps(kLumR), wg = _mm_set1_ps(kLumG), wb = _mm_set1_ps(kLumB);
+                uint32_t x = 0;
+                for (; x + 4 <= width; x += 4)
+                {
+                    __m128 r = _mm_loadu_ps(pTexels + 4 * x);
+                    __m128 g = _mm_loadu_ps(pTexels + 4 * x + 4);
+                    __m128 b = _mm_loadu_ps(pTexels + 4 * x + 8);
+                    __m128 a = _mm_loadu_ps(pTexels + 4 * x + 12);
+                    _MM_TRANSPOSE4_PS(r, g, b, a);
+                    _mm_storeu_ps(pDst + x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, wr), _mm_mul_ps(g, wg)), _mm_mul_ps(b, wb)));
+                }
+                for (; x < width; x++) pDst[x] = luminance(pTexels[4 * x], pTexels[4 * x + 1], pTexels[4 * x + 2]);
+                break;
+            }
+            case ResourceFormat::RGB32Float:
+            {
+                const float* pTexels = reinterpret_cast<const float*>(pSrc);
+                for (uint32_t x = 0; x < width; x++) pDst[x] = luminance(pTexels[3 * x], pTexels[3 * x + 1], pTexels[3 * x + 2]);
+                break;
+            }
+            case ResourceFormat::RGBA16Float:
+            case ResourceFormat::RGB16Float:
+            {
+                const glm::detail::hdata* pTexels = reinterpret_cast<const glm::detail::hdata*>(pSrc);
+                const uint32_t stride = format == ResourceFormat::RGBA16Float ? 4 : 3;
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    const glm::detail::hdata* pTexel = pTexels + stride * x;
+                    pDst[x] = luminance(glm::detail::toFloat32(pTexel[0]), glm::detail::toFloat32(pTexel[1]), glm::detail::toFloat32(pTexel[2]));
+                }
+                break;
+            }
+            case ResourceFormat::RGBA8Unorm:
+            case ResourceFormat::BGRA8Unorm:
+            case ResourceFormat::BGRX8Unorm:
+            {
+                const bool bgr = format != ResourceFormat::RGBA8Unorm;
+                for (uint32_t x = 0; x < width; x++)
+                {
+                    const uint8_t* pTexel = pSrc + 4 * x;
+                    float r = pTexel[bgr ? 2 : 0] / 255.f, g = pTexel[1] / 255.f, b = pTexel[bgr ? 0 : 2] / 255.f;
+                    pDst[x] = luminance(r, g, b);
+                }
+                break;
+            }
+            case ResourceFormat::RG8Unorm:
+                for (uint32_t x = 0; x < width; x++) pDst[x] = luminance(pSrc[2 * x] / 255.f, pSrc[2 * x + 1] / 255.f, 0.f);
+                break;
+            case ResourceFormat::R8Unorm:
+                for (uint32_t x = 0; x < width; x++) pDst[x] = luminance(pSrc[x] / 255.f, 0.f, 0.f);
+                break;
+            case ResourceFormat::R16Unorm:
+            {
+                const uint16_t* pTexels = reinterpret_cast<const uint16_t*>(pSrc);
+                for (uint32_t x = 0; x < width; x++) pDst[x] = luminance(pTexels[x] / 65535.f, 0.f, 0.f);
+                break;
+            }
+            default:
+                should_not_get_here();
+            }
+        }
+
+        /** Luminance of a lat-long map sampled with bilinear filtering.
+            Addressing matches the env map sampler: U wraps around, V is clamped.
+        */
+        class LuminanceImage
+        {
+        public:
+            LuminanceImage(const Bitmap& image)
+                : mWidth(image.getWidth())
+                , mHeight(image.getHeight())
+                , mData(size_t(mWidth) * mHeight)
+            {
+                Threading::parallelFor(0u, mHeight, [&](uint32_t y)
+                {
+                    computeLuminanceRow(image.getFormat(), image.getData() + size_t(y) * image.getRowPitch(), mWidth, mData.data() + size_t(y) * mWidth);
+                });
+            }
+
+            float sample(float2 uv) const
+            {
+                float x = uv.x * mWidth - 0.5f;
+                float y = uv.y * mHeight - 0.5f;
+                float x0 = std::floor(x), y0 = std::floor(y);
+                float fx = x - x0, fy = y - y0;
+
+                int ix = int(x0) % int(mWidth);
+                if (ix < 0) ix += int(mWidth);
+                uint32_t xa = uint32_t(ix), xb = xa + 1 < mWidth ? xa + 1 : 0;
+                uint32_t ya = uint32_t(std::clamp(int(y0), 0, int(mHeight) - 1));
+                uint32_t yb = uint32_t(std::clamp(int(y0) + 1, 0, int(mHeight) - 1));
+
+                const float* pRowA = mData.data() + size_t(ya) * mWidth;
+                const float* pRowB = mData.data() + size_t(yb) * mWidth;
+                float a = pRowA[xa] + (pRowA[xb] - pRowA[xa]) * fx;
+                float b = pRowB[xa] + (pRowB[xb] - pRowB[xa]) * fx;
+                return a + (b - a) * fy;
+            }
+
+        private:
+            uint32_t mWidth;
+            uint32_t mHeight;
+            std::vector<float> mData;
+        };
+
+        float signOf(float x)
+        {
+            return x > 0.f ? 1.f : (x < 0.f ? -1.f : 0.f);
+        }
+
+        /** Port of oct_to_ndir_equal_area_unorm() in MathHelpers.slang.
+        */
+        float3 octToDirEqualAreaUnorm(float2 p)
+        {
+            p = p * 2.f - 1.f;
+            float d = 1.f - (std::abs(p.x) + std::abs(p.y));
+            float r = 1.f - std::abs(d);
+            float phi = (r > 0.f) ? ((std::abs(p.y) - std::abs(p.x)) / r + 1.f) * (float)M_PI_4 : 0.f;
+            float f = r * std::sqrt(2.f - r * r);
+            return float3(f * signOf(p.x) * std::cos(phi), f * signOf(p.y) * std::sin(phi), signOf(d) * (1.f - r * r));
+        }
+
+        /** Port of world_to_latlong_map() in MathHelpers.slang.
+        */
+        float2 dirToLatLong(float3 dir)
+        {
+            float3 p = glm::normalize(dir);
+            return float2(std::atan2(p.x, -p.z) * float(M_1_PI) * 0.5f + 0.5f, std::acos(std::clamp(p.y, -1.f, 1.f)) * float(M_1_PI));
+        }
+    }
+
+    EnvMapImportanceMap::SharedPtr EnvMapImportanceMap::create(const Bitmap& image, uint32_t dimension, uint32_t samples)
+    {
+        if (!isFormatSupported(image.getFormat())) throw std::exception(("Can't build an environment map importance map from format " + to_string(image.getFormat())).c_str());
+        if (!isPowerOf2(dimension) || !isPowerOf2(samples)) throw std::exception("Environment map importance map dimension and sample count must be powers of two");
+
+        SharedPtr pMap = SharedPtr(new EnvMapImportanceMap(dimension, samples));
+        LuminanceImage luminanceImage(image);
+
+        // Compute the most detailed mip level. Samples are placed and accumulated in the same order as in EnvMapSamplerSetup.cs.slang.
+        uint32_t samplesX = std::max(1u, (uint32_t)std::sqrt(samples));
+        uint32_t samplesY = samples / samplesX;
+        assert(samples == samplesX * samplesY);
+        float2 invDimInSamples = 1.f / float2(dimension * samplesX, dimension * samplesY);
+        float invSamples = 1.f / (samplesX * samplesY);
+
+        float* pBase = pMap->mData.data();
+        Threading::parallelFor(0u, dimension, [&](uint32_t y)
+        {
+            for (uint32_t x = 0; x < dimension; x++)
+            {
+                float L = 0.f;
+                for (uint32_t sy = 0; sy < samplesY; sy++)
+                {
+                    for (uint32_t sx = 0; sx < samplesX; sx++)
+                    {
+                        float2 p = (float2(x * samplesX + sx, y * samplesY + sy) + 0.5f) * invDimInSamples;
+                        L += luminanceImage.sample(dirToLatLong(octToDirEqualAreaUnorm(p)));
+                    }
+                }
+                pBase[size_t(y) * dimension + x] = L * invSamples;
+            }
+        });
+
+        // Reduce to the less detailed mip levels by averaging 2x2 texels, as the GPU mip generation does.
+        for (uint32_t mip = 1; mip < pMap->getMipCount(); mip++)
+        {
+            const float* pSrc = pMap->getMip(mip - 1);
+            float* pDst = pMap->mData.data() + pMap->mMipOffsets[mip];
+            uint32_t srcDim = dimension >> (mip - 1), dstDim = dimension >> mip;
+            Threading::parallelFor(0u, dstDim, [&](uint32_t y)
+            {
+                const float* pRow0 = pSrc + size_t(2 * y) * srcDim;
+                const float* pRow1 = pRow0 + srcDim;
+                for (uint32_t x = 0; x < dstDim; x++)
+                {
+                    pDst[size_t(y) * dstDim + x] = (pRow0[2 * x] + pRow0[2 * x + 1] + pRow1[2 * x] + pRow1[2 * x + 1]) * 0.25f;
+                }
+            });
+        }
+
+        return pMap;
+    }
+
+    EnvMapImportanceMap::SharedPtr EnvMapImportanceMap::create(uint32_t dimension, uint32_t samples, std::vector<float> data)
+    {
+        if (!isPowerOf2(dimension)) throw std::exception("Environment map importance map dimension must be a power of two");
+
+        SharedPtr pMap = SharedPtr(new EnvMapImportanceMap(dimension, samples));
+        if (data.size() != pMap->mData.size()) throw std::exception("Environment map importance map data doesn't match its dimension");
+        pMap->mData = std::move(data);
+        return pMap;
+    }
+
+    bool EnvMapImportanceMap::isFormatSupported(ResourceFormat format)
+    {
+        switch (format)
+        {
+        case ResourceFormat::RGBA32Float:
+        case ResourceFormat::RGB32Float:
+        case ResourceFormat::RGBA16Float:
+        case ResourceFormat::RGB16Float:
+        case ResourceFormat::RGBA8Unorm:
+        case ResourceFormat::BGRA8Unorm:
+        case ResourceFormat::BGRX8Unorm:
+        case ResourceFormat::RG8Unorm:
+        case ResourceFormat::R8Unorm:
+        case ResourceFormat::R16Unorm:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    float2 EnvMapImportanceMap::sample(float2 rnd, float& pdf) const
+    {
+        float2 p = rnd;
+        uint2 pos = uint2(0);
+
+        // Iterate over mips of 2x2...NxN resolution.
+        for (int mip = (int)getMipCount() - 2; mip >= 0; mip--)
+        {
+            pos *= 2u;
+
+            const float* pMip = getMip(mip);
+            uint32_t dim = mDimension >> mip;
+            float w[4];
+            w[0] = pMip[pos.y * dim + pos.x];
+            w[1] = pMip[pos.y * dim + pos.x + 1];
+            w[2] = pMip[(pos.y + 1) * dim + pos.x];
+            w[3] = pMip[(pos.y + 1) * dim + pos.x + 1];
+
+            float q[2] = { w[0] + w[2], w[1] + w[3] };
+            uint2 off;
+
+            // Horizontal warp.
+            float d = q[0] / (q[0] + q[1]);
+            if (p.x < d)
+            {
+                off.x = 0;
+                p.x = p.x / d;
+            }
+            else
+            {
+                off.x = 1;
+                p.x = (p.x - d) / (1.f - d);
+            }
+
+            // Vertical warp.
+            float e = w[off.x] / q[off.x];
+            if (p.y < e)
+            {
+                off.y = 0;
+                p.y = p.y / e;
+            }
+            else
+            {
+                off.y = 1;
+                p.y = (p.y - e) / (1.f - e);
+            }
+
+            pos += off;
+        }
+
+        float avg = getMip(getMipCount() - 1)[0];
+        pdf = getMip(0)[pos.y * mDimension + pos.x] / avg;
+        return (float2(pos) + p) / float(mDimension);
+    }
+
+    EnvMapImportanceMap::EnvMapImportanceMap(uint32_t dimension, uint32_t samples)
+        : mDimension(dimension)
+        , mSamples(samples)
+    {
+        assert(isPowerOf2(dimension));
+        size_t offset = 0;
+        for (uint32_t dim = dimension; dim > 0; dim >>= 1)
+        {
+            mMipOffsets.push_back(offset);
+            offset += size_t(dim) * dim;
+        }
+        mData.resize(offset);
+    }
+}
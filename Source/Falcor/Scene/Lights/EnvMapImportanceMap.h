@@ -0,0 +1,118 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include "Utils/Image/Bitmap.h"
+#include "Utils/CryptoUtils.h"
+
+namespace Falcor
+{
+    /** Hierarchical importance map of an environment map, built on the CPU.
+
+        The map has the same layout as the importance map EnvMapSampler builds on the GPU. The most detailed mip level
+        is a square power-of-two grid over the equal-area octahedral map of the sphere. Each texel holds the average
+        luminance of the lat-long environment map over the texel, estimated with a regular grid of bilinear samples.
+        Each following mip level holds the average of 2x2 texels of the previous one, down to a single texel holding
+        the average over the sphere. The data can be uploaded as-is and is stored in the scene cache.
+    */
+    class dlldecl EnvMapImportanceMap
+    {
+    public:
+        using SharedPtr = std::shared_ptr<EnvMapImportanceMap>;
+        using SharedConstPtr = std::shared_ptr<const EnvMapImportanceMap>;
+
+        static const uint32_t kDefaultDimension = 512;  ///< Default resolution of the most detailed mip level.
+        static const uint32_t kDefaultSamples = 64;     ///< Default number of samples per texel of the most detailed mip level.
+
+        /** Build an importance map from an environment map image.
+            Throws an exception if the image format is not supported.
+            \param[in] image Lat-long environment map image, top-down.
+            \param[in] dimension Resolution of the most detailed mip level. Must be a power of two.
+            \param[in] samples Number of samples per texel of the most detailed mip level. Must be a power of two.
+            \return New object.
+        */
+        static SharedPtr create(const Bitmap& image, uint32_t dimension = kDefaultDimension, uint32_t samples = kDefaultSamples);
+
+        /** Create an importance map from precomputed data.
+            Throws an exception if the data size doesn't match the dimension.
+            \param[in] dimension Resolution of the most detailed mip level. Must be a power of two.
+            \param[in] samples Number of samples per texel the data was computed with.
+            \param[in] data All mip levels, tightly packed from the most to the least detailed.
+            \return New object.
+        */
+        static SharedPtr create(uint32_t dimension, uint32_t samples, std::vector<float> data);
+
+        /** Check if importance maps can be built from images in a given format.
+            \param[in] format Image format.
+            \return True if the format is supported.
+        */
+        static bool isFormatSupported(ResourceFormat format);
+
+        /** Sample a position in the octahedral map proportional to the importance map.
+            This mirrors the hierarchical warping in EnvMapSampler.slang.
+            \param[in] rnd Uniform random sample in [0,1)^2.
+            \param[out] pdf Probability density of the sample with respect to the area of the unit square.
+            \return Position in the octahedral map in [0,1)^2.
+        */
+        float2 sample(float2 rnd, float& pdf) const;
+
+        uint32_t getDimension() const { return mDimension; }
+        uint32_t getSamples() const { return mSamples; }
+        uint32_t getMipCount() const { return (uint32_t)mMipOffsets.size(); }
+
+        /** Get the texels of a mip level, stored row by row.
+        */
+        const float* getMip(uint32_t mipLevel) const { return mData.data() + mMipOffsets[mipLevel]; }
+
+        /** Get all mip levels, tightly packed from the most to the least detailed. Can be used as initial data for Texture::create2D().
+        */
+        const std::vector<float>& getData() const { return mData; }
+
+        /** Set the hash of the environment map file content the map was built from. Used as key in the scene cache.
+        */
+        void setContentHash(const SHA1::MD& hash) { mContentHash = hash; }
+        const SHA1::MD& getContentHash() const { return mContentHash; }
+
+        /** Set the size and last write time of the environment map file the map was built from.
+            The scene cache only hashes the file content if these don't match.
+        */
+        void setFileStamp(uint64_t size, int64_t writeTime) { mFileSize = size; mFileWriteTime = writeTime; }
+        uint64_t getFileSize() const { return mFileSize; }
+        int64_t getFileWriteTime() const { return mFileWriteTime; }
+
+    private:
+        EnvMapImportanceMap(uint32_t dimension, uint32_t samples);
+
+        uint32_t mDimension = 0;
+        uint32_t mSamples = 0;
+        std::vector<size_t> mMipOffsets;    ///< Offset of each mip level in mData.
+        std::vector<float> mData;
+        SHA1::MD mContentHash = {};
+        uint64_t mFileSize = 0;
+        int64_t mFileWriteTime = 0;
+    };
+}
@@ -84,6 +84,14 @@ namespace Falcor
             size_t constantNormalMaps = 0;
         };
 
+        /** Texture analysis results for optimizeTexture(), keyed by texture source filename and whether the texture has an sRGB format.
+        */
+        using TextureAnalysisMap = std::map<std::pair<std::string, bool>, TextureAnalyzer::Result>;
+
+        /** Get the key of a texture in a TextureAnalysisMap.
+        */
+        static TextureAnalysisMap::key_type getTextureAnalysisKey(const Texture& texture) { return { texture.getSourceFilename(), isSrgbFormat(texture.getFormat()) }; }
+
         virtual ~Material() = default;
 
         /** Render the UI.
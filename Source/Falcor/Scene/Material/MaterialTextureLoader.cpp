@@ -27,11 +27,38 @@
  **************************************************************************/
 #include "stdafx.h"
 #include "MaterialTextureLoader.h"
+#include <filesystem>
 
 namespace Falcor
 {
-    MaterialTextureLoader::MaterialTextureLoader(bool useSrgb)
-        : mUseSrgb(useSrgb)
+    namespace
+    {
+        /** Get the load priority of a material texture. Base color textures are loaded first, specular (roughness) textures last.
+        */
+        AsyncTextureLoader::Priority getPriority(Material::TextureSlot slot)
+        {
+            switch (slot)
+            {
+            case Material::TextureSlot::BaseColor:
+                return AsyncTextureLoader::Priority::High;
+            case Material::TextureSlot::Specular:
+                return AsyncTextureLoader::Priority::Low;
+            default:
+                return AsyncTextureLoader::Priority::Normal;
+            }
+        }
+
+        /** Get the analysis to perform while loading a material texture.
+            Displacement maps are kept at full size, as displacement relies on their min/max mip pyramid.
+        */
+        AsyncTextureLoader::AnalysisMode getAnalysisMode(Material::TextureSlot slot)
+        {
+            return slot == Material::TextureSlot::Displacement ? AsyncTextureLoader::AnalysisMode::Analyze : AsyncTextureLoader::AnalysisMode::CollapseConstant;
+        }
+    }
+
+    MaterialTextureLoader::MaterialTextureLoader(bool useSrgb, const TextureCache::SharedPtr& pTextureCache, const TextureStreamer::SharedPtr& pTextureStreamer, Material::TextureAnalysisMap* pTextureAnalysis)
+        : mUseSrgb(useSrgb), mpTextureCache(pTextureCache), mpTextureStreamer(pTextureStreamer), mpTextureAnalysis(pTextureAnalysis)
     {
     }
 
@@ -40,7 +67,7 @@ namespace Falcor
         assignTextures();
     }
 
-    void MaterialTextureLoader::loadTexture(const Material::SharedPtr& pMaterial, Material::TextureSlot slot, const std::string& filename)
+    void MaterialTextureLoader::loadTexture(const Material::SharedPtr& pMaterial, Material::TextureSlot slot, const std::string& filename, const std::optional<TextureAnalyzer::Result>& analysis)
     {
         assert(pMaterial);
         if (!pMaterial->hasTextureSlot(slot))
@@ -57,31 +84,101 @@ namespace Falcor
         }
 
         bool srgb = mUseSrgb && pMaterial->getTextureSlotInfo(slot).srgb;
-        TextureKey textureKey{fullPath, srgb};
+        TextureKey textureKey = resolveDuplicate({ fullPath, srgb });
+
+        // Let the streamer assign the texture whenever its resident mip levels change.
+        if (mpTextureStreamer)
+        {
+            std::weak_ptr<Material> pWeakMaterial = pMaterial;
+            mpTextureStreamer->addTexture(textureKey.first, srgb, [pWeakMaterial, slot](const Texture::SharedPtr& pTexture)
+            {
+                if (auto pMaterial = pWeakMaterial.lock()) pMaterial->setTexture(slot, pTexture);
+            });
+            return;
+        }
 
         // Load texture if not already requested before.
         if (mRequestedTextures.find(textureKey) == mRequestedTextures.end())
         {
-            mRequestedTextures[textureKey] = mAsyncTextureLoader.loadFromFile(fullPath, true, srgb);
+            // Analyze the texture if requested. Textures known to be constant are collapsed again.
+            auto analysisMode = AsyncTextureLoader::AnalysisMode::None;
+            if (mpTextureAnalysis || (analysis && analysis->isConstant(TextureChannelFlags::RGBA))) analysisMode = getAnalysisMode(slot);
+            mRequestedTextures[textureKey] = mAsyncTextureLoader.loadAndAnalyzeFromFile(textureKey.first, true, srgb, analysisMode, mpTextureCache, getPriority(slot), mCancellationToken);
         }
 
         // Store assignment to material for later.
-        mTextureAssignments.emplace_back(TextureAssignment{ pMaterial, slot, textureKey });
+        mTextureAssignments.emplace_back(TextureAssignment{ pMaterial, slot, textureKey, analysis });
+    }
+
+    void MaterialTextureLoader::cancel()
+    {
+        mCancellationToken.cancel();
     }
 
     void MaterialTextureLoader::assignTextures()
     {
+        // Wait for the mip tails of streamed textures, which are assigned by the streamer.
+        if (mpTextureStreamer) mpTextureStreamer->finishInitialLoads();
+
         // Wait for all textures to be loaded.
-        std::map<TextureKey, Texture::SharedPtr> loadedTextures;
+        std::map<TextureKey, AsyncTextureLoader::AnalyzedTexture> loadedTextures;
         for (auto &[key, texture] : mRequestedTextures)
         {
             loadedTextures[key] = texture.get();
         }
 
+        // Report the memory saved by sharing textures between files with identical content.
+        size_t duplicateCount = 0;
+        uint64_t savedBytes = 0;
+        for (const auto& [key, canonicalKey] : mCanonicalKeys)
+        {
+            if (key == canonicalKey) continue;
+            duplicateCount++;
+            if (auto it = loadedTextures.find(canonicalKey); it != loadedTextures.end() && it->second.pTexture) savedBytes += it->second.pTexture->getTextureSizeInBytes();
+        }
+        if (duplicateCount > 0)
+        {
+            logInfo("Found " + std::to_string(duplicateCount) + " duplicate material textures. Sharing them saved " + formatByteSize(savedBytes) + " of texture memory.");
+        }
+
         // Assign textures to materials.
+        Material::TextureOptimizationStats stats;
         for (const auto& assignment : mTextureAssignments)
         {
-            assignment.pMaterial->setTexture(assignment.textureSlot, loadedTextures[assignment.textureKey]);
+            const auto& loaded = loadedTextures[assignment.textureKey];
+            assignment.pMaterial->setTexture(assignment.textureSlot, loaded.pTexture);
+            if (!loaded.pTexture) continue;
+
+            if (mpTextureAnalysis && loaded.analysis) (*mpTextureAnalysis)[Material::getTextureAnalysisKey(*loaded.pTexture)] = *loaded.analysis;
+
+            // Setting a texture resets the material's texture optimizations, so apply the known analysis again.
+            if (assignment.analysis) assignment.pMaterial->optimizeTexture(assignment.textureSlot, *assignment.analysis, stats);
         }
     }
+
+    MaterialTextureLoader::TextureKey MaterialTextureLoader::resolveDuplicate(const TextureKey& textureKey)
+    {
+        if (auto it = mCanonicalKeys.find(textureKey); it != mCanonicalKeys.end()) return it->second;
+
+        // Files can only have identical content if they have the same size.
+        // Compare content hashes with the loaded textures of the same size, hashing them on demand.
+        std::error_code ec;
+        const uintmax_t fileSize = std::filesystem::file_size(textureKey.first, ec);
+        if (ec) return mCanonicalKeys[textureKey] = textureKey;
+
+        auto& uniqueTextures = mUniqueTextures[{ fileSize, textureKey.second }];
+        std::optional<SHA1::MD> contentHash;
+        for (auto& uniqueTexture : uniqueTextures)
+        {
+            if (!contentHash) contentHash = SHA1::computeFile(textureKey.first);
+            if (!uniqueTexture.contentHash) uniqueTexture.contentHash = SHA1::computeFile(uniqueTexture.textureKey.first);
+            if (contentHash && uniqueTexture.contentHash && *contentHash == *uniqueTexture.contentHash)
+            {
+                return mCanonicalKeys[textureKey] = uniqueTexture.textureKey;
+            }
+        }
+
+        uniqueTextures.push_back({ textureKey, contentHash });
+        return mCanonicalKeys[textureKey] = textureKey;
+    }
 }
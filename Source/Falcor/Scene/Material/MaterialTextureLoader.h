@@ -28,6 +28,7 @@
 #pragma once
 #include "Falcor.h"
 #include "Scene/Material/Material.h"
+#include "Scene/Material/TextureStreamer.h"
 #include "Utils/AsyncTextureLoader.h"
 
 namespace Falcor
@@ -39,36 +40,72 @@ namespace Falcor
         material assignment is stored. When the client destroys the instance of the
         `MaterialTextureLoader`, it blocks until all textures are loaded and assigns
         them to the materials.
+
+        Textures are deduplicated by content: files with identical content (e.g. copies of an image
+        under different names) share a single texture. Only files of equal size are hashed.
+
+        If a texture analysis map is given, the images are analyzed on the CPU while they are loaded (see TextureAnalyzer).
+        Images that are constant in all channels are created with a single texel, so constant textures are never uploaded at full size.
+
+        If a texture streamer is given, textures are added to the streamer instead.
+        The materials are then assigned the mip tails and are updated by the streamer.
     */
     class MaterialTextureLoader
     {
     public:
-        MaterialTextureLoader(bool useSrgb);
+        /** Constructor.
+            \param[in] useSrgb Load textures of color slots in sRGB format.
+            \param[in] pTextureCache Optional texture cache to consult before decoding image files.
+            \param[in] pTextureStreamer Optional texture streamer to stream the textures with.
+            \param[out] pTextureAnalysis Optional map to add the CPU analysis results of the loaded textures to when they are assigned.
+        */
+        MaterialTextureLoader(bool useSrgb, const TextureCache::SharedPtr& pTextureCache = nullptr, const TextureStreamer::SharedPtr& pTextureStreamer = nullptr, Material::TextureAnalysisMap* pTextureAnalysis = nullptr);
         ~MaterialTextureLoader();
 
         /** Request loading a material texture.
             \param[in] pMaterial Material to load texture into.
             \param[in] slot Slot to load texture into.
             \param[in] filename Texture filename.
+            \param[in] analysis Optional known analysis result of the texture, e.g. from the scene cache. It is applied with Material::optimizeTexture() when the texture is assigned.
         */
-        void loadTexture(const Material::SharedPtr& pMaterial, Material::TextureSlot slot, const std::string& filename);
+        void loadTexture(const Material::SharedPtr& pMaterial, Material::TextureSlot slot, const std::string& filename, const std::optional<TextureAnalyzer::Result>& analysis = std::nullopt);
+
+        /** Cancel all texture loads that have not started yet.
+            The affected material texture slots are left empty.
+        */
+        void cancel();
 
     private:
+        using TextureKey = std::pair<std::string, bool>; // filename, srgb
+
         void assignTextures();
+        TextureKey resolveDuplicate(const TextureKey& textureKey);
 
         bool mUseSrgb;
-
-        using TextureKey = std::pair<std::string, bool>; // filename, srgb
+        TextureCache::SharedPtr mpTextureCache;
+        TextureStreamer::SharedPtr mpTextureStreamer;
+        Material::TextureAnalysisMap* mpTextureAnalysis;
 
         struct TextureAssignment
         {
             Material::SharedPtr pMaterial;
             Material::TextureSlot textureSlot;
             TextureKey textureKey;
+            std::optional<TextureAnalyzer::Result> analysis;
         };
 
-        std::map<TextureKey, std::future<Texture::SharedPtr>> mRequestedTextures;
+        std::map<TextureKey, std::future<AsyncTextureLoader::AnalyzedTexture>> mRequestedTextures;
         std::vector<TextureAssignment> mTextureAssignments;
+
+        struct UniqueTexture
+        {
+            TextureKey textureKey;
+            std::optional<SHA1::MD> contentHash;    ///< Hash of the file content, computed on demand.
+        };
+
+        std::map<TextureKey, TextureKey> mCanonicalKeys;                                ///< Maps each requested texture to the texture with identical content that is loaded.
+        std::map<std::pair<uintmax_t, bool>, std::vector<UniqueTexture>> mUniqueTextures; ///< Loaded textures grouped by file size and sRGB setting.
+        AsyncTextureLoader::CancellationToken mCancellationToken;
         AsyncTextureLoader mAsyncTextureLoader;
     };
 }
@@ -0,0 +1,134 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "TexelDensityFeedback.h"
+#include "Scene/Scene.h"
+#include "Utils/Threading.h"
+#include <unordered_map>
+
+namespace Falcor
+{
+    TexelDensityFeedback::SharedPtr TexelDensityFeedback::create(Scene* pScene, const ArrayView<uint32_t>& meshIndexData, const ArrayView<PackedStaticVertexData>& meshStaticData, const Options& options)
+    {
+        return SharedPtr(new TexelDensityFeedback(pScene, meshIndexData, meshStaticData, options));
+    }
+
+    TexelDensityFeedback::TexelDensityFeedback(Scene* pScene, const ArrayView<uint32_t>& meshIndexData, const ArrayView<PackedStaticVertexData>& meshStaticData, const Options& options)
+        : mpScene(pScene)
+        , mOptions(options)
+    {
+        assert(pScene);
+
+        // Compute the ratio of the surface area to the texture coordinate area of each mesh.
+        mMeshUVScales.resize(pScene->getMeshCount(), 0.f);
+        Threading::parallelFor((size_t)0, mMeshUVScales.size(), [&](size_t meshID)
+        {
+            const MeshDesc& mesh = pScene->getMesh((uint32_t)meshID);
+            const uint16_t* pIndices16 = reinterpret_cast<const uint16_t*>(meshIndexData.data() + mesh.ibOffset);
+            const uint32_t* pIndices32 = meshIndexData.data() + mesh.ibOffset;
+            auto getVertex = [&](uint32_t index)
+            {
+                if (mesh.indexCount > 0) index = mesh.use16BitIndices() ? pIndices16[index] : pIndices32[index];
+                return meshStaticData[mesh.vbOffset + index];
+            };
+
+            double area = 0.0, uvArea = 0.0;
+            for (uint32_t triangle = 0; triangle < mesh.getTriangleCount(); triangle++)
+            {
+                const auto v0 = getVertex(triangle * 3), v1 = getVertex(triangle * 3 + 1), v2 = getVertex(triangle * 3 + 2);
+                area += glm::length(glm::cross(v1.position - v0.position, v2.position - v0.position));
+                const float2 e1 = v1.texCrd - v0.texCrd, e2 = v2.texCrd - v0.texCrd;
+                uvArea += std::abs(e1.x * e2.y - e1.y * e2.x);
+            }
+            if (uvArea > 0.0) mMeshUVScales[meshID] = (float)std::sqrt(area / uvArea);
+        });
+    }
+
+    void TexelDensityFeedback::collectRequests(RenderContext* pRenderContext, std::vector<TextureStreamer::Request>& requests)
+    {
+        const auto& pStreamer = mpScene->getTextureStreamer();
+        const auto& pCamera = mpScene->getCamera();
+        if (!pStreamer || !pCamera) return;
+
+        // Number of pixels covered by a length of one at unit distance from the camera.
+        const float pixelsPerUnit = mOptions.screenHeight * pCamera->getFocalLength() / pCamera->getFrameHeight();
+        const float3 cameraPos = pCamera->getPosition();
+
+        // Find the largest number of pixels per texture coordinate unit of each material over its visible mesh instances.
+        const auto& globalMatrices = mpScene->getAnimationController()->getGlobalMatrices();
+        std::vector<float> pixelsPerUV(mpScene->getMaterialCount(), 0.f);
+        for (uint32_t instanceID = 0; instanceID < mpScene->getMeshInstanceCount(); instanceID++)
+        {
+            const auto& instance = mpScene->getMeshInstance(instanceID);
+            const float uvScale = mMeshUVScales[instance.meshID];
+            if (uvScale == 0.f) continue;
+
+            const glm::mat4& transform = globalMatrices[instance.globalMatrixID];
+            const AABB bounds = mpScene->getMeshBounds(instance.meshID).transform(transform);
+            if (pCamera->isObjectCulled(bounds)) continue;
+
+            const float distance = std::max(glm::length(cameraPos - glm::clamp(cameraPos, bounds.minPoint, bounds.maxPoint)), pCamera->getNearPlane());
+            const float scale = std::max({ glm::length(float3(transform[0])), glm::length(float3(transform[1])), glm::length(float3(transform[2])) });
+            pixelsPerUV[instance.materialID] = std::max(pixelsPerUV[instance.materialID], uvScale * scale * pixelsPerUnit / distance);
+        }
+
+        // Map the textures assigned to the materials to the streamed textures.
+        std::unordered_map<const Texture*, TextureStreamer::TextureID> textureIDs;
+        for (TextureStreamer::TextureID textureID = 0; textureID < pStreamer->getTextureCount(); textureID++)
+        {
+            if (auto pTexture = pStreamer->getTexture(textureID)) textureIDs[pTexture.get()] = textureID;
+        }
+
+        // Request the mip level at which one texel covers about one pixel.
+        // The most detailed mip level has about 2^(mipCount - 1) texels along its larger side.
+        for (uint32_t materialID = 0; materialID < mpScene->getMaterialCount(); materialID++)
+        {
+            if (pixelsPerUV[materialID] == 0.f) continue;
+
+            const auto& pMaterial = mpScene->getMaterial(materialID);
+            for (uint32_t slot = 0; slot < (uint32_t)Material::TextureSlot::Count; slot++)
+            {
+                const auto pTexture = pMaterial->getTexture(Material::TextureSlot(slot));
+                auto it = pTexture ? textureIDs.find(pTexture.get()) : textureIDs.end();
+                if (it == textureIDs.end()) continue;
+
+                const uint32_t mipCount = pStreamer->getMipCount(it->second);
+                if (mipCount == 0) continue;
+                const float mipLevel = float(mipCount - 1) - std::log2(pixelsPerUV[materialID]) + mOptions.lodBias;
+                requests.push_back({ it->second, (uint32_t)std::clamp(std::floor(mipLevel), 0.f, float(mipCount - 1)) });
+            }
+        }
+    }
+
+    void TexelDensityFeedback::renderUI(Gui::Widgets& widget)
+    {
+        widget.var("Screen height", mOptions.screenHeight, 1u, 16384u);
+        widget.tooltip("Height of the rendered image in pixels, used to estimate the texel density on screen.");
+        widget.var("LOD bias", mOptions.lodBias, -4.f, 4.f, 0.25f);
+    }
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include "TextureStreamer.h"
+#include "Scene/SceneTypes.slang"
+#include "Utils/ArrayView.h"
+
+namespace Falcor
+{
+    class Scene;
+
+    /** Texture streaming feedback source that estimates the needed mip levels on the CPU.
+
+        Each frame, the screen-space texel density of the materials is estimated from the camera and the mesh instances.
+        The texture coordinate scale of each mesh (object space length per texture coordinate unit) is computed once
+        from its triangles. For each visible mesh instance, the scale is projected to the screen at the distance of the
+        closest point of the instance's bounding box. Each streamed texture of the instance's material is then requested
+        down to the mip level at which one texel covers about one pixel.
+
+        This is a conservative approximation: it uses the closest point of the bounds for the whole instance and
+        ignores texture transforms and the viewing angle. It is used by the scene by default when textures are streamed.
+    */
+    class dlldecl TexelDensityFeedback : public TextureStreamer::FeedbackSource
+    {
+    public:
+        using SharedPtr = std::shared_ptr<TexelDensityFeedback>;
+
+        struct Options
+        {
+            uint32_t screenHeight = 1080;   ///< Height of the rendered image in pixels.
+            float lodBias = 0.f;            ///< Bias added to the estimated mip levels. Negative values request more detailed mip levels.
+        };
+
+        /** Create a feedback source for a scene.
+            \param[in] pScene Scene to estimate the texel densities for. The feedback source must not outlive the scene.
+            \param[in] meshIndexData Index data of all meshes, used to compute the texture coordinate scale of the meshes.
+            \param[in] meshStaticData Static vertex data of all meshes.
+            \param[in] options Options.
+            \return A new object.
+        */
+        static SharedPtr create(Scene* pScene, const ArrayView<uint32_t>& meshIndexData, const ArrayView<PackedStaticVertexData>& meshStaticData, const Options& options = Options());
+
+        void collectRequests(RenderContext* pRenderContext, std::vector<TextureStreamer::Request>& requests) override;
+
+        void renderUI(Gui::Widgets& widget) override;
+
+        void setOptions(const Options& options) { mOptions = options; }
+        const Options& getOptions() const { return mOptions; }
+
+    private:
+        TexelDensityFeedback(Scene* pScene, const ArrayView<uint32_t>& meshIndexData, const ArrayView<PackedStaticVertexData>& meshStaticData, const Options& options);
+
+        Scene* mpScene;
+        Options mOptions;
+        std::vector<float> mMeshUVScales;   ///< Object space length per texture coordinate unit for each mesh, or zero if the texture coordinates are degenerate.
+    };
+}
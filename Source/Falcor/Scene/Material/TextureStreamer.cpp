@@ -0,0 +1,436 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "TextureStreamer.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Get the size in bytes of a mip level.
+        */
+        uint64_t getMipSize(ResourceFormat format, uint32_t width, uint32_t height, uint32_t mipLevel)
+        {
+            const uint64_t blocksX = div_round_up(std::max(1u, width >> mipLevel), getFormatWidthCompressionRatio(format));
+            const uint64_t blocksY = div_round_up(std::max(1u, height >> mipLevel), getFormatHeightCompressionRatio(format));
+            return blocksX * blocksY * getFormatBytesPerBlock(format);
+        }
+
+        /** Check if a texture can be created with the given mip level as its most detailed mip level.
+            Block compressed textures need a size that is a multiple of the block size.
+        */
+        bool isValidMostDetailedMip(ResourceFormat format, uint32_t width, uint32_t height, uint32_t mipLevel)
+        {
+            if (mipLevel == 0) return true;
+            const uint32_t w = width >> mipLevel;
+            const uint32_t h = height >> mipLevel;
+            const uint32_t blockWidth = getFormatWidthCompressionRatio(format);
+            const uint32_t blockHeight = getFormatHeightCompressionRatio(format);
+            return w >= blockWidth && h >= blockHeight && w % blockWidth == 0 && h % blockHeight == 0;
+        }
+    }
+
+    // EmulatedFeedback
+
+    void TextureStreamer::EmulatedFeedback::collectRequests(RenderContext* pRenderContext, std::vector<Request>& requests)
+    {
+        requests.insert(requests.end(), mRequests.begin(), mRequests.end());
+        mRequests.clear();
+    }
+
+    // TextureStreamer
+
+    TextureStreamer::SharedPtr TextureStreamer::create(const TextureCache::SharedPtr& pTextureCache, const Options& options)
+    {
+        return SharedPtr(new TextureStreamer(pTextureCache, options));
+    }
+
+    TextureStreamer::TextureStreamer(const TextureCache::SharedPtr& pTextureCache, const Options& options)
+        : mpTextureCache(pTextureCache ? pTextureCache : TextureCache::create())
+        , mOptions(options)
+    {
+    }
+
+    TextureStreamer::TextureID TextureStreamer::addTexture(const std::string& filename, bool loadAsSrgb, UpdateCallback onUpdate)
+    {
+        std::string fullPath;
+        if (!findFileInDataDirectories(filename, fullPath))
+        {
+            logWarning("Can't find texture image file '" + filename + "'");
+            return kInvalidID;
+        }
+
+        auto key = std::make_pair(fullPath, loadAsSrgb);
+        if (auto it = mTextureIDs.find(key); it != mTextureIDs.end())
+        {
+            auto& texture = mTextures[it->second];
+            if (onUpdate)
+            {
+                texture.callbacks.push_back(onUpdate);
+                if (texture.pTexture) onUpdate(texture.pTexture);
+            }
+            return it->second;
+        }
+
+        TextureID textureID = (TextureID)mTextures.size();
+        StreamedTexture texture;
+        texture.filename = fullPath;
+        texture.loadAsSrgb = loadAsSrgb;
+        if (onUpdate) texture.callbacks.push_back(onUpdate);
+        mTextures.push_back(std::move(texture));
+        mTextureIDs[key] = textureID;
+
+        dispatchLoad(textureID, 0, true);
+
+        return textureID;
+    }
+
+    void TextureStreamer::finishInitialLoads()
+    {
+        for (TextureID textureID = 0; textureID < (TextureID)mTextures.size(); textureID++)
+        {
+            const auto& pLoad = mTextures[textureID].pLoad;
+            if (pLoad && pLoad->initial) finishLoad(textureID);
+        }
+    }
+
+    void TextureStreamer::update(RenderContext* pRenderContext, FeedbackSource* pFeedback)
+    {
+        mFrame++;
+
+        // Finish the loads that completed since the last update.
+        for (TextureID textureID = 0; textureID < (TextureID)mTextures.size(); textureID++)
+        {
+            const auto& pLoad = mTextures[textureID].pLoad;
+            if (pLoad && !pLoad->task.isRunning()) finishLoad(textureID);
+        }
+
+        // Gather the requests.
+        std::vector<Request> requests;
+        if (pFeedback) pFeedback->collectRequests(pRenderContext, requests);
+
+        // Mark the requested pages as used and find the most detailed requested mip level of each texture.
+        const uint32_t kNoRequest = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> requestedMips(mTextures.size(), kNoRequest);
+        for (const auto& request : requests)
+        {
+            if (request.textureID >= mTextures.size()) continue;
+            auto& texture = mTextures[request.textureID];
+            if (texture.pages.empty()) continue;
+
+            uint32_t mipLevel = std::min(request.mipLevel, (uint32_t)texture.pages.size() - 1);
+            for (uint32_t mip = mipLevel; mip < texture.pages.size(); mip++) texture.pages[mip].lastUsedFrame = mFrame;
+            requestedMips[request.textureID] = std::min(requestedMips[request.textureID], mipLevel);
+        }
+
+        // Evict mip levels until the budget is met, in case it was lowered.
+        std::vector<TextureID> evicted;
+        while (mResidentBytes + mPendingBytes > mOptions.memoryBudget && evictMip(kInvalidID, true, evicted)) {}
+
+        // Stream in the missing mip levels, textures missing the most mip levels first.
+        std::vector<TextureID> candidates;
+        uint32_t pendingLoads = 0;
+        for (TextureID textureID = 0; textureID < (TextureID)mTextures.size(); textureID++)
+        {
+            const auto& texture = mTextures[textureID];
+            if (texture.pLoad) pendingLoads++;
+            else if (requestedMips[textureID] < texture.residentMip) candidates.push_back(textureID);
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [&](TextureID a, TextureID b)
+        {
+            return mTextures[a].residentMip - requestedMips[a] > mTextures[b].residentMip - requestedMips[b];
+        });
+
+        for (TextureID textureID : candidates)
+        {
+            if (pendingLoads >= mOptions.maxPendingLoads) break;
+
+            auto& texture = mTextures[textureID];
+            uint32_t mipLevel = requestedMips[textureID];
+            while (!isValidMostDetailedMip(texture.format, texture.width, texture.height, mipLevel)) mipLevel--;
+
+            // Make room within the budget. Mip levels used in this frame are not evicted, instead fewer mip levels are loaded.
+            while (mipLevel < texture.residentMip && mResidentBytes + mPendingBytes + getSize(texture, mipLevel, texture.residentMip) > mOptions.memoryBudget)
+            {
+                if (!evictMip(textureID, false, evicted)) mipLevel = getNextValidMip(texture, mipLevel);
+            }
+            if (mipLevel >= texture.residentMip) continue;
+
+            mPendingBytes += getSize(texture, mipLevel, texture.residentMip);
+            dispatchLoad(textureID, mipLevel, false);
+            pendingLoads++;
+        }
+
+        // Recreate the textures that lost mip levels.
+        for (TextureID textureID : evicted) recreateTexture(pRenderContext, textureID);
+    }
+
+    void TextureStreamer::renderUI(Gui::Widgets& widget)
+    {
+        const auto stats = getStats();
+        std::ostringstream oss;
+        oss << "Textures: " << stats.textureCount << " (" << stats.streamedTextureCount << " streamed)" << std::endl
+            << "Mip tails: " << formatByteSize(stats.pinnedMemoryInBytes) << std::endl
+            << "Streamed mips: " << formatByteSize(stats.residentMemoryInBytes) << " resident, " << formatByteSize(stats.pendingMemoryInBytes) << " loading" << std::endl
+            << "Total loaded: " << formatByteSize(stats.loadedBytes) << std::endl
+            << "Total evicted: " << formatByteSize(stats.evictedBytes) << std::endl
+            << "Pending loads: " << stats.pendingLoads << std::endl;
+        widget.text(oss.str());
+
+        uint32_t budgetMB = (uint32_t)(mOptions.memoryBudget >> 20);
+        if (widget.var("Memory budget (MB)", budgetMB)) mOptions.memoryBudget = uint64_t(budgetMB) << 20;
+        widget.var("Max pending loads", mOptions.maxPendingLoads, 1u, 64u);
+    }
+
+    Texture::SharedPtr TextureStreamer::getTexture(TextureID textureID) const
+    {
+        assert(textureID < mTextures.size());
+        return mTextures[textureID].pTexture;
+    }
+
+    uint32_t TextureStreamer::getResidentMip(TextureID textureID) const
+    {
+        assert(textureID < mTextures.size());
+        return mTextures[textureID].residentMip;
+    }
+
+    uint32_t TextureStreamer::getMipCount(TextureID textureID) const
+    {
+        assert(textureID < mTextures.size());
+        const auto& texture = mTextures[textureID];
+        return texture.pages.empty() ? (texture.pTexture ? texture.pTexture->getMipCount() : 0) : (uint32_t)texture.pages.size();
+    }
+
+    bool TextureStreamer::isStreamed(const Texture::SharedPtr& pTexture) const
+    {
+        if (!pTexture) return false;
+        for (const auto& texture : mTextures)
+        {
+            if (texture.pTexture == pTexture) return texture.pinnedMip > 0;
+        }
+        return false;
+    }
+
+    TextureStreamer::Stats TextureStreamer::getStats() const
+    {
+        Stats stats;
+        stats.textureCount = (uint32_t)mTextures.size();
+        for (const auto& texture : mTextures)
+        {
+            if (texture.pinnedMip > 0) stats.streamedTextureCount++;
+            if (texture.pLoad) stats.pendingLoads++;
+        }
+        stats.pinnedMemoryInBytes = mPinnedBytes;
+        stats.residentMemoryInBytes = mResidentBytes;
+        stats.pendingMemoryInBytes = mPendingBytes;
+        stats.loadedBytes = mLoadedBytes;
+        stats.evictedBytes = mEvictedBytes;
+        return stats;
+    }
+
+    void TextureStreamer::dispatchLoad(TextureID textureID, uint32_t mostDetailedMip, bool initial)
+    {
+        auto& texture = mTextures[textureID];
+        assert(!texture.pLoad);
+
+        auto pLoad = std::make_shared<LoadJob>();
+        pLoad->initial = initial;
+        pLoad->mostDetailedMip = mostDetailedMip;
+        pLoad->ddsPath = texture.ddsPath;
+
+        // The task only accesses the job, as the texture list can change while it is running.
+        pLoad->task = Threading::dispatchTask([pLoad, pTextureCache = mpTextureCache, filename = texture.filename, loadAsSrgb = texture.loadAsSrgb, initialResolution = mOptions.initialResolution]()
+        {
+            if (pLoad->initial)
+            {
+                auto ddsPath = pTextureCache->cacheTexture(filename, true, loadAsSrgb);
+                if (!ddsPath) return;
+
+                pLoad->ddsPath = *ddsPath;
+                pLoad->desc = ImageIO::getDDSDesc(pLoad->ddsPath);
+                const auto& desc = pLoad->desc;
+                if (desc.type != Resource::Type::Texture2D || desc.arraySize != 1 || desc.mipLevels == 0) return;
+
+                // Find the most detailed mip level of the mip tail.
+                uint32_t mip = 0;
+                while (mip + 1 < desc.mipLevels && std::max(desc.width >> mip, desc.height >> mip) > initialResolution) mip++;
+                while (!isValidMostDetailedMip(desc.format, desc.width, desc.height, mip)) mip--;
+                pLoad->mostDetailedMip = mip;
+            }
+
+            pLoad->mipChain = ImageIO::loadMipChainFromDDS(pLoad->ddsPath, loadAsSrgb, pLoad->mostDetailedMip);
+        });
+
+        texture.pLoad = std::move(pLoad);
+    }
+
+    void TextureStreamer::finishLoad(TextureID textureID)
+    {
+        auto& texture = mTextures[textureID];
+        auto pLoad = std::move(texture.pLoad);
+
+        try
+        {
+            pLoad->task.finish();
+        }
+        catch (const std::exception& e)
+        {
+            logWarning("Failed to load texture '" + texture.filename + "': " + e.what());
+            pLoad->mipChain = {};
+        }
+
+        const auto& mipChain = pLoad->mipChain;
+        Texture::SharedPtr pTexture;
+        if (!mipChain.data.empty())
+        {
+            pTexture = Texture::create2D(mipChain.width, mipChain.height, mipChain.format, 1, mipChain.mipLevels, mipChain.data.data());
+            if (pTexture) pTexture->setSourceFilename(texture.filename);
+        }
+
+        if (pLoad->initial)
+        {
+            if (!pTexture)
+            {
+                // Textures that cannot be streamed are loaded as a whole.
+                texture.pTexture = mpTextureCache->loadTexture(texture.filename, true, texture.loadAsSrgb);
+                if (texture.pTexture)
+                {
+                    for (uint32_t mip = 0; mip < texture.pTexture->getMipCount(); mip++)
+                    {
+                        mPinnedBytes += getMipSize(texture.pTexture->getFormat(), texture.pTexture->getWidth(), texture.pTexture->getHeight(), mip) * texture.pTexture->getDepth() * texture.pTexture->getArraySize();
+                    }
+                }
+                notify(textureID);
+                return;
+            }
+
+            const auto& desc = pLoad->desc;
+            texture.ddsPath = pLoad->ddsPath;
+            texture.format = mipChain.format;
+            texture.width = desc.width;
+            texture.height = desc.height;
+            texture.pinnedMip = texture.residentMip = pLoad->mostDetailedMip;
+            texture.pages.resize(desc.mipLevels);
+            for (uint32_t mip = 0; mip < desc.mipLevels; mip++)
+            {
+                auto& page = texture.pages[mip];
+                page.size = getMipSize(texture.format, texture.width, texture.height, mip);
+                page.resident = mip >= texture.pinnedMip;
+                if (page.resident) mPinnedBytes += page.size;
+            }
+        }
+        else
+        {
+            const uint64_t size = getSize(texture, pLoad->mostDetailedMip, texture.residentMip);
+            mPendingBytes -= size;
+            if (!pTexture) return;
+
+            for (uint32_t mip = pLoad->mostDetailedMip; mip < texture.residentMip; mip++) texture.pages[mip].resident = true;
+            texture.residentMip = pLoad->mostDetailedMip;
+            mResidentBytes += size;
+            mLoadedBytes += size;
+        }
+
+        texture.pTexture = pTexture;
+        notify(textureID);
+    }
+
+    bool TextureStreamer::evictMip(TextureID excludedID, bool allowRecentlyUsed, std::vector<TextureID>& evicted)
+    {
+        // Find the least recently used resident mip level that is not pinned.
+        // Only the most detailed resident mip level of a texture can be evicted to keep the resident mip levels contiguous.
+        TextureID victimID = kInvalidID;
+        uint64_t lastUsedFrame = std::numeric_limits<uint64_t>::max();
+        for (TextureID textureID = 0; textureID < (TextureID)mTextures.size(); textureID++)
+        {
+            const auto& texture = mTextures[textureID];
+            if (textureID == excludedID || texture.pLoad || texture.residentMip >= texture.pinnedMip) continue;
+
+            const auto& page = texture.pages[texture.residentMip];
+            if (!allowRecentlyUsed && page.lastUsedFrame == mFrame) continue;
+            if (page.lastUsedFrame < lastUsedFrame)
+            {
+                lastUsedFrame = page.lastUsedFrame;
+                victimID = textureID;
+            }
+        }
+
+        if (victimID == kInvalidID) return false;
+
+        auto& texture = mTextures[victimID];
+        const uint32_t mipLevel = getNextValidMip(texture, texture.residentMip);
+        const uint64_t size = getSize(texture, texture.residentMip, mipLevel);
+        for (uint32_t mip = texture.residentMip; mip < mipLevel; mip++) texture.pages[mip].resident = false;
+        texture.residentMip = mipLevel;
+        mResidentBytes -= size;
+        mEvictedBytes += size;
+        evicted.push_back(victimID);
+
+        return true;
+    }
+
+    uint32_t TextureStreamer::getNextValidMip(const StreamedTexture& texture, uint32_t mipLevel) const
+    {
+        uint32_t mip = mipLevel + 1;
+        while (mip < texture.pinnedMip && !isValidMostDetailedMip(texture.format, texture.width, texture.height, mip)) mip++;
+        return mip;
+    }
+
+    void TextureStreamer::recreateTexture(RenderContext* pRenderContext, TextureID textureID)
+    {
+        auto& texture = mTextures[textureID];
+        const auto& pOldTexture = texture.pTexture;
+        const uint32_t mipCount = (uint32_t)texture.pages.size() - texture.residentMip;
+        if (!pOldTexture || pOldTexture->getMipCount() == mipCount) return;
+
+        // Copy the remaining mip levels on the GPU.
+        auto pTexture = Texture::create2D(std::max(1u, texture.width >> texture.residentMip), std::max(1u, texture.height >> texture.residentMip), texture.format, 1, mipCount);
+        pTexture->setSourceFilename(texture.filename);
+        const uint32_t mipOffset = pOldTexture->getMipCount() - mipCount;
+        for (uint32_t mip = 0; mip < mipCount; mip++)
+        {
+            pRenderContext->copySubresource(pTexture.get(), pTexture->getSubresourceIndex(0, mip), pOldTexture.get(), pOldTexture->getSubresourceIndex(0, mip + mipOffset));
+        }
+
+        texture.pTexture = pTexture;
+        notify(textureID);
+    }
+
+    void TextureStreamer::notify(TextureID textureID)
+    {
+        const auto& texture = mTextures[textureID];
+        for (const auto& callback : texture.callbacks) callback(texture.pTexture);
+    }
+
+    uint64_t TextureStreamer::getSize(const StreamedTexture& texture, uint32_t beginMip, uint32_t endMip) const
+    {
+        uint64_t size = 0;
+        for (uint32_t mip = beginMip; mip < endMip; mip++) size += texture.pages[mip].size;
+        return size;
+    }
+}
@@ -0,0 +1,243 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include "Falcor.h"
+#include "Utils/Image/ImageIO.h"
+#include "Utils/Image/TextureCache.h"
+
+namespace Falcor
+{
+    /** Streams the mip levels of material textures in and out of GPU memory.
+
+        Each texture is loaded from its preprocessed DDS file (see TextureCache) and has a page table with
+        one page per mip level. The mip levels up to Options::initialResolution form the tail of the
+        mip chain, which is loaded up front and is always resident. The more detailed mip levels are
+        streamed in when requested and evicted in least recently used order to stay within the memory budget.
+
+        The resident mip levels of a texture are always a contiguous range ending at the least detailed
+        mip level. A texture is recreated with only its resident mip levels whenever its residency changes,
+        and the new texture is passed to the update callbacks registered for it. As the hardware selects the
+        mip level relative to the texture size, this is transparent to shaders.
+
+        Streaming is driven by mip level requests from a FeedbackSource. Scenes use TexelDensityFeedback by default,
+        which estimates the needed mip levels from the screen-space texel density of the materials. Requests can also
+        be issued explicitly on the CPU (EmulatedFeedback). Shaders do not write sampling feedback, so without a
+        feedback source only the mip tails are resident.
+    */
+    class dlldecl TextureStreamer
+    {
+    public:
+        using SharedPtr = std::shared_ptr<TextureStreamer>;
+        using TextureID = uint32_t;
+        using UpdateCallback = std::function<void(const Texture::SharedPtr& pTexture)>;
+
+        static const TextureID kInvalidID = std::numeric_limits<TextureID>::max();
+
+        struct Options
+        {
+            uint64_t memoryBudget = 1ull << 30;     ///< Memory budget in bytes for the streamed mip levels. The mip tails are not counted.
+            uint32_t initialResolution = 128;       ///< Mip levels with both dimensions of at most this size are loaded up front and are never evicted.
+            uint32_t maxPendingLoads = 8;           ///< Maximum number of textures that are streamed in at the same time.
+        };
+
+        /** Request for a texture to be resident down to a given mip level.
+        */
+        struct Request
+        {
+            TextureID textureID;
+            uint32_t mipLevel;                      ///< Most detailed mip level that is needed.
+        };
+
+        /** Source of mip level requests.
+        */
+        class dlldecl FeedbackSource
+        {
+        public:
+            using SharedPtr = std::shared_ptr<FeedbackSource>;
+
+            virtual ~FeedbackSource() = default;
+
+            /** Collect the requests issued since the last call.
+                \param[in] pRenderContext Render context.
+                \param[out] requests Requests are appended to this list.
+            */
+            virtual void collectRequests(RenderContext* pRenderContext, std::vector<Request>& requests) = 0;
+
+            /** Render the UI of the feedback source.
+            */
+            virtual void renderUI(Gui::Widgets& widget) {}
+        };
+
+        /** Feedback source for requests issued on the CPU.
+        */
+        class dlldecl EmulatedFeedback : public FeedbackSource
+        {
+        public:
+            using SharedPtr = std::shared_ptr<EmulatedFeedback>;
+
+            static SharedPtr create() { return SharedPtr(new EmulatedFeedback()); }
+
+            /** Request a texture to be resident down to a given mip level in the next update.
+            */
+            void requestMip(TextureID textureID, uint32_t mipLevel) { mRequests.push_back({ textureID, mipLevel }); }
+
+            void collectRequests(RenderContext* pRenderContext, std::vector<Request>& requests) override;
+
+        private:
+            EmulatedFeedback() = default;
+
+            std::vector<Request> mRequests;
+        };
+
+        struct Stats
+        {
+            uint32_t textureCount = 0;              ///< Number of textures.
+            uint32_t streamedTextureCount = 0;      ///< Number of textures with mip levels that are streamed.
+            uint64_t pinnedMemoryInBytes = 0;       ///< Memory used by the mip tails.
+            uint64_t residentMemoryInBytes = 0;     ///< Memory used by the resident streamed mip levels.
+            uint64_t pendingMemoryInBytes = 0;      ///< Memory reserved for mip levels that are being loaded.
+            uint64_t loadedBytes = 0;               ///< Total size of the mip levels streamed in.
+            uint64_t evictedBytes = 0;              ///< Total size of the mip levels evicted.
+            uint32_t pendingLoads = 0;              ///< Number of textures being streamed in.
+        };
+
+        /** Create a texture streamer.
+            \param[in] pTextureCache Texture cache holding the preprocessed textures. If nullptr, a cache with default options is used.
+            \param[in] options Streaming options.
+            \return A new object.
+        */
+        static SharedPtr create(const TextureCache::SharedPtr& pTextureCache = nullptr, const Options& options = Options());
+
+        /** Add a texture to stream. The mip tail is loaded asynchronously.
+            Adding the same file with the same sRGB setting again returns the existing texture.
+            \param[in] filename Filename of the image. Can also include a full path or relative path from a data directory.
+            \param[in] loadAsSrgb Load the texture using sRGB format.
+            \param[in] onUpdate Callback that is called with the new texture whenever the texture is (re)created.
+            \return ID of the texture, or kInvalidID if the file could not be found.
+        */
+        TextureID addTexture(const std::string& filename, bool loadAsSrgb, UpdateCallback onUpdate);
+
+        /** Wait until the mip tails of all added textures are loaded and call their update callbacks.
+        */
+        void finishInitialLoads();
+
+        /** Update the texture residency. Finishes pending loads, processes the requests and issues new loads.
+            \param[in] pRenderContext Render context.
+            \param[in] pFeedback Source of the requests. If nullptr, no new mip levels are streamed in.
+        */
+        void update(RenderContext* pRenderContext, FeedbackSource* pFeedback = nullptr);
+
+        /** Render the GUI.
+        */
+        void renderUI(Gui::Widgets& widget);
+
+        /** Get the current texture with the resident mip levels.
+        */
+        Texture::SharedPtr getTexture(TextureID textureID) const;
+
+        /** Get the most detailed resident mip level of a texture.
+        */
+        uint32_t getResidentMip(TextureID textureID) const;
+
+        /** Get the number of mip levels of the full texture.
+        */
+        uint32_t getMipCount(TextureID textureID) const;
+
+        /** Check if a texture has mip levels that can be streamed in or out.
+        */
+        bool isStreamed(const Texture::SharedPtr& pTexture) const;
+
+        uint32_t getTextureCount() const { return (uint32_t)mTextures.size(); }
+
+        void setOptions(const Options& options) { mOptions = options; }
+        const Options& getOptions() const { return mOptions; }
+
+        Stats getStats() const;
+
+    private:
+        TextureStreamer(const TextureCache::SharedPtr& pTextureCache, const Options& options);
+
+        /** Page table entry of a mip level.
+        */
+        struct Page
+        {
+            uint64_t size = 0;                      ///< Size of the mip level in bytes.
+            uint64_t lastUsedFrame = 0;             ///< Last frame the mip level was requested.
+            bool resident = false;
+        };
+
+        /** Asynchronous load of a range of mip levels.
+        */
+        struct LoadJob
+        {
+            bool initial = false;                   ///< Loads the mip tail. The file is only known after the load.
+            uint32_t mostDetailedMip = 0;
+            std::string ddsPath;
+            ImageIO::DDSDesc desc;
+            ImageIO::MipChain mipChain;
+            Threading::Task task;
+        };
+
+        struct StreamedTexture
+        {
+            std::string filename;                   ///< Absolute path of the source image.
+            bool loadAsSrgb = false;
+            std::string ddsPath;                    ///< DDS file holding the full mip chain.
+            ResourceFormat format = ResourceFormat::Unknown;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t pinnedMip = 0;                 ///< Mip levels from this level on are always resident.
+            uint32_t residentMip = 0;               ///< Most detailed resident mip level.
+            std::vector<Page> pages;                ///< Page table with one page per mip level. Empty until the mip tail is loaded.
+            Texture::SharedPtr pTexture;
+            std::vector<UpdateCallback> callbacks;
+            std::shared_ptr<LoadJob> pLoad;         ///< Pending load or nullptr.
+        };
+
+        void dispatchLoad(TextureID textureID, uint32_t mostDetailedMip, bool initial);
+        void finishLoad(TextureID textureID);
+        bool evictMip(TextureID excludedID, bool allowRecentlyUsed, std::vector<TextureID>& evicted);
+        uint32_t getNextValidMip(const StreamedTexture& texture, uint32_t mipLevel) const;
+        void recreateTexture(RenderContext* pRenderContext, TextureID textureID);
+        void notify(TextureID textureID);
+        uint64_t getSize(const StreamedTexture& texture, uint32_t beginMip, uint32_t endMip) const;
+
+        TextureCache::SharedPtr mpTextureCache;
+        Options mOptions;
+
+        std::vector<StreamedTexture> mTextures;
+        std::map<std::pair<std::string, bool>, TextureID> mTextureIDs;   ///< Maps (filename, sRGB) to texture ID.
+
+        uint64_t mFrame = 0;
+        uint64_t mPinnedBytes = 0;
+        uint64_t mResidentBytes = 0;
+        uint64_t mPendingBytes = 0;
+        uint64_t mLoadedBytes = 0;
+        uint64_t mEvictedBytes = 0;
+    };
+}
@@ -0,0 +1,268 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "MeshOptimizer.h"
+#include "Utils/Math/AABB.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        const uint32_t kInvalidIndex = 0xffffffff;
+
+        /** Pops dead-end vertices until one with live triangles is found. Falls back to scanning the vertices in order.
+        */
+        uint32_t skipDeadEnd(std::vector<uint32_t>& deadEnd, const std::vector<uint32_t>& liveCount, uint32_t& cursor)
+        {
+            while (!deadEnd.empty())
+            {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveCount[v] > 0) return v;
+            }
+            for (; cursor < (uint32_t)liveCount.size(); cursor++)
+            {
+                if (liveCount[cursor] > 0) return cursor;
+            }
+            return kInvalidIndex;
+        }
+
+        /** Tipsify triangle reordering [Sander et al. 2007].
+            Triangles are emitted as fans around a vertex. The next fanning vertex is chosen among the vertices of the
+            last fan, preferring the one that is still in the cache and whose remaining triangles fit before it is evicted.
+        */
+        void tipsify(const uint32_t* pIndices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize, uint32_t* pOutput)
+        {
+            const uint32_t triangleCount = uint32_t(indexCount / 3);
+
+            // Build vertex-triangle adjacency.
+            std::vector<uint32_t> liveCount(vertexCount, 0);
+            for (size_t i = 0; i < indexCount; i++) liveCount[pIndices[i]]++;
+
+            std::vector<uint32_t> offsets(vertexCount + 1, 0);
+            for (uint32_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + liveCount[v];
+
+            std::vector<uint32_t> adjacency(indexCount);
+            {
+                std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+                for (uint32_t t = 0; t < triangleCount; t++)
+                {
+                    for (uint32_t k = 0; k < 3; k++) adjacency[fill[pIndices[t * 3 + k]]++] = t;
+                }
+            }
+
+            std::vector<uint32_t> cacheTime(vertexCount, 0);
+            std::vector<bool> emitted(triangleCount, false);
+            std::vector<uint32_t> deadEnd;
+            std::vector<uint32_t> candidates;
+            deadEnd.reserve(indexCount);
+
+            uint32_t time = cacheSize + 1;
+            uint32_t cursor = 0;
+            size_t outputCount = 0;
+            uint32_t fanVertex = skipDeadEnd(deadEnd, liveCount, cursor);
+
+            while (fanVertex != kInvalidIndex)
+            {
+                candidates.clear();
+
+                // Emit all remaining triangles around the fanning vertex.
+                for (uint32_t a = offsets[fanVertex]; a < offsets[fanVertex + 1]; a++)
+                {
+                    uint32_t t = adjacency[a];
+                    if (emitted[t]) continue;
+
+                    for (uint32_t k = 0; k < 3; k++)
+                    {
+                        uint32_t v = pIndices[t * 3 + k];
+                        pOutput[outputCount++] = v;
+                        deadEnd.push_back(v);
+                        candidates.push_back(v);
+                        liveCount[v]--;
+                        if (time - cacheTime[v] > cacheSize)
+                        {
+                            cacheTime[v] = time;
+                            time++;
+                        }
+                    }
+                    emitted[t] = true;
+                }
+
+                // Select the next fanning vertex.
+                uint32_t nextVertex = kInvalidIndex;
+                int64_t bestPriority = -1;
+                for (uint32_t v : candidates)
+                {
+                    if (liveCount[v] == 0) continue;
+                    int64_t priority = 0;
+                    if (time - cacheTime[v] + 2 * liveCount[v] <= cacheSize) priority = time - cacheTime[v];
+                    if (priority > bestPriority)
+                    {
+                        bestPriority = priority;
+                        nextVertex = v;
+                    }
+                }
+                if (nextVertex == kInvalidIndex) nextVertex = skipDeadEnd(deadEnd, liveCount, cursor);
+                fanVertex = nextVertex;
+            }
+
+            assert(outputCount == (size_t)triangleCount * 3);
+        }
+
+        /** Spreads the lower 10 bits of x so that there are two zero bits between each bit.
+        */
+        uint32_t part1By2(uint32_t x)
+        {
+            x &= 0x3ff;
+            x = (x ^ (x << 16)) & 0xff0000ff;
+            x = (x ^ (x << 8)) & 0x0300f00f;
+            x = (x ^ (x << 4)) & 0x030c30c3;
+            x = (x ^ (x << 2)) & 0x09249249;
+            return x;
+        }
+    }
+
+    MeshOptimizer::CacheStats MeshOptimizer::computeCacheStats(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+    {
+        // A vertex is in the FIFO cache if fewer than 'cacheSize' misses occurred since it was inserted.
+        std::vector<uint64_t> insertTime(vertexCount, 0);
+        CacheStats stats;
+        stats.triangleCount = indices.size() / 3;
+
+        for (uint32_t v : indices)
+        {
+            assert(v < vertexCount);
+            if (insertTime[v] == 0) stats.vertexCount++;
+            if (insertTime[v] == 0 || stats.missCount - insertTime[v] >= cacheSize)
+            {
+                stats.missCount++;
+                insertTime[v] = stats.missCount;
+            }
+        }
+
+        return stats;
+    }
+
+    std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize, uint32_t clusterTriangleCount)
+    {
+        assert(indices.size() % 3 == 0);
+        std::vector<uint32_t> result(indices.size());
+
+        if (clusterTriangleCount == 0)
+        {
+            tipsify(indices.data(), indices.size(), vertexCount, cacheSize, result.data());
+            return result;
+        }
+
+        // Optimize each cluster on its own compact set of vertices, so the cost is linear in the cluster size.
+        std::vector<uint32_t> localIndex(vertexCount, kInvalidIndex);
+        std::vector<uint32_t> globalIndex;
+        std::vector<uint32_t> clusterIndices;
+        std::vector<uint32_t> clusterResult;
+        const size_t clusterIndexCount = (size_t)clusterTriangleCount * 3;
+
+        for (size_t start = 0; start < indices.size(); start += clusterIndexCount)
+        {
+            const size_t end = std::min(start + clusterIndexCount, indices.size());
+            globalIndex.clear();
+            clusterIndices.clear();
+
+            for (size_t i = start; i < end; i++)
+            {
+                uint32_t v = indices[i];
+                if (localIndex[v] == kInvalidIndex)
+                {
+                    localIndex[v] = (uint32_t)globalIndex.size();
+                    globalIndex.push_back(v);
+                }
+                clusterIndices.push_back(localIndex[v]);
+            }
+
+            clusterResult.resize(clusterIndices.size());
+            tipsify(clusterIndices.data(), clusterIndices.size(), (uint32_t)globalIndex.size(), cacheSize, clusterResult.data());
+
+            for (size_t i = 0; i < clusterResult.size(); i++) result[start + i] = globalIndex[clusterResult[i]];
+            for (uint32_t v : globalIndex) localIndex[v] = kInvalidIndex;
+        }
+
+        return result;
+    }
+
+    std::vector<uint32_t> MeshOptimizer::optimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount)
+    {
+        std::vector<uint32_t> remap(vertexCount, kInvalidIndex);
+        uint32_t nextIndex = 0;
+
+        for (auto& index : indices)
+        {
+            assert(index < vertexCount);
+            if (remap[index] == kInvalidIndex) remap[index] = nextIndex++;
+            index = remap[index];
+        }
+
+        for (auto& index : remap)
+        {
+            if (index == kInvalidIndex) index = nextIndex++;
+        }
+
+        return remap;
+    }
+
+    void MeshOptimizer::sortTrianglesMorton(std::vector<uint32_t>& indices, const std::vector<float3>& positions)
+    {
+        const uint32_t triangleCount = uint32_t(indices.size() / 3);
+        if (triangleCount == 0) return;
+
+        std::vector<float3> centroids(triangleCount);
+        AABB bounds;
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            centroids[t] = (positions[indices[t * 3]] + positions[indices[t * 3 + 1]] + positions[indices[t * 3 + 2]]) / 3.f;
+            bounds.include(centroids[t]);
+        }
+
+        // Quantize the centroids to 10 bits per axis and sort by the interleaved code.
+        // Ties are broken by the original triangle order, so the result is deterministic.
+        const float3 scale = 1023.f / glm::max(bounds.extent(), float3(1e-20f));
+        std::vector<std::pair<uint32_t, uint32_t>> keys(triangleCount);
+        for (uint32_t t = 0; t < triangleCount; t++)
+        {
+            uint3 q = uint3(glm::clamp((centroids[t] - bounds.minPoint) * scale, float3(0.f), float3(1023.f)));
+            keys[t] = { part1By2(q.x) | (part1By2(q.y) << 1) | (part1By2(q.z) << 2), t };
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<uint32_t> sorted(indices.size());
+        for (uint32_t i = 0; i < triangleCount; i++)
+        {
+            uint32_t t = keys[i].second;
+            for (uint32_t k = 0; k < 3; k++) sorted[i * 3 + k] = indices[t * 3 + k];
+        }
+        indices = std::move(sorted);
+    }
+}
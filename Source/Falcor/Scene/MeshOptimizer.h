@@ -0,0 +1,99 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+
+namespace Falcor
+{
+    /** Mesh optimizations improving the memory locality of indexed triangle meshes.
+        All functions operate on triangle list index buffers with 32-bit indices.
+    */
+    class dlldecl MeshOptimizer
+    {
+    public:
+        static const uint32_t kDefaultCacheSize = 16;   ///< Default size of the simulated post-transform vertex cache.
+
+        /** Post-transform vertex cache statistics of an index buffer.
+            The counts are additive so statistics of multiple meshes can be accumulated.
+        */
+        struct CacheStats
+        {
+            uint64_t triangleCount = 0;     ///< Number of triangles.
+            uint64_t vertexCount = 0;       ///< Number of unique vertices referenced.
+            uint64_t missCount = 0;         ///< Number of vertex cache misses, i.e. vertex shader invocations.
+
+            /** Average cache miss ratio, i.e. the number of transformed vertices per triangle (0.5 is optimal for large regular meshes, 3 is worst).
+            */
+            float getACMR() const { return triangleCount > 0 ? float(missCount) / float(triangleCount) : 0.f; }
+
+            /** Average transformed vertex ratio, i.e. the number of transformed vertices per unique vertex (1 is optimal).
+            */
+            float getATVR() const { return vertexCount > 0 ? float(missCount) / float(vertexCount) : 0.f; }
+
+            CacheStats& operator+=(const CacheStats& other)
+            {
+                triangleCount += other.triangleCount;
+                vertexCount += other.vertexCount;
+                missCount += other.missCount;
+                return *this;
+            }
+        };
+
+        /** Compute vertex cache statistics by simulating a FIFO post-transform vertex cache.
+            \param[in] indices Triangle list indices.
+            \param[in] vertexCount Number of vertices. All indices must be smaller.
+            \param[in] cacheSize Number of vertices in the simulated cache.
+            \return Cache statistics.
+        */
+        static CacheStats computeCacheStats(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = kDefaultCacheSize);
+
+        /** Reorder triangles to improve post-transform vertex cache reuse.
+            This implements the Tipsify algorithm [Sander et al. 2007], which is linear in the number of triangles.
+            \param[in] indices Triangle list indices.
+            \param[in] vertexCount Number of vertices. All indices must be smaller.
+            \param[in] cacheSize Number of vertices in the targeted vertex cache.
+            \param[in] clusterTriangleCount If non-zero, consecutive clusters of this many triangles are optimized independently so that the cluster order is preserved.
+            \return Reordered triangle list indices.
+        */
+        static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = kDefaultCacheSize, uint32_t clusterTriangleCount = 0);
+
+        /** Reorder vertices in the order they are first referenced by the indices, to improve vertex fetch locality.
+            The indices are updated to the new vertex order. Unreferenced vertices are moved to the end.
+            \param[in,out] indices Triangle list indices.
+            \param[in] vertexCount Number of vertices. All indices must be smaller.
+            \return Remapping table from old to new vertex index.
+        */
+        static std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+        /** Sort triangles along a Morton curve through their centroids.
+            Splitting the result into consecutive clusters yields spatially compact meshlets.
+            \param[in,out] indices Triangle list indices.
+            \param[in] positions Vertex positions.
+        */
+        static void sortTrianglesMorton(std::vector<uint32_t>& indices, const std::vector<float3>& positions);
+    };
+}
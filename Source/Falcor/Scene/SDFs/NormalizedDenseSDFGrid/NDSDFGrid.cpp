@@ -49,6 +49,13 @@ namespace Falcor
     {
         size_t totalSize = 0;
 
+        if (mNDSDFTextures.empty())
+        {
+            // Report the size of the CPU data if the GPU resources have not been created yet, the textures use the same format.
+            for (const std::vector<uint8_t>& lodValues : mValues) totalSize += lodValues.size();
+            return totalSize;
+        }
+
         for (const Texture::SharedPtr& pNormalizedVolumeTexture : mNDSDFTextures)
         {
             totalSize += pNormalizedVolumeTexture->getTextureSizeInBytes();
@@ -122,10 +129,7 @@ namespace Falcor
                         uint32_t writeLocation = x + lodWidthInValues * (y + lodWidthInValues * z);
                         uint32_t readLocation = lodReadStride * (x + gridWidthInValues * (y + gridWidthInValues * z));
 
-                        float normalizedValue = glm::clamp(cornerValues[readLocation] / normalizationFactor, -1.0f, 1.0f);
-
-                        float integerScale = normalizedValue * float(INT8_MAX);
-                        int8_t v = integerScale >= 0.0f ? int8_t(integerScale + 0.5f) : int8_t(integerScale - 0.5f);
+                        int8_t v = quantizeNormalizedDistance(cornerValues[readLocation] / normalizationFactor);
                         std::memcpy(&lodFormattedValues[writeLocation], &v, sizeof(int8_t));
                     }
                 }
@@ -135,6 +139,36 @@ namespace Falcor
         return true;
     }
 
+    float NDSDFGrid::evalDistance(const float3& pLocal) const
+    {
+        if (mValues.empty())
+        {
+            logError("NDSDFGrid::evalDistance() can't be called before the values have been set");
+            return 0.0f;
+        }
+
+        const std::vector<uint8_t>& values = mValues.back();
+        const uint32_t gridWidthInValues = mGridWidth + 1;
+
+        float3 voxelPosition = glm::clamp(pLocal + 0.5f, 0.0f, 1.0f) * float(mGridWidth);
+        uint3 voxelCoords = glm::min(uint3(voxelPosition), uint3(mGridWidth - 1));
+        float3 voxelUnitCoords = voxelPosition - float3(voxelCoords);
+
+        auto loadValue = [&](uint32_t x, uint32_t y, uint32_t z)
+        {
+            int8_t v;
+            std::memcpy(&v, &values[x + gridWidthInValues * (y + gridWidthInValues * z)], sizeof(int8_t));
+            return dequantizeNormalizedDistance(v);
+        };
+
+        const uint32_t x = voxelCoords.x, y = voxelCoords.y, z = voxelCoords.z;
+        float4 values0xx(loadValue(x, y, z), loadValue(x, y, z + 1), loadValue(x, y + 1, z), loadValue(x, y + 1, z + 1));
+        float4 values1xx(loadValue(x + 1, y, z), loadValue(x + 1, y, z + 1), loadValue(x + 1, y + 1, z), loadValue(x + 1, y + 1, z + 1));
+
+        const float normalizationFactor = mCoarsestLODNormalizationFactor / float(1 << (mValues.size() - 1));
+        return interpolateVoxel(values0xx, values1xx, voxelUnitCoords) * normalizationFactor;
+    }
+
     void NDSDFGrid::setShaderData(const ShaderVar& var) const
     {
         if (mNDSDFTextures.empty()) logError("NDSDFGrid::setShaderData() can't be called before calling NDSDFGrid::createResources()");
@@ -32,7 +32,8 @@
 
 namespace Falcor
 {
-    /** A normalized dense SDF grid, represented as a set of textures. Can only be accessed on the GPU.
+    /** A normalized dense SDF grid, represented as a set of textures, one per LOD.
+        The finest LOD is kept on the CPU so that the grid can be evaluated with SDFGrid::evalDistance().
     */
     class dlldecl NDSDFGrid : public SDFGrid
     {
@@ -44,6 +45,8 @@ namespace Falcor
         */
         static SharedPtr create();
 
+        virtual Type getType() const override { return Type::NormalizedDenseGrid; }
+
         virtual size_t getSize() const override;
 
         virtual uint32_t getMaxPrimitiveIDBits() const override { return bitScanReverse(uint32_t(mValues.size() - 1)) + 1; }
@@ -52,6 +55,8 @@ namespace Falcor
 
         virtual void setShaderData(const ShaderVar& var) const override;
 
+        virtual float evalDistance(const float3& pLocal) const override;
+
     protected:
         virtual bool setValuesInternal(const std::vector<float>& cornerValues) override;
 
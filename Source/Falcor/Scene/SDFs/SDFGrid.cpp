@@ -28,16 +28,42 @@
 #include "stdafx.h"
 #include "SDFGrid.h"
 #include "Scene/SDFs/NormalizedDenseSDFGrid/NDSDFGrid.h"
+#include "Scene/SDFs/SparseBrickSet/SDFSBS.h"
 
 namespace Falcor
 {
-    SDFGrid::SharedPtr SDFGrid::create()
+    namespace
     {
-        // This function exists to make it possible to create the SDF grids in python.
-        // In the future it will take an SDF grid type as parameter and create the correct underlying implementation.
-        // TODO: Take an SDF grid type as parameter and create the corrent underlying implementation.
+        const float kMinStepSize = 0.001f;
+        const uint32_t kMaxSteps = 512;
+
+        // Returns the entry and exit distances of a ray and the unit cube, matches intersectRayAABB() on the GPU.
+        bool intersectUnitCube(const float3& origin, const float3& dir, float2& nearFar)
+        {
+            float3 invDir = 1.0f / dir;
+            float3 t1 = (float3(0.0f) - origin) * invDir;
+            float3 t2 = (float3(1.0f) - origin) * invDir;
+            float3 tNear = glm::min(t1, t2);
+            float3 tFar = glm::max(t1, t2);
+            nearFar.x = std::max(0.0f, std::max(std::max(tNear.x, tNear.y), tNear.z));
+            nearFar.y = std::min(std::min(tFar.x, tFar.y), tFar.z);
+            return nearFar.x <= nearFar.y;
+        }
+    }
 
-        return NDSDFGrid::create();
+    SDFGrid::SharedPtr SDFGrid::create(Type type)
+    {
+        // This function exists to make it possible to create the SDF grids in python.
+        switch (type)
+        {
+        case Type::NormalizedDenseGrid:
+            return NDSDFGrid::create();
+        case Type::SparseBrickSet:
+            return SDFSBS::create();
+        default:
+            logError("SDFGrid::create() unknown SDF grid type " + std::to_string((uint32_t)type));
+            return nullptr;
+        }
     }
 
     bool SDFGrid::setValues(const std::vector<float>& cornerValues, uint32_t gridWidth, float narrowBandThickness)
@@ -83,16 +109,70 @@ namespace Falcor
         return false;
     }
 
-    float SDFGrid::calculateNormalizationFactor(uint32_t gridWidth)
+    float SDFGrid::calculateNormalizationFactor(uint32_t gridWidth) const
     {
         return 0.5f * glm::root_three<float>() * mNarrowBandThickness / gridWidth;
     }
 
+    bool SDFGrid::intersectRay(const float3& rayOrigin, const float3& rayDir, float tMin, float tMax, float& t) const
+    {
+        // Add 0.5f to origin so that it is in [0, 1] instead of [-0.5, 0.5].
+        float3 rayOrigLocal = rayOrigin + 0.5f;
+
+        // Normalize ray direction.
+        float dirLength = glm::length(rayDir);
+        float inverseDirLength = 1.0f / dirLength;
+        float3 rayDirLocal = rayDir * inverseDirLength;
+
+        float2 nearFar;
+        if (!intersectUnitCube(rayOrigLocal, rayDirLocal, nearFar)) return false;
+
+        t = std::max(tMin * dirLength, nearFar.x);
+        float tMaxLocal = std::min(tMax * dirLength, nearFar.y);
+        if (tMaxLocal < t) return false;
+
+        // Distances are clamped to the narrow band, so the minimum step is relative to the normalization factor of the finest grid.
+        const float minStep = kMinStepSize * calculateNormalizationFactor(mGridWidth);
+
+        float currH = evalDistance(rayOrigLocal + t * rayDirLocal - 0.5f);
+        if (currH <= 0.0f)
+        {
+            t = tMin;
+            return true;
+        }
+        currH = std::max(currH, minStep);
+
+        for (uint32_t steps = 0; steps < kMaxSteps; steps++)
+        {
+            t += currH;
+            if (t > tMaxLocal) return false;
+
+            float nextH = evalDistance(rayOrigLocal + t * rayDirLocal - 0.5f);
+            if (nextH <= 0.0f)
+            {
+                // Linear interpolation to approximate intersection point.
+                t += currH * nextH / (currH - nextH);
+                t *= inverseDirLength;
+                return true;
+            }
+
+            currH = std::max(nextH, minStep);
+        }
+
+        return false;
+    }
+
+    int8_t SDFGrid::quantizeNormalizedDistance(float normalizedDistance)
+    {
+        float integerScale = glm::clamp(normalizedDistance, -1.0f, 1.0f) * float(INT8_MAX);
+        return integerScale >= 0.0f ? int8_t(integerScale + 0.5f) : int8_t(integerScale - 0.5f);
+    }
+
     SCRIPT_BINDING(SDFGrid)
     {
-        auto createCheeseSDFGrid = [](uint32_t gridWidth, float narrowBandThickness, uint32_t seed)
+        auto createCheeseSDFGrid = [](uint32_t gridWidth, float narrowBandThickness, uint32_t seed, SDFGrid::Type type)
         {
-            SDFGrid::SharedPtr pSDFGrid = SDFGrid::create();
+            SDFGrid::SharedPtr pSDFGrid = SDFGrid::create(type);
 
             const float kHalfCheeseExtent = 0.4f;
             const uint32_t kHoleCount = 32;
@@ -146,9 +226,16 @@ namespace Falcor
         };
 
         pybind11::class_<SDFGrid, SDFGrid::SharedPtr> sdfGrid(m, "SDFGrid");
-        sdfGrid.def(pybind11::init(pybind11::overload_cast<void>(&SDFGrid::create)));
+
+        pybind11::enum_<SDFGrid::Type> type(sdfGrid, "Type");
+        type.value("NormalizedDenseGrid", SDFGrid::Type::NormalizedDenseGrid);
+        type.value("SparseBrickSet", SDFGrid::Type::SparseBrickSet);
+
+        sdfGrid.def(pybind11::init(&SDFGrid::create), "type"_a = SDFGrid::Type::NormalizedDenseGrid);
         sdfGrid.def("loadValuesFromFile", &SDFGrid::loadValuesFromFile, "filename"_a, "narrowBandThickness"_a);
         sdfGrid.def_property("name", &SDFGrid::getName, &SDFGrid::setName);
-        sdfGrid.def_static("createCheeseSDFGrid", createCheeseSDFGrid, "gridWidth"_a, "narrowBandThickness"_a, "seed"_a);
+        sdfGrid.def_property_readonly("type", &SDFGrid::getType);
+        sdfGrid.def_property_readonly("size", &SDFGrid::getSize);
+        sdfGrid.def_static("createCheeseSDFGrid", createCheeseSDFGrid, "gridWidth"_a, "narrowBandThickness"_a, "seed"_a, "type"_a = SDFGrid::Type::NormalizedDenseGrid);
     }
 }
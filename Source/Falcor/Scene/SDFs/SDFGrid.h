@@ -43,12 +43,21 @@ namespace Falcor
     public:
         using SharedPtr = std::shared_ptr<SDFGrid>;
 
+        /** SDF grid implementation. All SDF grids in a scene must use the same implementation.
+        */
+        enum class Type : uint32_t
+        {
+            NormalizedDenseGrid = 0,    ///< Dense normalized grid with one texture per LOD, see NDSDFGrid.
+            SparseBrickSet = 1,         ///< Sparse set of bricks covering the narrow band, see SDFSBS.
+        };
+
         virtual ~SDFGrid() = default;
 
         /** Create a new, empty SDF grid.
-           \return dlldecl object, or nullptr if errors occurred.
-       */
-        static SharedPtr create();
+            \param[in] type The SDF grid implementation to create.
+            \return SDFGrid object, or nullptr if errors occurred.
+        */
+        static SharedPtr create(Type type = Type::NormalizedDenseGrid);
 
         /** Set the signed distance values of the SDF grid, values are expected to be at the corners of voxels.
             \param[in] cornerValues The corner values for all voxels in the grid.
@@ -67,7 +76,22 @@ namespace Falcor
 
         /** Calculates the appropriate normalization factor given a grid width (in voxels).
         */
-        float calculateNormalizationFactor(uint32_t gridWidth);
+        float calculateNormalizationFactor(uint32_t gridWidth) const;
+
+        /** Intersect a ray with the SDF grid on the CPU by sphere tracing the same quantized values that are used on the GPU.
+            This is intended for validation and is not optimized for performance.
+            \param[in] rayOrigin The origin of the ray in the local space of the SDF grid.
+            \param[in] rayDir The direction of the ray in the local space of the SDF grid, does not need to be normalized.
+            \param[in] tMin Minimum valid value for t.
+            \param[in] tMax Maximum valid value for t.
+            \param[out] t Intersection t, in units of rayDir.
+            \return True if the ray intersects the SDF grid, false otherwise.
+        */
+        bool intersectRay(const float3& rayOrigin, const float3& rayDir, float tMin, float tMax, float& t) const;
+
+        /** Returns the implementation type of the SDF grid.
+        */
+        virtual Type getType() const = 0;
 
         /** Returns the width of the SDF grid in voxels.
         */
@@ -103,9 +127,32 @@ namespace Falcor
         */
         virtual void setShaderData(const ShaderVar& var) const = 0;
 
+        /** Evaluates the signed distance at a point on the CPU by trilinearly interpolating the quantized corner values of the finest grid.
+            \param[in] pLocal The point in the local space of the SDF grid.
+            \return The signed distance in the local space of the SDF grid, clamped to the narrow band.
+        */
+        virtual float evalDistance(const float3& pLocal) const = 0;
+
     protected:
         virtual bool setValuesInternal(const std::vector<float>& cornerValues) = 0;
 
+        /** Quantizes a normalized distance to snorm8, values outside [-1, 1] are clamped.
+        */
+        static int8_t quantizeNormalizedDistance(float normalizedDistance);
+
+        /** Converts a snorm8 value back to a normalized distance, matches the conversion done by the GPU for R8Snorm textures.
+        */
+        static float dequantizeNormalizedDistance(int8_t value) { return std::max(float(value) / float(INT8_MAX), -1.0f); }
+
+        /** Trilinearly interpolates the eight corner values of a voxel using voxel unit coords, matches SDFVoxelCommon::sdfVoxelTrilin().
+        */
+        static float interpolateVoxel(const float4& values0xx, const float4& values1xx, const float3& voxelUnitCoords)
+        {
+            float4 cXs = glm::mix(values0xx, values1xx, voxelUnitCoords.x);
+            float2 cYs = glm::mix(float2(cXs.x, cXs.y), float2(cXs.z, cXs.w), voxelUnitCoords.y);
+            return glm::mix(cYs.x, cYs.y, voxelUnitCoords.z);
+        }
+
         std::string mName;
         uint32_t mGridWidth = 0;
         float mNarrowBandThickness = 0.0f;
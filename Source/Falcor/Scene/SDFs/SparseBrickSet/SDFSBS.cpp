@@ -0,0 +1,283 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "SDFSBS.h"
+#include "Utils/Threading.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        // Largest 3D texture dimension, limits the size of the brick atlas.
+        const uint32_t kMaxAtlasWidthInBricks = 2048 / SDFSBS::kBrickWidthInValues;
+
+        // Temporary indirection value used during classification for bricks that intersect the narrow band.
+        const uint32_t kSurfaceBrick = 0;
+    }
+
+    Sampler::SharedPtr SDFSBS::sSDFSBSSampler;
+
+    SDFSBS::SharedPtr SDFSBS::create()
+    {
+        if (!sSDFSBSSampler)
+        {
+            Sampler::Desc sdfSBSSamplerDesc;
+            sdfSBSSamplerDesc.setFilterMode(Sampler::Filter::Linear, Sampler::Filter::Linear, Sampler::Filter::Linear);
+            sdfSBSSamplerDesc.setAddressingMode(Sampler::AddressMode::Clamp, Sampler::AddressMode::Clamp, Sampler::AddressMode::Clamp);
+            sSDFSBSSampler = Sampler::create(sdfSBSSamplerDesc);
+        }
+
+        return SharedPtr(new SDFSBS());
+    }
+
+    size_t SDFSBS::getSize() const
+    {
+        if (mpBrickAtlas && mpIndirectionTexture)
+        {
+            return mpBrickAtlas->getTextureSizeInBytes() + mpIndirectionTexture->getTextureSizeInBytes();
+        }
+
+        // Report the size of the CPU data if the GPU resources have not been created yet.
+        return mBrickValues.size() * sizeof(int8_t) + mIndirection.size() * sizeof(uint32_t);
+    }
+
+    bool SDFSBS::createResources(RenderContext* pRenderContext, bool deleteScratchData)
+    {
+        if (mIndirection.empty())
+        {
+            logError("SDFSBS::createResources() can't be called before the values have been set");
+            return false;
+        }
+
+        // Lay out the bricks in the atlas, brick i is placed at (i % x, (i / x) % y, i / (x * y)) in units of bricks.
+        const uint3 atlasSize = mAtlasSizeInBricks * kBrickWidthInValues;
+        std::vector<int8_t> atlasData(size_t(atlasSize.x) * atlasSize.y * atlasSize.z, 0);
+
+        Threading::parallelFor(0u, mBrickCount, [&](uint32_t brickID)
+        {
+            const uint3 atlasOrigin = kBrickWidthInValues * uint3(brickID % mAtlasSizeInBricks.x, (brickID / mAtlasSizeInBricks.x) % mAtlasSizeInBricks.y, brickID / (mAtlasSizeInBricks.x * mAtlasSizeInBricks.y));
+            const int8_t* pSrc = mBrickValues.data() + size_t(brickID) * kBrickValueCount;
+
+            for (uint32_t z = 0; z < kBrickWidthInValues; z++)
+            {
+                for (uint32_t y = 0; y < kBrickWidthInValues; y++)
+                {
+                    size_t dstOffset = atlasOrigin.x + size_t(atlasSize.x) * ((atlasOrigin.y + y) + size_t(atlasSize.y) * (atlasOrigin.z + z));
+                    std::memcpy(&atlasData[dstOffset], pSrc + kBrickWidthInValues * (y + kBrickWidthInValues * z), kBrickWidthInValues);
+                }
+            }
+        });
+
+        if (pRenderContext && mpBrickAtlas && mpBrickAtlas->getWidth() == atlasSize.x && mpBrickAtlas->getHeight() == atlasSize.y && mpBrickAtlas->getDepth() == atlasSize.z)
+        {
+            pRenderContext->updateTextureData(mpBrickAtlas.get(), atlasData.data());
+        }
+        else
+        {
+            mpBrickAtlas = Texture::create3D(atlasSize.x, atlasSize.y, atlasSize.z, ResourceFormat::R8Snorm, 1, atlasData.data());
+        }
+
+        if (pRenderContext && mpIndirectionTexture && mpIndirectionTexture->getWidth() == mBrickGridWidth)
+        {
+            pRenderContext->updateTextureData(mpIndirectionTexture.get(), mIndirection.data());
+        }
+        else
+        {
+            mpIndirectionTexture = Texture::create3D(mBrickGridWidth, mBrickGridWidth, mBrickGridWidth, ResourceFormat::R32Uint, 1, mIndirection.data());
+        }
+
+        return true;
+    }
+
+    bool SDFSBS::setValuesInternal(const std::vector<float>& cornerValues)
+    {
+        const uint32_t gridWidthInValues = mGridWidth + 1;
+        const size_t totalValueCount = size_t(gridWidthInValues) * gridWidthInValues * gridWidthInValues;
+
+        if (cornerValues.size() != totalValueCount)
+        {
+            logError("SDFSBS::setValues() expected " + std::to_string(totalValueCount) + " corner values, got " + std::to_string(cornerValues.size()));
+            return false;
+        }
+
+        mNormalizationFactor = calculateNormalizationFactor(mGridWidth);
+        mBrickGridWidth = (mGridWidth + kBrickWidthInVoxels - 1) / kBrickWidthInVoxels;
+        const uint32_t brickGridCount = mBrickGridWidth * mBrickGridWidth * mBrickGridWidth;
+
+        // Quantize all corner values to snorm8 in the same way as the finest LOD of NDSDFGrid.
+        std::vector<int8_t> quantizedValues(totalValueCount);
+        Threading::parallelFor(size_t(0), totalValueCount, [&](size_t i)
+        {
+            quantizedValues[i] = quantizeNormalizedDistance(cornerValues[i] / mNormalizationFactor);
+        }, 4096);
+
+        auto brickOrigin = [&](uint32_t brickIndex)
+        {
+            return kBrickWidthInVoxels * uint3(brickIndex % mBrickGridWidth, (brickIndex / mBrickGridWidth) % mBrickGridWidth, brickIndex / (mBrickGridWidth * mBrickGridWidth));
+        };
+
+        auto valueIndex = [&](uint32_t x, uint32_t y, uint32_t z)
+        {
+            return x + gridWidthInValues * (y + size_t(gridWidthInValues) * z);
+        };
+
+        // Classify bricks in parallel. A brick can be skipped if all its corner values are clamped to the same side of the narrow band,
+        // as trilinear interpolation then evaluates to that constant everywhere inside the brick.
+        mIndirection.assign(brickGridCount, kSurfaceBrick);
+        Threading::parallelFor(0u, brickGridCount, [&](uint32_t brickIndex)
+        {
+            const uint3 first = brickOrigin(brickIndex);
+            const uint3 last = glm::min(first + kBrickWidthInVoxels, uint3(mGridWidth));
+
+            bool allOutside = true;
+            bool allInside = true;
+            for (uint32_t z = first.z; z <= last.z && (allOutside || allInside); z++)
+            {
+                for (uint32_t y = first.y; y <= last.y; y++)
+                {
+                    for (uint32_t x = first.x; x <= last.x; x++)
+                    {
+                        int8_t v = quantizedValues[valueIndex(x, y, z)];
+                        allOutside &= v == INT8_MAX;
+                        allInside &= v == -INT8_MAX;
+                    }
+                }
+            }
+
+            if (allOutside) mIndirection[brickIndex] = kEmptyOutsideBrick;
+            else if (allInside) mIndirection[brickIndex] = kEmptyInsideBrick;
+        });
+
+        // Assign brick IDs in grid order so that the layout is deterministic.
+        mBrickCount = 0;
+        for (uint32_t& indirection : mIndirection)
+        {
+            if (indirection == kSurfaceBrick) indirection = mBrickCount++;
+        }
+
+        // Always allocate at least one brick so that the atlas texture can be created.
+        const uint32_t allocatedBrickCount = std::max(mBrickCount, 1u);
+        mAtlasSizeInBricks.x = std::min(allocatedBrickCount, kMaxAtlasWidthInBricks);
+        mAtlasSizeInBricks.y = std::min(div_round_up(allocatedBrickCount, mAtlasSizeInBricks.x), kMaxAtlasWidthInBricks);
+        mAtlasSizeInBricks.z = div_round_up(allocatedBrickCount, mAtlasSizeInBricks.x * mAtlasSizeInBricks.y);
+
+        if (mAtlasSizeInBricks.z > kMaxAtlasWidthInBricks)
+        {
+            logError("SDFSBS::setValues() the " + std::to_string(mBrickCount) + " bricks intersecting the narrow band do not fit in a brick atlas");
+            mIndirection.clear();
+            mBrickCount = 0;
+            return false;
+        }
+
+        // Copy the corner values of each stored brick in parallel. Values outside the grid are clamped to the grid border.
+        mBrickValues.assign(size_t(mBrickCount) * kBrickValueCount, 0);
+        Threading::parallelFor(0u, brickGridCount, [&](uint32_t brickIndex)
+        {
+            const uint32_t brickID = mIndirection[brickIndex];
+            if (brickID >= kEmptyInsideBrick) return;
+
+            const uint3 first = brickOrigin(brickIndex);
+            int8_t* pDst = mBrickValues.data() + size_t(brickID) * kBrickValueCount;
+
+            for (uint32_t z = 0; z < kBrickWidthInValues; z++)
+            {
+                for (uint32_t y = 0; y < kBrickWidthInValues; y++)
+                {
+                    for (uint32_t x = 0; x < kBrickWidthInValues; x++)
+                    {
+                        const uint3 p = glm::min(first + uint3(x, y, z), uint3(mGridWidth));
+                        pDst[x + kBrickWidthInValues * (y + kBrickWidthInValues * z)] = quantizedValues[valueIndex(p.x, p.y, p.z)];
+                    }
+                }
+            }
+        });
+
+        // Invalidate GPU resources created from previous values.
+        mpBrickAtlas = nullptr;
+        mpIndirectionTexture = nullptr;
+
+        return true;
+    }
+
+    float SDFSBS::evalDistance(const float3& pLocal) const
+    {
+        if (mIndirection.empty())
+        {
+            logError("SDFSBS::evalDistance() can't be called before the values have been set");
+            return 0.0f;
+        }
+
+        float3 voxelPosition = glm::clamp(pLocal + 0.5f, 0.0f, 1.0f) * float(mGridWidth);
+        uint3 voxelCoords = glm::min(uint3(voxelPosition), uint3(mGridWidth - 1));
+        float3 voxelUnitCoords = voxelPosition - float3(voxelCoords);
+
+        uint3 brickCoords = voxelCoords / kBrickWidthInVoxels;
+        uint32_t brickID = mIndirection[brickCoords.x + mBrickGridWidth * (brickCoords.y + mBrickGridWidth * brickCoords.z)];
+
+        float4 values0xx;
+        float4 values1xx;
+        if (brickID >= kEmptyInsideBrick)
+        {
+            // Interpolate the constant value of an empty brick as well, so that the result matches a dense grid exactly.
+            float v = dequantizeNormalizedDistance(int8_t(brickID == kEmptyOutsideBrick ? INT8_MAX : -INT8_MAX));
+            values0xx = float4(v);
+            values1xx = float4(v);
+        }
+        else
+        {
+            const int8_t* pBrick = mBrickValues.data() + size_t(brickID) * kBrickValueCount;
+            const uint3 l = voxelCoords - brickCoords * kBrickWidthInVoxels;
+
+            auto loadValue = [&](uint32_t x, uint32_t y, uint32_t z)
+            {
+                return dequantizeNormalizedDistance(pBrick[x + kBrickWidthInValues * (y + kBrickWidthInValues * z)]);
+            };
+
+            values0xx = float4(loadValue(l.x, l.y, l.z), loadValue(l.x, l.y, l.z + 1), loadValue(l.x, l.y + 1, l.z), loadValue(l.x, l.y + 1, l.z + 1));
+            values1xx = float4(loadValue(l.x + 1, l.y, l.z), loadValue(l.x + 1, l.y, l.z + 1), loadValue(l.x + 1, l.y + 1, l.z), loadValue(l.x + 1, l.y + 1, l.z + 1));
+        }
+
+        return interpolateVoxel(values0xx, values1xx, voxelUnitCoords) * mNormalizationFactor;
+    }
+
+    void SDFSBS::setShaderData(const ShaderVar& var) const
+    {
+        if (!mpBrickAtlas || !mpIndirectionTexture) logError("SDFSBS::setShaderData() can't be called before calling SDFSBS::createResources()");
+
+        auto sbsVar = var["sbs"];
+
+        sbsVar["sampler"] = sSDFSBSSampler;
+        sbsVar["brickAtlas"] = mpBrickAtlas;
+        sbsVar["indirection"] = mpIndirectionTexture;
+        sbsVar["gridWidth"] = mGridWidth;
+        sbsVar["brickGridWidth"] = mBrickGridWidth;
+        sbsVar["atlasSizeInBricks"] = mAtlasSizeInBricks;
+        sbsVar["normalizationFactor"] = mNormalizationFactor;
+        sbsVar["narrowBandThickness"] = mNarrowBandThickness;
+    }
+}
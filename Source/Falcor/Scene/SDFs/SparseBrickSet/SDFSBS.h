@@ -0,0 +1,101 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+
+#include "Scene/SDFs/SDFGrid.h"
+#include "Core/API/Texture.h"
+
+namespace Falcor
+{
+    /** A sparse brick set SDF grid.
+        The grid is divided into bricks of kBrickWidthInVoxels^3 voxels and only bricks that intersect the narrow band are stored.
+        Each stored brick holds its own kBrickWidthInValues^3 corner values, so that bricks can be sampled with hardware trilinear filtering from a 3D brick atlas.
+        Bricks outside the narrow band are represented by an entry in the indirection grid that tells whether the brick is fully outside or fully inside the surface.
+        The values are quantized in the same way as the finest LOD of an NDSDFGrid, so the two representations evaluate to the same distances.
+    */
+    class dlldecl SDFSBS : public SDFGrid
+    {
+    public:
+        using SharedPtr = std::shared_ptr<SDFSBS>;
+
+        static const uint32_t kBrickWidthInVoxels = 7;
+        static const uint32_t kBrickWidthInValues = kBrickWidthInVoxels + 1;
+        static const uint32_t kBrickValueCount = kBrickWidthInValues * kBrickWidthInValues * kBrickWidthInValues;
+
+        static const uint32_t kEmptyOutsideBrick = 0xffffffff;  ///< Indirection value for bricks that lie fully outside the surface and the narrow band.
+        static const uint32_t kEmptyInsideBrick = 0xfffffffe;   ///< Indirection value for bricks that lie fully inside the surface and the narrow band.
+
+        /** Create a new, empty sparse brick set SDF grid.
+            \return SDFSBS object, or nullptr if errors occurred.
+        */
+        static SharedPtr create();
+
+        virtual Type getType() const override { return Type::SparseBrickSet; }
+
+        virtual size_t getSize() const override;
+
+        virtual uint32_t getMaxPrimitiveIDBits() const override { return 1; }
+
+        virtual bool createResources(RenderContext* pRenderContext = nullptr, bool deleteScratchData = true) override;
+
+        virtual void setShaderData(const ShaderVar& var) const override;
+
+        virtual float evalDistance(const float3& pLocal) const override;
+
+        /** Returns the number of stored bricks.
+        */
+        uint32_t getBrickCount() const { return mBrickCount; }
+
+        /** Returns the width of the indirection grid in bricks.
+        */
+        uint32_t getBrickGridWidth() const { return mBrickGridWidth; }
+
+    protected:
+        virtual bool setValuesInternal(const std::vector<float>& cornerValues) override;
+
+    private:
+        SDFSBS() = default;
+
+        // CPU data.
+        std::vector<uint32_t> mIndirection;     ///< Brick index, or kEmptyOutsideBrick/kEmptyInsideBrick, for each brick in the grid.
+        std::vector<int8_t> mBrickValues;       ///< Quantized corner values of all stored bricks, kBrickValueCount values per brick.
+
+        // Specs.
+        uint32_t mBrickGridWidth = 0;
+        uint32_t mBrickCount = 0;
+        uint3 mAtlasSizeInBricks = uint3(0);
+        float mNormalizationFactor = 0.0f;
+
+        // Brick atlas sampler, shared among all SDFSBSs.
+        static Sampler::SharedPtr sSDFSBSSampler;
+
+        // GPU data.
+        Texture::SharedPtr mpBrickAtlas;
+        Texture::SharedPtr mpIndirectionTexture;
+    };
+}
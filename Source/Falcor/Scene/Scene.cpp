@@ -28,6 +28,7 @@
 #include "stdafx.h"
 #include "Scene.h"
 #include "ScenePrimitiveDefines.slangh"
+#include "Material/TexelDensityFeedback.h"
 #include <sstream>
 #include <numeric>
 
@@ -120,6 +121,7 @@ namespace Falcor
         mGridVolumes = std::move(sceneData.gridVolumes);
         mGrids = std::move(sceneData.grids);
         mpEnvMap = sceneData.pEnvMap;
+        mpTextureStreamer = sceneData.pTextureStreamer;
         mSceneGraph = std::move(sceneData.sceneGraph);
         mMetadata = std::move(sceneData.metadata);
 
@@ -171,19 +173,44 @@ namespace Falcor
         // Setup volume grid -> id map.
         for (size_t i = 0; i < mGrids.size(); ++i) mGridIDs.emplace(mGrids[i], (uint32_t)i);
 
+        // Reserve the grid IDs of the streamed slots. The grids of the current frames are swapped in during playback.
+        // The grid of the current frame takes up the ID, so streamed slots need a grid when the scene is created.
+        mStreamedGridIDs.resize(mGridVolumes.size());
+        for (size_t i = 0; i < mGridVolumes.size(); ++i)
+        {
+            for (uint32_t slotIndex = 0; slotIndex < (uint32_t)GridVolume::GridSlot::Count; ++slotIndex)
+            {
+                auto slot = (GridVolume::GridSlot)slotIndex;
+                const auto& pGrid = mGridVolumes[i]->getGrid(slot);
+                bool streamed = mGridVolumes[i]->getGridStreamer(slot) != nullptr;
+                if (streamed && !pGrid) throw std::exception(("Grid volume '" + mGridVolumes[i]->getName() + "' has a streamed grid slot without a grid in the current frame.").c_str());
+                mStreamedGridIDs[i][slotIndex] = streamed ? mGridIDs.at(pGrid) : kInvalidGrid;
+            }
+        }
+
         // Set default SDF grid config.
         setDefaultSDFGridConfig();
 
+        // Mesh data is either owned by the scene data or referenced in place in a memory-mapped scene cache.
+        // It is only used for initializing GPU buffers and not kept around after this point.
+        const bool isMapped = sceneData.pMappedMeshData != nullptr;
+        ArrayView<uint32_t> meshIndexData = isMapped ? sceneData.mappedMeshIndexData : sceneData.meshIndexData;
+        ArrayView<PackedStaticVertexData> meshStaticData = isMapped ? sceneData.mappedMeshStaticData : sceneData.meshStaticData;
+        ArrayView<DynamicVertexData> meshDynamicData = isMapped ? sceneData.mappedMeshDynamicData : sceneData.meshDynamicData;
+
         // Create vertex array objects for meshes and curves.
-        createMeshVao(sceneData.meshDrawCount, sceneData.meshIndexData, sceneData.meshStaticData, sceneData.meshDynamicData);
+        createMeshVao(sceneData.meshDrawCount, meshIndexData, meshStaticData, meshDynamicData);
         createCurveVao(mCurveIndexData, mCurveStaticData);
 
         // Create animation controller.
-        mpAnimationController = AnimationController::create(this, sceneData.meshStaticData, sceneData.meshDynamicData, sceneData.animations);
+        mpAnimationController = AnimationController::create(this, meshStaticData, meshDynamicData, sceneData.animations);
 
         // Must be placed after curve data/AABB creation.
         mpAnimationController->addAnimatedVertexCaches(std::move(sceneData.cachedCurves), std::move(sceneData.cachedMeshes));
 
+        // Drive texture streaming from the texel density of the materials on screen.
+        if (mpTextureStreamer) mpTextureFeedback = TexelDensityFeedback::create(this, meshIndexData, meshStaticData);
+
         // Finalize scene.
         finalize();
     }
@@ -205,6 +232,9 @@ namespace Falcor
         mRenderSettings.sdfGridConfig.addDefines(defines);
         defines.add("SCENE_SDF_GRID_COUNT",  std::to_string(mSDFGrids.size()));
         defines.add("SCENE_SDF_GRID_MAX_LOD_COUNT",  std::to_string(mSDFGridMaxLODCount));
+        defines.add("SCENE_SDF_GRID_IMPLEMENTATION_NDSDF", std::to_string((uint32_t)SDFGrid::Type::NormalizedDenseGrid));
+        defines.add("SCENE_SDF_GRID_IMPLEMENTATION_SBS", std::to_string((uint32_t)SDFGrid::Type::SparseBrickSet));
+        defines.add("SCENE_SDF_GRID_IMPLEMENTATION", std::to_string((uint32_t)(mSDFGrids.empty() ? SDFGrid::Type::NormalizedDenseGrid : mSDFGrids.front()->getType())));
         defines.add("SCENE_MATERIAL_COUNT", std::to_string(mMaterials.size()));
         defines.add("MONOCHROME", mMonochromeMode ? "1" : "0");
         defines.add("SCENE_GRID_COUNT", std::to_string(mGrids.size()));
@@ -294,7 +324,7 @@ namespace Falcor
         pContext->raytrace(pProgram, pVars.get(), dispatchDims.x, dispatchDims.y, dispatchDims.z);
     }
 
-    void Scene::createMeshVao(uint32_t drawCount, const std::vector<uint32_t>& indexData, const std::vector<PackedStaticVertexData>& staticData, const std::vector<DynamicVertexData>& dynamicData)
+    void Scene::createMeshVao(uint32_t drawCount, const ArrayView<uint32_t>& indexData, const ArrayView<PackedStaticVertexData>& staticData, const ArrayView<DynamicVertexData>& dynamicData)
     {
         // Create the index buffer.
         size_t ibSize = sizeof(uint32_t) * indexData.size();
@@ -1368,6 +1398,36 @@ namespace Falcor
             }
         }
 
+        // Swap in the current grids of streamed slots.
+        for (size_t i = 0; i < mGridVolumes.size(); ++i)
+        {
+            if (!is_set(mGridVolumes[i]->getUpdates(), GridVolume::UpdateFlags::GridsChanged)) continue;
+
+            for (uint32_t slotIndex = 0; slotIndex < (uint32_t)GridVolume::GridSlot::Count; ++slotIndex)
+            {
+                uint32_t gridID = mStreamedGridIDs[i][slotIndex];
+                const auto& pGrid = mGridVolumes[i]->getGrid((GridVolume::GridSlot)slotIndex);
+
+                // Grid IDs are only reserved when the scene is created. A slot that started streaming later has no ID to swap its grids into.
+                if (gridID == kInvalidGrid && pGrid && mGridVolumes[i]->getGridStreamer((GridVolume::GridSlot)slotIndex) && mGridIDs.find(pGrid) == mGridIDs.end())
+                {
+                    throw std::exception(("Grid volume '" + mGridVolumes[i]->getName() + "' streams a grid slot that was not streamed when the scene was created. Call streamGridSequence() before creating the scene.").c_str());
+                }
+                if (gridID == kInvalidGrid || !pGrid || mGrids[gridID] == pGrid) continue;
+
+                mGridIDs.erase(mGrids[gridID]);
+                mGrids[gridID] = pGrid;
+                mGridIDs[pGrid] = gridID;
+                pGrid->setShaderData(mpSceneBlock["grids"][gridID]);
+            }
+        }
+
+        auto getGridID = [this](const Grid::SharedPtr& pGrid)
+        {
+            auto it = pGrid ? mGridIDs.find(pGrid) : mGridIDs.end();
+            return it != mGridIDs.end() ? it->second : kInvalidGrid;
+        };
+
         // Upload volumes and clear updates.
         uint32_t volumeIndex = 0;
         for (const auto& pGridVolume : mGridVolumes)
@@ -1376,8 +1436,8 @@ namespace Falcor
             {
                 // Fetch copy of volume data.
                 auto data = pGridVolume->getData();
-                data.densityGrid = pGridVolume->getDensityGrid() ? mGridIDs.at(pGridVolume->getDensityGrid()) : kInvalidGrid;
-                data.emissionGrid = pGridVolume->getEmissionGrid() ? mGridIDs.at(pGridVolume->getEmissionGrid()) : kInvalidGrid;
+                data.densityGrid = getGridID(pGridVolume->getDensityGrid());
+                data.emissionGrid = getGridID(pGridVolume->getEmissionGrid());
                 // Merge grid and volume transforms.
                 const auto& densityGrid = pGridVolume->getDensityGrid();
                 if (densityGrid)
@@ -1523,6 +1583,7 @@ namespace Falcor
         mUpdates |= updateLights(false);
         mUpdates |= updateGridVolumes(false);
         mUpdates |= updateEnvMap(false);
+        if (mpTextureStreamer) mpTextureStreamer->update(pContext, mpTextureFeedback.get());
         mUpdates |= updateMaterials(false);
         mUpdates |= updateGeometry(false);
         pContext->flush();
@@ -1745,6 +1806,15 @@ namespace Falcor
             }
         }
 
+        if (mpTextureStreamer)
+        {
+            if (auto streamingGroup = widget.group("Texture streaming"))
+            {
+                mpTextureStreamer->renderUI(streamingGroup);
+                if (mpTextureFeedback) mpTextureFeedback->renderUI(streamingGroup);
+            }
+        }
+
         if (auto volumesGroup = widget.group("Grid volumes"))
         {
             uint32_t volumeID = 0;
@@ -33,11 +33,15 @@
 #include "Lights/EnvMap.h"
 #include "Camera/Camera.h"
 #include "Material/Material.h"
+#include "Material/TextureStreamer.h"
 #include "Volume/GridVolume.h"
 #include "Volume/Grid.h"
 #include "SDFs/SDFGrid.h"
 #include "SDFs/NormalizedDenseSDFGrid/NDSDFGrid.h"
+#include "SDFs/SparseBrickSet/SDFSBS.h"
 #include "Utils/Math/AABB.h"
+#include "Utils/ArrayView.h"
+#include "Core/Platform/MemoryMappedFile.h"
 #include "Animation/AnimationController.h"
 #include "Animation/AnimatedVertexCache.h"
 #include "Camera/CameraController.h"
@@ -692,6 +696,19 @@ namespace Falcor
         */
         const EnvMap::SharedPtr& getEnvMap() const { return mpEnvMap; }
 
+        /** Get the texture streamer or nullptr if material textures are not streamed.
+        */
+        const TextureStreamer::SharedPtr& getTextureStreamer() const { return mpTextureStreamer; }
+
+        /** Set the source of texture streaming requests. By default, a TexelDensityFeedback source is used.
+            \param[in] pFeedback Feedback source. If nullptr, only the mip tails of the textures are resident.
+        */
+        void setTextureFeedbackSource(const TextureStreamer::FeedbackSource::SharedPtr& pFeedback) { mpTextureFeedback = pFeedback; }
+
+        /** Get the source of texture streaming requests or nullptr if there is none.
+        */
+        const TextureStreamer::FeedbackSource::SharedPtr& getTextureFeedbackSource() const { return mpTextureFeedback; }
+
         /** Set how the scene's TLASes are updated when raytracing.
             TLASes are REBUILT by default.
         */
@@ -884,6 +901,7 @@ namespace Falcor
             float4x4 localToBindSpace;  ///< For bones. Skeleton to bind space transformation. AKA the inverse-bind transform.
         };
 
+    public:
         /** Full set of required data to create a scene object.
             This data is typically prepared by SceneBuilder before creating a Scene object.
         */
@@ -899,6 +917,8 @@ namespace Falcor
             std::vector<GridVolume::SharedPtr> gridVolumes;         ///< List of grid volumes.
             std::vector<Grid::SharedPtr> grids;                     ///< List of grids.
             EnvMap::SharedPtr pEnvMap;                              ///< Environment map.
+            TextureStreamer::SharedPtr pTextureStreamer;            ///< Texture streamer for the material textures or nullptr.
+            Material::TextureAnalysisMap materialTextureAnalysis;   ///< Analysis results of the material textures. Used to optimize the materials and stored in the scene cache.
             std::vector<Node> sceneGraph;                           ///< Scene graph nodes.
             std::vector<Animation::SharedPtr> animations;           ///< List of animations.
             Metadata metadata;                                      ///< Scene meadata.
@@ -921,6 +941,12 @@ namespace Falcor
             std::vector<PackedStaticVertexData> meshStaticData;     ///< Vertex attributes for all meshes in packed format.
             std::vector<DynamicVertexData> meshDynamicData;         ///< Additional vertex attributes for dynamic (skinned) meshes.
 
+            // Mesh data referenced in place (optional)
+            MemoryMappedFile::SharedPtr pMappedMeshData;            ///< Memory-mapped file holding the mesh index/vertex data. If set, the views below are used instead of the vectors above.
+            ArrayView<uint32_t> mappedMeshIndexData;                ///< View of the mesh index data in the mapped file.
+            ArrayView<PackedStaticVertexData> mappedMeshStaticData; ///< View of the mesh static vertex data in the mapped file.
+            ArrayView<DynamicVertexData> mappedMeshDynamicData;     ///< View of the mesh dynamic vertex data in the mapped file.
+
             // Curve data
             std::vector<CurveDesc> curveDesc;                       ///< List of curve descriptors.
             std::vector<AABB> curveBBs;                             ///< List of curve bounding boxes in object space. Each curve consists of many segments, each with its own AABB. The bounding boxes here are the unions of those.
@@ -941,6 +967,7 @@ namespace Falcor
             std::vector<AABB> customPrimitiveAABBs;                 ///< List of AABBs for custom primitives in world space. Each custom primitive consists of one AABB.
         };
 
+    private:
         friend class SceneBuilder;
         friend class SceneCache;
         friend class AnimationController;
@@ -952,7 +979,7 @@ namespace Falcor
 
         static SharedPtr create(SceneData&& sceneData, bool monochromeMode = false);
 
-        void createMeshVao(uint32_t drawCount, const std::vector<uint32_t>& indexData, const std::vector<PackedStaticVertexData>& staticData, const std::vector<DynamicVertexData>& dynamicData);
+        void createMeshVao(uint32_t drawCount, const ArrayView<uint32_t>& indexData, const ArrayView<PackedStaticVertexData>& staticData, const ArrayView<DynamicVertexData>& dynamicData);
         void createCurveVao(const std::vector<uint32_t>& indexData, const std::vector<StaticCurveVertexData>& staticData);
 
         /** Sets the default SDF grid config.
@@ -1141,9 +1168,12 @@ namespace Falcor
         std::vector<GridVolume::SharedPtr> mGridVolumes;            ///< All loaded grid volumes.
         std::vector<Grid::SharedPtr> mGrids;                        ///< All loaded grids.
         std::unordered_map<Grid::SharedPtr, uint32_t> mGridIDs;     ///< Lookup table for grid IDs.
+        std::vector<std::array<uint32_t, (size_t)GridVolume::GridSlot::Count>> mStreamedGridIDs; ///< Grid IDs of the streamed slots of each grid volume, or kInvalidGrid. The grid bound to the ID changes during playback.
         LightCollection::SharedPtr mpLightCollection;               ///< Class for managing emissive geometry. This is created lazily upon first use.
         EnvMap::SharedPtr mpEnvMap;                                 ///< Environment map or nullptr if not loaded.
         bool mEnvMapChanged = false;                                ///< Flag indicating that the environment map has changed since last frame.
+        TextureStreamer::SharedPtr mpTextureStreamer;               ///< Texture streamer for the material textures or nullptr if textures are not streamed.
+        TextureStreamer::FeedbackSource::SharedPtr mpTextureFeedback; ///< Source of texture streaming requests.
         uint32_t mActiveLightCount = 0;                             ///< Number of currently active analytic lights.
 
         // Scene metadata (CPU only)
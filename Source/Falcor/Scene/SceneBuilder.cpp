@@ -28,10 +28,12 @@
 #include "stdafx.h"
 #include "SceneBuilder.h"
 #include "SceneCache.h"
+#include "MeshOptimizer.h"
 #include "Importer.h"
 #include "Utils/Math/MathConstants.slangh"
 #include "Utils/Image/TextureAnalyzer.h"
 #include "Utils/Timing/TimeReport.h"
+#include "Utils/Threading.h"
 #include <mikktspace.h>
 #include <filesystem>
 #include <numeric>
@@ -48,6 +50,9 @@ namespace Falcor
         // We'll log a warning if the maximum quantization error exceeds this value.
         const float kMaxTexelError = 0.5f;
 
+        // Number of triangles per meshlet when optimizing vertex locality with the MortonOrderMeshlets flag.
+        const uint32_t kMeshletTriangleCount = 128;
+
         int largestAxis(const float3& v)
         {
             if (v.x >= v.y && v.x >= v.z) return 0;
@@ -138,6 +143,202 @@ namespace Falcor
             return true;
         }
 
+        /** Merges identical vertices using the topology defined by the original index buffer.
+            A linked-list of vertices is built for each original vertex index.
+            We iterate over all vertices and first check if a vertex is identical to any of the other vertices
+            using the same original vertex index. If not, a new vertex is inserted and added to the list.
+            The 'heads' array point to the first vertex in each list, and each vertex has an associated next-pointer.
+            This ensures that adding to the linked lists do not require any dynamic memory allocation.
+        */
+        void mergeVertices(SceneBuilder::Mesh& mesh, std::vector<SceneBuilder::Mesh::Vertex>& vertices, std::vector<uint32_t>& indices, SceneBuilder::MeshAttributeIndices* pAttributeIndices)
+        {
+            const uint32_t invalidIndex = 0xffffffff;
+            std::vector<uint32_t> heads(mesh.vertexCount, invalidIndex);
+            std::vector<uint32_t> next;
+            next.reserve(mesh.vertexCount);
+
+            for (uint32_t face = 0; face < mesh.faceCount; face++)
+            {
+                for (uint32_t vert = 0; vert < 3; vert++)
+                {
+                    const SceneBuilder::Mesh::Vertex v = mesh.getVertex(face, vert);
+                    const uint32_t origIndex = mesh.pIndices[face * 3 + vert];
+
+                    // Iterate over vertex list to check if it already exists.
+                    assert(origIndex < heads.size());
+                    uint32_t index = heads[origIndex];
+                    bool found = false;
+
+                    while (index != invalidIndex)
+                    {
+                        if (compareVertices(v, vertices[index]))
+                        {
+                            found = true;
+                            break;
+                        }
+                        index = next[index];
+                    }
+
+                    // Insert new vertex if we couldn't find it.
+                    if (!found)
+                    {
+                        assert(vertices.size() < std::numeric_limits<uint32_t>::max());
+                        index = (uint32_t)vertices.size();
+                        vertices.push_back(v);
+                        next.push_back(heads[origIndex]);
+
+                        if (pAttributeIndices)
+                        {
+                            pAttributeIndices->push_back(mesh.getAttributeIndices(face, vert));
+                            assert(vertices.size() == pAttributeIndices->size());
+                        }
+
+                        heads[origIndex] = index;
+                    }
+
+                    // Store new vertex index.
+                    indices[face * 3 + vert] = index;
+                }
+            }
+        }
+
+        /** Key used for welding vertices. Holds the bit patterns of the quantized vertex attributes.
+        */
+        struct WeldKey
+        {
+            static const size_t kWordCount = 20;
+            uint32_t words[kWordCount];
+
+            bool operator==(const WeldKey& other) const { return std::memcmp(words, other.words, sizeof(words)) == 0; }
+        };
+
+        WeldKey computeWeldKey(const SceneBuilder::Mesh::Vertex& v, float tolerance)
+        {
+            const float invTolerance = tolerance > 0.f ? 1.f / tolerance : 0.f;
+            auto quantize = [&](float x)
+            {
+                // Store the grid cell index as a float. Adding zero maps -0 to +0 so that both produce the same key.
+                float q = (tolerance > 0.f ? std::floor(x * invTolerance) : x) + 0.f;
+                uint32_t bits;
+                std::memcpy(&bits, &q, sizeof(bits));
+                return bits;
+            };
+            auto exact = [](float x)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &x, sizeof(bits));
+                return bits;
+            };
+
+            WeldKey key;
+            uint32_t* pWord = key.words;
+            for (int i = 0; i < 3; i++) *pWord++ = quantize(v.position[i]);
+            for (int i = 0; i < 3; i++) *pWord++ = quantize(v.normal[i]);
+            for (int i = 0; i < 3; i++) *pWord++ = quantize(v.tangent[i]);
+            *pWord++ = exact(v.tangent.w);
+            for (int i = 0; i < 2; i++) *pWord++ = quantize(v.texCrd[i]);
+            for (int i = 0; i < 4; i++) *pWord++ = v.boneIDs[i];
+            for (int i = 0; i < 4; i++) *pWord++ = quantize(v.boneWeights[i]);
+            assert(pWord == key.words + WeldKey::kWordCount);
+            return key;
+        }
+
+        uint64_t hashWeldKey(const WeldKey& key)
+        {
+            uint64_t h = 0;
+            for (uint32_t word : key.words) h = (h ^ word) * 0x9e3779b97f4a7c15ull;
+            // Final avalanche so that the low bits used for the table slot depend on all words.
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        /** Welds vertices using an open-addressing hash table over the quantized vertex attributes.
+            Unlike mergeVertices(), vertices are welded regardless of their original vertex index.
+            Keys are computed in parallel for blocks of faces and inserted in face order, so the result is deterministic.
+        */
+        void weldVertices(SceneBuilder::Mesh& mesh, float tolerance, std::vector<SceneBuilder::Mesh::Vertex>& vertices, std::vector<uint32_t>& indices, SceneBuilder::MeshAttributeIndices* pAttributeIndices)
+        {
+            const uint32_t invalidIndex = 0xffffffff;
+            const uint32_t kBlockFaceCount = 1 << 14;
+            const size_t kGrainSize = 1024;
+
+            // The table stores vertex indices and uses linear probing.
+            // The capacity is kept at twice the index count so the load factor stays below 0.5.
+            size_t capacity = 1;
+            while (capacity < 2 * (size_t)mesh.indexCount) capacity <<= 1;
+            const size_t mask = capacity - 1;
+            std::vector<uint32_t> table(capacity, invalidIndex);
+            std::vector<WeldKey> vertexKeys;
+            std::vector<uint64_t> vertexHashes;
+            vertexKeys.reserve(mesh.vertexCount);
+            vertexHashes.reserve(mesh.vertexCount);
+
+            std::vector<WeldKey> keys(std::min(kBlockFaceCount, mesh.faceCount) * 3);
+            std::vector<uint64_t> hashes(keys.size());
+
+            for (uint32_t blockStart = 0; blockStart < mesh.faceCount; blockStart += kBlockFaceCount)
+            {
+                const uint32_t blockEnd = std::min(blockStart + kBlockFaceCount, mesh.faceCount);
+
+                Threading::parallelFor(blockStart, blockEnd, [&](uint32_t face)
+                {
+                    for (uint32_t vert = 0; vert < 3; vert++)
+                    {
+                        const size_t i = (face - blockStart) * 3 + vert;
+                        keys[i] = computeWeldKey(mesh.getVertex(face, vert), tolerance);
+                        hashes[i] = hashWeldKey(keys[i]);
+                    }
+                }, kGrainSize);
+
+                for (uint32_t face = blockStart; face < blockEnd; face++)
+                {
+                    for (uint32_t vert = 0; vert < 3; vert++)
+                    {
+                        const size_t i = (face - blockStart) * 3 + vert;
+                        size_t slot = hashes[i] & mask;
+                        uint32_t index;
+
+                        while ((index = table[slot]) != invalidIndex)
+                        {
+                            if (vertexHashes[index] == hashes[i] && vertexKeys[index] == keys[i]) break;
+                            slot = (slot + 1) & mask;
+                        }
+
+                        // Insert new vertex if we couldn't find it.
+                        if (index == invalidIndex)
+                        {
+                            assert(vertices.size() < std::numeric_limits<uint32_t>::max());
+                            index = (uint32_t)vertices.size();
+                            vertices.push_back(mesh.getVertex(face, vert));
+                            vertexKeys.push_back(keys[i]);
+                            vertexHashes.push_back(hashes[i]);
+                            table[slot] = index;
+
+                            if (pAttributeIndices)
+                            {
+                                pAttributeIndices->push_back(mesh.getAttributeIndices(face, vert));
+                                assert(vertices.size() == pAttributeIndices->size());
+                            }
+                        }
+
+                        // Store new vertex index.
+                        indices[face * 3 + vert] = index;
+                    }
+                }
+            }
+        }
+
+        template<typename T>
+        void copyAttribute(SceneBuilder::Mesh& mesh, const SceneBuilder::Mesh::Attribute<T>& attribute, std::vector<T>& data)
+        {
+            if (attribute.pData == nullptr || attribute.frequency == SceneBuilder::Mesh::AttributeFrequency::None) return;
+            data.assign(attribute.pData, attribute.pData + mesh.getAttributeCount(attribute));
+        }
+
         std::vector<uint32_t> compact16BitIndices(const std::vector<uint32_t>& indices)
         {
             if (indices.empty()) return {};
@@ -154,7 +355,8 @@ namespace Falcor
 
         SceneCache::Key computeSceneCacheKey(const std::string& scenePath, SceneBuilder::Flags buildFlags)
         {
-            SceneBuilder::Flags cacheFlags = buildFlags & (~(SceneBuilder::Flags::UseCache | SceneBuilder::Flags::RebuildCache));
+            SceneBuilder::Flags cacheFlags = buildFlags & (~(SceneBuilder::Flags::UseCache | SceneBuilder::Flags::RebuildCache | SceneBuilder::Flags::HashCacheDependencies | SceneBuilder::Flags::MemoryMappedCache |
+                SceneBuilder::Flags::UseTextureCache | SceneBuilder::Flags::CompressTextures | SceneBuilder::Flags::StreamTextures));
             SHA1 sha1;
             sha1.update(scenePath.data(), scenePath.size());
             sha1.update(&cacheFlags, sizeof(cacheFlags));
@@ -167,6 +369,22 @@ namespace Falcor
         : mFlags(flags)
     {
         mpFence = GpuFence::create();
+
+        if (is_set(mFlags, Flags::UseTextureCache))
+        {
+            TextureCache::Options options;
+            options.compress = is_set(mFlags, Flags::CompressTextures);
+            mpTextureCache = TextureCache::create(options);
+        }
+
+        // Streamed textures are always loaded from the texture cache.
+        if (is_set(mFlags, Flags::StreamTextures)) mpTextureStreamer = TextureStreamer::create(mpTextureCache);
+    }
+
+    SceneBuilder::~SceneBuilder()
+    {
+        // Don't wait for textures of a scene that is not going to be created.
+        if (mpMaterialTextureLoader) mpMaterialTextureLoader->cancel();
     }
 
     SceneBuilder::SharedPtr SceneBuilder::create(Flags flags)
@@ -201,7 +419,9 @@ namespace Falcor
         {
             try
             {
-                pBuilder->mpScene = Scene::create(SceneCache::readCache(pBuilder->mSceneCacheKey));
+                auto sceneData = SceneCache::readCache(pBuilder->mSceneCacheKey, pBuilder->mpTextureCache, pBuilder->mpTextureStreamer);
+                sceneData.pTextureStreamer = pBuilder->mpTextureStreamer;
+                pBuilder->mpScene = Scene::create(std::move(sceneData));
                 return pBuilder;
             }
             catch (const std::exception& e)
@@ -215,16 +435,33 @@ namespace Falcor
 
     bool SceneBuilder::import(const std::string& filename, const InstanceMatrices& instances, const Dictionary& dict)
     {
+        addCacheDependency(filename);
         bool success = Importer::import(filename, *this, instances, dict);
         mSceneData.filename = filename;
         return success;
     }
 
+    void SceneBuilder::addCacheDependency(const std::string& filename)
+    {
+        if (!mWriteSceneCache) return;
+
+        std::string fullPath;
+        if (findFileInDataDirectories(filename, fullPath)) mCacheDependencies.insert(fullPath);
+    }
+
+    void SceneBuilder::setVertexWeldTolerance(float tolerance)
+    {
+        if (!(tolerance >= 0.f)) throw std::runtime_error("SceneBuilder::setVertexWeldTolerance() - Tolerance must be non-negative");
+        mVertexWeldTolerance = tolerance;
+    }
 
     Scene::SharedPtr SceneBuilder::getScene(bool monochromeMode)
     {
         if (mpScene) return mpScene;
 
+        // Process meshes that were queued for deferred processing.
+        processDeferredMeshes();
+
         // Finish loading textures. This blocks until all textures are loaded and assigned.
         mpMaterialTextureLoader.reset();
 
@@ -257,6 +494,7 @@ namespace Falcor
         calculateMeshBoundingBoxes();
         createMeshGroups();
         optimizeGeometry();
+        optimizeVertexLocality();
         sortMeshes();
         createGlobalBuffers();
         createCurveGlobalBuffers();
@@ -286,11 +524,17 @@ namespace Falcor
         // Write scene cache if requested.
         if (mWriteSceneCache)
         {
-            SceneCache::writeCache(mSceneData, mSceneCacheKey);
+            // Build the env map importance map on the CPU, so that it is stored in the cache and doesn't need to be computed on load.
+            if (mSceneData.pEnvMap) mSceneData.pEnvMap->buildImportanceMap();
+
+            std::vector<std::string> dependencies(mCacheDependencies.begin(), mCacheDependencies.end());
+            auto format = is_set(mFlags, Flags::MemoryMappedCache) ? SceneCache::Format::Mapped : SceneCache::Format::Compressed;
+            SceneCache::writeCache(mSceneData, mSceneCacheKey, dependencies, is_set(mFlags, Flags::HashCacheDependencies), format);
             timeReport.measure("Writing cache");
         }
 
         // Create the scene object.
+        mSceneData.pTextureStreamer = mpTextureStreamer;
         mpScene = Scene::create(std::move(mSceneData), monochromeMode);
         mSceneData = {};
 
@@ -337,6 +581,116 @@ namespace Falcor
         return addMesh(mesh);
     }
 
+    uint32_t SceneBuilder::addMeshDeferred(const Mesh& mesh)
+    {
+        DeferredMesh deferredMesh;
+        deferredMesh.mesh = mesh;
+
+        auto& m = deferredMesh.mesh;
+        if (m.pIndices) deferredMesh.indices.assign(m.pIndices, m.pIndices + m.indexCount);
+        copyAttribute(m, m.positions, deferredMesh.positions);
+        copyAttribute(m, m.normals, deferredMesh.normals);
+        copyAttribute(m, m.tangents, deferredMesh.tangents);
+        copyAttribute(m, m.texCrds, deferredMesh.texCrds);
+        copyAttribute(m, m.boneIDs, deferredMesh.boneIDs);
+        copyAttribute(m, m.boneWeights, deferredMesh.boneWeights);
+
+        return queueDeferredMesh(std::move(deferredMesh));
+    }
+
+    uint32_t SceneBuilder::addTriangleMeshDeferred(const TriangleMesh::SharedPtr& pTriangleMesh, const Material::SharedPtr& pMaterial)
+    {
+        DeferredMesh deferredMesh;
+        auto& mesh = deferredMesh.mesh;
+
+        const auto& indices = pTriangleMesh->getIndices();
+        const auto& vertices = pTriangleMesh->getVertices();
+
+        mesh.name = pTriangleMesh->getName();
+        mesh.faceCount = (uint32_t)(indices.size() / 3);
+        mesh.vertexCount = (uint32_t)vertices.size();
+        mesh.indexCount = (uint32_t)indices.size();
+        mesh.topology = Vao::Topology::TriangleList;
+        mesh.isFrontFaceCW = pTriangleMesh->getFrontFaceCW();
+        mesh.pMaterial = pMaterial;
+
+        deferredMesh.indices = indices;
+        deferredMesh.positions.resize(vertices.size());
+        deferredMesh.normals.resize(vertices.size());
+        deferredMesh.texCrds.resize(vertices.size());
+        std::transform(vertices.begin(), vertices.end(), deferredMesh.positions.begin(), [] (const auto& v) { return v.position; });
+        std::transform(vertices.begin(), vertices.end(), deferredMesh.normals.begin(), [] (const auto& v) { return v.normal; });
+        std::transform(vertices.begin(), vertices.end(), deferredMesh.texCrds.begin(), [] (const auto& v) { return v.texCoord; });
+
+        mesh.positions.frequency = SceneBuilder::Mesh::AttributeFrequency::Vertex;
+        mesh.normals.frequency = SceneBuilder::Mesh::AttributeFrequency::Vertex;
+        mesh.texCrds.frequency = SceneBuilder::Mesh::AttributeFrequency::Vertex;
+
+        return queueDeferredMesh(std::move(deferredMesh));
+    }
+
+    void SceneBuilder::processDeferredMeshes()
+    {
+        if (mDeferredMeshes.empty()) return;
+
+        auto startTime = CpuTimer::getCurrentTimePoint();
+
+        // Meshes vary a lot in size, so each mesh is scheduled as a separate task.
+        std::vector<ProcessedMesh> processedMeshes(mDeferredMeshes.size());
+        Threading::parallelFor((size_t)0, mDeferredMeshes.size(), [&](size_t i)
+        {
+            processedMeshes[i] = processMesh(mDeferredMeshes[i].getMesh());
+        }, 1);
+
+        // Fill in the reserved mesh specs. Instances may already have been added.
+        for (size_t i = 0; i < mDeferredMeshes.size(); i++)
+        {
+            auto& spec = mMeshes[mDeferredMeshes[i].meshID];
+            auto instances = std::move(spec.instances);
+            spec = createMeshSpec(std::move(processedMeshes[i]), spec.materialId);
+            spec.instances = std::move(instances);
+        }
+
+        logInfo("SceneBuilder::processDeferredMeshes() - Processed " + std::to_string(mDeferredMeshes.size()) + " meshes in " + std::to_string(CpuTimer::calcDuration(startTime, CpuTimer::getCurrentTimePoint())) + " ms.");
+        mDeferredMeshes.clear();
+    }
+
+    SceneBuilder::Mesh SceneBuilder::DeferredMesh::getMesh() const
+    {
+        auto getData = [](const auto& data) { return data.empty() ? nullptr : data.data(); };
+
+        Mesh m = mesh;
+        m.pIndices = getData(indices);
+        m.positions.pData = getData(positions);
+        m.normals.pData = getData(normals);
+        m.tangents.pData = getData(tangents);
+        m.texCrds.pData = getData(texCrds);
+        m.boneIDs.pData = getData(boneIDs);
+        m.boneWeights.pData = getData(boneWeights);
+        return m;
+    }
+
+    uint32_t SceneBuilder::queueDeferredMesh(DeferredMesh&& deferredMesh)
+    {
+        // Reserve the mesh spec now so that mesh IDs follow the submission order.
+        // The material is added now for the same reason. A missing material is reported by processMesh().
+        MeshSpec spec;
+        spec.name = deferredMesh.mesh.name;
+        spec.topology = deferredMesh.mesh.topology;
+        if (deferredMesh.mesh.pMaterial) spec.materialId = addMaterial(deferredMesh.mesh.pMaterial);
+
+        mMeshes.push_back(spec);
+
+        if (mMeshes.size() > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::exception("Trying to build a scene that exceeds supported number of meshes");
+        }
+
+        deferredMesh.meshID = (uint32_t)(mMeshes.size() - 1);
+        mDeferredMeshes.push_back(std::move(deferredMesh));
+        return (uint32_t)(mMeshes.size() - 1);
+    }
+
     SceneBuilder::ProcessedMesh SceneBuilder::processMesh(const Mesh& mesh_, MeshAttributeIndices* pAttributeIndices) const
     {
         // This function preprocesses a mesh into the final runtime representation.
@@ -420,67 +774,19 @@ namespace Falcor
         }
 
         // Build new vertex/index buffers by merging identical vertices.
-        // The search is based on the topology defined by the original index buffer.
-        //
-        // A linked-list of vertices is built for each original vertex index.
-        // We iterate over all vertices and first check if a vertex is identical to any of the other vertices
-        // using the same original vertex index. If not, a new vertex is inserted and added to the list.
-        // The 'heads' array point to the first vertex in each list, and each vertex has an associated next-pointer.
-        // This ensures that adding to the linked lists do not require any dynamic memory allocation.
-        //
-        const uint32_t invalidIndex = 0xffffffff;
-        std::vector<std::pair<Mesh::Vertex, uint32_t>> vertices;
+        // By default, the search is based on the topology defined by the original index buffer.
+        // With the HashVertexWelding flag, vertices are welded across the whole mesh using a hash table.
+        std::vector<Mesh::Vertex> vertices;
         vertices.reserve(mesh.vertexCount);
         std::vector<uint32_t> indices(mesh.indexCount);
-        std::vector<uint32_t> heads(mesh.vertexCount, invalidIndex);
 
         if (pAttributeIndices)
         {
             pAttributeIndices->reserve(mesh.vertexCount);
         }
 
-        for (uint32_t face = 0; face < mesh.faceCount; face++)
-        {
-            for (uint32_t vert = 0; vert < 3; vert++)
-            {
-                const Mesh::Vertex v = mesh.getVertex(face, vert);
-                const uint32_t origIndex = mesh.pIndices[face * 3 + vert];
-
-                // Iterate over vertex list to check if it already exists.
-                assert(origIndex < heads.size());
-                uint32_t index = heads[origIndex];
-                bool found = false;
-
-                while (index != invalidIndex)
-                {
-                    if (compareVertices(v, vertices[index].first))
-                    {
-                        found = true;
-                        break;
-                    }
-                    index = vertices[index].second;
-                }
-
-                // Insert new vertex if we couldn't find it.
-                if (!found)
-                {
-                    assert(vertices.size() < std::numeric_limits<uint32_t>::max());
-                    index = (uint32_t)vertices.size();
-                    vertices.push_back({ v, heads[origIndex] });
-
-                    if (pAttributeIndices)
-                    {
-                        pAttributeIndices->push_back(mesh.getAttributeIndices(face, vert));
-                        assert(vertices.size() == pAttributeIndices->size());
-                    }
-
-                    heads[origIndex] = index;
-                }
-
-                // Store new vertex index.
-                indices[face * 3 + vert] = index;
-            }
-        }
+        if (is_set(mFlags, Flags::HashVertexWelding)) weldVertices(mesh, mVertexWeldTolerance, vertices, indices, pAttributeIndices);
+        else mergeVertices(mesh, vertices, indices, pAttributeIndices);
 
         assert(vertices.size() > 0);
         assert(indices.size() == mesh.indexCount);
@@ -494,7 +800,7 @@ namespace Falcor
         size_t zeroCount = 0;
         for (const auto& v : vertices)
         {
-            validateVertex(v.first, invalidCount, zeroCount);
+            validateVertex(v, invalidCount, zeroCount);
         }
         if (invalidCount > 0) logWarning("The mesh '" + mesh.name + "' has inf/nan vertex attributes at " + std::to_string(invalidCount) + " vertices. Please fix the asset.");
         if (zeroCount > 0) logWarning("The mesh '" + mesh.name + "' has zero-length normals/tangents at " + std::to_string(zeroCount) + " vertices. Please fix the asset.");
@@ -521,7 +827,7 @@ namespace Falcor
         {
             uint32_t index = isIndexed ? i : indices[i];
             assert(index < vertices.size());
-            const Mesh::Vertex& v = vertices[index].first;
+            const Mesh::Vertex& v = vertices[index];
 
             StaticVertexData s;
             s.position = v.position;
@@ -563,37 +869,8 @@ namespace Falcor
 
     uint32_t SceneBuilder::addProcessedMesh(const ProcessedMesh& mesh)
     {
-        const bool isIndexed = !is_set(mFlags, Flags::NonIndexedVertices);
-
-        MeshSpec spec;
-
         // Add the mesh to the scene.
-        spec.name = mesh.name;
-        spec.topology = mesh.topology;
-        spec.materialId = addMaterial(mesh.pMaterial);
-        spec.isFrontFaceCW = mesh.isFrontFaceCW;
-        spec.skeletonNodeID = mesh.skeletonNodeId;
-
-        spec.vertexCount = (uint32_t)mesh.staticData.size();
-        spec.staticVertexCount = (uint32_t)mesh.staticData.size();
-        spec.dynamicVertexCount = (uint32_t)mesh.dynamicData.size();
-
-        spec.indexData = std::move(mesh.indexData);
-        spec.staticData = std::move(mesh.staticData);
-        spec.dynamicData = std::move(mesh.dynamicData);
-
-        if (isIndexed)
-        {
-            spec.indexCount = (uint32_t)mesh.indexCount;
-            spec.use16BitIndices = mesh.use16BitIndices;
-        }
-
-        if (!spec.dynamicData.empty())
-        {
-            spec.hasDynamicData = true;
-        }
-
-        mMeshes.push_back(spec);
+        mMeshes.push_back(createMeshSpec(ProcessedMesh(mesh), addMaterial(mesh.pMaterial)));
 
         if (mMeshes.size() > std::numeric_limits<uint32_t>::max())
         {
@@ -714,6 +991,12 @@ namespace Falcor
         assert(pSDFGrid);
         assert(pMaterial);
 
+        // The SDF grid implementation is selected per scene on the GPU, so all grids must be of the same type.
+        if (!mSceneData.sdfGrids.empty() && mSceneData.sdfGrids.front()->getType() != pSDFGrid->getType())
+        {
+            throw std::runtime_error("SceneBuilder::addSDFGrid() - all SDF grids in a scene must be of the same type");
+        }
+
         Scene::SDFGridDesc desc;
         desc.materialID = addMaterial(pMaterial);
         desc.sdfGridID = uint32_t(mSceneData.sdfGrids.size());
@@ -752,8 +1035,14 @@ namespace Falcor
 
     void SceneBuilder::loadMaterialTexture(const Material::SharedPtr& pMaterial, Material::TextureSlot slot, const std::string& filename)
     {
-        if (!mpMaterialTextureLoader) mpMaterialTextureLoader.reset(new MaterialTextureLoader(!is_set(mFlags, Flags::AssumeLinearSpaceTextures)));
+        if (!mpMaterialTextureLoader)
+        {
+            // Analyze the textures while they are loaded, unless materials are not optimized.
+            auto pTextureAnalysis = is_set(mFlags, Flags::DontOptimizeMaterials) ? nullptr : &mSceneData.materialTextureAnalysis;
+            mpMaterialTextureLoader.reset(new MaterialTextureLoader(!is_set(mFlags, Flags::AssumeLinearSpaceTextures), mpTextureCache, mpTextureStreamer, pTextureAnalysis));
+        }
         mpMaterialTextureLoader->loadTexture(pMaterial, slot, filename);
+        addCacheDependency(filename);
     }
 
     void SceneBuilder::waitForMaterialTextureLoading()
@@ -1489,6 +1778,39 @@ namespace Falcor
         if (transformedMeshCount > 0) logInfo("Pre-transformed " + std::to_string(transformedMeshCount) + " static meshes to world space");
     }
 
+    SceneBuilder::MeshSpec SceneBuilder::createMeshSpec(ProcessedMesh&& mesh, uint32_t materialId) const
+    {
+        const bool isIndexed = !is_set(mFlags, Flags::NonIndexedVertices);
+
+        MeshSpec spec;
+        spec.name = mesh.name;
+        spec.topology = mesh.topology;
+        spec.materialId = materialId;
+        spec.isFrontFaceCW = mesh.isFrontFaceCW;
+        spec.skeletonNodeID = mesh.skeletonNodeId;
+
+        spec.vertexCount = (uint32_t)mesh.staticData.size();
+        spec.staticVertexCount = (uint32_t)mesh.staticData.size();
+        spec.dynamicVertexCount = (uint32_t)mesh.dynamicData.size();
+
+        spec.indexData = std::move(mesh.indexData);
+        spec.staticData = std::move(mesh.staticData);
+        spec.dynamicData = std::move(mesh.dynamicData);
+
+        if (isIndexed)
+        {
+            spec.indexCount = (uint32_t)mesh.indexCount;
+            spec.use16BitIndices = mesh.use16BitIndices;
+        }
+
+        if (!spec.dynamicData.empty())
+        {
+            spec.hasDynamicData = true;
+        }
+
+        return spec;
+    }
+
     void SceneBuilder::flipTriangleWinding(MeshSpec& mesh)
     {
         assert(mesh.topology == Vao::Topology::TriangleList);
@@ -2099,6 +2421,79 @@ namespace Falcor
         mMeshGroups = std::move(optimizedGroups);
     }
 
+    void SceneBuilder::optimizeVertexLocality()
+    {
+        // This function reorders the triangles and vertices within each mesh to improve memory locality.
+        // Non-indexed meshes are skipped as there is no vertex reuse to optimize for.
+        // Meshes animated by the vertex cache are skipped as the cached data references the vertices in their original order.
+        if (!is_set(mFlags, Flags::OptimizeVertexLocality) || is_set(mFlags, Flags::NonIndexedVertices)) return;
+
+        const bool useMeshlets = is_set(mFlags, Flags::MortonOrderMeshlets);
+
+        std::set<uint32_t> cachedMeshIDs;
+        for (const auto& cachedMesh : mSceneData.cachedMeshes) cachedMeshIDs.insert(cachedMesh.meshID);
+
+        std::vector<MeshOptimizer::CacheStats> statsBefore(mMeshes.size());
+        std::vector<MeshOptimizer::CacheStats> statsAfter(mMeshes.size());
+
+        Threading::parallelFor((size_t)0, mMeshes.size(), [&](size_t meshID)
+        {
+            auto& mesh = mMeshes[meshID];
+            if (mesh.indexCount == 0 || mesh.topology != Vao::Topology::TriangleList || cachedMeshIDs.count((uint32_t)meshID) > 0) return;
+
+            std::vector<uint32_t> indices(mesh.indexCount);
+            for (uint32_t i = 0; i < mesh.indexCount; i++) indices[i] = mesh.getIndex(i);
+            statsBefore[meshID] = MeshOptimizer::computeCacheStats(indices, mesh.vertexCount);
+
+            if (useMeshlets)
+            {
+                std::vector<float3> positions(mesh.staticData.size());
+                for (size_t i = 0; i < positions.size(); i++) positions[i] = mesh.staticData[i].position;
+                MeshOptimizer::sortTrianglesMorton(indices, positions);
+            }
+
+            indices = MeshOptimizer::optimizeVertexCache(indices, mesh.vertexCount, MeshOptimizer::kDefaultCacheSize, useMeshlets ? kMeshletTriangleCount : 0);
+            statsAfter[meshID] = MeshOptimizer::computeCacheStats(indices, mesh.vertexCount);
+
+            // Reorder the vertices. Dynamic vertices have a one-to-one mapping to the static vertices and are reordered the same way.
+            auto remap = MeshOptimizer::optimizeVertexFetch(indices, mesh.vertexCount);
+            std::vector<StaticVertexData> staticData(mesh.staticData.size());
+            for (size_t i = 0; i < staticData.size(); i++) staticData[remap[i]] = mesh.staticData[i];
+            mesh.staticData = std::move(staticData);
+
+            if (!mesh.dynamicData.empty())
+            {
+                assert(mesh.dynamicData.size() == mesh.staticData.size());
+                std::vector<DynamicVertexData> dynamicData(mesh.dynamicData.size());
+                for (size_t i = 0; i < dynamicData.size(); i++)
+                {
+                    dynamicData[remap[i]] = mesh.dynamicData[i];
+                    dynamicData[remap[i]].staticIndex = remap[mesh.dynamicData[i].staticIndex];
+                }
+                mesh.dynamicData = std::move(dynamicData);
+            }
+
+            if (mesh.use16BitIndices) mesh.indexData = compact16BitIndices(indices);
+            else mesh.indexData = std::move(indices);
+        });
+
+        MeshOptimizer::CacheStats totalBefore;
+        MeshOptimizer::CacheStats totalAfter;
+        for (size_t i = 0; i < mMeshes.size(); i++)
+        {
+            totalBefore += statsBefore[i];
+            totalAfter += statsAfter[i];
+        }
+
+        if (totalBefore.triangleCount > 0)
+        {
+            logInfo("SceneBuilder::optimizeVertexLocality() - Optimized " + std::to_string(totalAfter.triangleCount) + " triangles. " +
+                "ACMR " + std::to_string(totalBefore.getACMR()) + " -> " + std::to_string(totalAfter.getACMR()) + ", " +
+                "ATVR " + std::to_string(totalBefore.getATVR()) + " -> " + std::to_string(totalAfter.getATVR()) +
+                " (FIFO cache size " + std::to_string(MeshOptimizer::kDefaultCacheSize) + ").");
+        }
+    }
+
     void SceneBuilder::sortMeshes()
     {
         // This function sorts meshes by the order they are used in the mesh groups.
@@ -2258,7 +2653,8 @@ namespace Falcor
             for (uint32_t i = 0; i < (uint32_t)Material::TextureSlot::Count; i++)
             {
                 auto slot = (Material::TextureSlot)i;
-                if (auto pTexture = pMaterial->getTexture(slot))
+                // Streamed textures are not analyzed, as only their mip tail is loaded and they are replaced when streaming.
+                if (auto pTexture = pMaterial->getTexture(slot); pTexture && !(mpTextureStreamer && mpTextureStreamer->isStreamed(pTexture)))
                 {
                     materialSlots.push_back({ pMaterial, slot });
                     textures.push_back(pTexture);
@@ -2268,33 +2664,61 @@ namespace Falcor
 
         if (textures.empty()) return;
 
-        // Analyze the textures.
-        logInfo("Analyzing " + std::to_string(textures.size()) + " material textures");
+        // Use the results of the textures analyzed on the CPU while loading. Analyze the remaining textures on the GPU.
+        // Textures without a source file cannot be identified in the results map and are always analyzed on the GPU.
+        std::vector<TextureAnalyzer::Result> results(textures.size());
+        std::vector<size_t> gpuIndices;
+        std::vector<Texture::SharedPtr> gpuTextures;
 
-        TextureAnalyzer::SharedPtr pAnalyzer = TextureAnalyzer::create();
-        auto pResults = Buffer::create(textures.size() * TextureAnalyzer::getResultSize(), ResourceBindFlags::UnorderedAccess);
-        pAnalyzer->analyze(gpDevice->getRenderContext(), textures, pResults);
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            auto it = mSceneData.materialTextureAnalysis.find(Material::getTextureAnalysisKey(*textures[i]));
+            if (!textures[i]->getSourceFilename().empty() && it != mSceneData.materialTextureAnalysis.end())
+            {
+                results[i] = it->second;
+            }
+            else
+            {
+                gpuIndices.push_back(i);
+                gpuTextures.push_back(textures[i]);
+            }
+        }
 
-        // Copy result to staging buffer for readback.
-        // This is mostly to avoid a full flush and the associated perf warning.
-        // We do not have any other useful GPU work, but unrelated GPU tasks can be in flight.
-        auto pResultsStaging = Buffer::create(textures.size() * TextureAnalyzer::getResultSize(), ResourceBindFlags::None, Buffer::CpuAccess::Read);
-        gpDevice->getRenderContext()->copyResource(pResultsStaging.get(), pResults.get());
-        gpDevice->getRenderContext()->flush(false);
-        mpFence->gpuSignal(gpDevice->getRenderContext()->getLowLevelData()->getCommandQueue());
+        if (!gpuTextures.empty())
+        {
+            logInfo("Analyzing " + std::to_string(gpuTextures.size()) + " material textures");
 
-        // Wait for results to become available. Then optimize the materials.
-        mpFence->syncCpu();
-        const TextureAnalyzer::Result* results = static_cast<const TextureAnalyzer::Result*>(pResultsStaging->map(Buffer::MapType::Read));
-        Material::TextureOptimizationStats stats = {};
+            TextureAnalyzer::SharedPtr pAnalyzer = TextureAnalyzer::create();
+            auto pResults = Buffer::create(gpuTextures.size() * TextureAnalyzer::getResultSize(), ResourceBindFlags::UnorderedAccess);
+            pAnalyzer->analyze(gpDevice->getRenderContext(), gpuTextures, pResults);
 
+            // Copy result to staging buffer for readback.
+            // This is mostly to avoid a full flush and the associated perf warning.
+            // We do not have any other useful GPU work, but unrelated GPU tasks can be in flight.
+            auto pResultsStaging = Buffer::create(gpuTextures.size() * TextureAnalyzer::getResultSize(), ResourceBindFlags::None, Buffer::CpuAccess::Read);
+            gpDevice->getRenderContext()->copyResource(pResultsStaging.get(), pResults.get());
+            gpDevice->getRenderContext()->flush(false);
+            mpFence->gpuSignal(gpDevice->getRenderContext()->getLowLevelData()->getCommandQueue());
+
+            // Wait for results to become available.
+            // Add them to the results map, which is stored in the scene cache.
+            mpFence->syncCpu();
+            const TextureAnalyzer::Result* gpuResults = static_cast<const TextureAnalyzer::Result*>(pResultsStaging->map(Buffer::MapType::Read));
+            for (size_t i = 0; i < gpuTextures.size(); i++)
+            {
+                results[gpuIndices[i]] = gpuResults[i];
+                if (!gpuTextures[i]->getSourceFilename().empty()) mSceneData.materialTextureAnalysis[Material::getTextureAnalysisKey(*gpuTextures[i])] = gpuResults[i];
+            }
+            pResultsStaging->unmap();
+        }
+
+        // Optimize the materials.
+        Material::TextureOptimizationStats stats = {};
         for (size_t i = 0; i < textures.size(); i++)
         {
             materialSlots[i].first->optimizeTexture(materialSlots[i].second, results[i], stats);
         }
 
-        pResultsStaging->unmap();
-
         // Log optimization stats.
         if (size_t totalRemoved = std::accumulate(stats.texturesRemoved.begin(), stats.texturesRemoved.end(), 0ull); totalRemoved > 0)
         {
@@ -2721,8 +3145,16 @@ namespace Falcor
         flags.value("DontOptimizeGraph", SceneBuilder::Flags::DontOptimizeGraph);
         flags.value("DontOptimizeMaterials", SceneBuilder::Flags::DontOptimizeMaterials);
         flags.value("DontUseDisplacement", SceneBuilder::Flags::DontUseDisplacement);
+        flags.value("HashVertexWelding", SceneBuilder::Flags::HashVertexWelding);
+        flags.value("OptimizeVertexLocality", SceneBuilder::Flags::OptimizeVertexLocality);
+        flags.value("MortonOrderMeshlets", SceneBuilder::Flags::MortonOrderMeshlets);
+        flags.value("StreamTextures", SceneBuilder::Flags::StreamTextures);
+        flags.value("CompressTextures", SceneBuilder::Flags::CompressTextures);
+        flags.value("UseTextureCache", SceneBuilder::Flags::UseTextureCache);
+        flags.value("MemoryMappedCache", SceneBuilder::Flags::MemoryMappedCache);
         flags.value("UseCache", SceneBuilder::Flags::UseCache);
         flags.value("RebuildCache", SceneBuilder::Flags::RebuildCache);
+        flags.value("HashCacheDependencies", SceneBuilder::Flags::HashCacheDependencies);
         ScriptBindings::addEnumBinaryOperators(flags);
 
         pybind11::class_<SceneBuilder, SceneBuilder::SharedPtr> sceneBuilder(m, "SceneBuilder");
@@ -2737,6 +3169,7 @@ namespace Falcor
         sceneBuilder.def_property("envMap", &SceneBuilder::getEnvMap, &SceneBuilder::setEnvMap);
         sceneBuilder.def_property("selectedCamera", &SceneBuilder::getSelectedCamera, &SceneBuilder::setSelectedCamera);
         sceneBuilder.def_property("cameraSpeed", &SceneBuilder::getCameraSpeed, &SceneBuilder::setCameraSpeed);
+        sceneBuilder.def_property("vertexWeldTolerance", &SceneBuilder::getVertexWeldTolerance, &SceneBuilder::setVertexWeldTolerance);
         sceneBuilder.def("importScene", [] (SceneBuilder* pSceneBuilder, const std::string& filename, const pybind11::dict& dict, const std::vector<Transform>& instances) {
             SceneBuilder::InstanceMatrices instanceMatrices;
             for (const auto& instance : instances)
@@ -2746,10 +3179,12 @@ namespace Falcor
             return pSceneBuilder->import(filename, instanceMatrices, Dictionary(dict));
         }, "filename"_a, "dict"_a = pybind11::dict(), "instances"_a = std::vector<Transform>());
         sceneBuilder.def("addTriangleMesh", &SceneBuilder::addTriangleMesh, "triangleMesh"_a, "material"_a);
+        sceneBuilder.def("addTriangleMeshDeferred", &SceneBuilder::addTriangleMeshDeferred, "triangleMesh"_a, "material"_a);
         sceneBuilder.def("addSDFGrid", &SceneBuilder::addSDFGrid, "sdfGrid"_a, "material"_a);
         sceneBuilder.def("addMaterial", &SceneBuilder::addMaterial, "material"_a);
         sceneBuilder.def("getMaterial", &SceneBuilder::getMaterial, "name"_a);
         sceneBuilder.def("loadMaterialTexture", &SceneBuilder::loadMaterialTexture, "material"_a, "slot"_a, "filename"_a);
+        sceneBuilder.def("addCacheDependency", &SceneBuilder::addCacheDependency, "filename"_a);
         sceneBuilder.def("waitForMaterialTextureLoading", &SceneBuilder::waitForMaterialTextureLoading);
         sceneBuilder.def("addGridVolume", &SceneBuilder::addGridVolume, "gridVolume"_a, "nodeID"_a = SceneBuilder::kInvalidNode);
         sceneBuilder.def("addVolume", &SceneBuilder::addGridVolume, "gridVolume"_a, "nodeID"_a = SceneBuilder::kInvalidNode); // PYTHONDEPRECATED
@@ -62,9 +62,17 @@ namespace Falcor
             DontOptimizeGraph           = 0x1000, ///< Don't optimize the scene graph to remove unnecessary nodes.
             DontOptimizeMaterials       = 0x2000, ///< Don't optimize materials by removing constant textures. The optimizations are lossless so should generally be enabled.
             DontUseDisplacement         = 0x4000, ///< Don't use displacement mapping.
-
+            HashVertexWelding           = 0x8000, ///< Merge vertices using a hash table over quantized vertex attributes. Identical vertices are welded even if they use different original vertex indices. See setVertexWeldTolerance().
+            OptimizeVertexLocality      = 0x10000, ///< Reorder triangles for post-transform vertex cache reuse and vertices for fetch locality. Only applies to indexed meshes.
+            MortonOrderMeshlets         = 0x20000, ///< Together with OptimizeVertexLocality, sort triangles along a Morton curve and optimize them in fixed-size meshlets, preserving spatial locality between meshlets.
+
+            StreamTextures              = 0x01000000, ///< Stream the mip levels of material textures (see TextureStreamer). Only the mip tails are loaded up front, more detailed mip levels are loaded within a memory budget as requested by the scene's texture feedback source (see TexelDensityFeedback).
+            CompressTextures            = 0x02000000, ///< Together with UseTextureCache, block compress 8-bit textures when adding them to the texture cache.
+            UseTextureCache             = 0x04000000, ///< Load material textures through the texture cache (see TextureCache). Textures are decoded and mip-mapped on the CPU once and then loaded from the cache.
+            MemoryMappedCache           = 0x08000000, ///< Write the scene cache in the mapped format. The mesh data is then memory-mapped and referenced in place when loading the cache.
             UseCache                    = 0x10000000, ///< Enable scene caching. This caches the runtime scene representation on disk to reduce load time.
             RebuildCache                = 0x20000000, ///< Rebuild scene cache.
+            HashCacheDependencies       = 0x40000000, ///< Store content hashes of all files the scene cache depends on. Files that are touched without changing their content then don't invalidate the cache.
 
             Default = None
         };
@@ -316,6 +324,10 @@ namespace Falcor
         */
         static SharedPtr create(const std::string& filename, Flags buildFlags = Flags::Default, const InstanceMatrices& instances = InstanceMatrices());
 
+        /** Destructor. Cancels pending material texture loads if the scene was not created.
+        */
+        ~SceneBuilder();
+
         /** Import a scene/model file
             \param filename The filename to load
             \param instances A list of instance matrices to load. This is optional, by default a single instance will be load
@@ -328,10 +340,31 @@ namespace Falcor
         */
         Scene::SharedPtr getScene(bool monochromeMode = false);
 
+        /** Add a file the scene depends on to the scene cache.
+            Scene files and material textures are added automatically. Use this for other files loaded
+            by the importers (e.g. meshes or volume grids loaded from a python scene file).
+            If any of these files changes, the scene cache is invalidated.
+            \param[in] filename Filename. Can also include a full path or relative path from a data directory.
+        */
+        void addCacheDependency(const std::string& filename);
+
         /** Get the build flags
         */
         Flags getFlags() const { return mFlags; }
 
+        /** Set the tolerance used for welding vertices when the HashVertexWelding flag is set.
+            With a tolerance of zero, only vertices with bitwise identical attributes are welded.
+            Otherwise, all floating-point vertex attributes are snapped to a grid with the given cell size and
+            vertices falling into the same cells are welded. The attributes of the first such vertex are used.
+            The tolerance needs to be set before adding meshes to take effect.
+            \param[in] tolerance Weld tolerance (>= 0).
+        */
+        void setVertexWeldTolerance(float tolerance);
+
+        /** Get the tolerance used for welding vertices.
+        */
+        float getVertexWeldTolerance() const { return mVertexWeldTolerance; }
+
         /** Set the render settings.
         */
         void setRenderSettings(const Scene::RenderSettings& renderSettings) { mSceneData.renderSettings = renderSettings; }
@@ -372,6 +405,27 @@ namespace Falcor
         */
         uint32_t addTriangleMesh(const TriangleMesh::SharedPtr& pTriangleMesh, const Material::SharedPtr& pMaterial);
 
+        /** Add a mesh for deferred processing.
+            The mesh data is copied, so the caller doesn't need to keep it alive. All deferred meshes are pre-processed
+            in parallel when processDeferredMeshes() is called, which getScene() does automatically.
+            Mesh IDs are assigned in submission order, so they are deterministic and can be used with addMeshInstance() right away.
+            \param mesh The mesh to add.
+            \return The ID of the mesh in the scene.
+        */
+        uint32_t addMeshDeferred(const Mesh& mesh);
+
+        /** Add a triangle mesh for deferred processing. See addMeshDeferred().
+            \param pTriangleMesh The triangle mesh to add.
+            \param pMaterial The material to use for the mesh.
+            \return The ID of the mesh in the scene.
+        */
+        uint32_t addTriangleMeshDeferred(const TriangleMesh::SharedPtr& pTriangleMesh, const Material::SharedPtr& pMaterial);
+
+        /** Pre-process all meshes that were added for deferred processing, in parallel.
+            Throws an exception if something went wrong.
+        */
+        void processDeferredMeshes();
+
         /** Pre-process a mesh into the data format that is used in the global scene buffers.
             Throws an exception if something went wrong.
             \param mesh The mesh to pre-process.
@@ -434,7 +488,7 @@ namespace Falcor
 
         // SDFs
 
-        /** Add an SDF grid.
+        /** Add an SDF grid. All SDF grids in a scene must be of the same type, throws an exception otherwise.
             \param pSDFGrid The SDF grid.
             \param pMaterial The material to be used by this SDF grid.
             \return The ID of the SDG grid desc in the scene.
@@ -685,6 +739,23 @@ namespace Falcor
             std::vector<StaticCurveVertexData> staticData;
         };
 
+        /** Mesh queued for deferred processing. Holds copies of the mesh data.
+        */
+        struct DeferredMesh
+        {
+            uint32_t meshID = 0;
+            Mesh mesh;                          ///< Mesh description. The data pointers are set up by getMesh().
+            std::vector<uint32_t> indices;
+            std::vector<float3> positions;
+            std::vector<float3> normals;
+            std::vector<float4> tangents;
+            std::vector<float2> texCrds;
+            std::vector<uint4> boneIDs;
+            std::vector<float4> boneWeights;
+
+            Mesh getMesh() const;
+        };
+
         using SceneGraph = std::vector<InternalNode>;
         using MeshList = std::vector<MeshSpec>;
         using MeshGroup = Scene::MeshGroup;
@@ -695,16 +766,22 @@ namespace Falcor
         Scene::SharedPtr mpScene;
         SceneCache::Key mSceneCacheKey;
         bool mWriteSceneCache = false;  ///< True if scene cache should be written after import.
+        std::set<std::string> mCacheDependencies; ///< Absolute paths of files the scene cache depends on.
 
         SceneGraph mSceneGraph;
         const Flags mFlags;
+        float mVertexWeldTolerance = 0.f; ///< Tolerance used for welding vertices when the HashVertexWelding flag is set.
 
         MeshList mMeshes;
         MeshGroupList mMeshGroups; ///< Groups of meshes. Each group represents all the geometries in a BLAS for ray tracing.
 
+        std::vector<DeferredMesh> mDeferredMeshes; ///< Meshes queued for deferred processing.
+
         CurveList mCurves;
 
         std::unique_ptr<MaterialTextureLoader> mpMaterialTextureLoader;
+        TextureCache::SharedPtr mpTextureCache;         ///< Texture cache used for material textures if Flags::UseTextureCache is set.
+        TextureStreamer::SharedPtr mpTextureStreamer;   ///< Texture streamer used for material textures if Flags::StreamTextures is set.
         GpuFence::SharedPtr mpFence;
 
         // Helpers
@@ -713,6 +790,8 @@ namespace Falcor
         bool collapseNodes(uint32_t parentNodeID, uint32_t childNodeID);
         bool mergeNodes(uint32_t dstNodeID, uint32_t srcNodeID);
         void flipTriangleWinding(MeshSpec& mesh);
+        MeshSpec createMeshSpec(ProcessedMesh&& mesh, uint32_t materialId) const;
+        uint32_t queueDeferredMesh(DeferredMesh&& deferredMesh);
         void updateSDFGridID(uint32_t oldID, uint32_t newID);
 
         /** Split a mesh by the given axis-aligned splitting plane.
@@ -742,6 +821,7 @@ namespace Falcor
         void calculateMeshBoundingBoxes();
         void createMeshGroups();
         void optimizeGeometry();
+        void optimizeVertexLocality();
         void sortMeshes();
         void createGlobalBuffers();
         void createCurveGlobalBuffers();
@@ -28,8 +28,11 @@
 #include "stdafx.h"
 #include "SceneCache.h"
 #include "Material/MaterialTextureLoader.h"
+#include "Core/Platform/MemoryMappedFile.h"
+#include "Utils/Threading.h"
 
 #include <lz4_stream/lz4_stream.h>
+#include <lz4.h>
 
 namespace Falcor
 {
@@ -38,7 +41,7 @@ namespace Falcor
         /** Specfies the current cache file version.
             This needs to be incremented every time the file format changes!
         */
-        const uint32_t kVersion = 17;
+        const uint32_t kVersion = 28;
 
         /** Scene cache directory (subdirectory in the application data directory).
         */
@@ -46,17 +49,201 @@ namespace Falcor
 
         const size_t kBlockSize = 1 * 1024 * 1024;
 
+        /** Arrays of at least this size are stored as blobs of independently compressed chunks.
+        */
+        const size_t kMinBlobSize = 64 * 1024;
+
+        /** Uncompressed size of a chunk. Chunks are compressed and decompressed in parallel.
+        */
+        const size_t kChunkSize = 1 * 1024 * 1024;
+
+        /** Alignment of the sections in the mapped format. Sections start on a new page, so that touching
+            one array in the mapped file does not page in data of another.
+        */
+        const uint64_t kSectionAlignment = 4096;
+
         const char* kMagic = "FalcorS$";
         struct Header
         {
             uint8_t magic[8]{};
             uint32_t version{};
+            SceneCache::Format format{};
 
             bool isValid() const
             {
-                return std::memcmp(magic, kMagic, sizeof(Header::magic)) == 0 && version == kVersion;
+                return std::memcmp(magic, kMagic, sizeof(Header::magic)) == 0 && version == kVersion &&
+                    (format == SceneCache::Format::Compressed || format == SceneCache::Format::Mapped);
+            }
+        };
+
+        /** Section table of the mapped format. Stored after the dependencies.
+        */
+        struct MappedLayout
+        {
+            struct Section
+            {
+                uint64_t offset = 0;
+                uint64_t size = 0;
+            };
+
+            Section sceneData;          ///< Chunked scene data excluding mesh data.
+            Section meshIndexData;      ///< Uncompressed mesh index data.
+            Section meshStaticData;     ///< Uncompressed mesh static vertex data.
+            Section meshDynamicData;    ///< Uncompressed mesh dynamic vertex data.
+        };
+
+        /** Read-only stream buffer over a block of memory.
+        */
+        class MemoryStreamBuf : public std::streambuf
+        {
+        public:
+            MemoryStreamBuf(const uint8_t* pData, size_t size)
+            {
+                char* p = const_cast<char*>(reinterpret_cast<const char*>(pData));
+                setg(p, p, p + size);
             }
         };
+
+        /** Layout of a chunked section, which holds the scene data in both formats.
+            The section starts with a table of contents, followed by the LZ4-compressed main stream
+            and the chunks. Large arrays are not written to the main stream but stored as blobs. A blob is
+            split into chunks of kChunkSize bytes, each compressed independently. This allows compressing and
+            decompressing chunks in parallel and decoding any blob on demand.
+        */
+        struct ChunkedHeader
+        {
+            uint64_t mainSize = 0;      ///< Size of the compressed main stream.
+            uint32_t blobCount = 0;     ///< Number of blobs.
+            uint32_t chunkCount = 0;    ///< Number of chunks.
+        };
+
+        struct BlobEntry
+        {
+            uint64_t size = 0;          ///< Uncompressed size of the blob.
+            uint32_t firstChunk = 0;    ///< Index of the first chunk of the blob.
+            uint32_t chunkCount = 0;    ///< Number of chunks of the blob.
+        };
+
+        struct ChunkEntry
+        {
+            uint64_t offset = 0;            ///< Offset of the compressed chunk relative to the start of the section.
+            uint32_t compressedSize = 0;    ///< Compressed size of the chunk.
+            uint32_t size = 0;              ///< Uncompressed size of the chunk.
+        };
+
+        /** Reference to an array that is written as a blob.
+        */
+        struct BlobRef
+        {
+            const void* pData = nullptr;
+            size_t size = 0;
+        };
+
+        /** Table of contents of a chunked section in memory.
+        */
+        class ChunkTable
+        {
+        public:
+            ChunkTable(const uint8_t* pSection, size_t sectionSize)
+                : mpSection(pSection)
+            {
+                auto invalid = [] () { return std::runtime_error("Invalid chunk table in scene cache file!"); };
+
+                if (sectionSize < sizeof(ChunkedHeader)) throw invalid();
+                std::memcpy(&mHeader, pSection, sizeof(ChunkedHeader));
+                size_t offset = sizeof(ChunkedHeader);
+
+                const size_t tableSize = mHeader.blobCount * sizeof(BlobEntry) + mHeader.chunkCount * sizeof(ChunkEntry);
+                if (tableSize > sectionSize - offset || mHeader.mainSize > sectionSize - offset - tableSize) throw invalid();
+
+                mBlobs.resize(mHeader.blobCount);
+                std::memcpy(mBlobs.data(), pSection + offset, mBlobs.size() * sizeof(BlobEntry));
+                offset += mBlobs.size() * sizeof(BlobEntry);
+                mChunks.resize(mHeader.chunkCount);
+                std::memcpy(mChunks.data(), pSection + offset, mChunks.size() * sizeof(ChunkEntry));
+                offset += mChunks.size() * sizeof(ChunkEntry);
+                mMainOffset = offset;
+
+                for (const auto& blob : mBlobs)
+                {
+                    if (blob.firstChunk > mChunks.size() || blob.chunkCount > mChunks.size() - blob.firstChunk) throw invalid();
+                    if (blob.chunkCount != div_round_up(blob.size, (uint64_t)kChunkSize)) throw invalid();
+                    for (uint32_t i = 0; i < blob.chunkCount; i++)
+                    {
+                        const auto& chunk = mChunks[blob.firstChunk + i];
+                        uint64_t expectedSize = std::min((uint64_t)kChunkSize, blob.size - (uint64_t)i * kChunkSize);
+                        if (chunk.size != expectedSize || chunk.offset > sectionSize || chunk.compressedSize > sectionSize - chunk.offset) throw invalid();
+                    }
+                }
+            }
+
+            const uint8_t* getMainData() const { return mpSection + mMainOffset; }
+            size_t getMainSize() const { return mHeader.mainSize; }
+
+            /** Decode a blob. The chunks of the blob are decompressed in parallel.
+                \param[in] index Blob index.
+                \param[in] pData Destination buffer.
+                \param[in] size Size of the destination buffer, which needs to match the blob size.
+            */
+            void decodeBlob(uint32_t index, void* pData, size_t size) const
+            {
+                if (index >= mBlobs.size() || mBlobs[index].size != size) throw std::runtime_error("Invalid blob in scene cache file!");
+
+                const auto& blob = mBlobs[index];
+                Threading::parallelFor(0u, blob.chunkCount, [&](uint32_t i)
+                {
+                    const auto& chunk = mChunks[blob.firstChunk + i];
+                    const char* pSrc = reinterpret_cast<const char*>(mpSection + chunk.offset);
+                    char* pDst = static_cast<char*>(pData) + (size_t)i * kChunkSize;
+                    if (LZ4_decompress_safe(pSrc, pDst, (int)chunk.compressedSize, (int)chunk.size) != (int)chunk.size)
+                    {
+                        throw std::runtime_error("Failed to decompress chunk in scene cache file!");
+                    }
+                }, 1);
+            }
+
+        private:
+            const uint8_t* mpSection;
+            ChunkedHeader mHeader;
+            std::vector<BlobEntry> mBlobs;
+            std::vector<ChunkEntry> mChunks;
+            size_t mMainOffset = 0;
+        };
+
+        template<typename T>
+        MappedLayout::Section writeSection(std::ostream& fs, const std::vector<T>& data)
+        {
+            // Pad to section alignment.
+            uint64_t offset = (uint64_t)fs.tellp();
+            uint64_t alignedOffset = align_to(kSectionAlignment, offset);
+            std::vector<char> padding(alignedOffset - offset, 0);
+            fs.write(padding.data(), padding.size());
+
+            MappedLayout::Section section = { alignedOffset, data.size() * sizeof(T) };
+            fs.write(reinterpret_cast<const char*>(data.data()), section.size);
+            return section;
+        }
+
+        template<typename T>
+        ArrayView<T> getSectionView(const MemoryMappedFile& file, const MappedLayout::Section& section)
+        {
+            if (section.offset > file.getSize() || section.size > file.getSize() - section.offset || section.size % sizeof(T) != 0)
+            {
+                throw std::runtime_error("Invalid section in scene cache file!");
+            }
+            return ArrayView<T>(reinterpret_cast<const T*>(file.getData() + section.offset), section.size / sizeof(T));
+        }
+
+        bool getFileStamp(const std::string& path, uint64_t& size, int64_t& writeTime)
+        {
+            std::error_code ec;
+            size = std::filesystem::file_size(path, ec);
+            if (ec) return false;
+            auto time = std::filesystem::last_write_time(path, ec);
+            if (ec) return false;
+            writeTime = (int64_t)time.time_since_epoch().count();
+            return true;
+        }
     }
 
     /** Wrapper around std::ostream to ease serialization of basic types.
@@ -64,13 +251,32 @@ namespace Falcor
     class SceneCache::OutputStream
     {
     public:
-        OutputStream(std::ostream& stream) : mStream(stream) {}
+        /** Constructor.
+            \param[in] stream Output stream.
+            \param[in] pBlobs Optional list to collect blobs in. If set, large arrays are added to the list instead of being written to the stream.
+        */
+        OutputStream(std::ostream& stream, std::vector<BlobRef>* pBlobs = nullptr) : mStream(stream), mpBlobs(pBlobs) {}
 
         void write(const void* data, size_t len)
         {
             mStream.write(reinterpret_cast<const char*>(data), len);
         }
 
+        void writeBlob(const void* data, size_t len)
+        {
+            bool isBlob = mpBlobs && len >= kMinBlobSize;
+            write(isBlob);
+            if (isBlob)
+            {
+                write((uint32_t)mpBlobs->size());
+                mpBlobs->push_back({ data, len });
+            }
+            else
+            {
+                write(data, len);
+            }
+        }
+
         template<typename T>
         void write(const T& value)
         {
@@ -92,7 +298,7 @@ namespace Falcor
             write(len);
             if constexpr (std::is_trivial<T>::value && !std::is_same<T, bool>::value)
             {
-                write(vec.data(), len * sizeof(T));
+                writeBlob(vec.data(), len * sizeof(T));
             }
             else
             {
@@ -110,6 +316,7 @@ namespace Falcor
 
     private:
         std::ostream& mStream;
+        std::vector<BlobRef>* mpBlobs;
     };
 
     /** Wrapper around std::istream to ease serialization of basic types.
@@ -117,13 +324,32 @@ namespace Falcor
     class SceneCache::InputStream
     {
     public:
-        InputStream(std::istream& stream) : mStream(stream) {}
+        /** Constructor.
+            \param[in] stream Input stream.
+            \param[in] pChunkTable Optional chunk table to decode blobs from.
+        */
+        InputStream(std::istream& stream, const ChunkTable* pChunkTable = nullptr) : mStream(stream), mpChunkTable(pChunkTable) {}
 
         void read(void* data, size_t len)
         {
             mStream.read(reinterpret_cast<char*>(data), len);
         }
 
+        void readBlob(void* data, size_t len)
+        {
+            bool isBlob = read<bool>();
+            if (isBlob)
+            {
+                uint32_t index = read<uint32_t>();
+                if (!mpChunkTable) throw std::runtime_error("Found blob without chunk table in scene cache file!");
+                mpChunkTable->decodeBlob(index, data, len);
+            }
+            else
+            {
+                read(data, len);
+            }
+        }
+
         template<typename T>
         void read(T& value)
         {
@@ -153,7 +379,7 @@ namespace Falcor
             vec.resize(len);
             if constexpr (std::is_trivial<T>::value && !std::is_same<T, bool>::value)
             {
-                read(vec.data(), len * sizeof(T));
+                readBlob(vec.data(), len * sizeof(T));
             }
             else
             {
@@ -170,6 +396,7 @@ namespace Falcor
 
     private:
         std::istream& mStream;
+        const ChunkTable* mpChunkTable;
     };
 
     bool SceneCache::hasValidCache(const Key& key)
@@ -184,13 +411,63 @@ namespace Falcor
         // Verify header.
         Header header;
         fs.read(reinterpret_cast<char*>(&header), sizeof(header));
-        return !fs.eof() && header.isValid();
+        if (fs.eof() || !header.isValid()) return false;
+
+        // Verify dependencies.
+        try
+        {
+            InputStream stream(fs);
+            auto dependencies = readDependencies(stream);
+            if (fs.fail()) return false;
+
+            bool updated = false;
+            std::vector<std::string> changedFiles;
+            return validateDependencies(dependencies, updated, changedFiles);
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
     }
 
-    void SceneCache::writeCache(const Scene::SceneData& sceneData, const Key& key)
+    void SceneCache::writeCache(const Scene::SceneData& sceneData, const Key& key, const std::vector<std::string>& dependencies, bool hashDependencies, Format format)
     {
         auto cachePath = getCachePath(key);
 
+        // Collect files that are reloaded from disk when reading the cache.
+        std::set<std::string> reloadedFiles;
+        for (const auto& pMaterial : sceneData.materials)
+        {
+            for (uint32_t slot = 0; slot < (uint32_t)Material::TextureSlot::Count; ++slot)
+            {
+                const auto& pTexture = pMaterial->getTexture(Material::TextureSlot(slot));
+                if (pTexture && !pTexture->getSourceFilename().empty()) reloadedFiles.insert(pTexture->getSourceFilename());
+            }
+        }
+        if (sceneData.pEnvMap && !sceneData.pEnvMap->getEnvMap()->getSourceFilename().empty())
+        {
+            reloadedFiles.insert(sceneData.pEnvMap->getEnvMap()->getSourceFilename());
+        }
+
+        // Record file stamps of all dependencies.
+        std::set<std::string> paths(dependencies.begin(), dependencies.end());
+        paths.insert(reloadedFiles.begin(), reloadedFiles.end());
+
+        DependencyList dependencyList;
+        for (const auto& path : paths)
+        {
+            Dependency dependency;
+            dependency.path = path;
+            dependency.isReloaded = reloadedFiles.find(path) != reloadedFiles.end();
+            if (!getFileStamp(path, dependency.size, dependency.writeTime))
+            {
+                logWarning("Scene cache dependency '" + path + "' not found. Ignoring it.");
+                continue;
+            }
+            if (hashDependencies) dependency.contentHash = SHA1::computeFile(path);
+            dependencyList.push_back(dependency);
+        }
+
         logInfo("Writing scene cache to " + cachePath.string());
 
         // Create directories if not existing.
@@ -204,16 +481,43 @@ namespace Falcor
         Header header;
         std::memcpy(header.magic, kMagic, sizeof(Header::magic));
         header.version = kVersion;
+        header.format = format;
         fs.write(reinterpret_cast<const char*>(&header), sizeof(header));
 
-        // Write cache (compressed).
-        lz4_stream::basic_ostream<kBlockSize> zs(fs);
-        OutputStream stream(zs);
-        writeSceneData(stream, sceneData);
+        // Write dependencies (uncompressed).
+        OutputStream fileStream(fs);
+        writeDependencies(fileStream, dependencyList);
+
+        if (format == Format::Mapped)
+        {
+            // Reserve space for the section table.
+            const auto layoutOffset = fs.tellp();
+            MappedLayout layout;
+            fileStream.write(layout);
+
+            // Write scene data without mesh data (compressed).
+            layout.sceneData.offset = (uint64_t)fs.tellp();
+            writeChunkedSceneData(fs, sceneData, false);
+            layout.sceneData.size = (uint64_t)fs.tellp() - layout.sceneData.offset;
+
+            // Write mesh data (uncompressed).
+            layout.meshIndexData = writeSection(fs, sceneData.meshIndexData);
+            layout.meshStaticData = writeSection(fs, sceneData.meshStaticData);
+            layout.meshDynamicData = writeSection(fs, sceneData.meshDynamicData);
+
+            // Write section table.
+            fs.seekp(layoutOffset);
+            fileStream.write(layout);
+        }
+        else
+        {
+            // Write scene data (compressed).
+            writeChunkedSceneData(fs, sceneData, true);
+        }
         if (fs.bad()) throw std::runtime_error("Failed to write scene cache file to '" + cachePath.string() + "'!");
     }
 
-    Scene::SceneData SceneCache::readCache(const Key& key)
+    Scene::SceneData SceneCache::readCache(const Key& key, const TextureCache::SharedPtr& pTextureCache, const TextureStreamer::SharedPtr& pTextureStreamer)
     {
         auto cachePath = getCachePath(key);
 
@@ -228,14 +532,81 @@ namespace Falcor
         fs.read(reinterpret_cast<char*>(&header), sizeof(header));
         if (!header.isValid()) throw std::runtime_error("Invalid header in scene cache file '" + cachePath.string() + "'!");
 
-        // Read cache (compressed).
-        lz4_stream::basic_istream<kBlockSize, kBlockSize> zs(fs);
-        InputStream stream(zs);
-        auto sceneData = readSceneData(stream);
-        if (fs.bad()) throw std::runtime_error("Failed to read scene cache file from '" + cachePath.string() + "'!");
+        // Read and validate dependencies (uncompressed).
+        InputStream fileStream(fs);
+        auto dependencies = readDependencies(fileStream);
+        const auto dependenciesSize = (size_t)fs.tellg() - sizeof(Header);
+
+        bool updated = false;
+        std::vector<std::string> changedFiles;
+        if (!validateDependencies(dependencies, updated, changedFiles)) throw std::runtime_error("Scene cache file '" + cachePath.string() + "' is outdated!");
+        for (const auto& path : changedFiles) logInfo("Scene cache dependency '" + path + "' has changed. Reloading it from disk.");
+
+        // Files that changed at any point since the cache was written. Their cached texture analysis is stale.
+        std::set<std::string> changedFileSet;
+        for (const auto& dependency : dependencies)
+        {
+            if (dependency.hasChanged) changedFileSet.insert(dependency.path);
+        }
+
+        // Locate the scene data. In the mapped format it is given by the section table, otherwise it follows the dependencies.
+        MappedLayout layout;
+        if (header.format == Format::Mapped) fileStream.read(layout);
+        else layout.sceneData.offset = (uint64_t)fs.tellg();
+        if (fs.fail()) throw std::runtime_error("Failed to read scene cache file from '" + cachePath.string() + "'!");
+        fs.close();
+
+        // Map the file. Compressed chunks are decoded directly from the mapped file,
+        // uncompressed mesh data is referenced in place and paged in when it is accessed.
+        auto pFile = MemoryMappedFile::create(cachePath.string());
+        if (!pFile) throw std::runtime_error("Failed to map scene cache file '" + cachePath.string() + "'!");
+
+        Scene::SceneData sceneData;
+        if (header.format == Format::Mapped)
+        {
+            // Read scene data without mesh data (compressed).
+            sceneData = readChunkedSceneData(*pFile, layout.sceneData.offset, layout.sceneData.size, false, pTextureCache, pTextureStreamer, changedFileSet);
+
+            sceneData.mappedMeshIndexData = getSectionView<uint32_t>(*pFile, layout.meshIndexData);
+            sceneData.mappedMeshStaticData = getSectionView<PackedStaticVertexData>(*pFile, layout.meshStaticData);
+            sceneData.mappedMeshDynamicData = getSectionView<DynamicVertexData>(*pFile, layout.meshDynamicData);
+            sceneData.pMappedMeshData = pFile;
+        }
+        else
+        {
+            // Read scene data (compressed). The section extends to the end of the file.
+            layout.sceneData.size = pFile->getSize() - std::min((uint64_t)pFile->getSize(), layout.sceneData.offset);
+            sceneData = readChunkedSceneData(*pFile, layout.sceneData.offset, layout.sceneData.size, true, pTextureCache, pTextureStreamer, changedFileSet);
+        }
+
+        // Update the recorded file stamps in place.
+        // Only fixed size fields are changed, so the serialized dependencies keep their size.
+        if (updated)
+        {
+            std::ostringstream ss;
+            OutputStream stampStream(ss);
+            writeDependencies(stampStream, dependencies);
+            const std::string data = ss.str();
+            assert(data.size() == dependenciesSize);
+
+            std::fstream file(cachePath.c_str(), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+            if (data.size() == dependenciesSize && file.good())
+            {
+                file.seekp(sizeof(Header));
+                file.write(data.data(), data.size());
+            }
+            if (!file.good()) logWarning("Failed to update dependencies in scene cache file '" + cachePath.string() + "'.");
+        }
+
         return sceneData;
     }
 
+    void SceneCache::deleteCache(const Key& key)
+    {
+        std::error_code ec;
+        std::filesystem::remove(getCachePath(key), ec);
+    }
+
     std::filesystem::path SceneCache::getCachePath(const Key& key)
     {
         std::stringstream ss;
@@ -244,9 +615,174 @@ namespace Falcor
         return std::filesystem::path(getAppDataDirectory()) / kDirectory / ss.str();
     }
 
+    // Dependencies
+
+    void SceneCache::writeDependencies(OutputStream& stream, const DependencyList& dependencies)
+    {
+        writeMarker(stream, "Dependencies");
+        stream.write((uint32_t)dependencies.size());
+        for (const auto& dependency : dependencies)
+        {
+            stream.write(dependency.path);
+            stream.write(dependency.isReloaded);
+            stream.write(dependency.size);
+            stream.write(dependency.writeTime);
+            stream.write(dependency.contentHash);
+            stream.write(dependency.hasChanged);
+        }
+    }
+
+    SceneCache::DependencyList SceneCache::readDependencies(InputStream& stream)
+    {
+        readMarker(stream, "Dependencies");
+        DependencyList dependencies(stream.read<uint32_t>());
+        for (auto& dependency : dependencies)
+        {
+            stream.read(dependency.path);
+            stream.read(dependency.isReloaded);
+            stream.read(dependency.size);
+            stream.read(dependency.writeTime);
+            stream.read(dependency.contentHash);
+            stream.read(dependency.hasChanged);
+        }
+        return dependencies;
+    }
+
+    bool SceneCache::validateDependencies(DependencyList& dependencies, bool& updated, std::vector<std::string>& changedFiles)
+    {
+        updated = false;
+        changedFiles.clear();
+
+        for (auto& dependency : dependencies)
+        {
+            uint64_t size = 0;
+            int64_t writeTime = 0;
+            if (!getFileStamp(dependency.path, size, writeTime))
+            {
+                logInfo("Scene cache is outdated. Dependency '" + dependency.path + "' no longer exists.");
+                return false;
+            }
+
+            // Cheap check first. If the file stamp is unchanged, we assume the content is unchanged.
+            if (size == dependency.size && writeTime == dependency.writeTime) continue;
+
+            // If a content hash was recorded, only treat the file as changed if the content actually changed.
+            bool contentChanged = true;
+            if (dependency.contentHash)
+            {
+                auto contentHash = SHA1::computeFile(dependency.path);
+                if (!contentHash)
+                {
+                    logInfo("Scene cache is outdated. Dependency '" + dependency.path + "' cannot be read.");
+                    return false;
+                }
+                contentChanged = contentHash != dependency.contentHash;
+                dependency.contentHash = contentHash;
+            }
+
+            if (contentChanged)
+            {
+                if (!dependency.isReloaded)
+                {
+                    logInfo("Scene cache is outdated. Dependency '" + dependency.path + "' has changed.");
+                    return false;
+                }
+                changedFiles.push_back(dependency.path);
+                dependency.hasChanged = true;
+            }
+
+            dependency.size = size;
+            dependency.writeTime = writeTime;
+            updated = true;
+        }
+
+        return true;
+    }
+
+    // Chunked scene data
+
+    void SceneCache::writeChunkedSceneData(std::ostream& fs, const Scene::SceneData& sceneData, bool writeMeshData)
+    {
+        // Serialize the scene data to memory. Large arrays are collected as blobs instead of being written to the main stream.
+        std::vector<BlobRef> blobs;
+        std::ostringstream ss;
+        {
+            lz4_stream::basic_ostream<kBlockSize> zs(ss);
+            OutputStream stream(zs, &blobs);
+            writeSceneData(stream, sceneData, writeMeshData);
+        }
+        const std::string mainData = ss.str();
+
+        // Split blobs into chunks.
+        std::vector<BlobEntry> blobEntries;
+        std::vector<ChunkEntry> chunkEntries;
+        std::vector<const uint8_t*> chunkData;
+        for (const auto& blob : blobs)
+        {
+            BlobEntry blobEntry;
+            blobEntry.size = blob.size;
+            blobEntry.firstChunk = (uint32_t)chunkEntries.size();
+            for (size_t offset = 0; offset < blob.size; offset += kChunkSize)
+            {
+                ChunkEntry chunkEntry;
+                chunkEntry.size = (uint32_t)std::min(kChunkSize, blob.size - offset);
+                chunkEntries.push_back(chunkEntry);
+                chunkData.push_back(static_cast<const uint8_t*>(blob.pData) + offset);
+            }
+            blobEntry.chunkCount = (uint32_t)chunkEntries.size() - blobEntry.firstChunk;
+            blobEntries.push_back(blobEntry);
+        }
+
+        // Compress chunks in parallel.
+        std::vector<std::vector<char>> compressedChunks(chunkEntries.size());
+        Threading::parallelFor(size_t(0), chunkEntries.size(), [&](size_t i)
+        {
+            const int size = (int)chunkEntries[i].size;
+            auto& compressed = compressedChunks[i];
+            compressed.resize(LZ4_compressBound(size));
+            int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(chunkData[i]), compressed.data(), size, (int)compressed.size());
+            if (compressedSize <= 0) throw std::runtime_error("Failed to compress chunk for scene cache file!");
+            compressed.resize(compressedSize);
+        }, 1);
+
+        // Compute chunk offsets.
+        ChunkedHeader header;
+        header.mainSize = mainData.size();
+        header.blobCount = (uint32_t)blobEntries.size();
+        header.chunkCount = (uint32_t)chunkEntries.size();
+
+        uint64_t offset = sizeof(ChunkedHeader) + blobEntries.size() * sizeof(BlobEntry) + chunkEntries.size() * sizeof(ChunkEntry) + mainData.size();
+        for (size_t i = 0; i < chunkEntries.size(); i++)
+        {
+            chunkEntries[i].offset = offset;
+            chunkEntries[i].compressedSize = (uint32_t)compressedChunks[i].size();
+            offset += compressedChunks[i].size();
+        }
+
+        // Write section.
+        OutputStream stream(fs);
+        stream.write(header);
+        stream.write(blobEntries.data(), blobEntries.size() * sizeof(BlobEntry));
+        stream.write(chunkEntries.data(), chunkEntries.size() * sizeof(ChunkEntry));
+        stream.write(mainData.data(), mainData.size());
+        for (const auto& compressed : compressedChunks) stream.write(compressed.data(), compressed.size());
+    }
+
+    Scene::SceneData SceneCache::readChunkedSceneData(const MemoryMappedFile& file, uint64_t offset, uint64_t size, bool readMeshData, const TextureCache::SharedPtr& pTextureCache, const TextureStreamer::SharedPtr& pTextureStreamer, const std::set<std::string>& changedFiles)
+    {
+        auto sectionView = getSectionView<uint8_t>(file, { offset, size });
+        ChunkTable chunkTable(sectionView.data(), sectionView.size());
+
+        MemoryStreamBuf buffer(chunkTable.getMainData(), chunkTable.getMainSize());
+        std::istream ms(&buffer);
+        lz4_stream::basic_istream<kBlockSize, kBlockSize> zs(ms);
+        InputStream stream(zs, &chunkTable);
+        return readSceneData(stream, readMeshData, pTextureCache, pTextureStreamer, changedFiles);
+    }
+
     // SceneData
 
-    void SceneCache::writeSceneData(OutputStream& stream, const Scene::SceneData& sceneData)
+    void SceneCache::writeSceneData(OutputStream& stream, const Scene::SceneData& sceneData, bool writeMeshData)
     {
         writeMarker(stream, "Filename");
         stream.write(sceneData.filename);
@@ -279,7 +815,7 @@ namespace Falcor
 
         writeMarker(stream, "Materials");
         stream.write((uint32_t)sceneData.materials.size());
-        for (const auto& pMaterial : sceneData.materials) writeMaterial(stream, pMaterial);
+        for (const auto& pMaterial : sceneData.materials) writeMaterial(stream, pMaterial, sceneData.materialTextureAnalysis);
 
         writeMarker(stream, "SceneGraph");
         stream.write((uint32_t)sceneData.sceneGraph.size());
@@ -331,9 +867,12 @@ namespace Falcor
         stream.write(sceneData.has16BitIndices);
         stream.write(sceneData.has32BitIndices);
         stream.write(sceneData.meshDrawCount);
-        stream.write(sceneData.meshIndexData);
-        stream.write(sceneData.meshStaticData);
-        stream.write(sceneData.meshDynamicData);
+        if (writeMeshData)
+        {
+            stream.write(sceneData.meshIndexData);
+            stream.write(sceneData.meshStaticData);
+            stream.write(sceneData.meshDynamicData);
+        }
 
         writeMarker(stream, "Curves");
         stream.write(sceneData.curveDesc);
@@ -359,7 +898,7 @@ namespace Falcor
         writeMarker(stream, "End");
     }
 
-    Scene::SceneData SceneCache::readSceneData(InputStream& stream)
+    Scene::SceneData SceneCache::readSceneData(InputStream& stream, bool readMeshData, const TextureCache::SharedPtr& pTextureCache, const TextureStreamer::SharedPtr& pTextureStreamer, const std::set<std::string>& changedFiles)
     {
         Scene::SceneData sceneData;
 
@@ -398,11 +937,11 @@ namespace Falcor
         // before material textures, as they upload buffers to the GPU when created.
         // Make sure no other GPU operations are executed until calling pMaterialTextureLoader.reset()
         // further down which blocks until all textures are loaded.
-        auto pMaterialTextureLoader = std::make_unique<MaterialTextureLoader>(true);
+        auto pMaterialTextureLoader = std::make_unique<MaterialTextureLoader>(true, pTextureCache, pTextureStreamer);
 
         readMarker(stream, "Materials");
         sceneData.materials.resize(stream.read<uint32_t>());
-        for (auto& pMaterial : sceneData.materials) pMaterial = readMaterial(stream, *pMaterialTextureLoader);
+        for (auto& pMaterial : sceneData.materials) pMaterial = readMaterial(stream, *pMaterialTextureLoader, changedFiles);
 
         readMarker(stream, "SceneGraph");
         sceneData.sceneGraph.resize(stream.read<uint32_t>());
@@ -451,9 +990,12 @@ namespace Falcor
         stream.read(sceneData.has16BitIndices);
         stream.read(sceneData.has32BitIndices);
         stream.read(sceneData.meshDrawCount);
-        stream.read(sceneData.meshIndexData);
-        stream.read(sceneData.meshStaticData);
-        stream.read(sceneData.meshDynamicData);
+        if (readMeshData)
+        {
+            stream.read(sceneData.meshIndexData);
+            stream.read(sceneData.meshStaticData);
+            stream.read(sceneData.meshDynamicData);
+        }
 
         readMarker(stream, "Curves");
         stream.read(sceneData.curveDesc);
@@ -639,13 +1181,13 @@ namespace Falcor
 
     // Material
 
-    void SceneCache::writeMaterial(OutputStream& stream, const Material::SharedPtr& pMaterial)
+    void SceneCache::writeMaterial(OutputStream& stream, const Material::SharedPtr& pMaterial, const Material::TextureAnalysisMap& textureAnalysis)
     {
         // Write common fields.
         stream.write((uint32_t)pMaterial->getType());
         stream.write(pMaterial->mName);
 
-        auto writeTextureSlot = [&stream, &pMaterial](Material::TextureSlot slot)
+        auto writeTextureSlot = [&stream, &pMaterial, &textureAnalysis](Material::TextureSlot slot)
         {
             const auto& pTexture = pMaterial->getTexture(slot);
             bool hasTexture = pTexture != nullptr;
@@ -653,6 +1195,11 @@ namespace Falcor
             if (hasTexture)
             {
                 stream.write(pTexture->getSourceFilename());
+
+                // Write the texture analysis result so that the texture optimizations can be restored without analyzing the texture.
+                std::optional<TextureAnalyzer::Result> analysis;
+                if (auto it = textureAnalysis.find(Material::getTextureAnalysisKey(*pTexture)); it != textureAnalysis.end()) analysis = it->second;
+                stream.write(analysis);
             }
         };
 
@@ -676,7 +1223,7 @@ namespace Falcor
         stream.write(pMaterial->mIsTexturedAlphaConstant);
     }
 
-    Material::SharedPtr SceneCache::readMaterial(InputStream& stream, MaterialTextureLoader& materialTextureLoader)
+    Material::SharedPtr SceneCache::readMaterial(InputStream& stream, MaterialTextureLoader& materialTextureLoader, const std::set<std::string>& changedFiles)
     {
         // Create derived material class of the right type.
         Material::SharedPtr pMaterial;
@@ -709,7 +1256,12 @@ namespace Falcor
             if (hasTexture)
             {
                 auto filename = stream.read<std::string>();
-                materialTextureLoader.loadTexture(pMaterial, slot, filename);
+                std::optional<TextureAnalyzer::Result> analysis;
+                stream.read(analysis);
+
+                // The analysis no longer describes the texture if the file has changed since the cache was written.
+                if (changedFiles.find(filename) != changedFiles.end()) analysis = std::nullopt;
+                materialTextureLoader.loadTexture(pMaterial, slot, filename, analysis);
             }
         };
 
@@ -743,15 +1295,36 @@ namespace Falcor
         stream.write(pGridVolume->mIsAnimated);
         stream.write(pGridVolume->mNodeID);
 
+        auto getGridID = [&grids](const Grid::SharedPtr& pGrid)
+        {
+            return pGrid ? (uint32_t)std::distance(grids.begin(), std::find(grids.begin(), grids.end(), pGrid)) : uint32_t(-1);
+        };
+
         stream.write(pGridVolume->mName);
-        for (const auto& gridSequence : pGridVolume->mGrids)
+
+        // Store the directory of the grid cache, so that streamed slots keep loading through it.
+        std::optional<std::string> gridCacheDirectory;
+        if (pGridVolume->mpGridCache) gridCacheDirectory = pGridVolume->mpGridCache->getOptions().directory;
+        stream.write(gridCacheDirectory);
+
+        for (size_t slotIndex = 0; slotIndex < pGridVolume->mGrids.size(); ++slotIndex)
         {
-            stream.write((uint32_t)gridSequence.size());
-            for (const auto& pGrid : gridSequence)
+            // Streamed slots store the files to stream from and the grid of the current frame.
+            const auto& pStreamer = pGridVolume->mStreamers[slotIndex];
+            stream.write(pStreamer != nullptr);
+            if (pStreamer)
             {
-                uint32_t id = pGrid ? (uint32_t)std::distance(grids.begin(), std::find(grids.begin(), grids.end(), pGrid)) : uint32_t(-1);
-                stream.write(id);
+                stream.write(pStreamer->getFilenames());
+                stream.write(pStreamer->getGridname());
+                stream.write(pStreamer->getOptions());
+                stream.write(pStreamer->getFrame());
+                stream.write(getGridID(pGridVolume->mStreamedGrids[slotIndex]));
+                continue;
             }
+
+            const auto& gridSequence = pGridVolume->mGrids[slotIndex];
+            stream.write((uint32_t)gridSequence.size());
+            for (const auto& pGrid : gridSequence) stream.write(getGridID(pGrid));
         }
         stream.write(pGridVolume->mGridFrame);
         stream.write(pGridVolume->mGridFrameCount);
@@ -768,8 +1341,36 @@ namespace Falcor
         stream.read(pGridVolume->mNodeID);
 
         stream.read(pGridVolume->mName);
-        for (auto& gridSequence : pGridVolume->mGrids)
+
+        std::optional<std::string> gridCacheDirectory;
+        stream.read(gridCacheDirectory);
+        if (gridCacheDirectory)
+        {
+            GridCache::Options options;
+            options.directory = *gridCacheDirectory;
+            pGridVolume->mpGridCache = GridCache::create(options);
+        }
+
+        for (size_t slotIndex = 0; slotIndex < pGridVolume->mGrids.size(); ++slotIndex)
         {
+            if (stream.read<bool>())
+            {
+                auto filenames = stream.read<std::vector<std::string>>();
+                auto gridname = stream.read<std::string>();
+                auto options = stream.read<GridStreamer::Options>();
+                auto frame = stream.read<uint32_t>();
+                auto id = stream.read<uint32_t>();
+
+                auto pStreamer = GridStreamer::createFromFiles(filenames, gridname, options, pGridVolume->mpGridCache);
+                auto pGrid = id == uint32_t(-1) ? nullptr : grids[id];
+                pStreamer->setResident(frame, pGrid);
+                pStreamer->setFrame(frame);
+                pGridVolume->mStreamers[slotIndex] = pStreamer;
+                pGridVolume->mStreamedGrids[slotIndex] = pGrid;
+                continue;
+            }
+
+            auto& gridSequence = pGridVolume->mGrids[slotIndex];
             gridSequence.resize(stream.read<uint32_t>());
             for (auto& pGrid : gridSequence)
             {
@@ -782,6 +1383,11 @@ namespace Falcor
         stream.read(pGridVolume->mBounds);
         stream.read(pGridVolume->mData);
 
+        for (const auto& pStreamer : pGridVolume->mStreamers)
+        {
+            if (pStreamer) pStreamer->setFrameRate(pGridVolume->mFrameRate);
+        }
+
         return pGridVolume;
     }
 
@@ -791,15 +1397,15 @@ namespace Falcor
     {
         const nanovdb::HostBuffer& buffer = pGrid->mGridHandle.buffer();
         stream.write((uint64_t)buffer.size());
-        stream.write(buffer.data(), buffer.size());
+        stream.writeBlob(buffer.data(), buffer.size());
     }
 
     Grid::SharedPtr SceneCache::readGrid(InputStream& stream)
     {
         uint64_t size = stream.read<uint64_t>();
         auto buffer = nanovdb::HostBuffer::create(size);
-        stream.read(buffer.data(), buffer.size());
-        return Grid::SharedPtr(new Grid(nanovdb::GridHandle<nanovdb::HostBuffer>(std::move(buffer))));
+        stream.readBlob(buffer.data(), buffer.size());
+        return Grid::SharedPtr(new Grid(nanovdb::GridHandle<nanovdb::HostBuffer>(std::move(buffer)), true));
     }
 
     // EnvMap
@@ -810,6 +1416,18 @@ namespace Falcor
         stream.write(filename);
         stream.write(pEnvMap->mData);
         stream.write(pEnvMap->mRotation);
+
+        const auto& pImportanceMap = pEnvMap->getImportanceMap();
+        stream.write(pImportanceMap != nullptr);
+        if (pImportanceMap)
+        {
+            stream.write(pImportanceMap->getContentHash());
+            stream.write(pImportanceMap->getFileSize());
+            stream.write(pImportanceMap->getFileWriteTime());
+            stream.write(pImportanceMap->getDimension());
+            stream.write(pImportanceMap->getSamples());
+            stream.write(pImportanceMap->getData());
+        }
     }
 
     EnvMap::SharedPtr SceneCache::readEnvMap(InputStream& stream)
@@ -818,6 +1436,33 @@ namespace Falcor
         auto pEnvMap = EnvMap::create(filename);
         stream.read(pEnvMap->mData);
         stream.read(pEnvMap->mRotation);
+
+        // The importance map is keyed by the content of the environment map file. Drop it if the file has changed.
+        // The file is only hashed if its size or write time differ from when the map was built.
+        if (stream.read<bool>())
+        {
+            auto contentHash = stream.read<SHA1::MD>();
+            auto fileSize = stream.read<uint64_t>();
+            auto fileWriteTime = stream.read<int64_t>();
+            auto dimension = stream.read<uint32_t>();
+            auto samples = stream.read<uint32_t>();
+            auto data = stream.read<std::vector<float>>();
+
+            uint64_t size = 0;
+            int64_t writeTime = 0;
+            bool valid = getFileStamp(pEnvMap->getFilename(), size, writeTime);
+            if (valid && (size != fileSize || writeTime != fileWriteTime))
+            {
+                valid = SHA1::computeFile(pEnvMap->getFilename()) == contentHash;
+            }
+            if (valid)
+            {
+                auto pImportanceMap = EnvMapImportanceMap::create(dimension, samples, std::move(data));
+                pImportanceMap->setContentHash(contentHash);
+                pImportanceMap->setFileStamp(size, writeTime);
+                pEnvMap->mpImportanceMap = pImportanceMap;
+            }
+        }
         return pEnvMap;
     }
 
@@ -31,19 +31,41 @@
 #include "Utils/CryptoUtils.h"
 
 #include <filesystem>
+#include <set>
 
 namespace Falcor
 {
     /** Helper class for reading and writing scene cache files.
         The scene cache is used to heavily reduce load times of more complex assets.
         The cache stores a binary representation of `Scene::SceneData` which contains everything to re-create a `Scene`.
+        In addition, the cache records the set of files the scene was built from (file size, last write time and
+        optionally a content hash). The dependencies are stored uncompressed after the header so they can be validated
+        cheaply without decompressing the scene data. Textures that are still referenced by the cached scene are
+        reloaded from disk when reading the cache, so changes to them don't invalidate the cache.
+
+        The scene data is stored in a chunked section: Large arrays (vertex/index/curve data, grids etc.) are split
+        into chunks that are LZ4-compressed independently and in parallel, and are listed in a table of contents.
+        The remaining data is stored in a single LZ4-compressed stream.
+
+        Two file formats are supported. The compressed format stores all data in the chunked section.
+        The mapped format stores the mesh index and vertex data uncompressed and page-aligned, so that it can be
+        referenced in place from a memory-mapped file without deserialization.
     */
     class dlldecl SceneCache
     {
     public:
         using Key = SHA1::MD;
 
+        /** Cache file format.
+        */
+        enum class Format : uint32_t
+        {
+            Compressed,     ///< All data is stored LZ4-compressed.
+            Mapped,         ///< Mesh data is stored uncompressed and memory-mapped when reading the cache.
+        };
+
         /** Check if there is a valid scene cache for a given cache key.
+            The cache is valid if it has the current version and none of the files it was built from have changed.
             \param[in] key Cache key.
             \return Returns true if a valid cache exists.
         */
@@ -52,23 +74,68 @@ namespace Falcor
         /** Write a scene cache.
             \param[in] sceneData Scene data.
             \param[in] key Cache key.
+            \param[in] dependencies List of absolute paths of files the scene was built from.
+                Textures referenced by the scene data and the environment map are added automatically.
+            \param[in] hashDependencies If true, content hashes of all dependencies are stored. This allows to detect
+                files that have been touched without changing their content, at the cost of reading all dependencies.
+            \param[in] format File format.
         */
-        static void writeCache(const Scene::SceneData& sceneData, const Key& key);
+        static void writeCache(const Scene::SceneData& sceneData, const Key& key, const std::vector<std::string>& dependencies = {}, bool hashDependencies = false, Format format = Format::Compressed);
 
         /** Read a scene cache.
             \param[in] key Cache key.
+            \param[in] pTextureCache Optional texture cache to load the material textures through.
+            \param[in] pTextureStreamer Optional texture streamer to stream the material textures with.
             \return Returns the loaded scene data.
         */
-        static Scene::SceneData readCache(const Key& key);
+        static Scene::SceneData readCache(const Key& key, const TextureCache::SharedPtr& pTextureCache = nullptr, const TextureStreamer::SharedPtr& pTextureStreamer = nullptr);
+
+        /** Delete a scene cache.
+            \param[in] key Cache key.
+        */
+        static void deleteCache(const Key& key);
+
+        /** Get the path of a scene cache file.
+            \param[in] key Cache key.
+            \return Returns the path of the cache file.
+        */
+        static std::filesystem::path getCachePath(const Key& key);
 
     private:
         class OutputStream;
         class InputStream;
 
-        static std::filesystem::path getCachePath(const Key& key);
+        /** Describes a file the cached scene was built from.
+        */
+        struct Dependency
+        {
+            std::string path;                       ///< Absolute path of the file.
+            bool isReloaded = false;                ///< True if the file is reloaded from disk when reading the cache. Changes to it don't invalidate the cache.
+            uint64_t size = 0;                      ///< File size in bytes.
+            int64_t writeTime = 0;                  ///< Last write time of the file.
+            std::optional<SHA1::MD> contentHash;    ///< Optional hash of the file content.
+            bool hasChanged = false;                ///< True if the content of a reloaded file has changed since the cache was written. Data derived from the file when writing the cache (e.g. texture analysis) is no longer valid.
+        };
+
+        using DependencyList = std::vector<Dependency>;
+
+        static void writeDependencies(OutputStream& stream, const DependencyList& dependencies);
+        static DependencyList readDependencies(InputStream& stream);
+
+        /** Validate dependencies against the file system.
+            Dependencies that are reloaded from disk and have changed get their recorded file stamps updated and are marked as changed.
+            \param[in,out] dependencies List of dependencies.
+            \param[out] updated True if any recorded file stamp was updated.
+            \param[out] changedFiles List of changed files that are reloaded when reading the cache.
+            \return Returns true if the cache is still valid.
+        */
+        static bool validateDependencies(DependencyList& dependencies, bool& updated, std::vector<std::string>& changedFiles);
+
+        static void writeChunkedSceneData(std::ostream& fs, const Scene::SceneData& sceneData, bool writeMeshData);
+        static Scene::SceneData readChunkedSceneData(const MemoryMappedFile& file, uint64_t offset, uint64_t size, bool readMeshData, const TextureCache::SharedPtr& pTextureCache, const TextureStreamer::SharedPtr& pTextureStreamer, const std::set<std::string>& changedFiles);
 
-        static void writeSceneData(OutputStream& stream, const Scene::SceneData& sceneData);
-        static Scene::SceneData readSceneData(InputStream& stream);
+        static void writeSceneData(OutputStream& stream, const Scene::SceneData& sceneData, bool writeMeshData = true);
+        static Scene::SceneData readSceneData(InputStream& stream, bool readMeshData = true, const TextureCache::SharedPtr& pTextureCache = nullptr, const TextureStreamer::SharedPtr& pTextureStreamer = nullptr, const std::set<std::string>& changedFiles = {});
 
         static void writeMetadata(OutputStream& stream, const Scene::Metadata& metadata);
         static Scene::Metadata readMetadata(InputStream& stream);
@@ -79,9 +146,9 @@ namespace Falcor
         static void writeLight(OutputStream& stream, const Light::SharedPtr& pLight);
         static Light::SharedPtr readLight(InputStream& stream);
 
-        static void writeMaterial(OutputStream& stream, const Material::SharedPtr& pMaterial);
+        static void writeMaterial(OutputStream& stream, const Material::SharedPtr& pMaterial, const Material::TextureAnalysisMap& textureAnalysis);
         static void writeBasicMaterial(OutputStream& stream, const BasicMaterial::SharedPtr& pMaterial);
-        static Material::SharedPtr readMaterial(InputStream& stream, MaterialTextureLoader& materialTextureLoader);
+        static Material::SharedPtr readMaterial(InputStream& stream, MaterialTextureLoader& materialTextureLoader, const std::set<std::string>& changedFiles);
         static void readBasicMaterial(InputStream& stream, MaterialTextureLoader& materialTextureLoader, const BasicMaterial::SharedPtr& pMaterial);
 
         static void writeGridVolume(OutputStream& stream, const GridVolume::SharedPtr& pVolume, const std::vector<Grid::SharedPtr>& grids);
@@ -0,0 +1,128 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "VertexCompression.h"
+#include "Utils/Math/PackedFormats.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Returns the angle in radians between two normalized directions. Accurate for small angles.
+        */
+        float angleBetween(const float3& a, const float3& b)
+        {
+            return 2.f * std::asin(std::min(1.f, glm::length(a - b) * 0.5f));
+        }
+    }
+
+    VertexCompression::Stats& VertexCompression::Stats::operator+=(const Stats& other)
+    {
+        vertexCount += other.vertexCount;
+        maxPositionError = std::max(maxPositionError, other.maxPositionError);
+        maxNormalError = std::max(maxNormalError, other.maxNormalError);
+        maxTangentError = std::max(maxTangentError, other.maxTangentError);
+        maxTexCrdError = std::max(maxTexCrdError, other.maxTexCrdError);
+        return *this;
+    }
+
+    VertexCompression::Params VertexCompression::computeParams(const AABB& bounds, PositionFormat positionFormat)
+    {
+        Params params;
+        params.positionFormat = positionFormat;
+        if (!bounds.valid()) return params;
+
+        if (positionFormat == PositionFormat::Unorm16)
+        {
+            params.origin = bounds.minPoint;
+            // Avoid a zero scale for flat meshes. The quantized value is then always zero.
+            params.scale = glm::max(bounds.extent(), float3(std::numeric_limits<float>::min())) / 65535.f;
+        }
+        else
+        {
+            params.origin = bounds.center();
+            params.scale = float3(1.f);
+        }
+        return params;
+    }
+
+    CompressedStaticVertexData VertexCompression::compress(const StaticVertexData& v, const Params& params)
+    {
+        CompressedStaticVertexData c;
+
+        const float3 p = (v.position - params.origin) / params.scale;
+        for (int i = 0; i < 3; i++)
+        {
+            if (params.positionFormat == PositionFormat::Unorm16) c.position[i] = (uint16_t)std::clamp(std::round(p[i]), 0.f, 65535.f);
+            else c.position[i] = (uint16_t)f32tof16(p[i]);
+        }
+
+        // A zero tangent w marks the tangent as invalid. Its direction is undefined (usually zero), so it is not encoded.
+        c.tangentW = (uint16_t)f32tof16(v.tangent.w);
+        c.normal = encodeNormal2x16(v.normal);
+        c.tangent = v.tangent.w != 0.f ? encodeNormal2x16(v.tangent.xyz) : 0;
+        c.texCrd = glm::packHalf2x16(v.texCrd);
+        return c;
+    }
+
+    StaticVertexData VertexCompression::decompress(const CompressedStaticVertexData& c, const Params& params)
+    {
+        StaticVertexData v;
+
+        float3 p;
+        for (int i = 0; i < 3; i++)
+        {
+            if (params.positionFormat == PositionFormat::Unorm16) p[i] = (float)c.position[i];
+            else p[i] = f16tof32(c.position[i]);
+        }
+        v.position = params.origin + p * params.scale;
+
+        v.normal = decodeNormal2x16(c.normal);
+        const float tangentW = f16tof32(c.tangentW);
+        v.tangent = tangentW != 0.f ? float4(decodeNormal2x16(c.tangent), tangentW) : float4(0.f);
+        v.texCrd = glm::unpackHalf2x16(c.texCrd);
+        return v;
+    }
+
+    void VertexCompression::compress(const PackedStaticVertexData* vertices, size_t count, const Params& params, CompressedStaticVertexData* pCompressed, Stats& stats)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            const StaticVertexData v = vertices[i].unpack();
+            pCompressed[i] = compress(v, params);
+
+            const StaticVertexData d = decompress(pCompressed[i], params);
+            stats.maxPositionError = std::max(stats.maxPositionError, glm::length(d.position - v.position));
+            stats.maxNormalError = std::max(stats.maxNormalError, angleBetween(d.normal, v.normal));
+            if (v.tangent.w != 0.f) stats.maxTangentError = std::max(stats.maxTangentError, angleBetween(d.tangent.xyz(), v.tangent.xyz()));
+            const float2 texCrdError = glm::abs(d.texCrd - v.texCrd);
+            stats.maxTexCrdError = std::max({ stats.maxTexCrdError, texCrdError.x, texCrdError.y });
+        }
+        stats.vertexCount += count;
+    }
+}
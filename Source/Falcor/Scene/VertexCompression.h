@@ -0,0 +1,127 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include "SceneTypes.slang"
+#include "Utils/Math/AABB.h"
+
+namespace Falcor
+{
+    /** Static vertex data compressed to 20B (vs. 32B for PackedStaticVertexData).
+        - Position: 3x 16-bit, either unorm relative to the mesh bounding box or fp16 relative to its center.
+        - Normal and tangent: octahedral 2x 16-bit snorm each.
+        - Tangent w (bitangent sign): fp16 in the 16 bits following the position. Tangents with w == 0 are invalid and decode to zero.
+        - Texture coordinates: 2x fp16.
+    */
+    struct CompressedStaticVertexData
+    {
+        uint16_t position[3];
+        uint16_t tangentW;
+        uint32_t normal;
+        uint32_t tangent;
+        uint32_t texCrd;
+    };
+
+    static_assert(sizeof(CompressedStaticVertexData) == 20, "CompressedStaticVertexData size should be 20B");
+
+    /** Utilities for compressing static vertex data.
+        The scene does not use this format yet. Its GPU vertex buffers, BLAS builds and skinning all expect PackedStaticVertexData,
+        so using it would require decoding the vertices in the shader vertex fetch.
+
+        Error bounds:
+        - Position (Unorm16): At most half a quantization step per axis, i.e., extent / (2 * 65535) of the mesh bounding box.
+        - Position (Float16): At most 2^-11 relative to the distance from the bounding box center. Requires coordinates within +-65504 of the center.
+        - Normal/tangent: The octahedral 2x 16-bit encoding has an angular error below kMaxDirectionError radians.
+        - Texture coordinates: At most 2^-11 relative error (fp16 rounding), for coordinates within +-65504.
+    */
+    class dlldecl VertexCompression
+    {
+    public:
+        static constexpr float kMaxDirectionError = 1e-4f; ///< Max angular error in radians for octahedral 2x 16-bit encoded directions.
+
+        enum class PositionFormat : uint32_t
+        {
+            Unorm16,    ///< Positions are quantized to 16-bit unorm relative to the bounding box.
+            Float16,    ///< Positions are stored as fp16 relative to the bounding box center.
+        };
+
+        /** Per-mesh parameters for decoding positions: position = origin + decoded * scale.
+        */
+        struct Params
+        {
+            float3 origin = float3(0.f);
+            float3 scale = float3(1.f);
+            PositionFormat positionFormat = PositionFormat::Unorm16;
+        };
+
+        /** Statistics collected when compressing vertices.
+        */
+        struct Stats
+        {
+            uint64_t vertexCount = 0;
+            float maxPositionError = 0.f;   ///< Max position error (distance) in object space.
+            float maxNormalError = 0.f;     ///< Max angular normal error in radians.
+            float maxTangentError = 0.f;    ///< Max angular tangent error in radians.
+            float maxTexCrdError = 0.f;     ///< Max absolute texture coordinate error.
+
+            uint64_t getUncompressedSize() const { return vertexCount * sizeof(PackedStaticVertexData); }
+            uint64_t getCompressedSize() const { return vertexCount * sizeof(CompressedStaticVertexData); }
+
+            Stats& operator+=(const Stats& other);
+        };
+
+        /** Compute the decoding parameters for a mesh.
+            \param[in] bounds Bounding box of the mesh vertices.
+            \param[in] positionFormat Position format.
+            \return Decoding parameters.
+        */
+        static Params computeParams(const AABB& bounds, PositionFormat positionFormat = PositionFormat::Unorm16);
+
+        /** Compress a vertex.
+            \param[in] v Vertex.
+            \param[in] params Decoding parameters of the mesh.
+            \return Compressed vertex.
+        */
+        static CompressedStaticVertexData compress(const StaticVertexData& v, const Params& params);
+
+        /** Decompress a vertex.
+            \param[in] v Compressed vertex.
+            \param[in] params Decoding parameters of the mesh.
+            \return Decompressed vertex.
+        */
+        static StaticVertexData decompress(const CompressedStaticVertexData& v, const Params& params);
+
+        /** Compress a range of vertices and accumulate the compression errors.
+            \param[in] vertices Vertices in packed format.
+            \param[in] count Number of vertices.
+            \param[in] params Decoding parameters of the mesh.
+            \param[out] pCompressed Compressed vertices. Must hold count elements.
+            \param[in,out] stats Statistics to update.
+        */
+        static void compress(const PackedStaticVertexData* vertices, size_t count, const Params& params, CompressedStaticVertexData* pCompressed, Stats& stats);
+    };
+}
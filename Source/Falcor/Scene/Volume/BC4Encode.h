@@ -26,8 +26,10 @@
  # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************/
 #pragma once
+#include <emmintrin.h>
 
-// this file exposes a single function, CompressAlphaDxt5, which encodes a 4x4 set of uint8 alpha values into a single 64 bit BC4 encoded block
+// this file exposes a single function, CompressAlphaDxt5, which encodes a 4x4 set of uint8 alpha values into a single 64 bit BC4 encoded block,
+// and the SSE2 batch encoder Falcor::BC4Encoder, whose reference mode produces the same blocks as CompressAlphaDxt5.
 static void CompressAlphaDxt5(uint8_t* tile, void* block);
 
 // derived from libsquish, alpha.cpp
@@ -241,3 +243,254 @@ static void CompressAlphaDxt5(uint8_t* tile, void* block)
         WriteAlphaBlock7(min7, max7, indices7, block);
 }
 
+namespace Falcor
+{
+    /** SSE2 BC4 encoder for batches of 4x4 blocks of uint8 values.
+        Texels of a block are processed together in one 128-bit register, which replaces the per-texel loops of CompressAlphaDxt5.
+    */
+    class BC4Encoder
+    {
+    public:
+        enum class Quality
+        {
+            Fast,       ///< Single 8-value interpolated palette (alpha0 > alpha1 mode) spanning the block range, indices computed by quantization. No endpoint search.
+            Reference,  ///< Same endpoint and index selection as CompressAlphaDxt5. Produces bit-identical blocks.
+            Exhaustive, ///< Searches all endpoint pairs around the reference endpoints in both palette modes. Never worse than Reference.
+        };
+
+        /** Encode a batch of blocks.
+            \param[in] tiles Block texels, 16 bytes per block in row-major order.
+            \param[out] blocks Encoded blocks, 8 bytes per block.
+            \param[in] blockCount Number of blocks to encode.
+            \param[in] quality Encoding quality.
+        */
+        static void encode(const uint8_t* tiles, void* blocks, size_t blockCount, Quality quality = Quality::Reference)
+        {
+            uint8_t* dst = (uint8_t*)blocks;
+            for (size_t i = 0; i < blockCount; ++i)
+            {
+                __m128i texels = _mm_loadu_si128((const __m128i*)(tiles + i * 16));
+                uint64_t block = 0;
+                switch (quality)
+                {
+                case Quality::Fast: block = encodeFast(texels); break;
+                case Quality::Reference: block = encodeReference(texels, nullptr); break;
+                case Quality::Exhaustive: block = encodeExhaustive(texels); break;
+                default: throw std::exception("Unknown BC4 encoding quality");
+                }
+                std::memcpy(dst + i * 8, &block, sizeof(block));
+            }
+        }
+
+    private:
+        static constexpr int kExhaustiveRadius = 6;
+
+        // Index remapping applied when the endpoints are swapped, as in WriteAlphaBlock5 and WriteAlphaBlock7.
+        static constexpr uint8_t kIdentityRemap[8] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+        static constexpr uint8_t kSwapRemap5[8] = { 1, 0, 5, 4, 3, 2, 6, 7 };
+        static constexpr uint8_t kSwapRemap7[8] = { 1, 0, 7, 6, 5, 4, 3, 2 };
+
+        /** Result of fitting the texels to a palette.
+        */
+        struct Fit
+        {
+            __m128i indices;    ///< Palette index of each texel.
+            uint32_t error;     ///< Sum of squared errors.
+        };
+
+        static __m128i absDiff(__m128i a, __m128i b)
+        {
+            return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        }
+
+        static int horizontalMin(__m128i v)
+        {
+            v = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+            v = _mm_min_epu8(v, _mm_srli_si128(v, 4));
+            v = _mm_min_epu8(v, _mm_srli_si128(v, 2));
+            v = _mm_min_epu8(v, _mm_srli_si128(v, 1));
+            return _mm_cvtsi128_si32(v) & 0xff;
+        }
+
+        static int horizontalMax(__m128i v)
+        {
+            v = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+            v = _mm_max_epu8(v, _mm_srli_si128(v, 4));
+            v = _mm_max_epu8(v, _mm_srli_si128(v, 2));
+            v = _mm_max_epu8(v, _mm_srli_si128(v, 1));
+            return _mm_cvtsi128_si32(v) & 0xff;
+        }
+
+        static uint32_t sumSquares(__m128i diff)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_unpacklo_epi8(diff, zero);
+            __m128i hi = _mm_unpackhi_epi8(diff, zero);
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+            return (uint32_t)_mm_cvtsi128_si32(sum);
+        }
+
+        /** Find the closest palette entry for each texel. Ties go to the lowest index, as in FitCodes.
+        */
+        static Fit fitCodes(__m128i texels, const uint8_t codes[8])
+        {
+            __m128i best = absDiff(texels, _mm_set1_epi8((char)codes[0]));
+            __m128i indices = _mm_setzero_si128();
+            for (int i = 1; i < 8; ++i)
+            {
+                __m128i diff = absDiff(texels, _mm_set1_epi8((char)codes[i]));
+                // diff < best iff max(diff, best) != diff.
+                __m128i notLess = _mm_cmpeq_epi8(_mm_max_epu8(diff, best), diff);
+                indices = _mm_or_si128(_mm_and_si128(notLess, indices), _mm_andnot_si128(notLess, _mm_set1_epi8((char)i)));
+                best = _mm_min_epu8(best, diff);
+            }
+            return { indices, sumSquares(best) };
+        }
+
+        static void makeCodes5(int min, int max, uint8_t codes[8])
+        {
+            codes[0] = (uint8_t)min;
+            codes[1] = (uint8_t)max;
+            for (int i = 1; i < 5; ++i) codes[1 + i] = (uint8_t)(((5 - i) * min + i * max) / 5);
+            codes[6] = 0;
+            codes[7] = 255;
+        }
+
+        static void makeCodes7(int min, int max, uint8_t codes[8])
+        {
+            codes[0] = (uint8_t)min;
+            codes[1] = (uint8_t)max;
+            for (int i = 1; i < 7; ++i) codes[1 + i] = (uint8_t)(((7 - i) * min + i * max) / 7);
+        }
+
+        /** Pack endpoints and indices into a block. The indices are remapped through 'remap' first.
+        */
+        static uint64_t packBlock(int alpha0, int alpha1, __m128i indices, const uint8_t remap[8])
+        {
+            alignas(16) uint8_t idx[16];
+            _mm_store_si128((__m128i*)idx, indices);
+            uint64_t block = uint64_t(alpha0) | (uint64_t(alpha1) << 8);
+            for (int i = 0; i < 16; ++i) block |= uint64_t(remap[idx[i]]) << (16 + 3 * i);
+            return block;
+        }
+
+        /** Write a 6-value palette block (alpha0 <= alpha1), matching WriteAlphaBlock5.
+        */
+        static uint64_t packBlock5(int min, int max, __m128i indices)
+        {
+            return min > max ? packBlock(max, min, indices, kSwapRemap5) : packBlock(min, max, indices, kIdentityRemap);
+        }
+
+        /** Write an 8-value palette block (alpha0 > alpha1), matching WriteAlphaBlock7.
+        */
+        static uint64_t packBlock7(int min, int max, __m128i indices)
+        {
+            return min < max ? packBlock(max, min, indices, kSwapRemap7) : packBlock(min, max, indices, kIdentityRemap);
+        }
+
+        static uint64_t encodeFast(__m128i texels)
+        {
+            int min = horizontalMin(texels);
+            int max = horizontalMax(texels);
+            if (min == max) return packBlock7(max, min, _mm_setzero_si128());
+
+            // Quantize (v - min) / (max - min) to t in [0,7] and map to the 8-value palette: t = 7 -> 0, t = 0 -> 1, otherwise 8 - t.
+            const __m128i zero = _mm_setzero_si128();
+            const __m128 scale = _mm_set1_ps(7.f / float(max - min));
+            const __m128 offset = _mm_set1_ps(0.5f - float(min) * 7.f / float(max - min));
+            __m128i lo = _mm_unpacklo_epi8(texels, zero);
+            __m128i hi = _mm_unpackhi_epi8(texels, zero);
+            __m128i t[4] =
+            {
+                _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero),
+            };
+            for (int i = 0; i < 4; ++i) t[i] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(t[i]), scale), offset));
+            __m128i steps = _mm_packus_epi16(_mm_packs_epi32(t[0], t[1]), _mm_packs_epi32(t[2], t[3]));
+            steps = _mm_min_epu8(steps, _mm_set1_epi8(7));
+
+            __m128i indices = _mm_sub_epi8(_mm_set1_epi8(8), steps);
+            __m128i isMax = _mm_cmpeq_epi8(steps, _mm_set1_epi8(7));
+            __m128i isMin = _mm_cmpeq_epi8(steps, zero);
+            indices = _mm_andnot_si128(isMax, indices);
+            indices = _mm_or_si128(_mm_andnot_si128(isMin, indices), _mm_and_si128(isMin, _mm_set1_epi8(1)));
+            return packBlock(max, min, indices, kIdentityRemap);
+        }
+
+        /** Encode as CompressAlphaDxt5 does. Optionally returns the squared error of the chosen block.
+        */
+        static uint64_t encodeReference(__m128i texels, uint32_t* pError)
+        {
+            // The 6-value palette has explicit 0 and 255 entries, so those texels are excluded from its range.
+            int min7 = horizontalMin(texels);
+            int max7 = horizontalMax(texels);
+            int min5 = horizontalMin(_mm_or_si128(texels, _mm_cmpeq_epi8(texels, _mm_setzero_si128())));
+            int max5 = horizontalMax(_mm_andnot_si128(_mm_cmpeq_epi8(texels, _mm_set1_epi8(-1)), texels));
+            if (min5 > max5) min5 = max5;
+            if (min7 > max7) min7 = max7;
+            FixRange(min5, max5, 5);
+            FixRange(min7, max7, 7);
+
+            uint8_t codes5[8], codes7[8];
+            makeCodes5(min5, max5, codes5);
+            makeCodes7(min7, max7, codes7);
+            Fit fit5 = fitCodes(texels, codes5);
+            Fit fit7 = fitCodes(texels, codes7);
+
+            if (fit5.error <= fit7.error)
+            {
+                if (pError) *pError = fit5.error;
+                return packBlock5(min5, max5, fit5.indices);
+            }
+            if (pError) *pError = fit7.error;
+            return packBlock7(min7, max7, fit7.indices);
+        }
+
+        static uint64_t encodeExhaustive(__m128i texels)
+        {
+            uint32_t bestError = 0;
+            uint64_t bestBlock = encodeReference(texels, &bestError);
+            if (bestError == 0) return bestBlock;
+
+            int min7 = horizontalMin(texels);
+            int max7 = horizontalMax(texels);
+            int min5 = horizontalMin(_mm_or_si128(texels, _mm_cmpeq_epi8(texels, _mm_setzero_si128())));
+            int max5 = horizontalMax(_mm_andnot_si128(_mm_cmpeq_epi8(texels, _mm_set1_epi8(-1)), texels));
+            if (min5 > max5) min5 = max5;
+            FixRange(min5, max5, 5);
+            FixRange(min7, max7, 7);
+
+            // Search endpoint pairs in a window around the range-fit endpoints. The reference endpoints are inside the window.
+            uint8_t codes[8];
+            for (int lo = std::max(0, min5 - kExhaustiveRadius); lo <= std::min(255, min5 + kExhaustiveRadius); ++lo)
+            {
+                for (int hi = std::max(lo, max5 - kExhaustiveRadius); hi <= std::min(255, max5 + kExhaustiveRadius); ++hi)
+                {
+                    makeCodes5(lo, hi, codes);
+                    Fit fit = fitCodes(texels, codes);
+                    if (fit.error < bestError)
+                    {
+                        bestError = fit.error;
+                        bestBlock = packBlock5(lo, hi, fit.indices);
+                    }
+                }
+            }
+            for (int lo = std::max(0, min7 - kExhaustiveRadius); lo <= std::min(255, min7 + kExhaustiveRadius); ++lo)
+            {
+                for (int hi = std::max(lo + 1, max7 - kExhaustiveRadius); hi <= std::min(255, max7 + kExhaustiveRadius); ++hi)
+                {
+                    makeCodes7(lo, hi, codes);
+                    Fit fit = fitCodes(texels, codes);
+                    if (fit.error < bestError)
+                    {
+                        bestError = fit.error;
+                        bestBlock = packBlock7(lo, hi, fit.indices);
+                    }
+                }
+            }
+            return bestBlock;
+        }
+    };
+}
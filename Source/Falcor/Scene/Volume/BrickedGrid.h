@@ -35,4 +35,35 @@ namespace Falcor
         Texture::SharedPtr indirection;
         Texture::SharedPtr atlas;
     };
+
+    /** Brick data of a grid in CPU memory.
+        Conversion to bricks can run on any thread, the textures are created from this data later on the main thread.
+    */
+    struct BrickedGridData
+    {
+        uint3 leafDim = uint3(0);                       ///< Size of the range and indirection textures in bricks.
+        uint3 atlasSize = uint3(0);                     ///< Size of the atlas texture in texels.
+        ResourceFormat atlasFormat = ResourceFormat::Unknown;
+        std::vector<uint32_t> rangeData;                ///< Range texture data (RG16Float) including 4 mip levels.
+        std::vector<uint32_t> indirectionData;          ///< Indirection texture data (RGBA8Uint).
+        std::vector<uint8_t> atlasData;                 ///< Atlas texture data.
+
+        /** Get the size of the brick data in bytes.
+        */
+        uint64_t getSizeInBytes() const
+        {
+            return (rangeData.size() + indirectionData.size()) * sizeof(uint32_t) + atlasData.size();
+        }
+
+        /** Create the brick textures.
+        */
+        BrickedGrid createTextures() const
+        {
+            BrickedGrid bricks;
+            bricks.range = Texture::create3D(leafDim.x, leafDim.y, leafDim.z, ResourceFormat::RG16Float, 4, rangeData.data(), ResourceBindFlags::ShaderResource, false);
+            bricks.indirection = Texture::create3D(leafDim.x, leafDim.y, leafDim.z, ResourceFormat::RGBA8Uint, 1, indirectionData.data(), ResourceBindFlags::ShaderResource, false);
+            bricks.atlas = Texture::create3D(atlasSize.x, atlasSize.y, atlasSize.z, atlasFormat, 1, atlasData.data(), ResourceBindFlags::ShaderResource, false);
+            return bricks;
+        }
+    };
 }
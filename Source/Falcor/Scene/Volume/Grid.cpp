@@ -58,19 +58,19 @@ namespace Falcor
         }
     }
 
-    Grid::SharedPtr Grid::createSphere(float radius, float voxelSize, float blendRange)
+    Grid::SharedPtr Grid::createSphere(float radius, float voxelSize, float blendRange, bool createResources)
     {
         auto handle = nanovdb::createFogVolumeSphere(radius, nanovdb::Vec3R(0.0), voxelSize, blendRange);
-        return SharedPtr(new Grid(std::move(handle)));
+        return SharedPtr(new Grid(std::move(handle), createResources));
     }
 
-    Grid::SharedPtr Grid::createBox(float width, float height, float depth, float voxelSize, float blendRange)
+    Grid::SharedPtr Grid::createBox(float width, float height, float depth, float voxelSize, float blendRange, bool createResources)
     {
         auto handle = nanovdb::createFogVolumeBox(width, height, depth, nanovdb::Vec3R(0.0), voxelSize, blendRange);
-        return SharedPtr(new Grid(std::move(handle)));
+        return SharedPtr(new Grid(std::move(handle), createResources));
     }
 
-    Grid::SharedPtr Grid::createFromFile(const std::string& filename, const std::string& gridname)
+    Grid::SharedPtr Grid::createFromFile(const std::string& filename, const std::string& gridname, bool createResources)
     {
         std::string fullpath;
         if (!findFileInDataDirectories(filename, fullpath))
@@ -82,11 +82,11 @@ namespace Falcor
         auto ext = getExtensionFromFile(fullpath);
         if (ext == "nvdb")
         {
-            return createFromNanoVDBFile(fullpath, gridname);
+            return createFromNanoVDBFile(fullpath, gridname, createResources);
         }
         else if (ext == "vdb")
         {
-            return createFromOpenVDBFile(fullpath, gridname);
+            return createFromOpenVDBFile(fullpath, gridname, createResources);
         }
         else
         {
@@ -109,6 +109,8 @@ namespace Falcor
 
     void Grid::setShaderData(const ShaderVar& var)
     {
+        createResources();
+
         var["buf"] = mpBuffer;
         var["rangeTex"] = mBrickedGrid.range;
         var["indirectionTex"] = mBrickedGrid.indirection;
@@ -119,6 +121,22 @@ namespace Falcor
         var["maxValue"] = getMaxValue();
     }
 
+    void Grid::createResources()
+    {
+        if (hasResources()) return;
+
+        // Keep both NanoVDB and brick textures resident in GPU memory for simplicity for now (~15% increased footprint).
+        mpBuffer = Buffer::createStructured(
+            sizeof(uint32_t),
+            uint32_t(div_round_up(mGridHandle.size(), sizeof(uint32_t))),
+            ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource,
+            Buffer::CpuAccess::None,
+            mGridHandle.data()
+        );
+        mBrickedGrid = mBrickedGridData.createTextures();
+        mBrickedGridData = {};
+    }
+
     int3 Grid::getMinIndex() const
     {
         return cast(mpFloatGrid->indexBBox().min()) & (~7); // The volume texture path requires the index bounding box to fall on a brick boundary (multiple of 8).
@@ -146,6 +164,8 @@ namespace Falcor
 
     uint64_t Grid::getGridSizeInBytes() const
     {
+        if (!hasResources()) return mGridHandle.size() + mBrickedGridData.getSizeInBytes();
+
         const uint64_t nvdb = mpBuffer ? mpBuffer->getSize() : (uint64_t)0;
         const uint64_t bricks = (mBrickedGrid.range ? mBrickedGrid.range->getTextureSizeInBytes() : (uint64_t)0) +
             (mBrickedGrid.indirection ? mBrickedGrid.indirection->getTextureSizeInBytes() : (uint64_t)0) +
@@ -185,7 +205,7 @@ namespace Falcor
         return glm::translate(float4x4(invAffine), -translation);
     }
 
-    Grid::Grid(nanovdb::GridHandle<nanovdb::HostBuffer> gridHandle)
+    Grid::Grid(nanovdb::GridHandle<nanovdb::HostBuffer> gridHandle, bool createResources)
         : mGridHandle(std::move(gridHandle))
         , mpFloatGrid(mGridHandle.grid<float>())
         , mAccessor(mpFloatGrid->getAccessor())
@@ -195,19 +215,22 @@ namespace Falcor
             nanovdb::gridStats(*mpFloatGrid);
         }
 
-        // Keep both NanoVDB and brick textures resident in GPU memory for simplicity for now (~15% increased footprint).
-        mpBuffer = Buffer::createStructured(
-            sizeof(uint32_t),
-            uint32_t(div_round_up(mGridHandle.size(), sizeof(uint32_t))),
-            ResourceBindFlags::UnorderedAccess | ResourceBindFlags::ShaderResource,
-            Buffer::CpuAccess::None,
-            mGridHandle.data()
-        );
+        // The conversion to bricks only uses CPU memory. GPU resources are created separately so that grids can be loaded on worker threads.
         using NanoVDBGridConverter = NanoVDBConverterBC4;
-        mBrickedGrid = NanoVDBGridConverter(mpFloatGrid).convert();
+        mBrickedGridData = NanoVDBGridConverter(mpFloatGrid).convertToData();
+        if (createResources) this->createResources();
+    }
+
+    Grid::Grid(nanovdb::GridHandle<nanovdb::HostBuffer> gridHandle, BrickedGridData brickedGridData, bool createResources)
+        : mGridHandle(std::move(gridHandle))
+        , mpFloatGrid(mGridHandle.grid<float>())
+        , mAccessor(mpFloatGrid->getAccessor())
+        , mBrickedGridData(std::move(brickedGridData))
+    {
+        if (createResources) this->createResources();
     }
 
-    Grid::SharedPtr Grid::createFromNanoVDBFile(const std::string& path, const std::string& gridname)
+    Grid::SharedPtr Grid::createFromNanoVDBFile(const std::string& path, const std::string& gridname, bool createResources)
     {
         if (!nanovdb::io::hasGrid(path, gridname))
         {
@@ -235,10 +258,10 @@ namespace Falcor
             return nullptr;
         }
 
-        return SharedPtr(new Grid(std::move(handle)));
+        return SharedPtr(new Grid(std::move(handle), createResources));
     }
 
-    Grid::SharedPtr Grid::createFromOpenVDBFile(const std::string& path, const std::string& gridname)
+    Grid::SharedPtr Grid::createFromOpenVDBFile(const std::string& path, const std::string& gridname, bool createResources)
     {
         openvdb::initialize();
 
@@ -278,7 +301,7 @@ namespace Falcor
         openvdb::FloatGrid::Ptr floatGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(baseGrid);
         auto handle = nanovdb::openToNanoVDB(floatGrid);
 
-        return SharedPtr(new Grid(std::move(handle)));
+        return SharedPtr(new Grid(std::move(handle), createResources));
     }
 
 
@@ -293,8 +316,8 @@ namespace Falcor
 
         grid.def("getValue", &Grid::getValue, "ijk"_a);
 
-        grid.def_static("createSphere", &Grid::createSphere, "radius"_a, "voxelSize"_a, "blendRange"_a = 3.f);
-        grid.def_static("createBox", &Grid::createBox, "width"_a, "height"_a, "depth"_a, "voxelSize"_a, "blendRange"_a = 3.f);
-        grid.def_static("createFromFile", &Grid::createFromFile, "filename"_a, "gridname"_a);
+        grid.def_static("createSphere", &Grid::createSphere, "radius"_a, "voxelSize"_a, "blendRange"_a = 3.f, "createResources"_a = true);
+        grid.def_static("createBox", &Grid::createBox, "width"_a, "height"_a, "depth"_a, "voxelSize"_a, "blendRange"_a = 3.f, "createResources"_a = true);
+        grid.def_static("createFromFile", &Grid::createFromFile, "filename"_a, "gridname"_a, "createResources"_a = true);
     }
 }
@@ -45,9 +45,10 @@ namespace Falcor
             \param[in] radius Radius of the sphere in world units.
             \param[in] voxelSize Size of a voxel in world units.
             \param[in] blendRange Range in voxels to blend from 0 to 1 (starting at surface inwards).
+            \param[in] createResources If false, GPU resources are created later by createResources(). This allows creating the grid on a worker thread.
             \return A new grid.
         */
-        static SharedPtr createSphere(float radius, float voxelSize, float blendRange = 2.f);
+        static SharedPtr createSphere(float radius, float voxelSize, float blendRange = 2.f, bool createResources = true);
 
         /** Create a box voxel grid.
             \param[in] width Width of the box in world units.
@@ -55,27 +56,39 @@ namespace Falcor
             \param[in] depth Depth of the box in world units.
             \param[in] voxelSize Size of a voxel in world units.
             \param[in] blendRange Range in voxels to blend from 0 to 1 (starting at surface inwards).
+            \param[in] createResources If false, GPU resources are created later by createResources(). This allows creating the grid on a worker thread.
             \return A new grid.
         */
-        static SharedPtr createBox(float width, float height, float depth, float voxelSize, float blendRange = 2.f);
+        static SharedPtr createBox(float width, float height, float depth, float voxelSize, float blendRange = 2.f, bool createResources = true);
 
         /** Create a grid from a file.
             Currently only OpenVDB and NanoVDB grids of type float are supported.
             \param[in] filename Filename of the grid. Can also include a full path or relative path from a data directory.
             \param[in] gridname Name of the grid to load.
+            \param[in] createResources If false, GPU resources are created later by createResources(). This allows loading the grid on a worker thread.
             \return A new grid, or nullptr if the grid failed to load.
         */
-        static SharedPtr createFromFile(const std::string& filename, const std::string& gridname);
+        static SharedPtr createFromFile(const std::string& filename, const std::string& gridname, bool createResources = true);
 
         /** Render the UI.
         */
         void renderUI(Gui::Widgets& widget);
 
         /** Bind the grid to a given shader var.
+            Creates the GPU resources first if they have not been created yet.
             \param[in] var The shader variable to set the data into.
         */
         void setShaderData(const ShaderVar& var);
 
+        /** Create the GPU resources (NanoVDB buffer and brick textures) if they have not been created yet.
+            Must be called from the main thread.
+        */
+        void createResources();
+
+        /** Check if the GPU resources have been created.
+        */
+        bool hasResources() const { return mpBuffer != nullptr; }
+
         /** Get the minimum index stored in the grid.
         */
         int3 getMinIndex() const;
@@ -97,6 +110,7 @@ namespace Falcor
         uint64_t getVoxelCount() const;
 
         /** Get the size of the grid in bytes as allocated in GPU memory.
+            If the GPU resources have not been created yet, this returns the size they will use.
         */
         uint64_t getGridSizeInBytes() const;
 
@@ -110,6 +124,10 @@ namespace Falcor
         */
         float getValue(const int3& ijk) const;
 
+        /** Get the brick data in CPU memory. Empty once the GPU resources have been created.
+        */
+        const BrickedGridData& getBrickedGridData() const { return mBrickedGridData; }
+
         /** Get the raw NanoVDB grid handle.
         */
         const nanovdb::GridHandle<nanovdb::HostBuffer>& getGridHandle() const;
@@ -123,10 +141,11 @@ namespace Falcor
         glm::mat4 getInvTransform() const;
 
     private:
-        Grid(nanovdb::GridHandle<nanovdb::HostBuffer> gridHandle);
+        Grid(nanovdb::GridHandle<nanovdb::HostBuffer> gridHandle, bool createResources);
+        Grid(nanovdb::GridHandle<nanovdb::HostBuffer> gridHandle, BrickedGridData brickedGridData, bool createResources);
 
-        static SharedPtr createFromNanoVDBFile(const std::string& path, const std::string& gridname);
-        static SharedPtr createFromOpenVDBFile(const std::string& path, const std::string& gridname);
+        static SharedPtr createFromNanoVDBFile(const std::string& path, const std::string& gridname, bool createResources);
+        static SharedPtr createFromOpenVDBFile(const std::string& path, const std::string& gridname, bool createResources);
 
         // Host data.
         nanovdb::GridHandle<nanovdb::HostBuffer> mGridHandle;
@@ -135,7 +154,9 @@ namespace Falcor
         // Device data.
         Buffer::SharedPtr mpBuffer;
         BrickedGrid mBrickedGrid;
+        BrickedGridData mBrickedGridData;   ///< Brick data waiting to be uploaded by createResources().
 
         friend class SceneCache;
+        friend class GridCache;
     };
 }
@@ -0,0 +1,366 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "GridCache.h"
+#include "Core/Platform/MemoryMappedFile.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Specifies the current cache file version.
+            This needs to be incremented every time the file format or the conversion of grids to bricks changes!
+        */
+        const uint32_t kVersion = 1;
+        const std::string kDirectory = "NVIDIA/Falcor/GridCache";
+        const size_t kBlockSize = 1 << 20;
+
+        /** Atlas format of the bricked grids created by Grid. Part of the cache key.
+        */
+        const ResourceFormat kAtlasFormat = ResourceFormat::BC4Unorm;
+
+        /** Alignment of the arrays in the cache file. Arrays start on a new page, so that touching
+            one array in the mapped file does not page in data of another.
+        */
+        const uint64_t kSectionAlignment = 4096;
+
+        const char* kMagic = "FalcorG$";
+
+        struct Section
+        {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        struct Header
+        {
+            uint8_t magic[8]{};
+            uint32_t version{};
+            ResourceFormat atlasFormat{};
+            uint3 leafDim{};
+            uint3 atlasSize{};
+            Section gridData;           ///< NanoVDB grid buffer.
+            Section rangeData;          ///< Range texture data (RG16Float) including 4 mip levels.
+            Section indirectionData;    ///< Indirection texture data (RGBA8Uint).
+            Section atlasData;          ///< Atlas texture data.
+
+            bool isValid() const
+            {
+                return std::memcmp(magic, kMagic, sizeof(Header::magic)) == 0 && version == kVersion && atlasFormat == kAtlasFormat;
+            }
+        };
+
+        std::string toHexString(const GridCache::Key& key)
+        {
+            std::stringstream ss;
+            ss << std::hex << std::setfill('0');
+            for (auto c : key) ss << std::setw(2) << (int)c;
+            return ss.str();
+        }
+
+        bool getFileStamp(const std::string& path, uint64_t& size, int64_t& writeTime)
+        {
+            std::error_code ec;
+            size = std::filesystem::file_size(path, ec);
+            if (ec) return false;
+            auto time = std::filesystem::last_write_time(path, ec);
+            if (ec) return false;
+            writeTime = (int64_t)time.time_since_epoch().count();
+            return true;
+        }
+    }
+
+    GridCache::SharedPtr GridCache::create(const Options& options)
+    {
+        return SharedPtr(new GridCache(options));
+    }
+
+    GridCache::GridCache(const Options& options)
+        : mOptions(options)
+    {
+        mDirectory = mOptions.directory.empty() ? std::filesystem::path(getAppDataDirectory()) / kDirectory : std::filesystem::path(mOptions.directory);
+    }
+
+    Grid::SharedPtr GridCache::loadGrid(const std::string& filename, const std::string& gridname, bool createResources) const
+    {
+        std::string fullPath;
+        if (!findFileInDataDirectories(filename, fullPath))
+        {
+            logWarning("Error when loading grid. Can't find grid file '" + filename + "'");
+            return nullptr;
+        }
+
+        auto key = findKey(fullPath, gridname);
+        if (!key) return Grid::createFromFile(fullPath, gridname, createResources);
+
+        if (hasGrid(*key))
+        {
+            try
+            {
+                return readGrid(*key, createResources);
+            }
+            catch (const std::exception& e)
+            {
+                logWarning("Failed to load grid '" + gridname + "' from '" + fullPath + "' through the grid cache: " + e.what());
+            }
+        }
+
+        // Convert the grid and add it to the cache before the brick data is moved to the GPU.
+        auto t0 = CpuTimer::getCurrentTimePoint();
+        auto pGrid = Grid::createFromFile(fullPath, gridname, false);
+        if (!pGrid) return nullptr;
+
+        try
+        {
+            writeGrid(*pGrid, *key);
+            logInfo("Added grid '" + gridname + "' from '" + fullPath + "' to the grid cache (" + std::to_string(CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint())) + " ms).");
+        }
+        catch (const std::exception& e)
+        {
+            logWarning("Failed to add grid '" + gridname + "' from '" + fullPath + "' to the grid cache: " + e.what());
+        }
+
+        if (createResources) pGrid->createResources();
+        return pGrid;
+    }
+
+    std::optional<GridCache::Key> GridCache::computeKey(const std::string& path, const std::string& gridname) const
+    {
+        std::ifstream fs(path, std::ios_base::binary);
+        if (!fs.good()) return {};
+
+        SHA1 sha1;
+        sha1.update(&kVersion, sizeof(kVersion));
+        sha1.update(&kAtlasFormat, sizeof(kAtlasFormat));
+        sha1.update(gridname.data(), gridname.size() + 1);
+
+        std::vector<char> buffer(kBlockSize);
+        while (fs)
+        {
+            fs.read(buffer.data(), buffer.size());
+            sha1.update(buffer.data(), (size_t)fs.gcount());
+        }
+        if (fs.bad()) return {};
+
+        return sha1.final();
+    }
+
+    std::filesystem::path GridCache::getCachePath(const Key& key) const
+    {
+        return mDirectory / (toHexString(key) + ".grid");
+    }
+
+    bool GridCache::hasGrid(const Key& key) const
+    {
+        std::error_code ec;
+        return std::filesystem::exists(getCachePath(key), ec);
+    }
+
+    void GridCache::clear() const
+    {
+        std::error_code ec;
+        uint32_t removedCount = 0;
+        for (const auto& entry : std::filesystem::directory_iterator(mDirectory, ec))
+        {
+            const auto extension = entry.path().extension();
+            if (extension != ".grid" && extension != ".ref") continue;
+            if (std::filesystem::remove(entry.path(), ec)) removedCount++;
+            else logWarning("Failed to remove grid cache file '" + entry.path().string() + "'");
+        }
+        logInfo("Removed " + std::to_string(removedCount) + " files from the grid cache.");
+    }
+
+    std::optional<GridCache::Key> GridCache::findKey(const std::string& path, const std::string& gridname) const
+    {
+        uint64_t size = 0;
+        int64_t writeTime = 0;
+        if (!getFileStamp(path, size, writeTime)) return {};
+
+        SHA1 sha1;
+        sha1.update(&kVersion, sizeof(kVersion));
+        sha1.update(path.data(), path.size() + 1);
+        sha1.update(gridname.data(), gridname.size() + 1);
+        sha1.update(&size, sizeof(size));
+        sha1.update(&writeTime, sizeof(writeTime));
+        const auto refPath = mDirectory / (toHexString(sha1.final()) + ".ref");
+
+        {
+            std::ifstream fs(refPath, std::ios_base::binary);
+            Key key;
+            if (fs.read(reinterpret_cast<char*>(key.data()), key.size())) return key;
+        }
+
+        auto key = computeKey(path, gridname);
+        if (!key) return {};
+
+        try
+        {
+            writeFile(refPath, [&key](std::ostream& fs) { fs.write(reinterpret_cast<const char*>(key->data()), key->size()); });
+        }
+        catch (const std::exception& e)
+        {
+            logWarning("Failed to write grid cache reference file for '" + path + "': " + e.what());
+        }
+
+        return key;
+    }
+
+    Grid::SharedPtr GridCache::readGrid(const Key& key, bool createResources) const
+    {
+        const auto cachePath = getCachePath(key);
+        auto pFile = MemoryMappedFile::create(cachePath.string());
+        if (!pFile) throw std::exception(("Failed to map cache file '" + cachePath.string() + "'").c_str());
+
+        Header header;
+        auto invalid = [&cachePath]() { return std::exception(("Invalid cache file '" + cachePath.string() + "'").c_str()); };
+        if (pFile->getSize() < sizeof(Header)) throw invalid();
+        std::memcpy(&header, pFile->getData(), sizeof(Header));
+        if (!header.isValid()) throw invalid();
+
+        auto getSection = [&](const Section& section)
+        {
+            if (section.offset > pFile->getSize() || section.size > pFile->getSize() - section.offset) throw invalid();
+            return pFile->getData() + section.offset;
+        };
+
+        const uint64_t leafCount = (uint64_t)header.leafDim.x * header.leafDim.y * header.leafDim.z;
+        const uint64_t atlasSize = (uint64_t)(header.atlasSize.x / getFormatWidthCompressionRatio(header.atlasFormat)) *
+            (header.atlasSize.y / getFormatHeightCompressionRatio(header.atlasFormat)) * header.atlasSize.z * getFormatBytesPerBlock(header.atlasFormat);
+        if (header.rangeData.size % sizeof(uint32_t) != 0 || header.indirectionData.size != leafCount * sizeof(uint32_t) || header.atlasData.size != atlasSize) throw invalid();
+
+        const uint8_t* pGridData = getSection(header.gridData);
+        const uint8_t* pRangeData = getSection(header.rangeData);
+        const uint8_t* pIndirectionData = getSection(header.indirectionData);
+        const uint8_t* pAtlasData = getSection(header.atlasData);
+
+        auto buffer = nanovdb::HostBuffer::create(header.gridData.size);
+        std::memcpy(buffer.data(), pGridData, header.gridData.size);
+        nanovdb::GridHandle<nanovdb::HostBuffer> handle(std::move(buffer));
+        if (!handle.grid<float>()) throw std::exception(("Invalid grid in cache file '" + cachePath.string() + "'").c_str());
+
+        BrickedGridData data;
+        data.leafDim = header.leafDim;
+        data.atlasSize = header.atlasSize;
+        data.atlasFormat = header.atlasFormat;
+        data.rangeData.assign(reinterpret_cast<const uint32_t*>(pRangeData), reinterpret_cast<const uint32_t*>(pRangeData + header.rangeData.size));
+        data.indirectionData.assign(reinterpret_cast<const uint32_t*>(pIndirectionData), reinterpret_cast<const uint32_t*>(pIndirectionData + header.indirectionData.size));
+        data.atlasData.assign(pAtlasData, pAtlasData + header.atlasData.size);
+
+        return Grid::SharedPtr(new Grid(std::move(handle), std::move(data), createResources));
+    }
+
+    void GridCache::writeGrid(const Grid& grid, const Key& key) const
+    {
+        if (grid.hasResources()) throw std::exception("Grid data has already been uploaded");
+
+        const nanovdb::HostBuffer& buffer = grid.mGridHandle.buffer();
+        const BrickedGridData& data = grid.mBrickedGridData;
+
+        Header header;
+        std::memcpy(header.magic, kMagic, sizeof(Header::magic));
+        header.version = kVersion;
+        header.atlasFormat = data.atlasFormat;
+        header.leafDim = data.leafDim;
+        header.atlasSize = data.atlasSize;
+
+        uint64_t offset = sizeof(Header);
+        auto addSection = [&offset](uint64_t size)
+        {
+            offset = align_to(kSectionAlignment, offset);
+            Section section = { offset, size };
+            offset += size;
+            return section;
+        };
+        header.gridData = addSection(buffer.size());
+        header.rangeData = addSection(data.rangeData.size() * sizeof(uint32_t));
+        header.indirectionData = addSection(data.indirectionData.size() * sizeof(uint32_t));
+        header.atlasData = addSection(data.atlasData.size());
+
+        writeFile(getCachePath(key), [&](std::ostream& fs)
+        {
+            auto writeSection = [&fs](const Section& section, const void* pData)
+            {
+                std::vector<char> padding(section.offset - (uint64_t)fs.tellp(), 0);
+                fs.write(padding.data(), padding.size());
+                fs.write(reinterpret_cast<const char*>(pData), section.size);
+            };
+            fs.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+            writeSection(header.gridData, buffer.data());
+            writeSection(header.rangeData, data.rangeData.data());
+            writeSection(header.indirectionData, data.indirectionData.data());
+            writeSection(header.atlasData, data.atlasData.data());
+        });
+    }
+
+    void GridCache::writeFile(const std::filesystem::path& path, const std::function<void(std::ostream&)>& writeFunc) const
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(mDirectory, ec);
+
+        std::stringstream ss;
+        ss << path.stem().string() << "." << std::this_thread::get_id() << ".tmp";
+        const auto tempPath = mDirectory / ss.str();
+        {
+            std::ofstream fs(tempPath, std::ios_base::binary);
+            if (!fs.good()) throw std::exception(("Failed to create file '" + tempPath.string() + "'").c_str());
+            writeFunc(fs);
+            if (!fs.good())
+            {
+                fs.close();
+                std::filesystem::remove(tempPath, ec);
+                throw std::exception(("Failed to write file '" + tempPath.string() + "'").c_str());
+            }
+        }
+
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+            if (!std::filesystem::exists(path, ec)) throw std::exception(("Failed to write cache file '" + path.string() + "'").c_str());
+        }
+    }
+
+    SCRIPT_BINDING(GridCache)
+    {
+        SCRIPT_BINDING_DEPENDENCY(Grid)
+
+        pybind11::class_<GridCache, GridCache::SharedPtr> gridCache(m, "GridCache");
+        auto create = [](const std::string& directory)
+        {
+            GridCache::Options options;
+            options.directory = directory;
+            return GridCache::create(options);
+        };
+        gridCache.def(pybind11::init(create), "directory"_a = "");
+        gridCache.def("loadGrid", &GridCache::loadGrid, "filename"_a, "gridname"_a, "createResources"_a = true);
+        gridCache.def("clear", &GridCache::clear);
+    }
+}
@@ -0,0 +1,122 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include "Grid.h"
+#include "Utils/CryptoUtils.h"
+#include <filesystem>
+
+namespace Falcor
+{
+    /** Persistent cache of converted grids.
+
+        Loading a grid from an OpenVDB file parses the file, converts it to NanoVDB and converts the NanoVDB grid
+        to bricks (including the BC4 encoding of the atlas). The cache stores the result of all these steps: the
+        NanoVDB buffer and the range, indirection and atlas data of the bricked grid. Each array is stored
+        uncompressed in the layout it is uploaded in and starts on a page boundary. Cache files are memory-mapped
+        when loading, so a cached grid is loaded with a few copies and no conversion.
+
+        Cache entries are keyed by a hash of the file content, the grid name and the conversion settings, so copies
+        of the same file share an entry and modified files get a new one. To avoid hashing the file content on every
+        load, the content key of a file is looked up through a small reference file keyed by the path, size and last
+        write time of the file. Old entries are never evicted, so the cache directory grows with every converted grid
+        and every modified version of a file until it is emptied with clear().
+    */
+    class dlldecl GridCache
+    {
+    public:
+        using SharedPtr = std::shared_ptr<GridCache>;
+        using Key = SHA1::MD;
+
+        struct Options
+        {
+            std::string directory;      ///< Cache directory. If empty, a directory in the application data directory is used.
+        };
+
+        /** Create a grid cache.
+            \param[in] options Cache options.
+            \return A new object.
+        */
+        static SharedPtr create(const Options& options = Options());
+
+        /** Load a grid through the cache. This function is thread-safe if createResources is false.
+            If the grid is not cached yet, it is loaded with Grid::createFromFile() and added to the cache first.
+            If the cache entry cannot be read or written, the grid is loaded without the cache.
+            \param[in] filename Filename of the grid. Can also include a full path or relative path from a data directory.
+            \param[in] gridname Name of the grid to load.
+            \param[in] createResources If false, GPU resources are created later by Grid::createResources(). This allows loading the grid on a worker thread.
+            \return A new grid, or nullptr if the grid failed to load.
+        */
+        Grid::SharedPtr loadGrid(const std::string& filename, const std::string& gridname, bool createResources = true) const;
+
+        /** Compute the cache key for a grid. This reads the whole file.
+            \param[in] path Absolute path of the grid file.
+            \param[in] gridname Name of the grid.
+            \return The cache key, or an empty optional if the file could not be read.
+        */
+        std::optional<Key> computeKey(const std::string& path, const std::string& gridname) const;
+
+        /** Get the path of the cache file for a given key.
+        */
+        std::filesystem::path getCachePath(const Key& key) const;
+
+        /** Check if a grid is cached.
+        */
+        bool hasGrid(const Key& key) const;
+
+        /** Remove all cached grids and reference files from the cache directory.
+            Grids that are already loaded are not affected.
+        */
+        void clear() const;
+
+        const Options& getOptions() const { return mOptions; }
+
+    private:
+        GridCache(const Options& options);
+
+        /** Find the cache key of a grid file. Uses the reference file of the file stamp if it exists, otherwise hashes the file and writes the reference file.
+            \return The cache key, or an empty optional if the file could not be read.
+        */
+        std::optional<Key> findKey(const std::string& path, const std::string& gridname) const;
+
+        /** Read a grid from its cache file. Throws an exception if the file is invalid.
+        */
+        Grid::SharedPtr readGrid(const Key& key, bool createResources) const;
+
+        /** Write a grid to its cache file. The grid must not have created its GPU resources yet.
+            Throws an exception if the file cannot be written.
+        */
+        void writeGrid(const Grid& grid, const Key& key) const;
+
+        /** Write a file by writing a temporary file first and renaming it, so that concurrent loads never see a partially written file.
+        */
+        void writeFile(const std::filesystem::path& path, const std::function<void(std::ostream&)>& writeFunc) const;
+
+        Options mOptions;
+        std::filesystem::path mDirectory;
+    };
+}
@@ -26,12 +26,11 @@
  # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************/
 #pragma once
-#include <execution>
 #pragma warning(disable:4244 4267)
 #include <nanovdb/NanoVDB.h>
 #pragma warning(default:4244 4267)
 #include "BC4Encode.h"
-#include "Utils/NumericRange.h"
+#include "Utils/Threading.h"
 #include "BrickedGrid.h"
 
 namespace Falcor
@@ -47,15 +46,40 @@ namespace Falcor
     public:
         NanoVDBToBricksConverter(const nanovdb::FloatGrid* grid);
         NanoVDBToBricksConverter(const NanoVDBToBricksConverter& rhs) = delete;
-        
+
+        /** Convert the grid to bricks and create the brick textures.
+        */
         BrickedGrid convert();
 
+        /** Convert the grid to bricks in CPU memory. Does not create GPU resources, so it can run on any thread.
+            \param[in] sparse If true, only the leaves of the grid are visited and the brick halos are read directly from the neighbouring leaves.
+                If false, every brick in the bounding box is visited and the halos are read through an accessor (reference implementation).
+            \return The brick data.
+        */
+        BrickedGridData convertToData(bool sparse = true);
+
+        /** Get the number of non-empty bricks stored in the atlas. Valid after conversion.
+        */
+        uint32_t getBrickCount() const { return mNonEmptyCount.load(); }
+
+        /** Get the peak amount of CPU memory used by the conversion in bytes, excluding the source grid. Valid after conversion.
+        */
+        uint64_t getPeakMemoryUsage() const { return mPeakMemoryUsage; }
+
     private:
+        using LeafT = nanovdb::NanoLeaf<float>;
+
         const static uint kBrickSize = 8; // Must be 8, to match both NanoVDB leaf size.
         const static int kBC4Compress = kBitsPerTexel == 4;
+        const static uint32_t kLeavesPerChunk = 64;
 
         void convertSlice(int z);
+        void fillSlice(int z);
+        void convertLeaves();
+        float2 computeLeafMajMin(const LeafT* leaf, nanovdb::FloatGrid::AccessorType& a) const;
         void computeMip(int mip);
+        void computeMipSlice(int mip, int z);
+        uint32_t writeBrick(const float* data, float minorant, float majorant, uint32_t brick, uint32_t& range);
 
         inline uint3 getAtlasSizeBricks() const { return mAtlasSizeBricks; }
         inline uint3 getAtlasSizePixels() const { return mAtlasSizeBricks * kBrickSize; }
@@ -81,7 +105,7 @@ namespace Falcor
             return float2(f16tof32(data16[0]), f16tof32(data16[1]));
         }
 
-        inline void expandMinorantMajorant(float value, float& min_inout, float& maj_inout)
+        inline void expandMinorantMajorant(float value, float& min_inout, float& maj_inout) const
         {
             if (value < min_inout) min_inout = value;
             if (value > maj_inout) maj_inout = value;
@@ -94,8 +118,9 @@ namespace Falcor
         uint32_t mLeafCount[4];
         std::vector<uint32_t> mRangeData;
         std::vector<uint32_t> mPtrData;
-        std::vector<TexelType> mAtlasData;
+        std::vector<uint8_t> mAtlasData;    ///< Atlas texels of type TexelType. Stored as bytes so it can be moved to BrickedGridData without a copy.
         std::atomic_uint32_t mNonEmptyCount;
+        uint64_t mPeakMemoryUsage = 0;
     };
 
     template <typename TexelType, unsigned int kBitsPerTexel>
@@ -121,17 +146,88 @@ namespace Falcor
         uint leafTexelCount = atlasSizePixels.x * atlasSizePixels.y * atlasSizePixels.z;
         mRangeData.resize(mLeafCount[3]);
         mPtrData.resize(mLeafCount[0]);
-        mAtlasData.resize(kBC4Compress ? (leafTexelCount / 16) : leafTexelCount);
+        mAtlasData.resize((kBC4Compress ? (leafTexelCount / 16) : leafTexelCount) * sizeof(TexelType));
+        mPeakMemoryUsage = (mRangeData.size() + mPtrData.size()) * sizeof(uint32_t) + mAtlasData.size();
     }
 
     template <typename TexelType, unsigned int kBitsPerTexel>
-    void NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::convertSlice(int z)
+    uint32_t NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::writeBrick(const float* data, float minorant, float majorant, uint32_t brick, uint32_t& range)
     {
         uint3 atlasSizePixels = getAtlasSizePixels();
-        uint brickMax = getAtlasMaxBrick();
         uint bricksPerSlice = mAtlasSizeBricks.x * mAtlasSizeBricks.y;
         uint pixelsPerSlice = atlasSizePixels.x * atlasSizePixels.y;
 
+        majorant = f16tof32(f32tof16(majorant) + 1);
+        minorant = f16tof32(f32tof16(minorant));
+        range = f32tof16(majorant) + (f32tof16(minorant) << 16);
+        uint32_t atlasx = brick % mAtlasSizeBricks.x;
+        uint32_t atlasy = (brick / mAtlasSizeBricks.x) % mAtlasSizeBricks.y;
+        uint32_t atlasz = brick / bricksPerSlice;
+
+        if (!kBC4Compress) {
+            float invRange = ((1 << kBitsPerTexel) - 1.f) / (majorant - minorant);
+            TexelType* atlasdst = (TexelType*)mAtlasData.data() + atlasx * kBrickSize + atlasy * (atlasSizePixels.x * kBrickSize) + atlasz * (pixelsPerSlice * kBrickSize);
+            for (int pixz = 0; pixz < kBrickSize; ++pixz)
+            {
+                for (int pixy = 0; pixy < kBrickSize; ++pixy)
+                {
+                    for (int pixx = 0; pixx < kBrickSize; ++pixx)
+                    {
+                        float f = data[pixx * kBrickSize * kBrickSize + pixy * kBrickSize + pixz];
+                        *atlasdst++ = TexelType((f - minorant) * invRange);
+                    }
+                    atlasdst += (atlasSizePixels.x - kBrickSize); // next scanline
+                }
+                atlasdst += (pixelsPerSlice - (atlasSizePixels.x * kBrickSize)); // next slice
+            }
+        }
+        else {
+            // BC4 compression: gather the 4x4 tiles of the brick (2x2 per slice) and encode them in one batch.
+            const uint32_t kTilesPerSlice = (kBrickSize / 4) * (kBrickSize / 4);
+            uint8_t tilevals[kBrickSize * kTilesPerSlice][4][4];
+            uint64_t blocks[kBrickSize * kTilesPerSlice];
+            float invRange = (255.f) / (majorant - minorant);
+            for (int pixz = 0; pixz < kBrickSize; ++pixz)
+            {
+                for (int tiley = 0; tiley < kBrickSize; tiley += 4)
+                {
+                    for (int tilex = 0; tilex < kBrickSize; tilex += 4)
+                    {
+                        auto& tile = tilevals[pixz * kTilesPerSlice + (tiley / 4) * (kBrickSize / 4) + tilex / 4];
+                        for (int pixy = 0; pixy < 4; ++pixy)
+                        {
+                            for (int pixx = 0; pixx < 4; ++pixx)
+                            {
+                                float f = data[(pixx + tilex) * (kBrickSize * kBrickSize) + (pixy + tiley) * kBrickSize + pixz];
+                                tile[pixy][pixx] = uint8_t((f - minorant) * invRange);
+                            }
+                        }
+                    }
+                }
+            }
+            BC4Encoder::encode(&tilevals[0][0][0], blocks, kBrickSize * kTilesPerSlice, BC4Encoder::Quality::Reference);
+
+            const uint64_t* src = blocks;
+            uint64_t* atlasdst = ((uint64_t*)mAtlasData.data() + atlasx * (kBrickSize / 4) + atlasy * ((atlasSizePixels.x / 4) * kBrickSize / 4) + atlasz * (pixelsPerSlice / 16 * kBrickSize));
+            for (int pixz = 0; pixz < kBrickSize; ++pixz)
+            {
+                for (int tiley = 0; tiley < kBrickSize; tiley += 4)
+                {
+                    for (int tilex = 0; tilex < kBrickSize; tilex += 4) *atlasdst++ = *src++;
+                    atlasdst += (atlasSizePixels.x / 4 - kBrickSize / 4); // next scanline
+                }
+                atlasdst += (pixelsPerSlice / 16 - (atlasSizePixels.x / 4 * kBrickSize / 4)); // next slice
+            } // z slice loop
+        } // bc4 compress?
+
+        return (atlasx + (atlasy << 8) + (atlasz << 16));
+    }
+
+    template <typename TexelType, unsigned int kBitsPerTexel>
+    void NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::convertSlice(int z)
+    {
+        uint brickMax = getAtlasMaxBrick();
+
         size_t offset = z * mLeafDim[0].x * mLeafDim[0].y;
         uint32_t* rangedst = mRangeData.data() + offset;
         uint32_t* ptrdst = mPtrData.data() + offset;
@@ -151,16 +247,16 @@ namespace Falcor
                     const float* data = leaf->voxels();
                     for (int i = 0; i < kBrickSize * kBrickSize * kBrickSize; ++i) expandMinorantMajorant(data[i], minorant, majorant);
                     // We also need the 1-halo from neighbouring bricks. Fetch them in an order that maximises nanovdb's internal cache reuse.
-                    for (int j = -1; j <= kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(i, j, -1)), minorant, majorant);
-                    for (int j = -1; j <= kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(i, j, kBrickSize)), minorant, majorant);
+                    for (int j = -1; j <= (int)kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(i, j, -1)), minorant, majorant);
+                    for (int j = -1; j <= (int)kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(i, j, kBrickSize)), minorant, majorant);
                     for (int j = 0; j < kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(i, -1, j)), minorant, majorant);
                     for (int j = 0; j < kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(i, kBrickSize, j)), minorant, majorant);
-                    for (int j = -1; j <= kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(-1, j, i)), minorant, majorant);
-                    for (int j = -1; j <= kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(kBrickSize, j, i)), minorant, majorant);
-                    for (int j = -1; j <= kBrickSize; ++j) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(-1, j, -1)), minorant, majorant);
-                    for (int j = -1; j <= kBrickSize; ++j) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(kBrickSize, j, -1)), minorant, majorant);
-                    for (int j = -1; j <= kBrickSize; ++j) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(-1, j, kBrickSize)), minorant, majorant);
-                    for (int j = -1; j <= kBrickSize; ++j) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(kBrickSize, j, kBrickSize)), minorant, majorant);
+                    for (int j = -1; j <= (int)kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(-1, j, i)), minorant, majorant);
+                    for (int j = -1; j <= (int)kBrickSize; ++j) for (int i = 0; i < kBrickSize; ++i) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(kBrickSize, j, i)), minorant, majorant);
+                    for (int j = -1; j <= (int)kBrickSize; ++j) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(-1, j, -1)), minorant, majorant);
+                    for (int j = -1; j <= (int)kBrickSize; ++j) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(kBrickSize, j, -1)), minorant, majorant);
+                    for (int j = -1; j <= (int)kBrickSize; ++j) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(-1, j, kBrickSize)), minorant, majorant);
+                    for (int j = -1; j <= (int)kBrickSize; ++j) expandMinorantMajorant(a.getValue(ijk + nanovdb::Coord(kBrickSize, j, kBrickSize)), minorant, majorant);
 
                     if (minorant != majorant) myleaf = mNonEmptyCount.fetch_add(1);
                 }
@@ -171,72 +267,150 @@ namespace Falcor
                 }
                 else
                 {
-                    const float* data = leaf->voxels();
-                    majorant = f16tof32(f32tof16(majorant) + 1);
-                    minorant = f16tof32(f32tof16(minorant));
-                    *rangedst++ = f32tof16(majorant) + (f32tof16(minorant) << 16);
-                    uint32_t atlasx = myleaf % mAtlasSizeBricks.x;
-                    uint32_t atlasy = (myleaf / mAtlasSizeBricks.x) % mAtlasSizeBricks.y;
-                    uint32_t atlasz = myleaf / bricksPerSlice;
-                    *ptrdst++ = (atlasx + (atlasy << 8) + (atlasz << 16));
-
-                    if (!kBC4Compress) {
-                        float invRange = ((1 << kBitsPerTexel) - 1.f) / (majorant - minorant);
-                        TexelType* atlasdst = (TexelType*)mAtlasData.data() + atlasx * kBrickSize + atlasy * (atlasSizePixels.x * kBrickSize) + atlasz * (pixelsPerSlice * kBrickSize);
-                        for (int pixz = 0; pixz < kBrickSize; ++pixz)
+                    *ptrdst++ = writeBrick(leaf->voxels(), minorant, majorant, myleaf, *rangedst++);
+                }
+            } // x brick loop
+        } // y brick loop
+    }
+
+    template <typename TexelType, unsigned int kBitsPerTexel>
+    void NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::fillSlice(int z)
+    {
+        // Bricks without a leaf are constant. The value is stored in the parent node as a tile (or is the background value).
+        size_t offset = z * mLeafDim[0].x * mLeafDim[0].y;
+        uint32_t* rangedst = mRangeData.data() + offset;
+        uint32_t* ptrdst = mPtrData.data() + offset;
+        auto a = mpFloatGrid->getAccessor();
+        for (int y = 0; y < mLeafDim[0].y; ++y)
+        {
+            for (int x = 0; x < mLeafDim[0].x; ++x)
+            {
+                float val = a.getValue(nanovdb::Coord(x * 8 + mBBMin.x, y * 8 + mBBMin.y, z * 8 + mBBMin.z));
+                *rangedst++ = f32tof16(val) + (f32tof16(val) << 16);
+                *ptrdst++ = 0;
+            }
+        }
+    }
+
+    template <typename TexelType, unsigned int kBitsPerTexel>
+    float2 NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::computeLeafMajMin(const LeafT* leaf, nanovdb::FloatGrid::AccessorType& a) const
+    {
+        const float* data = leaf->voxels();
+        float minorant = data[0], majorant = data[0];
+        for (int i = 0; i < kBrickSize * kBrickSize * kBrickSize; ++i) expandMinorantMajorant(data[i], minorant, majorant);
+
+        // The 1-halo is read from the 26 neighbouring leaves. Neighbours without a leaf are constant tiles.
+        const nanovdb::Coord origin = leaf->origin();
+        for (int dz = -1; dz <= 1; ++dz)
+        {
+            for (int dy = -1; dy <= 1; ++dy)
+            {
+                for (int dx = -1; dx <= 1; ++dx)
+                {
+                    if (dx == 0 && dy == 0 && dz == 0) continue;
+
+                    const nanovdb::Coord neighbourOrigin = origin + nanovdb::Coord(dx * kBrickSize, dy * kBrickSize, dz * kBrickSize);
+                    const LeafT* neighbour = a.probeLeaf(neighbourOrigin);
+                    if (!neighbour)
+                    {
+                        expandMinorantMajorant(a.getValue(neighbourOrigin), minorant, majorant);
+                        continue;
+                    }
+
+                    // Voxel range of the neighbour that borders this leaf along each axis.
+                    auto first = [](int d) { return d < 0 ? int(kBrickSize) - 1 : 0; };
+                    auto last = [](int d) { return d > 0 ? 0 : int(kBrickSize) - 1; };
+                    const float* neighbourData = neighbour->voxels();
+                    for (int x = first(dx); x <= last(dx); ++x)
+                    {
+                        for (int y = first(dy); y <= last(dy); ++y)
                         {
-                            for (int pixy = 0; pixy < kBrickSize; ++pixy)
-                            {
-                                for (int pixx = 0; pixx < kBrickSize; ++pixx)
-                                {
-                                    float f = data[pixx * kBrickSize * kBrickSize + pixy * kBrickSize + pixz];
-                                    *atlasdst++ = TexelType((f - minorant) * invRange);
-                                }
-                                atlasdst += (atlasSizePixels.x - kBrickSize); // next scanline
-                            }
-                            atlasdst += (pixelsPerSlice - (atlasSizePixels.x * kBrickSize)); // next slice
+                            const float* row = neighbourData + x * kBrickSize * kBrickSize + y * kBrickSize;
+                            for (int z = first(dz); z <= last(dz); ++z) expandMinorantMajorant(row[z], minorant, majorant);
                         }
                     }
-                    else {
-                        // BC4 compression:
-                        float invRange = (255.f) / (majorant - minorant);
-                        uint64_t* atlasdst = ((uint64_t*)mAtlasData.data() + atlasx * (kBrickSize / 4) + atlasy * ((atlasSizePixels.x / 4) * kBrickSize / 4) + atlasz * (pixelsPerSlice / 16 * kBrickSize));
-                        for (int pixz = 0; pixz < kBrickSize; ++pixz)
-                        {
-                            for (int tiley = 0; tiley < kBrickSize; tiley += 4)
-                            {
-                                for (int tilex = 0; tilex < kBrickSize; tilex += 4) {
-                                    uint8_t tilevals[4][4];
-                                    uint8_t tileminorant = 255, tilemajorant = 0;
-                                    for (int pixy = 0; pixy < 4; ++pixy)
-                                    {
-                                        for (int pixx = 0; pixx < 4; ++pixx)
-                                        {
-                                            float f = data[(pixx + tilex) * (kBrickSize * kBrickSize) + (pixy + tiley) * kBrickSize + pixz];
-                                            uint8_t voxel = uint8_t((f - minorant) * invRange);
-                                            tileminorant = std::min(tileminorant, voxel);
-                                            tilemajorant = std::max(tilemajorant, voxel);
-                                            tilevals[pixy][pixx] = voxel;
-                                        }
-                                    }
-                                    CompressAlphaDxt5((uint8_t*)&tilevals[0][0], atlasdst);
-                                    atlasdst++;
-                                }
-                                atlasdst += (atlasSizePixels.x / 4 - kBrickSize / 4); // next scanline
-                            }
-                            atlasdst += (pixelsPerSlice / 16 - (atlasSizePixels.x / 4 * kBrickSize / 4)); // next slice
-                        } // z slice loop
-                    } // bc4 compress?
-                } // non empty brick?
-            } // x brick loop
-        } // y brick loop
+                }
+            }
+        }
+        return float2(majorant, minorant);
+    }
+
+    template <typename TexelType, unsigned int kBitsPerTexel>
+    void NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::convertLeaves()
+    {
+        const uint32_t leafCount = mpFloatGrid->tree().nodeCount(0);
+        const LeafT* leaves = mpFloatGrid->tree().getFirstNode<0>();
+        const uint32_t chunkCount = (leafCount + kLeavesPerChunk - 1) / kLeavesPerChunk;
+
+        // Find the brick of each leaf, or kInvalidBrick if the leaf is outside the bounding box.
+        // Leaves are stored in tree order, so consecutive leaves and their neighbours are close in memory.
+        const uint32_t kInvalidBrick = uint32_t(-1);
+        std::vector<uint32_t> leafBricks(leafCount);
+        std::vector<float2> leafMajMin(leafCount);
+        mPeakMemoryUsage += leafCount * (sizeof(uint32_t) + sizeof(float2));
+
+        Threading::parallelFor(0u, chunkCount, [&](uint32_t chunk)
+        {
+            auto a = mpFloatGrid->getAccessor();
+            const uint32_t end = std::min(leafCount, (chunk + 1) * kLeavesPerChunk);
+            for (uint32_t i = chunk * kLeavesPerChunk; i < end; ++i)
+            {
+                const nanovdb::Coord origin = leaves[i].origin();
+                const int3 brick = (int3(origin[0], origin[1], origin[2]) - mBBMin) / int(kBrickSize);
+                if (glm::any(glm::lessThan(brick, int3(0))) || glm::any(glm::greaterThanEqual(brick, mLeafDim[0])))
+                {
+                    leafBricks[i] = kInvalidBrick;
+                    continue;
+                }
+                leafBricks[i] = brick.x + mLeafDim[0].x * (brick.y + mLeafDim[0].y * brick.z);
+                leafMajMin[i] = computeLeafMajMin(&leaves[i], a);
+            }
+        }, 1);
+
+        // Assign atlas slots in leaf order so the atlas layout is deterministic.
+        const uint brickMax = getAtlasMaxBrick();
+        std::vector<uint32_t> atlasSlots(leafCount);
+        mPeakMemoryUsage += leafCount * sizeof(uint32_t);
+        uint32_t nonEmptyCount = 0;
+        for (uint32_t i = 0; i < leafCount; ++i)
+        {
+            const bool hasData = leafBricks[i] != kInvalidBrick && leafMajMin[i].x != leafMajMin[i].y && nonEmptyCount < brickMax;
+            atlasSlots[i] = hasData ? nonEmptyCount++ : kInvalidBrick;
+        }
+        mNonEmptyCount.store(nonEmptyCount);
+
+        // Write the range and indirection entries and encode the bricks.
+        Threading::parallelFor(0u, chunkCount, [&](uint32_t chunk)
+        {
+            const uint32_t end = std::min(leafCount, (chunk + 1) * kLeavesPerChunk);
+            for (uint32_t i = chunk * kLeavesPerChunk; i < end; ++i)
+            {
+                const uint32_t brickIndex = leafBricks[i];
+                if (brickIndex == kInvalidBrick) continue;
+
+                const float2 majmin = leafMajMin[i];
+                if (atlasSlots[i] == kInvalidBrick)
+                {
+                    mRangeData[brickIndex] = f32tof16(majmin.x) + (f32tof16(majmin.x) << 16); // force identical major and minor
+                    mPtrData[brickIndex] = 0;
+                }
+                else
+                {
+                    mPtrData[brickIndex] = writeBrick(leaves[i].voxels(), majmin.y, majmin.x, atlasSlots[i], mRangeData[brickIndex]);
+                }
+            }
+        }, 1);
     }
 
     template <typename TexelType, unsigned int kBitsPerTexel>
     void NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::computeMip(int mip)
     {
-        uint32_t* rangedst = mRangeData.data() + mLeafCount[mip - 1];
-        uint32_t* rangesrc = mRangeData.data() + ((mip > 1) ? mLeafCount[mip - 2] : 0);
+        Threading::parallelFor(0, mLeafDim[mip].z, [&](int z) { computeMipSlice(mip, z); }, 1);
+    }
+
+    template <typename TexelType, unsigned int kBitsPerTexel>
+    void NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::computeMipSlice(int mip, int z)
+    {
         int3 leafdim_src = mLeafDim[mip - 1];
         uint32_t rowstride_src = leafdim_src.x;
         uint32_t slicestride_src = leafdim_src.y * rowstride_src;
@@ -245,42 +419,68 @@ namespace Falcor
         uint32_t rowstride_tgt = leafdim_tgt.x;
         uint32_t slicestride_tgt = leafdim_tgt.y * rowstride_tgt;
 
-        for (int z = 0; z < leafdim_tgt.z; ++z, rangesrc += slicestride_src)
+        uint32_t* rangedst = mRangeData.data() + mLeafCount[mip - 1] + z * slicestride_tgt;
+        const uint32_t* rangesrc_slice = mRangeData.data() + ((mip > 1) ? mLeafCount[mip - 2] : 0) + 2 * z * slicestride_src;
+
+        for (int y = 0; y < leafdim_tgt.y; ++y)
         {
-            for (int y = 0; y < leafdim_tgt.y; ++y, rangesrc += rowstride_src)
+            const uint32_t* rangesrc = rangesrc_slice + 2 * y * rowstride_src;
+            for (int x = 0; x < leafdim_tgt.x; ++x, rangesrc += 2)
             {
-                for (int x = 0; x < leafdim_tgt.x; ++x, rangesrc += 2)
+                // Most of a sparse grid is empty space with identical ranges, which needs no unpacking.
+                const uint32_t r = rangesrc[0];
+                if (rangesrc[1] == r && rangesrc[rowstride_src] == r && rangesrc[rowstride_src + 1] == r &&
+                    rangesrc[slicestride_src] == r && rangesrc[slicestride_src + 1] == r && rangesrc[slicestride_src + rowstride_src] == r && rangesrc[slicestride_src + rowstride_src + 1] == r)
                 {
-                    float2 majmin_dst = combineMajMin(
-                        combineMajMin(
-                            combineMajMin(unpackMajMin(rangesrc), unpackMajMin(rangesrc + 1)),
-                            combineMajMin(unpackMajMin(rangesrc + rowstride_src), unpackMajMin(rangesrc + 1 + rowstride_src))
-                        ),
-                        combineMajMin(
-                            combineMajMin(unpackMajMin(rangesrc + slicestride_src), unpackMajMin(rangesrc + slicestride_src + 1)),
-                            combineMajMin(unpackMajMin(rangesrc + slicestride_src + rowstride_src), unpackMajMin(rangesrc + slicestride_src + 1 + rowstride_src))
-                        )
-                    );
-                    *rangedst++ = f32tof16(majmin_dst.x) + (f32tof16(majmin_dst.y) << 16);
-                } // x
-            } // y
-        } // z
+                    *rangedst++ = r;
+                    continue;
+                }
+
+                float2 majmin_dst = combineMajMin(
+                    combineMajMin(
+                        combineMajMin(unpackMajMin(rangesrc), unpackMajMin(rangesrc + 1)),
+                        combineMajMin(unpackMajMin(rangesrc + rowstride_src), unpackMajMin(rangesrc + 1 + rowstride_src))
+                    ),
+                    combineMajMin(
+                        combineMajMin(unpackMajMin(rangesrc + slicestride_src), unpackMajMin(rangesrc + slicestride_src + 1)),
+                        combineMajMin(unpackMajMin(rangesrc + slicestride_src + rowstride_src), unpackMajMin(rangesrc + slicestride_src + 1 + rowstride_src))
+                    )
+                );
+                *rangedst++ = f32tof16(majmin_dst.x) + (f32tof16(majmin_dst.y) << 16);
+            } // x
+        } // y
     }
 
-    template <typename TexelType, unsigned int kBitsPerTexel> typename
+    template <typename TexelType, unsigned int kBitsPerTexel>
     BrickedGrid NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::convert()
+    {
+        return convertToData().createTextures();
+    }
+
+    template <typename TexelType, unsigned int kBitsPerTexel>
+    BrickedGridData NanoVDBToBricksConverter<TexelType, kBitsPerTexel>::convertToData(bool sparse)
     {
         auto t0 = CpuTimer::getCurrentTimePoint();
-        auto range = NumericRange<int>(0, mLeafDim[0].z);
-        std::for_each(std::execution::par, range.begin(), range.end(), [&](int z) { convertSlice(z); });
+        if (sparse)
+        {
+            Threading::parallelFor(0, mLeafDim[0].z, [&](int z) { fillSlice(z); }, 1);
+            convertLeaves();
+        }
+        else
+        {
+            Threading::parallelFor(0, mLeafDim[0].z, [&](int z) { convertSlice(z); }, 1);
+        }
         for (int mip = 1; mip < 4; ++mip) computeMip(mip);
         double dt = CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint());
         logInfo("converted in " + std::to_string(dt) + "ms: mNonEmptyCount " + std::to_string(mNonEmptyCount) + " vs max " + std::to_string(getAtlasMaxBrick()) + "\n");
 
-        BrickedGrid bricks;
-        bricks.range = Texture::create3D(mLeafDim[0].x, mLeafDim[0].y, mLeafDim[0].z, ResourceFormat::RG16Float, 4, mRangeData.data(), ResourceBindFlags::ShaderResource, false);
-        bricks.indirection = Texture::create3D(mLeafDim[0].x, mLeafDim[0].y, mLeafDim[0].z, ResourceFormat::RGBA8Uint, 1, mPtrData.data(), ResourceBindFlags::ShaderResource, false);
-        bricks.atlas = Texture::create3D(getAtlasSizePixels().x, getAtlasSizePixels().y, getAtlasSizePixels().z, getAtlasFormat(), 1, mAtlasData.data(), ResourceBindFlags::ShaderResource, false);
-        return bricks;
+        BrickedGridData data;
+        data.leafDim = uint3(mLeafDim[0]);
+        data.atlasSize = getAtlasSizePixels();
+        data.atlasFormat = getAtlasFormat();
+        data.rangeData = std::move(mRangeData);
+        data.indirectionData = std::move(mPtrData);
+        data.atlasData = std::move(mAtlasData);
+        return data;
     }
 }
@@ -0,0 +1,308 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "GridStreamer.h"
+
+namespace Falcor
+{
+    namespace
+    {
+        // Frame changes larger than this are treated as seeks and reset the predicted step to 1.
+        const uint32_t kMaxPredictedStep = 16;
+
+        // Weight of a new load time in the moving average.
+        const double kLoadTimeWeight = 0.2;
+
+        double getCurrentTime()
+        {
+            static const auto kStart = CpuTimer::getCurrentTimePoint();
+            return CpuTimer::calcDuration(kStart, CpuTimer::getCurrentTimePoint());
+        }
+    }
+
+    GridStreamer::GridStreamer(uint32_t frameCount, LoadFunc loadFunc, const Options& options, ClockFunc clockFunc)
+        : mLoadFunc(std::move(loadFunc))
+        , mClockFunc(clockFunc ? std::move(clockFunc) : getCurrentTime)
+        , mOptions(options)
+        , mFrameCount(frameCount)
+    {
+        if (mFrameCount == 0) throw std::exception("GridStreamer requires at least one frame");
+        if (!mLoadFunc) throw std::exception("GridStreamer requires a load function");
+    }
+
+    GridStreamer::~GridStreamer()
+    {
+        // Tasks reference the load jobs only, but the load function may reference data owned by the caller.
+        for (auto& [frame, pLoad] : mPending)
+        {
+            try
+            {
+                pLoad->task.finish();
+            }
+            catch (const std::exception&) {}
+        }
+    }
+
+    GridStreamer::SharedPtr GridStreamer::create(uint32_t frameCount, LoadFunc loadFunc, const Options& options, ClockFunc clockFunc)
+    {
+        return SharedPtr(new GridStreamer(frameCount, std::move(loadFunc), options, std::move(clockFunc)));
+    }
+
+    GridStreamer::SharedPtr GridStreamer::createFromFiles(const std::vector<std::string>& filenames, const std::string& gridname, const Options& options, const GridCache::SharedPtr& pGridCache)
+    {
+        auto loadFunc = [filenames, gridname, pGridCache](uint32_t frame)
+        {
+            return pGridCache ? pGridCache->loadGrid(filenames[frame], gridname, false) : Grid::createFromFile(filenames[frame], gridname, false);
+        };
+        auto pStreamer = create((uint32_t)filenames.size(), loadFunc, options);
+        pStreamer->mFilenames = filenames;
+        pStreamer->mGridname = gridname;
+        return pStreamer;
+    }
+
+    Grid::SharedPtr GridStreamer::setFrame(uint32_t frame)
+    {
+        frame = std::min(frame, mFrameCount - 1);
+
+        collectLoads(false);
+
+        if (mHasFrame && frame == mFrame) return mpGrid;
+
+        // Predict the step to the next frame from this frame change.
+        if (mHasFrame)
+        {
+            uint32_t delta = (frame + mFrameCount - mFrame) % mFrameCount;
+            mStep = delta <= kMaxPredictedStep ? delta : 1;
+        }
+
+        mStats.frameRequests++;
+        if (mResident.find(frame) != mResident.end())
+        {
+            mStats.prefetchHits++;
+        }
+        else
+        {
+            mStats.prefetchMisses++;
+            const double t0 = mClockFunc();
+
+            auto it = mPending.find(frame);
+            if (it != mPending.end())
+            {
+                auto pLoad = it->second;
+                mPending.erase(it);
+                finishLoad(pLoad);
+            }
+            else
+            {
+                auto pLoad = std::make_shared<LoadJob>();
+                pLoad->frame = frame;
+                try
+                {
+                    pLoad->pGrid = mLoadFunc(frame);
+                }
+                catch (const std::exception& e)
+                {
+                    logWarning("Failed to load grid frame " + std::to_string(frame) + ": " + e.what());
+                }
+                pLoad->loadTime = mClockFunc() - t0;
+                finishLoad(pLoad);
+            }
+
+            mStats.stallTime += mClockFunc() - t0;
+        }
+
+        mFrame = frame;
+        mHasFrame = true;
+
+        auto& resident = mResident.at(frame);
+        resident.lastUsed = ++mUseCounter;
+        mpGrid = resident.pGrid;
+
+        prefetch();
+        evict();
+
+        return mpGrid;
+    }
+
+    void GridStreamer::setResident(uint32_t frame, const Grid::SharedPtr& pGrid)
+    {
+        if (frame >= mFrameCount) throw std::exception("GridStreamer frame index out of range");
+
+        auto& resident = mResident[frame];
+        mResidentBytes -= resident.size;
+        resident.pGrid = pGrid;
+        resident.size = pGrid ? pGrid->getGridSizeInBytes() : 0;
+        mResidentBytes += resident.size;
+    }
+
+    void GridStreamer::finishPendingLoads()
+    {
+        collectLoads(true);
+    }
+
+    GridStreamer::Stats GridStreamer::getStats() const
+    {
+        Stats stats = mStats;
+        stats.residentFrames = (uint32_t)mResident.size();
+        stats.residentBytes = mResidentBytes;
+        stats.pendingLoads = (uint32_t)mPending.size();
+        stats.prefetchWindow = (uint32_t)getPrefetchFrames().size();
+        return stats;
+    }
+
+    void GridStreamer::resetStats()
+    {
+        mStats = Stats();
+    }
+
+    void GridStreamer::renderUI(Gui::Widgets& widget)
+    {
+        const auto stats = getStats();
+        std::ostringstream oss;
+        oss << "Resident frames: " << stats.residentFrames << " (" << formatByteSize(stats.residentBytes) << " of " << formatByteSize(mOptions.memoryBudget) << ")" << std::endl
+            << "Prefetch window: " << stats.prefetchWindow << " frames, step " << mStep << std::endl
+            << "Pending loads: " << stats.pendingLoads << std::endl
+            << "Prefetch hits: " << stats.prefetchHits << ", misses: " << stats.prefetchMisses << std::endl
+            << "Stall time: " << std::fixed << std::setprecision(2) << stats.stallTime << " ms" << std::endl
+            << "Loaded frames: " << stats.loadedFrames << ", evicted frames: " << stats.evictedFrames << std::endl;
+        widget.text(oss.str());
+
+        if (widget.button("Reset stats")) resetStats();
+    }
+
+    void GridStreamer::collectLoads(bool wait)
+    {
+        for (auto it = mPending.begin(); it != mPending.end();)
+        {
+            if (wait || !it->second->task.isRunning())
+            {
+                finishLoad(it->second);
+                it = mPending.erase(it);
+            }
+            else ++it;
+        }
+    }
+
+    void GridStreamer::finishLoad(const std::shared_ptr<LoadJob>& pLoad)
+    {
+        if (pLoad->task.isValid())
+        {
+            try
+            {
+                pLoad->task.finish();
+            }
+            catch (const std::exception& e)
+            {
+                logWarning("Failed to load grid frame " + std::to_string(pLoad->frame) + ": " + e.what());
+                pLoad->pGrid = nullptr;
+            }
+        }
+
+        if (pLoad->pGrid) mStats.loadedFrames++;
+        mAvgLoadTime = mAvgLoadTime > 0.0 ? (1.0 - kLoadTimeWeight) * mAvgLoadTime + kLoadTimeWeight * pLoad->loadTime : pLoad->loadTime;
+
+        // Frames that fail to load are kept as empty frames so they are not loaded again.
+        if (mResident.find(pLoad->frame) == mResident.end()) setResident(pLoad->frame, pLoad->pGrid);
+    }
+
+    void GridStreamer::dispatchLoad(uint32_t frame)
+    {
+        auto pLoad = std::make_shared<LoadJob>();
+        pLoad->frame = frame;
+        pLoad->task = Threading::dispatchTask([pLoad, loadFunc = mLoadFunc, clockFunc = mClockFunc]()
+        {
+            const double t0 = clockFunc();
+            pLoad->pGrid = loadFunc(pLoad->frame);
+            pLoad->loadTime = clockFunc() - t0;
+        });
+        mPending[frame] = pLoad;
+    }
+
+    void GridStreamer::prefetch()
+    {
+        for (uint32_t frame : getPrefetchFrames())
+        {
+            if (mResident.find(frame) == mResident.end() && mPending.find(frame) == mPending.end()) dispatchLoad(frame);
+        }
+    }
+
+    void GridStreamer::evict()
+    {
+        const auto prefetchFrames = getPrefetchFrames();
+        auto isProtected = [&](uint32_t frame)
+        {
+            return frame == mFrame || std::find(prefetchFrames.begin(), prefetchFrames.end(), frame) != prefetchFrames.end();
+        };
+
+        while (mResidentBytes > mOptions.memoryBudget)
+        {
+            auto lru = mResident.end();
+            for (auto it = mResident.begin(); it != mResident.end(); ++it)
+            {
+                if (isProtected(it->first)) continue;
+                if (lru == mResident.end() || it->second.lastUsed < lru->second.lastUsed) lru = it;
+            }
+            if (lru == mResident.end()) break;
+
+            mResidentBytes -= lru->second.size;
+            mResident.erase(lru);
+            mStats.evictedFrames++;
+        }
+    }
+
+    std::vector<uint32_t> GridStreamer::getPrefetchFrames() const
+    {
+        std::vector<uint32_t> frames;
+        if (!mHasFrame || mFrameCount <= 1 || mStep == 0) return frames;
+
+        // Load far enough ahead to hide the load time at the current frame rate.
+        uint32_t window = mOptions.prefetchFrames;
+        if (mOptions.adaptivePrefetch && mAvgLoadTime > 0.0 && mFrameRate > 0.0)
+        {
+            const double framesPerLoad = mAvgLoadTime * 1e-3 * mFrameRate / mStep;
+            window = std::max(window, (uint32_t)std::ceil(framesPerLoad) + 1);
+        }
+
+        // Limit the window to the frames that fit in the budget next to the current frame.
+        if (mResidentBytes > 0)
+        {
+            const uint64_t avgFrameSize = std::max<uint64_t>(1, mResidentBytes / mResident.size());
+            const uint64_t budgetFrames = mOptions.memoryBudget / avgFrameSize;
+            window = (uint32_t)std::min<uint64_t>(window, budgetFrames > 0 ? budgetFrames - 1 : 0);
+        }
+        window = std::min(window, mFrameCount - 1);
+
+        for (uint32_t i = 1; i <= window; ++i)
+        {
+            uint32_t frame = (uint32_t)((mFrame + (uint64_t)i * mStep) % mFrameCount);
+            if (frame == mFrame) break; // The step wrapped around to the current frame.
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+}
@@ -0,0 +1,206 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include "Grid.h"
+#include "GridCache.h"
+
+namespace Falcor
+{
+    /** Streams the frames of a grid sequence in and out of memory during playback.
+
+        Frames are loaded lazily when they are selected with setFrame(). While a sequence is played back,
+        the frames ahead of the current frame are loaded on worker threads so that they are resident by the
+        time they are selected. The prefetch window covers at least Options::prefetchFrames frames and is
+        extended when the measured load time exceeds the time between frames at the current frame rate
+        (see Options::adaptivePrefetch).
+        The step between frames is predicted from the last frame change, which handles playback that
+        skips frames. Resident frames outside the prefetch window are evicted in least recently used order
+        to keep the resident frames within the memory budget.
+
+        Frames are loaded without GPU resources, which are created on the main thread when a grid is first bound.
+    */
+    class dlldecl GridStreamer
+    {
+    public:
+        using SharedPtr = std::shared_ptr<GridStreamer>;
+
+        /** Function loading a frame of the sequence. Called on worker threads and must not create GPU resources.
+            Returns nullptr if the frame cannot be loaded.
+        */
+        using LoadFunc = std::function<Grid::SharedPtr(uint32_t frame)>;
+
+        /** Function returning the current time in ms. Used to measure load and stall times. Called on worker threads.
+        */
+        using ClockFunc = std::function<double()>;
+
+        struct Options
+        {
+            uint32_t prefetchFrames = 4;            ///< Minimum number of frames to load ahead of the current frame.
+            uint64_t memoryBudget = 1ull << 30;     ///< Memory budget in bytes for the resident frames. The current frame is always resident.
+            bool adaptivePrefetch = true;           ///< Extend the prefetch window when frames take longer to load than the time between frames.
+        };
+
+        struct Stats
+        {
+            uint32_t residentFrames = 0;            ///< Number of resident frames.
+            uint64_t residentBytes = 0;             ///< Size of the resident frames.
+            uint32_t pendingLoads = 0;              ///< Number of frames being loaded.
+            uint32_t prefetchWindow = 0;            ///< Number of frames currently loaded ahead of the current frame.
+            uint64_t frameRequests = 0;             ///< Number of frame changes.
+            uint64_t prefetchHits = 0;              ///< Number of frame changes to a frame that was already resident.
+            uint64_t prefetchMisses = 0;            ///< Number of frame changes that had to wait for the frame to load.
+            double stallTime = 0.0;                 ///< Total time in ms spent waiting for frames to load.
+            uint64_t loadedFrames = 0;              ///< Total number of frames loaded successfully.
+            uint64_t evictedFrames = 0;             ///< Total number of frames evicted.
+        };
+
+        ~GridStreamer();
+
+        /** Create a grid streamer.
+            \param[in] frameCount Number of frames in the sequence.
+            \param[in] loadFunc Function loading a frame of the sequence.
+            \param[in] options Streaming options.
+            \param[in] clockFunc Function returning the current time. If nullptr, the CPU timer is used.
+            \return A new object.
+        */
+        static SharedPtr create(uint32_t frameCount, LoadFunc loadFunc, const Options& options = Options(), ClockFunc clockFunc = nullptr);
+
+        /** Create a grid streamer for a sequence of grid files.
+            \param[in] filenames Filenames of the grids, one per frame. Can also include a full path or relative path from a data directory.
+            \param[in] gridname Name of the grid to load.
+            \param[in] options Streaming options.
+            \param[in] pGridCache Optional grid cache to load the grids through.
+            \return A new object.
+        */
+        static SharedPtr createFromFiles(const std::vector<std::string>& filenames, const std::string& gridname, const Options& options = Options(), const GridCache::SharedPtr& pGridCache = nullptr);
+
+        /** Select the current frame. Loads the frame if it is not resident, prefetches the next frames and evicts frames over budget.
+            \param[in] frame Frame index. Must be less than the frame count.
+            \return The grid of the frame, or nullptr if the frame failed to load.
+        */
+        Grid::SharedPtr setFrame(uint32_t frame);
+
+        /** Get the current frame.
+        */
+        uint32_t getFrame() const { return mFrame; }
+
+        /** Get the grid of the current frame.
+        */
+        const Grid::SharedPtr& getGrid() const { return mpGrid; }
+
+        /** Add an already loaded grid as a resident frame.
+            This is used to seed the streamer with grids restored from the scene cache.
+        */
+        void setResident(uint32_t frame, const Grid::SharedPtr& pGrid);
+
+        /** Wait until all pending loads have finished.
+        */
+        void finishPendingLoads();
+
+        /** Set the frame rate of the playback in frames per second. Used to size the prefetch window.
+        */
+        void setFrameRate(double frameRate) { mFrameRate = frameRate; }
+
+        /** Get the frame rate of the playback in frames per second.
+        */
+        double getFrameRate() const { return mFrameRate; }
+
+        /** Get the number of frames in the sequence.
+        */
+        uint32_t getFrameCount() const { return mFrameCount; }
+
+        /** Get the filenames of the sequence. Empty unless the streamer was created with createFromFiles().
+        */
+        const std::vector<std::string>& getFilenames() const { return mFilenames; }
+
+        /** Get the name of the grid loaded from the files. Empty unless the streamer was created with createFromFiles().
+        */
+        const std::string& getGridname() const { return mGridname; }
+
+        void setOptions(const Options& options) { mOptions = options; }
+        const Options& getOptions() const { return mOptions; }
+
+        Stats getStats() const;
+
+        /** Reset the counters of the stats.
+        */
+        void resetStats();
+
+        /** Render the GUI.
+        */
+        void renderUI(Gui::Widgets& widget);
+
+    private:
+        GridStreamer(uint32_t frameCount, LoadFunc loadFunc, const Options& options, ClockFunc clockFunc);
+
+        struct ResidentFrame
+        {
+            Grid::SharedPtr pGrid;
+            uint64_t size = 0;
+            uint64_t lastUsed = 0;                  ///< Value of the use counter when the frame was last selected.
+        };
+
+        /** Asynchronous load of a frame.
+        */
+        struct LoadJob
+        {
+            uint32_t frame = 0;
+            Grid::SharedPtr pGrid;
+            double loadTime = 0.0;                  ///< Load time in ms.
+            Threading::Task task;
+        };
+
+        void collectLoads(bool wait);
+        void finishLoad(const std::shared_ptr<LoadJob>& pLoad);
+        void dispatchLoad(uint32_t frame);
+        void prefetch();
+        void evict();
+        std::vector<uint32_t> getPrefetchFrames() const;
+
+        LoadFunc mLoadFunc;
+        ClockFunc mClockFunc;
+        Options mOptions;
+        uint32_t mFrameCount = 0;
+        std::vector<std::string> mFilenames;
+        std::string mGridname;
+
+        uint32_t mFrame = 0;
+        Grid::SharedPtr mpGrid;
+        bool mHasFrame = false;                     ///< True once a frame has been selected.
+        uint32_t mStep = 1;                         ///< Predicted step to the next frame.
+        double mFrameRate = 30.0;
+        uint64_t mUseCounter = 0;
+
+        std::map<uint32_t, ResidentFrame> mResident;
+        std::map<uint32_t, std::shared_ptr<LoadJob>> mPending;
+        uint64_t mResidentBytes = 0;
+        double mAvgLoadTime = 0.0;                  ///< Moving average of the load time in ms.
+
+        Stats mStats;                               ///< Counters. The current state is filled in by getStats().
+    };
+}
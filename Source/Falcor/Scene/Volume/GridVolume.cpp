@@ -44,6 +44,39 @@ namespace Falcor
         const float kMaxAnisotropy = 0.99f;
         const double kMinFrameRate = 1.0;
         const double kMaxFrameRate = 1000.0;
+
+        const std::string kSlotNames[] = { "Density", "Emission" };
+        static_assert(arraysize(kSlotNames) == (size_t)GridVolume::GridSlot::Count);
+
+        /** Find the grid files in a directory, sorted by length first, then alpha-numerically.
+            Returns false if the directory cannot be found.
+        */
+        bool findGridFiles(const std::string& path, std::vector<std::string>& files)
+        {
+            std::string fullpath;
+            if (!findFileInDataDirectories(path, fullpath))
+            {
+                logWarning("Cannot find directory '" + path + "'");
+                return false;
+            }
+            if (!std::filesystem::is_directory(fullpath))
+            {
+                logWarning("'" + path + "' is not a directory");
+                return false;
+            }
+
+            // Enumerate grid files.
+            files.clear();
+            for (auto p : std::filesystem::directory_iterator(fullpath))
+            {
+                if (p.path().extension() == ".nvdb" || p.path().extension() == ".vdb") files.push_back(p.path().string());
+            }
+
+            // Sort by length first, then alpha-numerically.
+            auto cmp = [](const std::string& a, const std::string& b) { return a.length() != b.length() ? a.length() < b.length() : a < b; };
+            std::sort(files.begin(), files.end(), cmp);
+            return true;
+        }
     }
 
     static_assert(sizeof(GridVolumeData) % 16 == 0, "GridVolumeData size should be a multiple of 16");
@@ -94,6 +127,12 @@ namespace Falcor
             if (widget.var("Emission scale", emissionScale, 0.f, std::numeric_limits<float>::max(), 0.01f)) setEmissionScale(emissionScale);
         }
 
+        for (size_t slotIndex = 0; slotIndex < mStreamers.size(); ++slotIndex)
+        {
+            if (!mStreamers[slotIndex]) continue;
+            if (auto group = widget.group(kSlotNames[slotIndex] + " Streaming")) mStreamers[slotIndex]->renderUI(group);
+        }
+
         float3 albedo = getAlbedo();
         if (widget.var("Albedo", albedo, 0.f, 1.f, 0.01f)) setAlbedo(albedo);
 
@@ -118,7 +157,7 @@ namespace Falcor
 
     bool GridVolume::loadGrid(GridSlot slot, const std::string& filename, const std::string& gridname)
     {
-        auto grid = Grid::createFromFile(filename, gridname);
+        auto grid = mpGridCache ? mpGridCache->loadGrid(filename, gridname) : Grid::createFromFile(filename, gridname);
         if (grid) setGrid(slot, grid);
         return grid != nullptr;
     }
@@ -128,7 +167,7 @@ namespace Falcor
         GridSequence grids;
         for (const auto& filename : filenames)
         {
-            auto grid = Grid::createFromFile(filename, gridname);
+            auto grid = mpGridCache ? mpGridCache->loadGrid(filename, gridname) : Grid::createFromFile(filename, gridname);
             if (keepEmpty || grid) grids.push_back(grid);
         }
         setGridSequence(slot, grids);
@@ -137,30 +176,53 @@ namespace Falcor
 
     uint32_t GridVolume::loadGridSequence(GridSlot slot, const std::string& path, const std::string& gridname, bool keepEmpty)
     {
-        std::string fullpath;
-        if (!findFileInDataDirectories(path, fullpath))
-        {
-            logWarning("Cannot find directory '" + path + "'");
-            return 0;
-        }
-        if (!std::filesystem::is_directory(fullpath))
+        std::vector<std::string> files;
+        if (!findGridFiles(path, files)) return 0;
+        return loadGridSequence(slot, files, gridname, keepEmpty);
+    }
+
+    uint32_t GridVolume::streamGridSequence(GridSlot slot, const std::vector<std::string>& filenames, const std::string& gridname, const GridStreamer::Options& options)
+    {
+        if (filenames.empty())
         {
-            logWarning("'" + path + "' is not a directory");
+            setGridSequence(slot, {});
             return 0;
         }
+        setGridStreamer(slot, GridStreamer::createFromFiles(filenames, gridname, options, mpGridCache));
+        return (uint32_t)filenames.size();
+    }
 
-        // Enumerate grid files.
+    uint32_t GridVolume::streamGridSequence(GridSlot slot, const std::string& path, const std::string& gridname, const GridStreamer::Options& options)
+    {
         std::vector<std::string> files;
-        for (auto p : std::filesystem::directory_iterator(fullpath))
-        {
-            if (p.path().extension() == ".nvdb" || p.path().extension() == ".vdb") files.push_back(p.path().string());
-        }
+        if (!findGridFiles(path, files)) return 0;
+        return streamGridSequence(slot, files, gridname, options);
+    }
+
+    void GridVolume::setGridStreamer(GridSlot slot, const GridStreamer::SharedPtr& pStreamer)
+    {
+        uint32_t slotIndex = (uint32_t)slot;
+        assert(slotIndex >= 0 && slotIndex < (uint32_t)GridSlot::Count);
 
-        // Sort by length first, then alpha-numerically.
-        auto cmp = [](const std::string& a, const std::string& b) { return a.length() != b.length() ? a.length() < b.length() : a < b; };
-        std::sort(files.begin(), files.end(), cmp);
+        if (mStreamers[slotIndex] == pStreamer) return;
 
-        return loadGridSequence(slot, files, gridname, keepEmpty);
+        mGrids[slotIndex].clear();
+        mStreamers[slotIndex] = pStreamer;
+        mStreamedGrids[slotIndex] = nullptr;
+        if (pStreamer) pStreamer->setFrameRate(mFrameRate);
+
+        updateSequence();
+        updateStreamedGrids();
+        updateBounds();
+        markUpdates(UpdateFlags::GridsChanged);
+    }
+
+    const GridStreamer::SharedPtr& GridVolume::getGridStreamer(GridSlot slot) const
+    {
+        uint32_t slotIndex = (uint32_t)slot;
+        assert(slotIndex >= 0 && slotIndex < (uint32_t)GridSlot::Count);
+
+        return mStreamers[slotIndex];
     }
 
     void GridVolume::setGridSequence(GridSlot slot, const GridSequence& grids)
@@ -168,9 +230,11 @@ namespace Falcor
         uint32_t slotIndex = (uint32_t)slot;
         assert(slotIndex >= 0 && slotIndex < (uint32_t)GridSlot::Count);
 
-        if (mGrids[slotIndex] != grids)
+        if (mGrids[slotIndex] != grids || mStreamers[slotIndex])
         {
             mGrids[slotIndex] = grids;
+            mStreamers[slotIndex] = nullptr;
+            mStreamedGrids[slotIndex] = nullptr;
             updateSequence();
             updateBounds();
             markUpdates(UpdateFlags::GridsChanged);
@@ -197,6 +261,8 @@ namespace Falcor
         uint32_t slotIndex = (uint32_t)slot;
         assert(slotIndex >= 0 && slotIndex < (uint32_t)GridSlot::Count);
 
+        if (mStreamers[slotIndex]) return mStreamedGrids[slotIndex];
+
         const auto& gridSequence = mGrids[slotIndex];
         uint32_t gridIndex = std::min(mGridFrame, (uint32_t)gridSequence.size() - 1);
         return gridSequence.empty() ? kNullGrid : gridSequence[gridIndex];
@@ -209,6 +275,10 @@ namespace Falcor
         {
             std::copy_if(grids.begin(), grids.end(), std::inserter(uniqueGrids, uniqueGrids.begin()), [] (const auto& grid) { return grid != nullptr; });
         }
+        for (const auto& grid : mStreamedGrids)
+        {
+            if (grid) uniqueGrids.insert(grid);
+        }
         return std::vector<Grid::SharedPtr>(uniqueGrids.begin(), uniqueGrids.end());
     }
 
@@ -218,6 +288,7 @@ namespace Falcor
         {
             mGridFrame = gridFrame;
             markUpdates(UpdateFlags::GridsChanged);
+            updateStreamedGrids();
             updateBounds();
         }
     }
@@ -225,6 +296,10 @@ namespace Falcor
     void GridVolume::setFrameRate(double frameRate)
     {
         mFrameRate = clamp(frameRate, kMinFrameRate, kMaxFrameRate);
+        for (const auto& pStreamer : mStreamers)
+        {
+            if (pStreamer) pStreamer->setFrameRate(mFrameRate);
+        }
     }
 
     void GridVolume::setPlaybackEnabled(bool enabled)
@@ -318,9 +393,29 @@ namespace Falcor
     {
         mGridFrameCount = 1;
         for (const auto& grids : mGrids) mGridFrameCount = std::max(mGridFrameCount, (uint32_t)grids.size());
+        for (const auto& pStreamer : mStreamers)
+        {
+            if (pStreamer) mGridFrameCount = std::max(mGridFrameCount, pStreamer->getFrameCount());
+        }
         setGridFrame(std::min(mGridFrame, mGridFrameCount - 1));
     }
 
+    void GridVolume::updateStreamedGrids()
+    {
+        for (size_t slotIndex = 0; slotIndex < mStreamers.size(); ++slotIndex)
+        {
+            const auto& pStreamer = mStreamers[slotIndex];
+            if (!pStreamer) continue;
+
+            auto grid = pStreamer->setFrame(std::min(mGridFrame, pStreamer->getFrameCount() - 1));
+            if (grid != mStreamedGrids[slotIndex])
+            {
+                mStreamedGrids[slotIndex] = grid;
+                markUpdates(UpdateFlags::GridsChanged);
+            }
+        }
+    }
+
     void GridVolume::updateBounds()
     {
         AABB bounds;
@@ -358,6 +453,7 @@ namespace Falcor
     {
         SCRIPT_BINDING_DEPENDENCY(Animatable)
         SCRIPT_BINDING_DEPENDENCY(Grid)
+        SCRIPT_BINDING_DEPENDENCY(GridCache)
 
         pybind11::class_<GridVolume, Animatable, GridVolume::SharedPtr> volume(m, "GridVolume");
         volume.def_property("name", &GridVolume::getName, &GridVolume::setName);
@@ -365,6 +461,7 @@ namespace Falcor
         volume.def_property_readonly("gridFrameCount", &GridVolume::getGridFrameCount);
         volume.def_property("frameRate", &GridVolume::getFrameRate, &GridVolume::setFrameRate);
         volume.def_property("playbackEnabled", &GridVolume::isPlaybackEnabled, &GridVolume::setPlaybackEnabled);
+        volume.def_property("gridCache", &GridVolume::getGridCache, &GridVolume::setGridCache);
         volume.def_property("densityGrid", &GridVolume::getDensityGrid, &GridVolume::setDensityGrid);
         volume.def_property("densityScale", &GridVolume::getDensityScale, &GridVolume::setDensityScale);
         volume.def_property("emissionGrid", &GridVolume::getEmissionGrid, &GridVolume::setEmissionGrid);
@@ -382,6 +479,26 @@ namespace Falcor
             pybind11::overload_cast<GridVolume::GridSlot, const std::string&, const std::string&, bool>(&GridVolume::loadGridSequence),
             "slot"_a, "path"_a, "gridnames"_a, "keepEmpty"_a = true);
 
+        auto streamGridSequenceFiles = [](GridVolume& volume, GridVolume::GridSlot slot, const std::vector<std::string>& filenames, const std::string& gridname, uint32_t prefetchFrames, uint64_t memoryBudgetMB)
+        {
+            GridStreamer::Options options;
+            options.prefetchFrames = prefetchFrames;
+            options.memoryBudget = memoryBudgetMB << 20;
+            return volume.streamGridSequence(slot, filenames, gridname, options);
+        };
+        auto streamGridSequencePath = [](GridVolume& volume, GridVolume::GridSlot slot, const std::string& path, const std::string& gridname, uint32_t prefetchFrames, uint64_t memoryBudgetMB)
+        {
+            GridStreamer::Options options;
+            options.prefetchFrames = prefetchFrames;
+            options.memoryBudget = memoryBudgetMB << 20;
+            return volume.streamGridSequence(slot, path, gridname, options);
+        };
+        const GridStreamer::Options kDefaultStreamerOptions;
+        volume.def("streamGridSequence", streamGridSequenceFiles,
+            "slot"_a, "filenames"_a, "gridname"_a, "prefetchFrames"_a = kDefaultStreamerOptions.prefetchFrames, "memoryBudgetMB"_a = kDefaultStreamerOptions.memoryBudget >> 20);
+        volume.def("streamGridSequence", streamGridSequencePath,
+            "slot"_a, "path"_a, "gridname"_a, "prefetchFrames"_a = kDefaultStreamerOptions.prefetchFrames, "memoryBudgetMB"_a = kDefaultStreamerOptions.memoryBudget >> 20);
+
         pybind11::enum_<GridVolume::GridSlot> gridSlot(volume, "GridSlot");
         gridSlot.value("Density", GridVolume::GridSlot::Density);
         gridSlot.value("Emission", GridVolume::GridSlot::Emission);
@@ -27,6 +27,8 @@
  **************************************************************************/
 #pragma once
 #include "Grid.h"
+#include "GridCache.h"
+#include "GridStreamer.h"
 #include "GridVolumeData.slang"
 #include "Scene/Animation/Animatable.h"
 
@@ -36,7 +38,8 @@ namespace Falcor
         The absorbing/scattering medium is defined by a density voxel grid and additional parameters.
         The emission is defined by an emission voxel grid and additional parameters.
         Grids are stored in grid slots (density, emission) and can either be static, using one grid per slot,
-        or dynamic, using a sequence of grids per slot.
+        or dynamic, using a sequence of grids per slot. Long sequences can be streamed instead, in which case
+        the grids are loaded when their frame is selected and only a bounded number of frames is kept in memory.
     */
     class dlldecl GridVolume : public Animatable
     {
@@ -100,6 +103,16 @@ namespace Falcor
         */
         const std::string& getName() const { return mName; }
 
+        /** Set the grid cache to load grids through. If nullptr, grids are loaded from their files directly.
+            This applies to grids loaded after the call with loadGrid(), loadGridSequence() and streamGridSequence().
+            Note that the cache never evicts entries (see GridCache::clear()).
+        */
+        void setGridCache(const GridCache::SharedPtr& pGridCache) { mpGridCache = pGridCache; }
+
+        /** Get the grid cache used to load grids, or nullptr if none is set.
+        */
+        const GridCache::SharedPtr& getGridCache() const { return mpGridCache; }
+
         /** Load a single grid from a file to a grid slot.
             Note: This will replace any existing grid sequence for that slot with just a single grid.
             \param[in] slot Grid slot.
@@ -129,11 +142,45 @@ namespace Falcor
         */
         uint32_t loadGridSequence(GridSlot slot, const std::string& path, const std::string& gridname, bool keepEmpty = true);
 
+        /** Stream a sequence of grids from files to a grid slot.
+            The current frame is loaded immediately, the other frames are loaded when needed during playback (see GridStreamer).
+            Note: This will replace any existing grid sequence for that slot.
+            Note: Streaming must be set up before the scene is created. The scene throws on update if a slot starts streaming later.
+            \param[in] slot Grid slot.
+            \param[in] filenames Filenames of the grids. Can also include a full path or relative path from a data directory.
+            \param[in] gridname Name of the grid to load.
+            \param[in] options Streaming options.
+            \return Returns the length of the streamed sequence.
+        */
+        uint32_t streamGridSequence(GridSlot slot, const std::vector<std::string>& filenames, const std::string& gridname, const GridStreamer::Options& options = GridStreamer::Options());
+
+        /** Stream a sequence of grids from a directory to a grid slot.
+            The current frame is loaded immediately, the other frames are loaded when needed during playback (see GridStreamer).
+            Note: This will replace any existing grid sequence for that slot.
+            Note: Streaming must be set up before the scene is created. The scene throws on update if a slot starts streaming later.
+            \param[in] slot Grid slot.
+            \param[in] path Directory containing grid files. Can also include a full path or relative path from a data directory.
+            \param[in] gridname Name of the grid to load.
+            \param[in] options Streaming options.
+            \return Returns the length of the streamed sequence.
+        */
+        uint32_t streamGridSequence(GridSlot slot, const std::string& path, const std::string& gridname, const GridStreamer::Options& options = GridStreamer::Options());
+
+        /** Set the grid streamer for the specified slot.
+            Note: This will replace any existing grid sequence for that slot.
+        */
+        void setGridStreamer(GridSlot slot, const GridStreamer::SharedPtr& pStreamer);
+
+        /** Get the grid streamer for the specified slot, or nullptr if the slot is not streamed.
+        */
+        const GridStreamer::SharedPtr& getGridStreamer(GridSlot slot) const;
+
         /** Set the grid sequence for the specified slot.
         */
         void setGridSequence(GridSlot slot, const GridSequence& grids);
 
         /** Get the grid sequence for the specified slot.
+            Note: This is empty for streamed slots.
         */
         const GridSequence& getGridSequence(GridSlot slot) const;
 
@@ -147,6 +194,7 @@ namespace Falcor
         const Grid::SharedPtr& getGrid(GridSlot slot) const;
 
         /** Get a list of all grids used for this volume.
+            For streamed slots, only the grid of the current frame is included.
         */
         std::vector<Grid::SharedPtr> getAllGrids() const;
 
@@ -261,6 +309,7 @@ namespace Falcor
         GridVolume(const std::string& name);
 
         void updateSequence();
+        void updateStreamedGrids();
         void updateBounds();
 
         void markUpdates(UpdateFlags updates);
@@ -268,6 +317,9 @@ namespace Falcor
 
         std::string mName;
         std::array<GridSequence, (size_t)GridSlot::Count> mGrids;
+        std::array<GridStreamer::SharedPtr, (size_t)GridSlot::Count> mStreamers;    ///< Streamers of the streamed slots.
+        std::array<Grid::SharedPtr, (size_t)GridSlot::Count> mStreamedGrids;        ///< Current grids of the streamed slots.
+        GridCache::SharedPtr mpGridCache;                                           ///< Grid cache used to load grids, or nullptr.
         uint32_t mGridFrame = 0;
         uint32_t mGridFrameCount = 1;
         double mFrameRate = 30.f;
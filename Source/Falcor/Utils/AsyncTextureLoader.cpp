@@ -32,12 +32,30 @@ namespace Falcor
 {
     namespace
     {
-        constexpr size_t kUploadsPerFlush = 16; ///< Number of texture uploads before issuing a flush (to keep upload heap from growing).
+        constexpr size_t kUploadBytesPerFlush = 256ull << 20; ///< Upload heap growth in bytes before issuing a flush (to keep upload heap from growing).
+
+        /** Get the size of the texture data, which is the amount of data uploaded when creating the texture.
+        */
+        uint64_t getDataSize(const Texture* pTexture)
+        {
+            const ResourceFormat format = pTexture->getFormat();
+            uint64_t size = 0;
+            for (uint32_t mip = 0; mip < pTexture->getMipCount(); mip++)
+            {
+                const uint64_t blocksX = div_round_up(pTexture->getWidth(mip), getFormatWidthCompressionRatio(format));
+                const uint64_t blocksY = div_round_up(pTexture->getHeight(mip), getFormatHeightCompressionRatio(format));
+                size += blocksX * blocksY * pTexture->getDepth(mip) * getFormatBytesPerBlock(format);
+            }
+            const uint32_t faceCount = pTexture->getType() == Resource::Type::TextureCube ? 6 : 1;
+            return size * pTexture->getArraySize() * faceCount;
+        }
     }
 
-    AsyncTextureLoader::AsyncTextureLoader(size_t threadCount)
+    AsyncTextureLoader::AsyncTextureLoader(size_t threadCount, size_t maxQueueSize)
+        : mMaxQueueSize(std::max<size_t>(1, maxQueueSize))
     {
-        runWorkers(threadCount);
+        mUploadHeapBaseline = gpDevice->getUploadHeap()->getAllocatedSize();
+        runWorkers(std::max<size_t>(1, threadCount));
     }
 
     AsyncTextureLoader::~AsyncTextureLoader()
@@ -47,74 +65,195 @@ namespace Falcor
         gpDevice->flushAndSync();
     }
 
-    std::future<Texture::SharedPtr> AsyncTextureLoader::loadFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, Resource::BindFlags bindFlags)
+    std::future<Texture::SharedPtr> AsyncTextureLoader::loadFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, Resource::BindFlags bindFlags, const TextureCache::SharedPtr& pTextureCache,
+        Priority priority, const CancellationToken& cancellationToken)
     {
-        std::lock_guard<std::mutex> lock(mMutex);
-        mRequestQueue.push(Request{filename, generateMipLevels, loadAsSrgb, bindFlags});
+        Request request{filename, generateMipLevels, loadAsSrgb, bindFlags, bindFlags == Resource::BindFlags::ShaderResource ? pTextureCache : nullptr, cancellationToken};
+        auto future = request.promise.get_future();
+        enqueue(std::move(request), priority);
+        return future;
+    }
+
+    std::future<AsyncTextureLoader::AnalyzedTexture> AsyncTextureLoader::loadAndAnalyzeFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, AnalysisMode analysisMode, const TextureCache::SharedPtr& pTextureCache,
+        Priority priority, const CancellationToken& cancellationToken)
+    {
+        Request request{filename, generateMipLevels, loadAsSrgb, Resource::BindFlags::ShaderResource, pTextureCache, cancellationToken, analysisMode, true};
+        auto future = request.analyzedPromise.get_future();
+        enqueue(std::move(request), priority);
+        return future;
+    }
+
+    void AsyncTextureLoader::enqueue(Request&& request, Priority priority)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+
+        // Apply back-pressure by waiting until there is room in the queue.
+        mSpaceCondition.wait(lock, [&] () { return mQueueSize < mMaxQueueSize; });
+
+        if (mQueueSize + mActiveLoads == 0) mBusyStart = CpuTimer::getCurrentTimePoint();
+
+        mRequestQueues[(size_t)priority].push(std::move(request));
+
+        mQueueSize++;
+        mStats.requestCount++;
+        mStats.maxQueueDepth = std::max(mStats.maxQueueDepth, mQueueSize);
+
         mCondition.notify_one();
-        return mRequestQueue.back().promise.get_future();
     }
 
-    void AsyncTextureLoader::runWorkers(size_t threadCount)
+    void AsyncTextureLoader::cancelAll()
     {
-        // Create a barrier to synchronize worker threads before issuing a global flush.
-        auto barrier = std::make_shared<Barrier>(threadCount, [&] () {
-            gpDevice->flushAndSync();
-            mFlushPending = false;
-            mUploadCounter = 0;
-        });
+        std::vector<Request> cancelled;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (auto& queue : mRequestQueues)
+            {
+                while (!queue.empty())
+                {
+                    cancelled.push_back(std::move(queue.front()));
+                    queue.pop();
+                }
+            }
+            mQueueSize = 0;
+            mStats.cancelledCount += cancelled.size();
+            if (!cancelled.empty() && mActiveLoads == 0) mStats.busyTime += CpuTimer::calcDuration(mBusyStart, CpuTimer::getCurrentTimePoint()) * 1e-3;
+            mSpaceCondition.notify_all();
+        }
+
+        for (auto& request : cancelled) request.setResult({});
+    }
+
+    AsyncTextureLoader::Stats AsyncTextureLoader::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Stats stats = mStats;
+        stats.queueDepth = mQueueSize;
+        if (mQueueSize + mActiveLoads > 0) stats.busyTime += CpuTimer::calcDuration(mBusyStart, CpuTimer::getCurrentTimePoint()) * 1e-3;
+        return stats;
+    }
 
+    void AsyncTextureLoader::runWorkers(size_t threadCount)
+    {
         // Start worker threads.
         for (size_t i = 0; i < threadCount; ++i)
         {
-            mThreads.emplace_back([&, barrier] () {
+            mThreads.emplace_back([&] () {
                 while (true)
                 {
                     // Wait on condition until more work is ready.
                     std::unique_lock<std::mutex> lock(mMutex);
-                    mCondition.wait(lock, [&] () { return mTerminate || !mRequestQueue.empty() || mFlushPending; });
+                    mCondition.wait(lock, [&] () { return mTerminate || mQueueSize > 0; });
 
-                    // Sync thread if a flush is pending.
-                    if (mFlushPending)
+                    // Terminate thread unless there is more work to do.
+                    if (mQueueSize == 0) break;
+
+                    // Pop next loading request from the highest priority queue.
+                    auto it = std::find_if(mRequestQueues.begin(), mRequestQueues.end(), [] (const auto& queue) { return !queue.empty(); });
+                    auto request = std::move(it->front());
+                    it->pop();
+                    mQueueSize--;
+                    mSpaceCondition.notify_one();
+
+                    if (request.cancellationToken.isCancelled())
                     {
+                        mStats.cancelledCount++;
+                        if (mQueueSize + mActiveLoads == 0) mStats.busyTime += CpuTimer::calcDuration(mBusyStart, CpuTimer::getCurrentTimePoint()) * 1e-3;
                         lock.unlock();
-                        barrier->wait();
-                        mCondition.notify_one();
+                        request.setResult({});
                         continue;
                     }
 
-                    // Terminate thread unless there is more work to do.
-                    if (mTerminate && mRequestQueue.empty() && !mFlushPending) break;
-
-                    // Go back waiting if queue is currently empty.
-                    if (mRequestQueue.empty()) continue;
-
-                    // Pop next loading request from queue.
-                    auto request = std::move(mRequestQueue.front());
-                    mRequestQueue.pop();
-
+                    mActiveLoads++;
                     lock.unlock();
 
                     // Load the textures (this part is running in parallel).
-                    Texture::SharedPtr pTexture = Texture::createFromFile(request.filename, request.generateMipLevels, request.loadAsSrgb, request.bindFlags);
-                    request.promise.set_value(pTexture);
+                    // Flushes wait for the loads in progress, as the uploads are recorded on the same render context.
+                    AnalyzedTexture result;
+                    {
+                        std::shared_lock<std::shared_mutex> uploadLock(mUploadMutex);
+                        result = loadTexture(request);
+                    }
+                    const auto& pTexture = result.pTexture;
 
                     lock.lock();
-
-                    // Issue a global flush if necessary.
-                    // TODO: It would be better to check the size of the upload heap instead.
-                    if (!mTerminate && ++mUploadCounter >= kUploadsPerFlush)
+                    mActiveLoads--;
+                    if (pTexture)
+                    {
+                        mStats.loadedCount++;
+                        mStats.uploadedBytes += getDataSize(pTexture.get());
+                    }
+                    else
                     {
-                        mFlushPending = true;
-                        mCondition.notify_all();
+                        mStats.failedCount++;
                     }
+                    if (mQueueSize + mActiveLoads == 0) mStats.busyTime += CpuTimer::calcDuration(mBusyStart, CpuTimer::getCurrentTimePoint()) * 1e-3;
+                    lock.unlock();
 
-                    mCondition.notify_one();
+                    request.setResult(std::move(result));
+
+                    // Issue a flush if the upload heap has grown too much since the last flush.
+                    if (gpDevice->getUploadHeap()->getAllocatedSize() > mUploadHeapBaseline + kUploadBytesPerFlush) flushUploads();
                 }
             });
         }
     }
 
+    AsyncTextureLoader::AnalyzedTexture AsyncTextureLoader::loadTexture(const Request& request)
+    {
+        // Decode the image here instead of in Texture::createFromFile() to analyze it before it is uploaded.
+        // Images that are not decoded on the CPU are loaded without analysis.
+        if (request.analysisMode == AnalysisMode::None || request.pTextureCache || hasSuffix(request.filename, ".dds"))
+        {
+            auto pTexture = request.pTextureCache ?
+                request.pTextureCache->loadTexture(request.filename, request.generateMipLevels, request.loadAsSrgb) :
+                Texture::createFromFile(request.filename, request.generateMipLevels, request.loadAsSrgb, request.bindFlags);
+            return { pTexture, std::nullopt };
+        }
+
+        std::string fullPath;
+        if (!findFileInDataDirectories(request.filename, fullPath))
+        {
+            logWarning("Error when loading image file. Can't find image file '" + request.filename + "'");
+            return {};
+        }
+
+        Bitmap::UniqueConstPtr pBitmap = Bitmap::createFromFile(fullPath, true);
+        if (!pBitmap) return {};
+
+        AnalyzedTexture result;
+        result.analysis = TextureAnalyzer::analyze(*pBitmap, request.loadAsSrgb);
+
+        // A constant image is created from its top-left texel only.
+        const bool collapse = request.analysisMode == AnalysisMode::CollapseConstant && result.analysis && result.analysis->isConstant(TextureChannelFlags::RGBA);
+        const uint32_t width = collapse ? 1 : pBitmap->getWidth();
+        const uint32_t height = collapse ? 1 : pBitmap->getHeight();
+        const ResourceFormat format = request.loadAsSrgb ? linearToSrgbFormat(pBitmap->getFormat()) : pBitmap->getFormat();
+
+        result.pTexture = Texture::create2D(width, height, format, 1, request.generateMipLevels ? Texture::kMaxPossible : 1, pBitmap->getData(), request.bindFlags);
+        result.pTexture->setSourceFilename(fullPath);
+        return result;
+    }
+
+    void AsyncTextureLoader::Request::setResult(AnalyzedTexture&& result)
+    {
+        if (analyzed) analyzedPromise.set_value(std::move(result));
+        else promise.set_value(result.pTexture);
+    }
+
+    void AsyncTextureLoader::flushUploads()
+    {
+        std::unique_lock<std::shared_mutex> uploadLock(mUploadMutex);
+
+        // Another worker may have flushed while we were waiting.
+        if (gpDevice->getUploadHeap()->getAllocatedSize() <= mUploadHeapBaseline + kUploadBytesPerFlush) return;
+
+        gpDevice->flushAndSync();
+        mUploadHeapBaseline = gpDevice->getUploadHeap()->getAllocatedSize();
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.flushCount++;
+    }
+
     void AsyncTextureLoader::terminateWorkers()
     {
         {
@@ -27,37 +27,144 @@
  **************************************************************************/
 #pragma once
 #include <future>
+#include <array>
+#include <shared_mutex>
 #include "Falcor.h"
+#include "Utils/Image/TextureCache.h"
+#include "Utils/Image/TextureAnalyzer.h"
 
 namespace Falcor
 {
     /** Utility class to load textures asynchronously using multiple worker threads.
+
+        Requests are processed in priority order, and in request order within the same priority.
+        The request queue is bounded: when it is full, loadFromFile() blocks until a worker picks up a request.
+        Requests can be cancelled with a CancellationToken as long as they have not started loading.
+
+        Textures can be analyzed with TextureAnalyzer while they are loaded. Images decoded on the CPU are
+        analyzed before they are uploaded, which allows constant textures to be created with a single texel.
+
+        To keep the upload heap from growing, the workers issue a device flush whenever the upload heap
+        allocations exceed a threshold. Only the workers that are loading a texture finish their load
+        before the flush, idle workers are not involved.
     */
     class dlldecl AsyncTextureLoader
     {
     public:
+        static const size_t kDefaultMaxQueueSize = 1024;
+
+        /** Load priority.
+        */
+        enum class Priority : uint32_t
+        {
+            High,       ///< Textures that are needed first, e.g. environment maps and base color textures.
+            Normal,
+            Low,        ///< Textures with little visual impact, e.g. roughness textures.
+
+            Count
+        };
+
+        /** Analysis to perform in loadAndAnalyzeFromFile().
+        */
+        enum class AnalysisMode
+        {
+            None,               ///< Don't analyze the texture.
+            Analyze,            ///< Analyze the decoded image.
+            CollapseConstant,   ///< Analyze the decoded image. If it is constant in all channels, create the texture with a single texel instead.
+        };
+
+        /** Texture loaded by loadAndAnalyzeFromFile().
+        */
+        struct AnalyzedTexture
+        {
+            Texture::SharedPtr pTexture;                        ///< The texture, or nullptr if it failed to load or the request was cancelled.
+            std::optional<TextureAnalyzer::Result> analysis;    ///< Analysis of the image, if it was decoded on the CPU and its format is supported.
+        };
+
+        /** Token to cancel load requests. Copies of a token share the cancellation state.
+        */
+        class dlldecl CancellationToken
+        {
+        public:
+            CancellationToken() : mpCancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+            /** Cancel all requests issued with this token that have not started loading yet.
+                The futures of cancelled requests return nullptr.
+            */
+            void cancel() { *mpCancelled = true; }
+
+            bool isCancelled() const { return *mpCancelled; }
+
+        private:
+            std::shared_ptr<std::atomic<bool>> mpCancelled;
+        };
+
+        struct Stats
+        {
+            uint64_t requestCount = 0;      ///< Number of requests issued.
+            uint64_t loadedCount = 0;       ///< Number of textures loaded.
+            uint64_t failedCount = 0;       ///< Number of textures that failed to load.
+            uint64_t cancelledCount = 0;    ///< Number of requests cancelled before loading.
+            size_t queueDepth = 0;          ///< Number of requests currently in the queue.
+            size_t maxQueueDepth = 0;       ///< Maximum number of requests in the queue so far.
+            uint64_t uploadedBytes = 0;     ///< Total size of the loaded texture data.
+            uint32_t flushCount = 0;        ///< Number of flushes issued to reclaim upload heap memory.
+            double busyTime = 0.0;          ///< Time in seconds during which requests were queued or loading.
+
+            double getTexturesPerSecond() const { return busyTime > 0.0 ? loadedCount / busyTime : 0.0; }
+            double getBytesPerSecond() const { return busyTime > 0.0 ? uploadedBytes / busyTime : 0.0; }
+        };
+
         /** Constructor.
             \param[in] threadCount Number of worker threads.
+            \param[in] maxQueueSize Maximum number of queued requests.
         */
-        AsyncTextureLoader(size_t threadCount = std::thread::hardware_concurrency());
+        AsyncTextureLoader(size_t threadCount = std::thread::hardware_concurrency(), size_t maxQueueSize = kDefaultMaxQueueSize);
 
         /** Destructor.
             Blocks until all textures are loaded.
         */
         ~AsyncTextureLoader();
 
-        /** Request loading a texture.
+        /** Request loading a texture. Blocks while the request queue is full.
             \param[in] filename Filename of the image. Can also include a full path or relative path from a data directory.
             \param[in] generateMipLevels Whether the mip-chain should be generated.
             \param[in] loadAsSrgb Load the texture using sRGB format. Only valid for 3 or 4 component textures.
             \param[in] bindFlags The bind flags to create the texture with.
-            \return A future to a new texture, or nullptr if the texture failed to load.
+            \param[in] pTextureCache Optional texture cache to load the texture through. Only used with the default bind flags.
+            \param[in] priority Load priority.
+            \param[in] cancellationToken Token to cancel the request with.
+            \return A future to a new texture, or nullptr if the texture failed to load or the request was cancelled.
+        */
+        std::future<Texture::SharedPtr> loadFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, Resource::BindFlags bindFlags = Resource::BindFlags::ShaderResource, const TextureCache::SharedPtr& pTextureCache = nullptr,
+            Priority priority = Priority::Normal, const CancellationToken& cancellationToken = CancellationToken());
+
+        /** Request loading a texture and analyzing its image on the CPU with TextureAnalyzer. Blocks while the request queue is full.
+            Only images decoded on the CPU are analyzed. DDS files and textures loaded from the texture cache are loaded without analysis.
+            \param[in] filename Filename of the image. Can also include a full path or relative path from a data directory.
+            \param[in] generateMipLevels Whether the mip-chain should be generated.
+            \param[in] loadAsSrgb Load the texture using sRGB format. Only valid for 3 or 4 component textures.
+            \param[in] analysisMode Analysis to perform.
+            \param[in] pTextureCache Optional texture cache to load the texture through.
+            \param[in] priority Load priority.
+            \param[in] cancellationToken Token to cancel the request with.
+            \return A future to the texture and its analysis.
+        */
+        std::future<AnalyzedTexture> loadAndAnalyzeFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, AnalysisMode analysisMode, const TextureCache::SharedPtr& pTextureCache = nullptr,
+            Priority priority = Priority::Normal, const CancellationToken& cancellationToken = CancellationToken());
+
+        /** Cancel all queued requests. Requests that are already loading are finished.
         */
-        std::future<Texture::SharedPtr> loadFromFile(const std::string& filename, bool generateMipLevels, bool loadAsSrgb, Resource::BindFlags bindFlags = Resource::BindFlags::ShaderResource);
+        void cancelAll();
+
+        /** Get the loader statistics. This function is thread-safe.
+        */
+        Stats getStats() const;
 
     private:
         void runWorkers(size_t threadCount);
         void terminateWorkers();
+        void flushUploads();
 
         struct Request
         {
@@ -65,15 +172,32 @@ namespace Falcor
             bool generateMipLevels;
             bool loadAsSrgb;
             Resource::BindFlags bindFlags;
+            TextureCache::SharedPtr pTextureCache;
+            CancellationToken cancellationToken;
+            AnalysisMode analysisMode = AnalysisMode::None;
+            bool analyzed = false;                          ///< True if the request was issued by loadAndAnalyzeFromFile(), which fulfills 'analyzedPromise' instead of 'promise'.
             std::promise<Texture::SharedPtr> promise;
+            std::promise<AnalyzedTexture> analyzedPromise;
+
+            void setResult(AnalyzedTexture&& result);
         };
 
-        std::queue<Request> mRequestQueue;      ///< Texture loading request queue.
+        void enqueue(Request&& request, Priority priority);
+        static AnalyzedTexture loadTexture(const Request& request);
+
+        std::array<std::queue<Request>, (size_t)Priority::Count> mRequestQueues;   ///< Texture loading request queues, one per priority.
+        size_t mQueueSize = 0;                  ///< Total number of queued requests.
+        size_t mMaxQueueSize;                   ///< Maximum number of queued requests.
+        size_t mActiveLoads = 0;                ///< Number of requests being loaded.
         std::condition_variable mCondition;     ///< Condition variable for workers to wait on.
-        std::mutex mMutex;                      ///< Mutex for synchronizing access to shared resources.
+        std::condition_variable mSpaceCondition;    ///< Condition variable for producers to wait on when the queue is full.
+        mutable std::mutex mMutex;              ///< Mutex for synchronizing access to shared resources.
+        std::shared_mutex mUploadMutex;         ///< Held shared while loading a texture and exclusively while flushing.
         std::vector<std::thread> mThreads;      ///< Worker threads.
         bool mTerminate = false;                ///< Flag to terminate worker threads.
-        bool mFlushPending = false;             ///< Flag to indicate a flush is pending.
-        uint32_t mUploadCounter = 0;            ///< Counter to issue a flush every few uploads.
+        std::atomic<size_t> mUploadHeapBaseline{ 0 };   ///< Upload heap allocation size after the last flush.
+
+        Stats mStats;
+        CpuTimer::TimePoint mBusyStart;         ///< Start of the current busy period.
     };
 }
@@ -29,6 +29,8 @@
 #include "CryptoUtils.h"
 
 #include <openssl/sha.h>
+#include <fstream>
+#include <vector>
 
 namespace Falcor
 {
@@ -61,4 +63,21 @@ namespace Falcor
         ::SHA1(reinterpret_cast<const unsigned char*>(data), len, md.data());
         return md;
     }
+
+    std::optional<SHA1::MD> SHA1::computeFile(const std::string& path)
+    {
+        std::ifstream fs(path, std::ios_base::binary);
+        if (!fs.good()) return {};
+
+        SHA1 sha1;
+        std::vector<char> buffer(1 << 20);
+        while (fs)
+        {
+            fs.read(buffer.data(), buffer.size());
+            sha1.update(buffer.data(), (size_t)fs.gcount());
+        }
+        if (fs.bad()) return {};
+
+        return sha1.final();
+    }
 }
@@ -28,6 +28,8 @@
 #pragma once
 #include <array>
 #include <cstdint>
+#include <optional>
+#include <string>
 
 namespace Falcor
 {
@@ -59,6 +61,12 @@ namespace Falcor
         */
         static MD compute(const void* data, size_t len);
 
+        /** Compute SHA-1 hash over the content of a file.
+            \param[in] path Path of the file.
+            \return Returns the SHA-1 message digest, or an empty optional if the file could not be read.
+        */
+        static std::optional<MD> computeFile(const std::string& path);
+
     private:
         void* mpCtx;
     };
@@ -29,6 +29,7 @@
 #include "Bitmap.h"
 #include "Core/API/Texture.h"
 #include "Utils/StringUtils.h"
+#include "Utils/Threading.h"
 
 #include <FreeImage.h>
 
@@ -454,6 +455,11 @@ namespace Falcor
     }
 
     void Bitmap::saveImage(const std::string& filename, uint32_t width, uint32_t height, FileFormat fileFormat, ExportFlags exportFlags, ResourceFormat resourceFormat, bool isTopDown, void* pData)
+    {
+        saveImage(filename, width, height, fileFormat, exportFlags, resourceFormat, isTopDown, pData, SaveOptions());
+    }
+
+    void Bitmap::saveImage(const std::string& filename, uint32_t width, uint32_t height, FileFormat fileFormat, ExportFlags exportFlags, ResourceFormat resourceFormat, bool isTopDown, const void* pData, const SaveOptions& options)
     {
         if (pData == nullptr)
         {
@@ -473,26 +479,53 @@ namespace Falcor
             return;
         }
 
-        int flags = 0;
-        FIBITMAP* pImage = nullptr;
-        uint32_t bytesPerPixel = getFormatBytesPerBlock(resourceFormat);
+        const bool exportAlpha = is_set(exportFlags, ExportFlags::ExportAlpha);
+        const bool useB44 = options.exrCompression == ExrCompression::Default && is_set(exportFlags, ExportFlags::Lossy);
 
-        // TODO: Replace this code for swapping channels. Can't use freeimage masks b/c they only care about 16 bpp images.
-        if (resourceFormat == ResourceFormat::RGBA8Unorm || resourceFormat == ResourceFormat::RGBA8Snorm || resourceFormat == ResourceFormat::RGBA8UnormSrgb)
+        if (fileFormat == FileFormat::ExrFile && !useB44 && options.exrCompression != ExrCompression::PIZ)
         {
-            for (uint32_t a = 0; a < width*height; a++)
+            const uint32_t channelCount = getFormatChannelCount(resourceFormat);
+            if (exportAlpha && channelCount < 4)
             {
-                uint32_t* pPixel = (uint32_t*)pData;
-                pPixel += a;
-                uint8_t* ch = (uint8_t*)pPixel;
-                std::swap(ch[0], ch[2]);
-                if (is_set(exportFlags, ExportFlags::ExportAlpha) == false)
-                {
-                    ch[3] = 0xff;
-                }
+                logError("Bitmap::saveImage requesting to export alpha-channel to EXR file, but the resource doesn't have an alpha-channel");
+                return;
+            }
+
+            ExrWriter::Compression compression = ExrWriter::Compression::ZIP;
+            switch (options.exrCompression)
+            {
+            case ExrCompression::Default:
+                if (is_set(exportFlags, ExportFlags::Uncompressed)) compression = ExrWriter::Compression::None;
+                break;
+            case ExrCompression::None: compression = ExrWriter::Compression::None; break;
+            case ExrCompression::RLE: compression = ExrWriter::Compression::RLE; break;
+            case ExrCompression::ZIPS: compression = ExrWriter::Compression::ZIPS; break;
+            case ExrCompression::ZIP: compression = ExrWriter::Compression::ZIP; break;
+            default: should_not_get_here();
+            }
+
+            ExrWriter::Layer layer;
+            layer.format = resourceFormat;
+            layer.pData = pData;
+            layer.channelCount = exportAlpha ? 4 : std::min(channelCount, 3u);
+            layer.isTopDown = isTopDown;
+
+            try
+            {
+                auto pixelType = is_set(exportFlags, ExportFlags::Uncompressed) ? ExrWriter::PixelType::Float : ExrWriter::PixelType::Half;
+                ExrWriter::write(filename, width, height, { layer }, compression, pixelType);
+            }
+            catch (const std::exception& e)
+            {
+                logError("Bitmap::saveImage: failed to save '" + filename + "'. " + e.what());
             }
+            return;
         }
 
+        int flags = 0;
+        FIBITMAP* pImage = nullptr;
+        uint32_t bytesPerPixel = getFormatBytesPerBlock(resourceFormat);
+
         if (fileFormat == Bitmap::FileFormat::PfmFile || fileFormat == Bitmap::FileFormat::ExrFile)
         {
             std::vector<float> floatData;
@@ -509,8 +542,6 @@ namespace Falcor
                 return;
             }
 
-            const bool exportAlpha = is_set(exportFlags, ExportFlags::ExportAlpha);
-
             if (fileFormat == Bitmap::FileFormat::PfmFile)
             {
                 if (is_set(exportFlags, ExportFlags::Lossy))
@@ -535,52 +566,68 @@ namespace Falcor
             bool scanlineCopy = exportAlpha ? bytesPerPixel == 16 : bytesPerPixel == 12;
 
             pImage = FreeImage_AllocateT(exportAlpha ? FIT_RGBAF : FIT_RGBF, width, height);
-            BYTE* head = (BYTE*)pData;
-            for (unsigned y = 0; y < height; y++)
+            Threading::parallelFor(0u, height, [&](uint32_t y)
             {
+                const float* pSrc = reinterpret_cast<const float*>(static_cast<const uint8_t*>(pData) + size_t(y) * bytesPerPixel * width);
                 float* dstBits = (float*)FreeImage_GetScanLine(pImage, height - y - 1);
                 if (scanlineCopy)
                 {
-                    std::memcpy(dstBits, head, bytesPerPixel * width);
+                    std::memcpy(dstBits, pSrc, bytesPerPixel * width);
                 }
                 else
                 {
                     assert(exportAlpha == false);
                     for (unsigned x = 0; x < width; x++)
                     {
-                        dstBits[x*3 + 0] = (((float*)head)[x*4 + 0]);
-                        dstBits[x*3 + 1] = (((float*)head)[x*4 + 1]);
-                        dstBits[x*3 + 2] = (((float*)head)[x*4 + 2]);
+                        dstBits[x*3 + 0] = pSrc[x*4 + 0];
+                        dstBits[x*3 + 1] = pSrc[x*4 + 1];
+                        dstBits[x*3 + 2] = pSrc[x*4 + 2];
                     }
                 }
-                head += bytesPerPixel * width;
-            }
+            });
 
             if (fileFormat == Bitmap::FileFormat::ExrFile)
             {
-                flags = 0;
-                if (is_set(exportFlags, ExportFlags::Uncompressed))
-                {
-                    flags |= EXR_NONE | EXR_FLOAT;
-                }
-                else if (is_set(exportFlags, ExportFlags::Lossy))
-                {
-                    flags |= EXR_B44 | EXR_ZIP;
-                }
+                flags = useB44 ? EXR_B44 | EXR_ZIP : EXR_PIZ;
+                if (is_set(exportFlags, ExportFlags::Uncompressed)) flags |= EXR_FLOAT;
             }
         }
         else
         {
-            FIBITMAP* pTemp = FreeImage_ConvertFromRawBits((BYTE*)pData, width, height, bytesPerPixel * width, bytesPerPixel * 8, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, isTopDown);
-            if (is_set(exportFlags, ExportFlags::ExportAlpha) == false || fileFormat == Bitmap::FileFormat::JpegFile)
+            const bool keepAlpha = exportAlpha && fileFormat != Bitmap::FileFormat::JpegFile;
+            if (bytesPerPixel == 4)
             {
-                pImage = FreeImage_ConvertTo24Bits(pTemp);
-                FreeImage_Unload(pTemp);
+                // Fill the FreeImage bitmap directly. FreeImage stores pixels in BGRA order, so the red and blue channels of RGBA formats are swapped.
+                const bool swapRB = resourceFormat == ResourceFormat::RGBA8Unorm || resourceFormat == ResourceFormat::RGBA8Snorm || resourceFormat == ResourceFormat::RGBA8UnormSrgb;
+                const uint32_t dstBytesPerPixel = keepAlpha ? 4 : 3;
+                pImage = FreeImage_Allocate(width, height, dstBytesPerPixel * 8, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK);
+                Threading::parallelFor(0u, height, [&](uint32_t y)
+                {
+                    const uint8_t* pSrc = static_cast<const uint8_t*>(pData) + size_t(y) * width * 4;
+                    BYTE* pDst = FreeImage_GetScanLine(pImage, isTopDown ? height - y - 1 : y);
+                    for (uint32_t x = 0; x < width; x++, pSrc += 4, pDst += dstBytesPerPixel)
+                    {
+                        pDst[0] = pSrc[swapRB ? 2 : 0];
+                        pDst[1] = pSrc[1];
+                        pDst[2] = pSrc[swapRB ? 0 : 2];
+                        if (keepAlpha) pDst[3] = pSrc[3];
+                    }
+                });
             }
             else
             {
-                pImage = pTemp;
+                FIBITMAP* pTemp = FreeImage_ConvertFromRawBits((BYTE*)pData, width, height, bytesPerPixel * width, bytesPerPixel * 8, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, isTopDown);
+                if (!keepAlpha)
+                {
+                    pImage = FreeImage_ConvertTo24Bits(pTemp);
+                    FreeImage_Unload(pTemp);
+                }
+                else
+                {
+                    pImage = pTemp;
+                }
             }
+            const int pngLevel = options.pngCompressionLevel >= 0 ? std::min(options.pngCompressionLevel, 9) : (is_set(exportFlags, ExportFlags::Uncompressed) ? 0 : 9);
 
             std::vector<std::string> warnings;
             switch(fileFormat)
@@ -598,7 +645,7 @@ namespace Falcor
 
             // Lossless formats
             case FileFormat::PngFile:
-                flags = is_set(exportFlags, ExportFlags::Uncompressed) ? PNG_Z_NO_COMPRESSION : PNG_Z_BEST_COMPRESSION;
+                flags = pngLevel == 0 ? PNG_Z_NO_COMPRESSION : pngLevel;
 
                 if (is_set(exportFlags, ExportFlags::Lossy))
                 {
@@ -26,6 +26,7 @@
  # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************/
 #pragma once
+#include "Utils/Image/ExrWriter.h"
 
 namespace Falcor
 {
@@ -56,6 +57,26 @@ namespace Falcor
                         //< See ImageIO. TODO: Remove(?) Bitmap IO implementation when ImageIO supports other formats
         };
 
+        /** Compression method for EXR files.
+        */
+        enum class ExrCompression
+        {
+            Default,    //< Chosen from the export flags: None for ExportFlags::Uncompressed, B44 for ExportFlags::Lossy, otherwise ZIP
+            None,       //< Uncompressed
+            RLE,        //< Lossless run-length encoding
+            ZIPS,       //< Lossless zlib compression of single scanlines
+            ZIP,        //< Lossless zlib compression of blocks of 16 scanlines
+            PIZ,        //< Lossless wavelet compression. Unlike the other methods, encoding is single-threaded and the image is always saved as RGB(A).
+        };
+
+        /** Per-call options for saveImage().
+        */
+        struct SaveOptions
+        {
+            ExrCompression exrCompression = ExrCompression::Default;    ///< Compression method for EXR files.
+            int pngCompressionLevel = -1;                               ///< zlib compression level in [0,9] for PNG files. If negative, no compression is used for ExportFlags::Uncompressed and the best compression otherwise.
+        };
+
         using UniquePtr = std::unique_ptr<Bitmap>;
         using UniqueConstPtr = std::unique_ptr<const Bitmap>;
 
@@ -87,6 +108,21 @@ namespace Falcor
         */
         static void saveImage(const std::string& filename, uint32_t width, uint32_t height, FileFormat fileFormat, ExportFlags exportFlags, ResourceFormat resourceFormat, bool isTopDown, void* pData);
 
+        /** Store a memory buffer to a file using the given compression options.
+            EXR files (except PIZ and lossy compression) are written by ExrWriter, which compresses blocks of scanlines in parallel and stores 32-bit floats for ExportFlags::Uncompressed and 16-bit floats otherwise.
+            Conversion of 8-bit images to the layout expected by the encoder is parallelized, the caller's buffer is not modified.
+            \param[in] filename Output filename. Can include a path - absolute or relative to the executable directory.
+            \param[in] width The width of the image.
+            \param[in] height The height of the image.
+            \param[in] fileFormat The destination file format. See FileFormat enum above.
+            \param[in] exportFlags The flags to export the file. See ExportFlags above.
+            \param[in] ResourceFormat the format of the resource data
+            \param[in] isTopDown Control the memory layout of the image. If true, the top-left pixel will be stored first, otherwise the bottom-left pixel will be stored first
+            \param[in] pData Pointer to the buffer containing the image
+            \param[in] options Compression options.
+        */
+        static void saveImage(const std::string& filename, uint32_t width, uint32_t height, FileFormat fileFormat, ExportFlags exportFlags, ResourceFormat resourceFormat, bool isTopDown, const void* pData, const SaveOptions& options);
+
         /**  Open dialog to save image to a file
             \param[in] pTexture Texture to save to file
         */
@@ -0,0 +1,617 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "ExrWriter.h"
+#include "Utils/Threading.h"
+#include "glm/detail/type_half.hpp"
+#include <FreeImage.h>
+#include <array>
+#include <fstream>
+
+namespace Falcor
+{
+    namespace
+    {
+        const int32_t kMagic = 20000630;
+        const int32_t kVersion = 2;
+        const int32_t kLongNamesFlag = 0x400;
+        const int32_t kMultiPartFlag = 0x1000;
+        const size_t kMaxShortNameLength = 31;
+        const size_t kMaxLongNameLength = 255;
+
+        const int32_t kPixelTypeUint = 0;
+        const int32_t kPixelTypeHalf = 1;
+        const int32_t kPixelTypeFloat = 2;
+        const uint8_t kLineOrderIncreasingY = 0;
+
+        // Number of chunks compressed in parallel before they are written to the file.
+        // Bounds the memory used for compressed data independent of the image size.
+        const uint32_t kChunksPerThread = 4;
+
+        using ConvertFunc = void(*)(const uint8_t* pSrc, size_t srcStride, uint32_t count, uint8_t* pDst);
+        using LoadFunc = float(*)(const uint8_t* pSrc);
+
+        /** Channel as stored in the file, referencing the source data of its layer.
+        */
+        struct Channel
+        {
+            std::string name;
+            const uint8_t* pData;       ///< Pointer to the channel in the top-left pixel.
+            ptrdiff_t rowPitch;         ///< Offset between rows from top to bottom. Negative for bottom-up layers.
+            size_t pixelStride;         ///< Offset between pixels of a row.
+            int32_t pixelType;          ///< Pixel type stored in the file.
+            size_t bytesPerValue;       ///< Size of the stored pixel type in bytes.
+            ConvertFunc convert;        ///< Converts a row of the channel to the pixel type stored in the file.
+        };
+
+        /** Part of the file with its converted layers.
+        */
+        struct PartDesc
+        {
+            uint32_t width;
+            uint32_t height;
+            std::vector<Channel> channels;
+            uint32_t chunkCount;
+        };
+
+        float loadFloat(const uint8_t* pSrc)
+        {
+            float v;
+            std::memcpy(&v, pSrc, sizeof(v));
+            return v;
+        }
+
+        float loadHalf(const uint8_t* pSrc)
+        {
+            glm::detail::hdata v;
+            std::memcpy(&v, pSrc, sizeof(v));
+            return glm::detail::toFloat32(v);
+        }
+
+        /** Loads an integer value normalized to [0,1] for unsigned and [-1,1] for signed types.
+        */
+        template<typename T>
+        float loadNormalized(const uint8_t* pSrc)
+        {
+            T v;
+            std::memcpy(&v, pSrc, sizeof(v));
+            return std::max(float(v) / float(std::numeric_limits<T>::max()), -1.f);
+        }
+
+        float loadSrgb8(const uint8_t* pSrc)
+        {
+            static const auto kTable = []()
+            {
+                std::array<float, 256> table;
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    float c = i / 255.f;
+                    table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+                return table;
+            }();
+            return kTable[*pSrc];
+        }
+
+        template<LoadFunc load>
+        void convertToHalf(const uint8_t* pSrc, size_t srcStride, uint32_t count, uint8_t* pDst)
+        {
+            for (uint32_t i = 0; i < count; i++, pSrc += srcStride, pDst += sizeof(glm::detail::hdata))
+            {
+                glm::detail::hdata v = glm::detail::toFloat16(load(pSrc));
+                std::memcpy(pDst, &v, sizeof(v));
+            }
+        }
+
+        template<LoadFunc load>
+        void convertToFloat(const uint8_t* pSrc, size_t srcStride, uint32_t count, uint8_t* pDst)
+        {
+            for (uint32_t i = 0; i < count; i++, pSrc += srcStride, pDst += sizeof(float))
+            {
+                float v = load(pSrc);
+                std::memcpy(pDst, &v, sizeof(v));
+            }
+        }
+
+        template<typename T>
+        void convertToUint(const uint8_t* pSrc, size_t srcStride, uint32_t count, uint8_t* pDst)
+        {
+            for (uint32_t i = 0; i < count; i++, pSrc += srcStride, pDst += sizeof(uint32_t))
+            {
+                T v;
+                std::memcpy(&v, pSrc, sizeof(v));
+                uint32_t u = uint32_t(v);
+                std::memcpy(pDst, &u, sizeof(u));
+            }
+        }
+
+        template<size_t N>
+        void copyValues(const uint8_t* pSrc, size_t srcStride, uint32_t count, uint8_t* pDst)
+        {
+            for (uint32_t i = 0; i < count; i++, pSrc += srcStride, pDst += N) std::memcpy(pDst, pSrc, N);
+        }
+
+        template<LoadFunc load>
+        ConvertFunc getConvertFunc(ExrWriter::PixelType pixelType)
+        {
+            return pixelType == ExrWriter::PixelType::Half ? convertToHalf<load> : convertToFloat<load>;
+        }
+
+        ConvertFunc getConvertFunc(FormatType type, uint32_t channelBits, ExrWriter::PixelType pixelType)
+        {
+            const bool isHalf = pixelType == ExrWriter::PixelType::Half;
+            switch (type)
+            {
+            case FormatType::Float:
+                if (channelBits == 16) return isHalf ? copyValues<2> : convertToFloat<loadHalf>;
+                if (channelBits == 32) return isHalf ? convertToHalf<loadFloat> : copyValues<4>;
+                break;
+            case FormatType::Unorm:
+            case FormatType::Uint:
+                if (channelBits == 8) return getConvertFunc<loadNormalized<uint8_t>>(pixelType);
+                if (channelBits == 16) return getConvertFunc<loadNormalized<uint16_t>>(pixelType);
+                if (channelBits == 32) return getConvertFunc<loadNormalized<uint32_t>>(pixelType);
+                break;
+            case FormatType::Snorm:
+            case FormatType::Sint:
+                if (channelBits == 8) return getConvertFunc<loadNormalized<int8_t>>(pixelType);
+                if (channelBits == 16) return getConvertFunc<loadNormalized<int16_t>>(pixelType);
+                if (channelBits == 32) return getConvertFunc<loadNormalized<int32_t>>(pixelType);
+                break;
+            case FormatType::UnormSrgb:
+                if (channelBits == 8) return getConvertFunc<loadSrgb8>(pixelType);
+                break;
+            default:
+                break;
+            }
+            return nullptr;
+        }
+
+        ConvertFunc getUintConvertFunc(FormatType type, uint32_t channelBits)
+        {
+            if (type == FormatType::Uint)
+            {
+                if (channelBits == 8) return convertToUint<uint8_t>;
+                if (channelBits == 16) return convertToUint<uint16_t>;
+                if (channelBits == 32) return copyValues<4>;
+            }
+            else if (type == FormatType::Sint)
+            {
+                if (channelBits == 8) return convertToUint<int8_t>;
+                if (channelBits == 16) return convertToUint<int16_t>;
+                if (channelBits == 32) return copyValues<4>;
+            }
+            return nullptr;
+        }
+
+        /** Check that all channels of the format have the same size and return it, or zero otherwise.
+        */
+        uint32_t getUniformChannelBits(ResourceFormat format)
+        {
+            const uint32_t channelCount = getFormatChannelCount(format);
+            const uint32_t channelBits = getNumChannelBits(format, 0);
+            for (uint32_t c = 1; c < channelCount; c++)
+            {
+                if (getNumChannelBits(format, c) != channelBits) return 0;
+            }
+            return channelBits;
+        }
+
+        /** Get the index of the source channel holding the given RGBA channel.
+        */
+        uint32_t getSourceChannel(ResourceFormat format, uint32_t channel)
+        {
+            switch (format)
+            {
+            case ResourceFormat::BGRA8Unorm:
+            case ResourceFormat::BGRA8UnormSrgb:
+            case ResourceFormat::BGRX8Unorm:
+            case ResourceFormat::BGRX8UnormSrgb:
+                return channel < 3 ? 2 - channel : channel;
+            default:
+                return channel;
+            }
+        }
+
+        std::vector<Channel> createChannels(uint32_t width, uint32_t height, const std::vector<ExrWriter::Layer>& layers, ExrWriter::PixelType pixelType)
+        {
+            static const char* kChannelNames[] = { "R", "G", "B", "A" };
+
+            std::vector<Channel> channels;
+            for (const auto& layer : layers)
+            {
+                const std::string layerName = layer.name.empty() ? "default" : "'" + layer.name + "'";
+                if (layer.pData == nullptr) throw std::exception(("Layer " + layerName + " has no data.").c_str());
+                if (!ExrWriter::isFormatSupported(layer.format)) throw std::exception(("Layer " + layerName + " has an unsupported format.").c_str());
+
+                const FormatType type = getFormatType(layer.format);
+                const uint32_t channelBits = getNumChannelBits(layer.format, 0);
+                const bool storeUint = layer.storeIntegers && (type == FormatType::Uint || type == FormatType::Sint);
+                const ConvertFunc convert = storeUint ? getUintConvertFunc(type, channelBits) : getConvertFunc(type, channelBits, pixelType);
+                assert(convert);
+
+                const uint32_t formatChannelCount = getFormatChannelCount(layer.format);
+                const uint32_t channelCount = layer.channelCount == 0 ? formatChannelCount : layer.channelCount;
+                if (channelCount > formatChannelCount) throw std::exception(("Layer " + layerName + " has only " + std::to_string(formatChannelCount) + " channels.").c_str());
+
+                const size_t pixelStride = getFormatBytesPerBlock(layer.format);
+                const size_t rowPitch = layer.rowPitch == 0 ? width * pixelStride : layer.rowPitch;
+                if (rowPitch < width * pixelStride) throw std::exception(("Layer " + layerName + " has a row pitch smaller than a row of pixels.").c_str());
+
+                const uint8_t* pData = static_cast<const uint8_t*>(layer.pData);
+                if (!layer.isTopDown) pData += (height - 1) * rowPitch;
+
+                for (uint32_t c = 0; c < channelCount; c++)
+                {
+                    Channel channel;
+                    channel.name = channelCount == 1 ? "Y" : kChannelNames[c];
+                    if (!layer.name.empty()) channel.name = layer.name + "." + channel.name;
+                    channel.pData = pData + getSourceChannel(layer.format, c) * (channelBits / 8);
+                    channel.rowPitch = layer.isTopDown ? ptrdiff_t(rowPitch) : -ptrdiff_t(rowPitch);
+                    channel.pixelStride = pixelStride;
+                    if (storeUint) channel.pixelType = kPixelTypeUint;
+                    else channel.pixelType = pixelType == ExrWriter::PixelType::Half ? kPixelTypeHalf : kPixelTypeFloat;
+                    channel.bytesPerValue = channel.pixelType == kPixelTypeHalf ? 2 : 4;
+                    channel.convert = convert;
+                    channels.push_back(channel);
+                }
+            }
+
+            // Channels are stored in alphabetical order.
+            std::sort(channels.begin(), channels.end(), [](const Channel& a, const Channel& b) { return a.name < b.name; });
+            for (size_t i = 1; i < channels.size(); i++)
+            {
+                if (channels[i].name == channels[i - 1].name) throw std::exception(("Duplicate channel '" + channels[i].name + "'.").c_str());
+            }
+            return channels;
+        }
+
+        template<typename T>
+        void append(std::vector<uint8_t>& data, const T& value)
+        {
+            const uint8_t* pValue = reinterpret_cast<const uint8_t*>(&value);
+            data.insert(data.end(), pValue, pValue + sizeof(T));
+        }
+
+        void appendString(std::vector<uint8_t>& data, const std::string& str)
+        {
+            data.insert(data.end(), str.begin(), str.end());
+            data.push_back(0);
+        }
+
+        void appendAttribute(std::vector<uint8_t>& data, const std::string& name, const std::string& type, const std::vector<uint8_t>& value)
+        {
+            appendString(data, name);
+            appendString(data, type);
+            append(data, int32_t(value.size()));
+            data.insert(data.end(), value.begin(), value.end());
+        }
+
+        template<typename... Args>
+        std::vector<uint8_t> makeValue(const Args&... args)
+        {
+            std::vector<uint8_t> value;
+            (append(value, args), ...);
+            return value;
+        }
+
+        /** Appends the attributes of a part's header.
+            \param[in] pName Part name, only written for multi-part files.
+            \return True if the header contains names longer than 31 characters.
+        */
+        bool appendHeader(std::vector<uint8_t>& data, const PartDesc& part, uint32_t displayWidth, uint32_t displayHeight, ExrWriter::Compression compression, const std::string* pName)
+        {
+            bool longNames = false;
+            std::vector<uint8_t> channelList;
+            for (const auto& channel : part.channels)
+            {
+                if (channel.name.size() > kMaxLongNameLength) throw std::exception(("Channel name '" + channel.name + "' is too long.").c_str());
+                longNames |= channel.name.size() > kMaxShortNameLength;
+                appendString(channelList, channel.name);
+                append(channelList, channel.pixelType);
+                append(channelList, uint32_t(0)); // pLinear and reserved bytes
+                append(channelList, int32_t(1)); // xSampling
+                append(channelList, int32_t(1)); // ySampling
+            }
+            channelList.push_back(0);
+
+            appendAttribute(data, "channels", "chlist", channelList);
+            appendAttribute(data, "compression", "compression", makeValue(uint8_t(compression)));
+            appendAttribute(data, "dataWindow", "box2i", makeValue(0, 0, int32_t(part.width) - 1, int32_t(part.height) - 1));
+            appendAttribute(data, "displayWindow", "box2i", makeValue(0, 0, int32_t(displayWidth) - 1, int32_t(displayHeight) - 1));
+            appendAttribute(data, "lineOrder", "lineOrder", makeValue(kLineOrderIncreasingY));
+            appendAttribute(data, "pixelAspectRatio", "float", makeValue(1.f));
+            appendAttribute(data, "screenWindowCenter", "v2f", makeValue(0.f, 0.f));
+            appendAttribute(data, "screenWindowWidth", "float", makeValue(1.f));
+
+            if (pName)
+            {
+                // Multi-part files store the part name, type and chunk count in each header. Strings are not null-terminated.
+                if (pName->size() > kMaxLongNameLength) throw std::exception(("Part name '" + *pName + "' is too long.").c_str());
+                longNames |= pName->size() > kMaxShortNameLength;
+                appendAttribute(data, "name", "string", std::vector<uint8_t>(pName->begin(), pName->end()));
+                const std::string type = "scanlineimage";
+                appendAttribute(data, "type", "string", std::vector<uint8_t>(type.begin(), type.end()));
+                appendAttribute(data, "chunkCount", "int", makeValue(int32_t(part.chunkCount)));
+            }
+
+            data.push_back(0);
+            return longNames;
+        }
+
+        /** Splits the data into even and odd bytes and replaces the bytes with their difference to the previous byte.
+            This is the preprocessing step shared by the RLE and ZIP compressors.
+        */
+        void reorderAndPredict(const uint8_t* pSrc, size_t size, uint8_t* pDst)
+        {
+            uint8_t* pEven = pDst;
+            uint8_t* pOdd = pDst + (size + 1) / 2;
+            for (size_t i = 0; i < size; i += 2)
+            {
+                *pEven++ = pSrc[i];
+                if (i + 1 < size) *pOdd++ = pSrc[i + 1];
+            }
+
+            uint8_t prev = pDst[0];
+            for (size_t i = 1; i < size; i++)
+            {
+                uint8_t value = pDst[i];
+                pDst[i] = uint8_t(int(value) - int(prev) + (128 + 256));
+                prev = value;
+            }
+        }
+
+        /** Run-length encodes the data. A non-negative count byte c is followed by one byte repeated c + 1 times,
+            a negative count byte c is followed by -c literal bytes.
+            \return Size of the encoded data.
+        */
+        size_t rleCompress(const uint8_t* pSrc, size_t size, uint8_t* pDst)
+        {
+            const ptrdiff_t kMinRunLength = 3;
+            const ptrdiff_t kMaxRunLength = 127;
+
+            const uint8_t* pEnd = pSrc + size;
+            const uint8_t* pRunStart = pSrc;
+            const uint8_t* pRunEnd = pSrc + 1;
+            uint8_t* pOut = pDst;
+
+            while (pRunStart < pEnd)
+            {
+                while (pRunEnd < pEnd && *pRunStart == *pRunEnd && pRunEnd - pRunStart - 1 < kMaxRunLength) ++pRunEnd;
+
+                if (pRunEnd - pRunStart >= kMinRunLength)
+                {
+                    *pOut++ = uint8_t(pRunEnd - pRunStart - 1);
+                    *pOut++ = *pRunStart;
+                    pRunStart = pRunEnd;
+                }
+                else
+                {
+                    // Extend the literal run until a run of three equal bytes starts.
+                    while (pRunEnd < pEnd &&
+                        ((pRunEnd + 1 >= pEnd || pRunEnd[0] != pRunEnd[1]) || (pRunEnd + 2 >= pEnd || pRunEnd[1] != pRunEnd[2])) &&
+                        pRunEnd - pRunStart < kMaxRunLength)
+                    {
+                        ++pRunEnd;
+                    }
+
+                    *pOut++ = uint8_t(pRunStart - pRunEnd);
+                    while (pRunStart < pRunEnd) *pOut++ = *pRunStart++;
+                }
+
+                ++pRunEnd;
+            }
+
+            return pOut - pDst;
+        }
+
+        /** Converts and compresses the scanlines [y, y + lineCount) of a part into a chunk including the chunk header.
+            \param[in] partIndex Index of the part, or -1 for single-part files.
+        */
+        void writeChunk(const PartDesc& part, uint32_t y, uint32_t lineCount, int32_t partIndex, ExrWriter::Compression compression, std::vector<uint8_t>& chunk)
+        {
+            size_t bytesPerLine = 0;
+            for (const auto& channel : part.channels) bytesPerLine += part.width * channel.bytesPerValue;
+            const size_t rawSize = lineCount * bytesPerLine;
+            std::vector<uint8_t> raw(rawSize);
+
+            uint8_t* pDst = raw.data();
+            for (uint32_t line = y; line < y + lineCount; line++)
+            {
+                for (const auto& channel : part.channels)
+                {
+                    channel.convert(channel.pData + ptrdiff_t(line) * channel.rowPitch, channel.pixelStride, part.width, pDst);
+                    pDst += part.width * channel.bytesPerValue;
+                }
+            }
+
+            std::vector<uint8_t> compressed;
+            size_t compressedSize = 0;
+            if (compression != ExrWriter::Compression::None)
+            {
+                std::vector<uint8_t> predicted(rawSize);
+                reorderAndPredict(raw.data(), rawSize, predicted.data());
+
+                if (compression == ExrWriter::Compression::RLE)
+                {
+                    compressed.resize(rawSize + rawSize / 64 + 16);
+                    compressedSize = rleCompress(predicted.data(), rawSize, compressed.data());
+                }
+                else
+                {
+                    compressed.resize(rawSize + rawSize / 1000 + 64);
+                    compressedSize = FreeImage_ZLibCompress(compressed.data(), DWORD(compressed.size()), predicted.data(), DWORD(rawSize));
+                }
+            }
+
+            // Chunks that don't get smaller are stored uncompressed, readers detect this from the data size.
+            const bool useCompressed = compressedSize > 0 && compressedSize < rawSize;
+            const uint8_t* pData = useCompressed ? compressed.data() : raw.data();
+            const size_t dataSize = useCompressed ? compressedSize : rawSize;
+
+            chunk.clear();
+            chunk.reserve(12 + dataSize);
+            if (partIndex >= 0) append(chunk, partIndex);
+            append(chunk, int32_t(y));
+            append(chunk, int32_t(dataSize));
+            chunk.insert(chunk.end(), pData, pData + dataSize);
+        }
+
+        PartDesc createPart(uint32_t width, uint32_t height, const std::vector<ExrWriter::Layer>& layers, ExrWriter::Compression compression, ExrWriter::PixelType pixelType)
+        {
+            if (width == 0 || height == 0) throw std::exception("Image is empty.");
+            if (layers.empty()) throw std::exception("No layers to write.");
+
+            PartDesc part;
+            part.width = width;
+            part.height = height;
+            part.channels = createChannels(width, height, layers, pixelType);
+            const uint32_t linesPerChunk = ExrWriter::getScanlinesPerChunk(compression);
+            part.chunkCount = (height + linesPerChunk - 1) / linesPerChunk;
+            return part;
+        }
+
+        void writeFile(const std::string& filename, const std::vector<PartDesc>& parts, const std::vector<std::string>* pPartNames, ExrWriter::Compression compression)
+        {
+            const bool isMultiPart = pPartNames != nullptr;
+
+            // Headers.
+            uint32_t displayWidth = 0;
+            uint32_t displayHeight = 0;
+            for (const auto& part : parts)
+            {
+                displayWidth = std::max(displayWidth, part.width);
+                displayHeight = std::max(displayHeight, part.height);
+            }
+
+            std::vector<uint8_t> header;
+            bool longNames = false;
+            for (size_t i = 0; i < parts.size(); i++)
+            {
+                longNames |= appendHeader(header, parts[i], displayWidth, displayHeight, compression, isMultiPart ? &(*pPartNames)[i] : nullptr);
+            }
+            if (isMultiPart) header.push_back(0);
+
+            int32_t version = kVersion;
+            if (longNames) version |= kLongNamesFlag;
+            if (isMultiPart) version |= kMultiPartFlag;
+
+            std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+            if (!file) throw std::exception(("Can't open file '" + filename + "' for writing.").c_str());
+
+            file.write(reinterpret_cast<const char*>(&kMagic), sizeof(kMagic));
+            file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            file.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+            // The offset tables are written after the chunks, once their offsets are known.
+            uint64_t position = sizeof(kMagic) + sizeof(version) + header.size();
+            const uint64_t offsetTablePosition = position;
+            // The chunk list is ordered by part, so the offset tables of all parts are stored contiguously.
+            std::vector<std::pair<uint32_t, uint32_t>> chunkList; // Part and chunk index of all chunks.
+            for (uint32_t p = 0; p < (uint32_t)parts.size(); p++)
+            {
+                for (uint32_t i = 0; i < parts[p].chunkCount; i++) chunkList.emplace_back(p, i);
+            }
+            position += chunkList.size() * sizeof(uint64_t);
+            std::vector<uint64_t> offsets(chunkList.size());
+            file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+
+            // Compress batches of chunks in parallel and write them in order.
+            const uint32_t chunkCount = (uint32_t)chunkList.size();
+            const uint32_t batchSize = Threading::getThreadCount() * kChunksPerThread;
+            std::vector<std::vector<uint8_t>> chunks(std::min(batchSize, chunkCount));
+            for (uint32_t firstChunk = 0; firstChunk < chunkCount && file; firstChunk += batchSize)
+            {
+                const uint32_t lastChunk = std::min(firstChunk + batchSize, chunkCount);
+                Threading::parallelFor(firstChunk, lastChunk, [&](uint32_t i)
+                {
+                    const auto& part = parts[chunkList[i].first];
+                    const uint32_t linesPerChunk = ExrWriter::getScanlinesPerChunk(compression);
+                    const uint32_t y = chunkList[i].second * linesPerChunk;
+                    const int32_t partIndex = isMultiPart ? int32_t(chunkList[i].first) : -1;
+                    writeChunk(part, y, std::min(linesPerChunk, part.height - y), partIndex, compression, chunks[i - firstChunk]);
+                }, 1);
+
+                for (uint32_t i = firstChunk; i < lastChunk; i++)
+                {
+                    const auto& chunk = chunks[i - firstChunk];
+                    offsets[i] = position;
+                    file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+                    position += chunk.size();
+                }
+            }
+
+            file.seekp(offsetTablePosition);
+            file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+            file.close();
+            if (!file) throw std::exception(("Failed to write file '" + filename + "'.").c_str());
+        }
+    }
+
+    uint32_t ExrWriter::getScanlinesPerChunk(Compression compression)
+    {
+        return compression == Compression::ZIP ? 16 : 1;
+    }
+
+    bool ExrWriter::isFormatSupported(ResourceFormat format)
+    {
+        if (format == ResourceFormat::Unknown || isCompressedFormat(format)) return false;
+        const uint32_t channelCount = getFormatChannelCount(format);
+        if (channelCount == 0 || channelCount > 4) return false;
+        const uint32_t channelBits = getUniformChannelBits(format);
+        return getConvertFunc(getFormatType(format), channelBits, PixelType::Float) != nullptr;
+    }
+
+    void ExrWriter::write(const std::string& filename, uint32_t width, uint32_t height, const std::vector<Layer>& layers, Compression compression, PixelType pixelType)
+    {
+        const std::vector<PartDesc> parts = { createPart(width, height, layers, compression, pixelType) };
+        writeFile(filename, parts, nullptr, compression);
+    }
+
+    void ExrWriter::writeMultiPart(const std::string& filename, const std::vector<Part>& parts, Compression compression, PixelType pixelType)
+    {
+        if (parts.empty()) throw std::exception("No parts to write.");
+
+        std::vector<PartDesc> partDescs;
+        std::vector<std::string> names;
+        for (const auto& part : parts)
+        {
+            if (std::find(names.begin(), names.end(), part.name) != names.end()) throw std::exception(("Duplicate part '" + part.name + "'.").c_str());
+            try
+            {
+                partDescs.push_back(createPart(part.width, part.height, part.layers, compression, pixelType));
+            }
+            catch (const std::exception& e)
+            {
+                throw std::exception(("Part '" + part.name + "': " + e.what()).c_str());
+            }
+            names.push_back(part.name);
+        }
+        writeFile(filename, partDescs, &names, compression);
+    }
+}
@@ -0,0 +1,113 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+
+namespace Falcor
+{
+    /** Writer for OpenEXR scanline images.
+
+        The image is split into chunks of scanlines which are converted and compressed in parallel on the global thread pool.
+        Pixel data is read directly from the caller's memory, so several images (e.g. the AOVs of a frame) can be written
+        as layers of a single file without first copying them into an interleaved buffer.
+    */
+    class dlldecl ExrWriter
+    {
+    public:
+        /** Compression method. The values match the OpenEXR file format.
+        */
+        enum class Compression : uint8_t
+        {
+            None = 0,   ///< Uncompressed.
+            RLE = 1,    ///< Lossless run-length encoding, one scanline per chunk.
+            ZIPS = 2,   ///< Lossless zlib compression, one scanline per chunk.
+            ZIP = 3,    ///< Lossless zlib compression, 16 scanlines per chunk.
+        };
+
+        /** Pixel type stored in the file.
+        */
+        enum class PixelType
+        {
+            Half,       ///< 16-bit floating point.
+            Float,      ///< 32-bit floating point.
+        };
+
+        /** Image written as a layer of the file.
+        */
+        struct Layer
+        {
+            std::string name;                                   ///< Layer name. Channels are named '<name>.R', '<name>.G' etc. If empty, the channels form the default layer.
+            ResourceFormat format = ResourceFormat::Unknown;    ///< Format of the pixel data. Uncompressed formats with up to four equally sized channels are supported.
+            const void* pData = nullptr;                        ///< Pointer to the pixel data. Must stay valid until write() returns.
+            uint32_t rowPitch = 0;                              ///< Row pitch in bytes. If zero, the rows are tightly packed.
+            uint32_t channelCount = 0;                          ///< Number of channels to write, starting with the first. If zero, all channels of the format are written.
+            bool isTopDown = true;                              ///< If true, the first row in memory is the top row of the image.
+            bool storeIntegers = false;                         ///< If true, integer formats are stored as 32-bit unsigned integers instead of normalized floating point. Signed values are stored as their two's complement bit pattern.
+        };
+
+        /** Image written as a part of a multi-part file. Unlike the layers of a part, parts can have different dimensions.
+        */
+        struct Part
+        {
+            std::string name;                                   ///< Part name. Must be unique within the file.
+            uint32_t width = 0;                                 ///< Width of the image in pixels.
+            uint32_t height = 0;                                ///< Height of the image in pixels.
+            std::vector<Layer> layers;                          ///< Layers of the part.
+        };
+
+        /** Write an EXR file.
+            Integer and normalized formats are converted to floating point in [0,1] for unsigned and [-1,1] for signed formats, sRGB formats are converted to linear.
+            Single channel layers are written as luminance channel 'Y'.
+            Throws an exception if the layers are invalid or the file cannot be written.
+            \param[in] filename Filename to save to.
+            \param[in] width Width of the image in pixels.
+            \param[in] height Height of the image in pixels.
+            \param[in] layers Layers to write. All layers have the given dimensions and their channel names must be unique.
+            \param[in] compression Compression method.
+            \param[in] pixelType Pixel type stored in the file for floating point channels.
+        */
+        static void write(const std::string& filename, uint32_t width, uint32_t height, const std::vector<Layer>& layers, Compression compression = Compression::ZIP, PixelType pixelType = PixelType::Half);
+
+        /** Write a multi-part EXR file (OpenEXR 2.0). Chunks of all parts are compressed in parallel.
+            The display window of all parts is the union of their data windows.
+            Throws an exception if the parts are invalid or the file cannot be written.
+            \param[in] filename Filename to save to.
+            \param[in] parts Parts to write, in the order they are stored.
+            \param[in] compression Compression method used for all parts.
+            \param[in] pixelType Pixel type stored in the file for floating point channels.
+        */
+        static void writeMultiPart(const std::string& filename, const std::vector<Part>& parts, Compression compression = Compression::ZIP, PixelType pixelType = PixelType::Half);
+
+        /** Check if a resource format can be written.
+        */
+        static bool isFormatSupported(ResourceFormat format);
+
+        /** Get the number of scanlines stored per chunk for a compression method.
+        */
+        static uint32_t getScanlinesPerChunk(Compression compression);
+    };
+}
@@ -248,6 +248,70 @@ namespace Falcor
         }
     }
 
+    ImageIO::DDSDesc ImageIO::getDDSDesc(const std::string& filename)
+    {
+        std::string fullpath;
+        if (findFileInDataDirectories(filename, fullpath) == false)
+        {
+            throw std::exception(("Can't find file: '" + filename + "'").c_str());
+        }
+
+        DirectX::TexMetadata meta = {};
+        if (FAILED(DirectX::GetMetadataFromDDSFile(string_2_wstring(fullpath).c_str(), DirectX::DDS_FLAGS_NONE, meta)))
+        {
+            throw std::exception(("Failed to read file: '" + filename + "'").c_str());
+        }
+
+        DDSDesc desc;
+        switch (meta.dimension)
+        {
+        case DirectX::TEX_DIMENSION_TEXTURE1D:
+            desc.type = Resource::Type::Texture1D;
+            break;
+        case DirectX::TEX_DIMENSION_TEXTURE2D:
+            desc.type = meta.IsCubemap() ? Resource::Type::TextureCube : Resource::Type::Texture2D;
+            break;
+        case DirectX::TEX_DIMENSION_TEXTURE3D:
+            desc.type = Resource::Type::Texture3D;
+            break;
+        }
+        desc.format = getResourceFormat(meta.format);
+        desc.width = (uint32_t)meta.width;
+        desc.height = (uint32_t)meta.height;
+        desc.depth = (uint32_t)meta.depth;
+        desc.arraySize = (uint32_t)meta.arraySize;
+        desc.mipLevels = (uint32_t)meta.mipLevels;
+
+        return desc;
+    }
+
+    ImageIO::MipChain ImageIO::loadMipChainFromDDS(const std::string& filename, bool loadAsSrgb, uint32_t mostDetailedMip)
+    {
+        ImportData data = loadDDS(filename, loadAsSrgb);
+
+        const auto& scratchImage = data.image.scratchImage;
+        const auto& meta = scratchImage.GetMetadata();
+        if (meta.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || meta.IsCubemap() || meta.arraySize != 1)
+        {
+            throw std::exception(("Cannot load mip chain of '" + filename + "'. Only 2D textures without array slices are supported.").c_str());
+        }
+
+        mostDetailedMip = std::min(mostDetailedMip, data.mipLevels - 1);
+
+        MipChain mipChain;
+        mipChain.format = data.format;
+        mipChain.width = std::max(1u, data.width >> mostDetailedMip);
+        mipChain.height = std::max(1u, data.height >> mostDetailedMip);
+        mipChain.mipLevels = data.mipLevels - mostDetailedMip;
+
+        // The images of a scratch image are tightly packed, copy the requested range.
+        const uint8_t* pBegin = scratchImage.GetImage(mostDetailedMip, 0, 0)->pixels;
+        const uint8_t* pEnd = scratchImage.GetPixels() + scratchImage.GetPixelsSize();
+        mipChain.data.assign(pBegin, pEnd);
+
+        return mipChain;
+    }
+
     Bitmap::UniqueConstPtr ImageIO::loadBitmapFromDDS(const std::string& filename)
     {
         ImportData data = loadDDS(filename, false);
@@ -76,6 +76,47 @@ namespace Falcor
             None
         };
 
+        /** Description of the image stored in a DDS file.
+        */
+        struct DDSDesc
+        {
+            Resource::Type type = Resource::Type::Texture2D;
+            ResourceFormat format = ResourceFormat::Unknown;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t depth = 0;
+            uint32_t arraySize = 0;
+            uint32_t mipLevels = 0;
+        };
+
+        /** Range of mip levels of a 2D texture loaded to CPU memory.
+        */
+        struct MipChain
+        {
+            ResourceFormat format = ResourceFormat::Unknown;
+            uint32_t width = 0;             ///< Width of the most detailed loaded mip level.
+            uint32_t height = 0;            ///< Height of the most detailed loaded mip level.
+            uint32_t mipLevels = 0;         ///< Number of loaded mip levels.
+            std::vector<uint8_t> data;      ///< Tightly packed image data of the loaded mip levels, ordered from most to least detailed. Can be used as initial data for Texture::create2D().
+        };
+
+        /** Read the description of a DDS file without loading the image data.
+            Throws an exception if file cannot be found or there is a loading error.
+            \param[in] filename Path of file to read.
+            \return Description of the image.
+        */
+        static DDSDesc getDDSDesc(const std::string& filename);
+
+        /** Load the mip levels [mostDetailedMip, mipLevels) of a 2D DDS texture to CPU memory.
+            The data can be loaded on any thread and uploaded later. Only 2D textures without array slices are supported.
+            Throws an exception if file cannot be found, is not a 2D texture or there is a loading error.
+            \param[in] filename Path of file to load.
+            \param[in] loadAsSrgb If true, convert the image format property to a corresponding sRGB format if available. Image data is not changed.
+            \param[in] mostDetailedMip Most detailed mip level to load. Clamped to the least detailed mip level in the file.
+            \return The loaded mip levels.
+        */
+        static MipChain loadMipChainFromDDS(const std::string& filename, bool loadAsSrgb, uint32_t mostDetailedMip = 0);
+
         /** Load a DDS file to a Bitmap. If the file contains an image array and/or mips, only the first image will be loaded.
             Throws an exception if file cannot be found or there is a loading error.
             \param[in] filename Path of file to load.
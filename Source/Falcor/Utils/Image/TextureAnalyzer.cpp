@@ -27,6 +27,8 @@
  **************************************************************************/
 #include "stdafx.h"
 #include "TextureAnalyzer.h"
+#include "glm/detail/type_half.hpp"
+#include <emmintrin.h>
 
 namespace Falcor
 {
@@ -39,6 +41,193 @@ namespace Falcor
         static_assert((uint32_t)TextureChannelFlags::Alpha == 0x8);
 
         const char kShaderFilename[] = "Utils/Image/TextureAnalyzer.cs.slang";
+
+        using RangeFlags = TextureAnalyzer::Result::RangeFlags;
+
+        /** Tables for converting 8-bit unorm values to float, with and without sRGB decoding.
+        */
+        struct UnormTables
+        {
+            std::array<float, 256> linear;
+            std::array<float, 256> srgb;
+
+            UnormTables()
+            {
+                for (uint32_t i = 0; i < 256; i++)
+                {
+                    const float v = i / 255.f;
+                    linear[i] = v;
+                    srgb[i] = v <= 0.04045f ? v / 12.92f : std::pow((v + 0.055f) / 1.055f, 2.4f);
+                }
+            }
+        };
+
+        const UnormTables& getUnormTables()
+        {
+            static const UnormTables tables;
+            return tables;
+        }
+
+        template<typename T>
+        T loadUnaligned(const uint8_t* pData)
+        {
+            T value;
+            std::memcpy(&value, pData, sizeof(T));
+            return value;
+        }
+
+        float loadHalf(const uint8_t* pData)
+        {
+            return glm::detail::toFloat32(loadUnaligned<glm::detail::hdata>(pData));
+        }
+
+        float4 toFloat4(__m128 v)
+        {
+            float4 result;
+            _mm_storeu_ps(&result.x, v);
+            return result;
+        }
+
+        /** Assemble the analysis result in the format written by the shader.
+            \param[in] varyingMask Bit i is set if channel i is varying.
+            \param[in] rangeFlags Union of RangeFlags for each channel.
+        */
+        TextureAnalyzer::Result makeResult(const float4& value, const float4& minValue, const float4& maxValue, uint32_t varyingMask, const std::array<uint32_t, 4>& rangeFlags)
+        {
+            TextureAnalyzer::Result result = {};
+            result.mask = varyingMask;
+            for (uint32_t i = 0; i < 4; i++) result.mask |= rangeFlags[i] << (4 + 4 * i);
+            result.value = value;
+            // Clamp to zero like the shader, which reduces the range with integer atomics.
+            result.minValue = glm::max(minValue, float4(0.f));
+            result.maxValue = glm::max(maxValue, float4(0.f));
+            return result;
+        }
+
+        /** Analyze 8-bit unorm texels. The image rows are reduced 16 bytes at a time, so the texel size must divide 16.
+            Because unorm and sRGB decoding are monotonic, the min/max reduction runs on the raw bytes and only the results are converted to float.
+            \param[in] channels Color channel (0-3) of each byte of the texel, or -1 if the byte is unused.
+            \param[in] srgb Decode the color channels as sRGB.
+        */
+        TextureAnalyzer::Result analyzeUnorm8(const Bitmap& bitmap, uint32_t bytesPerTexel, const std::array<int, 4>& channels, bool srgb)
+        {
+            assert(bytesPerTexel <= 4 && 16 % bytesPerTexel == 0);
+            const uint8_t* pData = bitmap.getData();
+
+            // Replicate the reference (top-left) texel to match a 16 byte chunk of a row.
+            alignas(16) uint8_t refBytes[16];
+            for (uint32_t i = 0; i < 16; i++) refBytes[i] = pData[i % bytesPerTexel];
+            const __m128i ref = _mm_load_si128((const __m128i*)refBytes);
+
+            __m128i minBytes = _mm_set1_epi8((char)0xff);
+            __m128i maxBytes = _mm_setzero_si128();
+            __m128i diffBytes = _mm_setzero_si128();
+            std::array<uint8_t, 4> minValue = { 0xff, 0xff, 0xff, 0xff };
+            std::array<uint8_t, 4> maxValue = {};
+            std::array<uint8_t, 4> diff = {};
+
+            const size_t rowSize = (size_t)bitmap.getWidth() * bytesPerTexel;
+            for (uint32_t y = 0; y < bitmap.getHeight(); y++)
+            {
+                const uint8_t* pRow = pData + (size_t)y * bitmap.getRowPitch();
+                size_t i = 0;
+                for (; i + 16 <= rowSize; i += 16)
+                {
+                    const __m128i bytes = _mm_loadu_si128((const __m128i*)(pRow + i));
+                    minBytes = _mm_min_epu8(bytes, minBytes);
+                    maxBytes = _mm_max_epu8(bytes, maxBytes);
+                    diffBytes = _mm_or_si128(_mm_xor_si128(bytes, ref), diffBytes);
+                }
+                for (; i < rowSize; i++)
+                {
+                    const size_t b = i % bytesPerTexel;
+                    minValue[b] = std::min(minValue[b], pRow[i]);
+                    maxValue[b] = std::max(maxValue[b], pRow[i]);
+                    diff[b] |= pRow[i] ^ refBytes[b];
+                }
+            }
+
+            // Fold the 16 byte lanes into the bytes of a texel.
+            alignas(16) uint8_t minLanes[16], maxLanes[16], diffLanes[16];
+            _mm_store_si128((__m128i*)minLanes, minBytes);
+            _mm_store_si128((__m128i*)maxLanes, maxBytes);
+            _mm_store_si128((__m128i*)diffLanes, diffBytes);
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                const uint32_t b = i % bytesPerTexel;
+                minValue[b] = std::min(minValue[b], minLanes[i]);
+                maxValue[b] = std::max(maxValue[b], maxLanes[i]);
+                diff[b] |= diffLanes[i];
+            }
+
+            // Convert the bytes to color channels. Missing channels are constant (0, 0, 0, 1).
+            const auto& tables = getUnormTables();
+            float4 value = float4(0.f, 0.f, 0.f, 1.f);
+            float4 minColor = value;
+            float4 maxColor = value;
+            uint32_t varyingMask = 0;
+            std::array<uint32_t, 4> rangeFlags = { 0, 0, 0, (uint32_t)RangeFlags::Pos };
+
+            for (uint32_t b = 0; b < bytesPerTexel; b++)
+            {
+                const int c = channels[b];
+                if (c < 0) continue;
+                const auto& table = srgb && c < 3 ? tables.srgb : tables.linear;
+                value[c] = table[refBytes[b]];
+                minColor[c] = table[minValue[b]];
+                maxColor[c] = table[maxValue[b]];
+                if (diff[b] != 0) varyingMask |= 1u << c;
+                rangeFlags[c] = maxValue[b] > 0 ? (uint32_t)RangeFlags::Pos : 0;
+            }
+
+            return makeResult(value, minColor, maxColor, varyingMask, rangeFlags);
+        }
+
+        /** Analyze texels of any format that loadTexel() converts to RGBA fp32.
+            The channels are reduced in parallel using SSE.
+        */
+        template<typename LoadTexel>
+        TextureAnalyzer::Result analyzeTexels(const Bitmap& bitmap, uint32_t bytesPerTexel, const LoadTexel& loadTexel)
+        {
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+            const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+            const __m128 ref = loadTexel(bitmap.getData());
+            __m128 minValue = _mm_set1_ps(std::numeric_limits<float>::max());
+            __m128 maxValue = _mm_set1_ps(-std::numeric_limits<float>::max());
+            __m128 varying = zero, pos = zero, neg = zero, isInf = zero, isNaN = zero;
+
+            for (uint32_t y = 0; y < bitmap.getHeight(); y++)
+            {
+                const uint8_t* pRow = bitmap.getData() + (size_t)y * bitmap.getRowPitch();
+                for (uint32_t x = 0; x < bitmap.getWidth(); x++)
+                {
+                    const __m128 value = loadTexel(pRow + (size_t)x * bytesPerTexel);
+                    varying = _mm_or_ps(_mm_cmpneq_ps(value, ref), varying);
+                    pos = _mm_or_ps(_mm_cmpgt_ps(value, zero), pos);
+                    neg = _mm_or_ps(_mm_cmplt_ps(value, zero), neg);
+                    isInf = _mm_or_ps(_mm_cmpeq_ps(_mm_and_ps(value, absMask), inf), isInf);
+                    isNaN = _mm_or_ps(_mm_cmpunord_ps(value, value), isNaN);
+                    // Min/max return the second operand if either is NaN, so NaNs are ignored.
+                    minValue = _mm_min_ps(value, minValue);
+                    maxValue = _mm_max_ps(value, maxValue);
+                }
+            }
+
+            const uint32_t posMask = _mm_movemask_ps(pos);
+            const uint32_t negMask = _mm_movemask_ps(neg);
+            const uint32_t infMask = _mm_movemask_ps(isInf);
+            const uint32_t nanMask = _mm_movemask_ps(isNaN);
+            std::array<uint32_t, 4> rangeFlags;
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                rangeFlags[i] = ((posMask >> i) & 1) * (uint32_t)RangeFlags::Pos | ((negMask >> i) & 1) * (uint32_t)RangeFlags::Neg |
+                    ((infMask >> i) & 1) * (uint32_t)RangeFlags::Inf | ((nanMask >> i) & 1) * (uint32_t)RangeFlags::NaN;
+            }
+
+            return makeResult(toFloat4(ref), toFloat4(minValue), toFloat4(maxValue), _mm_movemask_ps(varying), rangeFlags);
+        }
     }
 
     // Verify that the result struct matches the size expected by the shader.
@@ -152,4 +341,46 @@ namespace Falcor
             throw std::runtime_error("Unknown format type");
         }
     }
+
+    std::optional<TextureAnalyzer::Result> TextureAnalyzer::analyze(const Bitmap& bitmap, bool loadAsSrgb)
+    {
+        if (bitmap.getWidth() == 0 || bitmap.getHeight() == 0) return {};
+
+        ResourceFormat format = loadAsSrgb ? linearToSrgbFormat(bitmap.getFormat()) : bitmap.getFormat();
+        const bool srgb = isSrgbFormat(format);
+
+        switch (srgbToLinearFormat(format))
+        {
+        case ResourceFormat::R8Unorm:
+            return analyzeUnorm8(bitmap, 1, { 0, -1, -1, -1 }, srgb);
+        case ResourceFormat::RG8Unorm:
+            return analyzeUnorm8(bitmap, 2, { 0, 1, -1, -1 }, srgb);
+        case ResourceFormat::RGBA8Unorm:
+            return analyzeUnorm8(bitmap, 4, { 0, 1, 2, 3 }, srgb);
+        case ResourceFormat::BGRA8Unorm:
+            return analyzeUnorm8(bitmap, 4, { 2, 1, 0, 3 }, srgb);
+        case ResourceFormat::BGRX8Unorm:
+            return analyzeUnorm8(bitmap, 4, { 2, 1, 0, -1 }, srgb);
+        case ResourceFormat::R16Unorm:
+            return analyzeTexels(bitmap, 2, [](const uint8_t* p) { return _mm_set_ps(1.f, 0.f, 0.f, loadUnaligned<uint16_t>(p) / 65535.f); });
+        case ResourceFormat::R16Float:
+            return analyzeTexels(bitmap, 2, [](const uint8_t* p) { return _mm_set_ps(1.f, 0.f, 0.f, loadHalf(p)); });
+        case ResourceFormat::RG16Float:
+            return analyzeTexels(bitmap, 4, [](const uint8_t* p) { return _mm_set_ps(1.f, 0.f, loadHalf(p + 2), loadHalf(p)); });
+        case ResourceFormat::RGB16Float:
+            return analyzeTexels(bitmap, 6, [](const uint8_t* p) { return _mm_set_ps(1.f, loadHalf(p + 4), loadHalf(p + 2), loadHalf(p)); });
+        case ResourceFormat::RGBA16Float:
+            return analyzeTexels(bitmap, 8, [](const uint8_t* p) { return _mm_set_ps(loadHalf(p + 6), loadHalf(p + 4), loadHalf(p + 2), loadHalf(p)); });
+        case ResourceFormat::R32Float:
+            return analyzeTexels(bitmap, 4, [](const uint8_t* p) { return _mm_set_ps(1.f, 0.f, 0.f, loadUnaligned<float>(p)); });
+        case ResourceFormat::RG32Float:
+            return analyzeTexels(bitmap, 8, [](const uint8_t* p) { return _mm_set_ps(1.f, 0.f, loadUnaligned<float>(p + 4), loadUnaligned<float>(p)); });
+        case ResourceFormat::RGB32Float:
+            return analyzeTexels(bitmap, 12, [](const uint8_t* p) { return _mm_set_ps(1.f, loadUnaligned<float>(p + 8), loadUnaligned<float>(p + 4), loadUnaligned<float>(p)); });
+        case ResourceFormat::RGBA32Float:
+            return analyzeTexels(bitmap, 16, [](const uint8_t* p) { return _mm_loadu_ps((const float*)p); });
+        default:
+            return {};
+        }
+    }
 }
@@ -26,10 +26,13 @@
  # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************/
 #pragma once
+#include "Utils/Image/Bitmap.h"
+#include <optional>
 
 namespace Falcor
 {
     /** A class for analyzing texture contents.
+        Textures are analyzed on the GPU. Images can also be analyzed on the CPU before they are uploaded.
     */
     class dlldecl TextureAnalyzer : public std::enable_shared_from_this<TextureAnalyzer>
     {
@@ -123,6 +126,15 @@ namespace Falcor
         */
         static size_t getResultSize();
 
+        /** Analyze an image on the CPU. The result is the same as for analyzing a texture created from the image,
+            but no device is needed, so images can be analyzed while they are loaded.
+            Color channels that the image format does not have read as (0, 0, 0, 1), as they do when sampling the texture.
+            \param[in] bitmap The image to analyze.
+            \param[in] loadAsSrgb Analyze the image as if it were loaded in sRGB format. The color channels are then converted to linear space.
+            \return The analysis result, or an empty optional if the image format is not supported.
+        */
+        static std::optional<Result> analyze(const Bitmap& bitmap, bool loadAsSrgb);
+
     private:
         TextureAnalyzer();
         void checkFormatSupport(const Texture::SharedPtr pInput, uint32_t mipLevel, uint32_t arraySlice) const;
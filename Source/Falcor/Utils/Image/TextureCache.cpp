@@ -0,0 +1,220 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "TextureCache.h"
+#include "Utils/Image/Bitmap.h"
+#include "Utils/Image/ImageIO.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace Falcor
+{
+    namespace
+    {
+        const uint32_t kVersion = 1;
+        const std::string kDirectory = "NVIDIA/Falcor/TextureCache";
+        const size_t kBlockSize = 1 << 20;
+
+        /** Select the block compression mode for a texture. Block compressed textures need a size that is a multiple of 4.
+        */
+        ImageIO::CompressionMode getCompressionMode(const Bitmap& bitmap)
+        {
+            if (bitmap.getWidth() % 4 != 0 || bitmap.getHeight() % 4 != 0) return ImageIO::CompressionMode::None;
+
+            switch (bitmap.getFormat())
+            {
+            case ResourceFormat::R8Unorm:
+                return ImageIO::CompressionMode::BC4;
+            case ResourceFormat::RG8Unorm:
+                return ImageIO::CompressionMode::BC5;
+            case ResourceFormat::BGRA8Unorm:
+            case ResourceFormat::BGRA8UnormSrgb:
+            case ResourceFormat::BGRX8Unorm:
+            case ResourceFormat::BGRX8UnormSrgb:
+                return ImageIO::CompressionMode::BC7;
+            default:
+                return ImageIO::CompressionMode::None;
+            }
+        }
+
+        /** Initializes COM on the calling thread for the lifetime of the object. Required for mip generation in DirectXTex.
+        */
+        class ScopedCOMInit
+        {
+        public:
+            ScopedCOMInit() : mResult(CoInitializeEx(nullptr, COINIT_MULTITHREADED)) {}
+            ~ScopedCOMInit() { if (SUCCEEDED(mResult)) CoUninitialize(); }
+        private:
+            HRESULT mResult;
+        };
+    }
+
+    TextureCache::SharedPtr TextureCache::create(const Options& options)
+    {
+        return SharedPtr(new TextureCache(options));
+    }
+
+    TextureCache::TextureCache(const Options& options)
+        : mOptions(options)
+    {
+        mDirectory = mOptions.directory.empty() ? std::filesystem::path(getAppDataDirectory()) / kDirectory : std::filesystem::path(mOptions.directory);
+    }
+
+    Texture::SharedPtr TextureCache::loadTexture(const std::string& filename, bool generateMipLevels, bool loadAsSrgb) const
+    {
+        std::string fullPath;
+        if (!findFileInDataDirectories(filename, fullPath))
+        {
+            logWarning("Error when loading image file. Can't find image file '" + filename + "'");
+            return nullptr;
+        }
+
+        // DDS files are already in an uploadable layout.
+        if (hasSuffix(fullPath, ".dds", false)) return Texture::createFromFile(fullPath, generateMipLevels, loadAsSrgb);
+
+        if (auto cachePath = cacheTexture(fullPath, generateMipLevels, loadAsSrgb))
+        {
+            try
+            {
+                // The cached data is stored in the final (sRGB) format.
+                auto pTexture = ImageIO::loadTextureFromDDS(*cachePath, false);
+                if (pTexture)
+                {
+                    // Keep referring to the original image so the texture can be found and reloaded by its source.
+                    pTexture->setSourceFilename(fullPath);
+                    return pTexture;
+                }
+            }
+            catch (const std::exception& e)
+            {
+                logWarning("Failed to load texture '" + fullPath + "' through the texture cache: " + e.what());
+            }
+        }
+
+        return Texture::createFromFile(fullPath, generateMipLevels, loadAsSrgb);
+    }
+
+    std::optional<std::string> TextureCache::cacheTexture(const std::string& filename, bool generateMipLevels, bool loadAsSrgb) const
+    {
+        std::string fullPath;
+        if (!findFileInDataDirectories(filename, fullPath)) return {};
+
+        if (hasSuffix(fullPath, ".dds", false)) return fullPath;
+
+        auto key = computeKey(fullPath, generateMipLevels, loadAsSrgb);
+        if (!key) return {};
+
+        try
+        {
+            if (!hasTexture(*key)) writeTexture(fullPath, *key, generateMipLevels, loadAsSrgb);
+        }
+        catch (const std::exception& e)
+        {
+            logWarning("Failed to add texture '" + fullPath + "' to the texture cache: " + e.what());
+            return {};
+        }
+
+        return getCachePath(*key).string();
+    }
+
+    std::optional<TextureCache::Key> TextureCache::computeKey(const std::string& path, bool generateMipLevels, bool loadAsSrgb) const
+    {
+        std::ifstream fs(path, std::ios_base::binary);
+        if (!fs.good()) return {};
+
+        SHA1 sha1;
+        sha1.update(&kVersion, sizeof(kVersion));
+        sha1.update(&mOptions.compress, sizeof(mOptions.compress));
+        sha1.update(&generateMipLevels, sizeof(generateMipLevels));
+        sha1.update(&loadAsSrgb, sizeof(loadAsSrgb));
+
+        std::vector<char> buffer(kBlockSize);
+        while (fs)
+        {
+            fs.read(buffer.data(), buffer.size());
+            sha1.update(buffer.data(), (size_t)fs.gcount());
+        }
+        if (fs.bad()) return {};
+
+        return sha1.final();
+    }
+
+    std::filesystem::path TextureCache::getCachePath(const Key& key) const
+    {
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0');
+        for (auto c : key) ss << std::setw(2) << (int)c;
+        ss << ".dds";
+        return mDirectory / ss.str();
+    }
+
+    bool TextureCache::hasTexture(const Key& key) const
+    {
+        std::error_code ec;
+        return std::filesystem::exists(getCachePath(key), ec);
+    }
+
+    void TextureCache::writeTexture(const std::string& path, const Key& key, bool generateMipLevels, bool loadAsSrgb) const
+    {
+        auto t0 = CpuTimer::getCurrentTimePoint();
+
+        Bitmap::UniqueConstPtr pBitmap = Bitmap::createFromFile(path, true);
+        if (!pBitmap) throw std::runtime_error("Failed to decode image");
+
+        // Store the data in the final format so that mips of sRGB textures are filtered in linear space.
+        if (loadAsSrgb && linearToSrgbFormat(pBitmap->getFormat()) != pBitmap->getFormat())
+        {
+            pBitmap = Bitmap::create(pBitmap->getWidth(), pBitmap->getHeight(), linearToSrgbFormat(pBitmap->getFormat()), pBitmap->getData());
+        }
+
+        ImageIO::CompressionMode compressionMode = mOptions.compress ? getCompressionMode(*pBitmap) : ImageIO::CompressionMode::None;
+
+        std::error_code ec;
+        std::filesystem::create_directories(mDirectory, ec);
+
+        // Write to a temporary file first so that concurrent loads never see a partially written file.
+        const auto cachePath = getCachePath(key);
+        std::stringstream ss;
+        ss << cachePath.stem().string() << "." << std::this_thread::get_id() << ".tmp.dds";
+        const auto tempPath = mDirectory / ss.str();
+        {
+            ScopedCOMInit comInit;
+            ImageIO::saveToDDS(tempPath.string(), *pBitmap, compressionMode, generateMipLevels);
+        }
+
+        std::filesystem::rename(tempPath, cachePath, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+            if (!hasTexture(key)) throw std::runtime_error("Failed to write cache file '" + cachePath.string() + "'");
+        }
+
+        logInfo("Added texture '" + path + "' to the texture cache (" + std::to_string(CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint())) + " ms).");
+    }
+}
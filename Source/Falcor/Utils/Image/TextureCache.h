@@ -0,0 +1,112 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include "Core/API/Texture.h"
+#include "Utils/CryptoUtils.h"
+#include <filesystem>
+
+namespace Falcor
+{
+    /** Persistent cache of preprocessed textures.
+
+        On the first load of an image file, the image is decoded, its mip chain is generated on the CPU and
+        it is optionally block compressed. The result is stored as a DDS file (see ImageIO) in the cache directory.
+        Subsequent loads upload the stored mip chain directly, skipping image decoding and GPU mip generation.
+
+        Cache entries are keyed by a hash of the file content and the preprocessing settings, so copies of
+        the same image share an entry and modified files get a new one. Old entries are never evicted.
+        DDS files are loaded directly and are not cached.
+    */
+    class dlldecl TextureCache
+    {
+    public:
+        using SharedPtr = std::shared_ptr<TextureCache>;
+        using Key = SHA1::MD;
+
+        struct Options
+        {
+            bool compress = false;      ///< Block compress 8-bit textures whose size is a multiple of 4: BC4 for one channel, BC5 for two channels and BC7 otherwise. Other textures are stored uncompressed.
+            std::string directory;      ///< Cache directory. If empty, a directory in the application data directory is used.
+        };
+
+        /** Create a texture cache.
+            \param[in] options Cache options.
+            \return A new object.
+        */
+        static SharedPtr create(const Options& options = Options());
+
+        /** Load a texture through the cache. This function is thread-safe.
+            If the texture is not cached yet, it is preprocessed and added to the cache first.
+            If preprocessing fails, the texture is loaded without the cache.
+            \param[in] filename Filename of the image. Can also include a full path or relative path from a data directory.
+            \param[in] generateMipLevels Whether the mip-chain should be generated.
+            \param[in] loadAsSrgb Load the texture using sRGB format. Only valid for 3 or 4 component textures.
+            \return A new texture, or nullptr if the texture failed to load.
+        */
+        Texture::SharedPtr loadTexture(const std::string& filename, bool generateMipLevels, bool loadAsSrgb) const;
+
+        /** Make sure a texture is cached and get the DDS file holding its preprocessed data. This function is thread-safe.
+            The DDS file stores the data in the final format, i.e. it does not need to be loaded as sRGB.
+            DDS inputs are not cached, their own path is returned.
+            \param[in] filename Filename of the image. Can also include a full path or relative path from a data directory.
+            \param[in] generateMipLevels Whether the mip-chain should be generated.
+            \param[in] loadAsSrgb Load the texture using sRGB format. Only valid for 3 or 4 component textures.
+            \return Absolute path of the DDS file, or an empty optional if the file could not be found or preprocessed.
+        */
+        std::optional<std::string> cacheTexture(const std::string& filename, bool generateMipLevels, bool loadAsSrgb) const;
+
+        /** Compute the cache key for an image file.
+            \param[in] path Absolute path of the image file.
+            \param[in] generateMipLevels Whether the mip-chain should be generated.
+            \param[in] loadAsSrgb Load the texture using sRGB format.
+            \return The cache key, or an empty optional if the file could not be read.
+        */
+        std::optional<Key> computeKey(const std::string& path, bool generateMipLevels, bool loadAsSrgb) const;
+
+        /** Get the path of the cache file for a given key.
+        */
+        std::filesystem::path getCachePath(const Key& key) const;
+
+        /** Check if a texture is cached.
+        */
+        bool hasTexture(const Key& key) const;
+
+        const Options& getOptions() const { return mOptions; }
+
+    private:
+        TextureCache(const Options& options);
+
+        /** Decode an image file, preprocess it and write it to the cache.
+            Throws an exception if the image cannot be preprocessed.
+        */
+        void writeTexture(const std::string& path, const Key& key, bool generateMipLevels, bool loadAsSrgb) const;
+
+        Options mOptions;
+        std::filesystem::path mDirectory;
+    };
+}
@@ -27,69 +27,330 @@
  **************************************************************************/
 #include "stdafx.h"
 #include "Threading.h"
+#include <atomic>
+#include <deque>
 
 namespace Falcor
 {
+    struct Threading::Task::State
+    {
+        std::function<void(void)> func;
+        std::atomic<bool> done{ false };
+        std::exception_ptr exception;
+        std::mutex mutex;                                           ///< Protects the continuations and is used with the condition variable.
+        std::condition_variable condition;
+        std::vector<std::shared_ptr<State>> continuations;
+    };
+
     namespace
     {
+        using TaskStatePtr = std::shared_ptr<Threading::Task::State>;
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<TaskStatePtr> tasks;                         ///< Owner pushes/pops at the back, thieves steal from the front.
+        };
+
         struct ThreadingData
         {
-            bool initialized = false;
+            std::mutex initMutex;
+            std::atomic<bool> initialized{ false };
+            std::vector<std::unique_ptr<Worker>> workers;
             std::vector<std::thread> threads;
-            uint32_t current;
+
+            std::mutex globalMutex;
+            std::deque<TaskStatePtr> globalTasks;                   ///< Tasks dispatched from non-worker threads.
+
+            std::mutex sleepMutex;
+            std::condition_variable sleepCondition;
+            std::atomic<size_t> queuedCount{ 0 };                   ///< Number of tasks currently sitting in a queue.
+            bool terminate = false;
+
+            std::mutex idleMutex;
+            std::condition_variable idleCondition;
+            std::atomic<size_t> pendingCount{ 0 };                  ///< Number of dispatched tasks that have not finished yet.
         } gData;
+
+        thread_local int32_t tWorkerIndex = -1;
+
+        void ensureStarted()
+        {
+            if (!gData.initialized) Threading::start();
+        }
+
+        void enqueue(TaskStatePtr pTask)
+        {
+            if (tWorkerIndex >= 0)
+            {
+                Worker& worker = *gData.workers[tWorkerIndex];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.tasks.push_back(std::move(pTask));
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lock(gData.globalMutex);
+                gData.globalTasks.push_back(std::move(pTask));
+            }
+            gData.queuedCount++;
+
+            // Lock the sleep mutex to avoid a lost wakeup between a worker checking the predicate and going to sleep.
+            { std::lock_guard<std::mutex> lock(gData.sleepMutex); }
+            gData.sleepCondition.notify_one();
+        }
+
+        TaskStatePtr popFront(std::mutex& mutex, std::deque<TaskStatePtr>& tasks)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) return nullptr;
+            TaskStatePtr pTask = std::move(tasks.front());
+            tasks.pop_front();
+            return pTask;
+        }
+
+        TaskStatePtr findTask(int32_t workerIndex)
+        {
+            if (gData.queuedCount == 0) return nullptr;
+
+            TaskStatePtr pTask;
+
+            // Own deque first (LIFO for locality).
+            if (workerIndex >= 0)
+            {
+                Worker& worker = *gData.workers[workerIndex];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                if (!worker.tasks.empty())
+                {
+                    pTask = std::move(worker.tasks.back());
+                    worker.tasks.pop_back();
+                }
+            }
+
+            // Tasks dispatched from outside the pool.
+            if (!pTask) pTask = popFront(gData.globalMutex, gData.globalTasks);
+
+            // Steal from the other workers, starting at the next one to spread the contention.
+            if (!pTask)
+            {
+                const size_t workerCount = gData.workers.size();
+                const size_t start = workerIndex >= 0 ? size_t(workerIndex) + 1 : 0;
+                for (size_t i = 0; i < workerCount && !pTask; ++i)
+                {
+                    size_t victim = (start + i) % workerCount;
+                    if (int32_t(victim) == workerIndex) continue;
+                    pTask = popFront(gData.workers[victim]->mutex, gData.workers[victim]->tasks);
+                }
+            }
+
+            if (pTask) gData.queuedCount--;
+            return pTask;
+        }
+
+        void execute(const TaskStatePtr& pTask)
+        {
+            try
+            {
+                pTask->func();
+            }
+            catch (...)
+            {
+                pTask->exception = std::current_exception();
+            }
+            pTask->func = nullptr;
+
+            std::vector<TaskStatePtr> continuations;
+            {
+                std::lock_guard<std::mutex> lock(pTask->mutex);
+                pTask->done = true;
+                continuations.swap(pTask->continuations);
+            }
+            pTask->condition.notify_all();
+
+            for (auto& pContinuation : continuations) enqueue(std::move(pContinuation));
+
+            if (--gData.pendingCount == 0)
+            {
+                { std::lock_guard<std::mutex> lock(gData.idleMutex); }
+                gData.idleCondition.notify_all();
+            }
+        }
+
+        TaskStatePtr createTask(const std::function<void(void)>& func)
+        {
+            auto pTask = std::make_shared<Threading::Task::State>();
+            pTask->func = func;
+            gData.pendingCount++;
+            return pTask;
+        }
+
+        void workerLoop(int32_t workerIndex)
+        {
+            tWorkerIndex = workerIndex;
+            while (true)
+            {
+                if (auto pTask = findTask(workerIndex))
+                {
+                    execute(pTask);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(gData.sleepMutex);
+                gData.sleepCondition.wait(lock, [] () { return gData.terminate || gData.queuedCount > 0; });
+                if (gData.terminate && gData.queuedCount == 0) break;
+            }
+            tWorkerIndex = -1;
+        }
     }
 
     void Threading::start(uint32_t threadCount)
     {
+        std::lock_guard<std::mutex> lock(gData.initMutex);
         if (gData.initialized) return;
 
-        gData.threads.resize(threadCount);
+        if (threadCount == 0) threadCount = getLogicalThreadCount();
+
+        gData.terminate = false;
+        gData.workers.clear();
+        for (uint32_t i = 0; i < threadCount; ++i) gData.workers.push_back(std::make_unique<Worker>());
+        for (uint32_t i = 0; i < threadCount; ++i) gData.threads.emplace_back(workerLoop, int32_t(i));
+
         gData.initialized = true;
     }
 
     void Threading::shutdown()
     {
-        for (auto& t : gData.threads)
+        std::lock_guard<std::mutex> lock(gData.initMutex);
+        if (!gData.initialized) return;
+
+        finish();
+
         {
-            if (t.joinable()) t.join();
+            std::lock_guard<std::mutex> sleepLock(gData.sleepMutex);
+            gData.terminate = true;
         }
+        gData.sleepCondition.notify_all();
+
+        for (auto& t : gData.threads) t.join();
+        gData.threads.clear();
+        gData.workers.clear();
 
         gData.initialized = false;
     }
 
-    Threading::Task Threading::dispatchTask(const std::function<void(void)>& func)
+    uint32_t Threading::getThreadCount()
     {
-        assert(gData.initialized);
+        ensureStarted();
+        return (uint32_t)gData.threads.size();
+    }
 
-        std::thread& t = gData.threads[gData.current];
-        if (t.joinable()) t.join();
-        t = std::thread(func);
-        gData.current = (gData.current + 1) % gData.threads.size();
+    Threading::Task Threading::dispatchTask(const std::function<void(void)>& func)
+    {
+        ensureStarted();
 
-        return Task();
+        auto pTask = createTask(func);
+        enqueue(pTask);
+        return Task(pTask);
     }
 
     void Threading::finish()
     {
-        for (auto& t : gData.threads)
+        assert(tWorkerIndex < 0);
+
+        std::unique_lock<std::mutex> lock(gData.idleMutex);
+        gData.idleCondition.wait(lock, [] () { return gData.pendingCount == 0; });
+    }
+
+    size_t Threading::getChunkSize(size_t count, size_t grainSize)
+    {
+        if (grainSize > 0) return grainSize;
+
+        // Aim for a few chunks per worker to balance the load.
+        const size_t targetChunkCount = 4 * (size_t)getThreadCount();
+        return std::max<size_t>(1, (count + targetChunkCount - 1) / targetChunkCount);
+    }
+
+    void Threading::dispatchChunks(size_t chunkCount, const std::function<void(size_t)>& func)
+    {
+        if (chunkCount == 0) return;
+
+        // Helper tasks and the calling thread pull chunks from a shared counter until all are processed.
+        const size_t helperCount = std::min(chunkCount, (size_t)getThreadCount()) - 1;
+        std::atomic<size_t> nextChunk{ 0 };
+        auto runChunks = [&] ()
         {
-            if (t.joinable()) t.join();
+            for (size_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) func(chunk);
+        };
+
+        std::vector<Task> helpers;
+        helpers.reserve(helperCount);
+        for (size_t i = 0; i < helperCount; ++i) helpers.push_back(dispatchTask(runChunks));
+
+        std::exception_ptr exception;
+        try
+        {
+            runChunks();
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+            nextChunk = chunkCount;
         }
+
+        // The helpers reference local state, so always wait for all of them before returning.
+        for (auto& helper : helpers)
+        {
+            try
+            {
+                helper.finish();
+            }
+            catch (...)
+            {
+                if (!exception) exception = std::current_exception();
+            }
+        }
+
+        if (exception) std::rethrow_exception(exception);
     }
 
-    Threading::Task::Task()
+    bool Threading::Task::isRunning() const
     {
+        return mpState && !mpState->done;
     }
 
-    bool Threading::Task::isRunning()
+    void Threading::Task::finish()
     {
-        logError("Threading::Task::isRunning() not implemented");
-        return true;
+        if (!mpState) return;
+
+        while (!mpState->done)
+        {
+            // Help executing other tasks while waiting. This avoids deadlocks when waiting from within a task.
+            if (auto pTask = findTask(tWorkerIndex))
+            {
+                execute(pTask);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mpState->mutex);
+            mpState->condition.wait_for(lock, std::chrono::microseconds(500), [this] () { return mpState->done.load(); });
+        }
+
+        if (mpState->exception) std::rethrow_exception(mpState->exception);
     }
 
-    void Threading::Task::finish()
+    Threading::Task Threading::Task::then(const std::function<void(void)>& func)
     {
-        logError("Threading::Task::finish() not implemented");
+        assert(mpState);
+
+        auto pContinuation = createTask(func);
+        {
+            std::lock_guard<std::mutex> lock(mpState->mutex);
+            if (!mpState->done)
+            {
+                mpState->continuations.push_back(pContinuation);
+                return Task(pContinuation);
+            }
+        }
+        enqueue(pContinuation);
+        return Task(pContinuation);
     }
 }
@@ -26,58 +26,150 @@
  # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  **************************************************************************/
 #pragma once
+#include <algorithm>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
 
 namespace Falcor
 {
+    /** Global work-stealing thread pool.
+
+        Each worker thread owns a task deque. Tasks dispatched from a worker are pushed to its own deque
+        and executed in LIFO order, idle workers steal from the other end of the other deques.
+        Tasks dispatched from non-worker threads are placed in a shared queue.
+
+        The pool is started lazily on first use if start() has not been called explicitly.
+    */
     class dlldecl Threading
     {
     public:
-        const static uint32_t kDefaultThreadCount = 16;
-
-        /** Handle to a dispatched task
-
-            TODO: Implementation
+        /** Handle to a dispatched task.
         */
-        class Task
+        class dlldecl Task
         {
         public:
-            /** Check if task is still executing
+            /** Internal task state (defined in Threading.cpp).
+            */
+            struct State;
+
+            /** Create an empty task handle.
             */
-            bool isRunning();
+            Task() = default;
 
-            /** Wait for task to finish executing
+            /** Check if the handle refers to a task.
+            */
+            bool isValid() const { return mpState != nullptr; }
+
+            /** Check if task is still executing (or waiting to be executed).
+            */
+            bool isRunning() const;
+
+            /** Wait for task to finish executing.
+                The calling thread executes other pending tasks while waiting.
+                If the task threw an exception, it is rethrown here.
             */
             void finish();
 
+            /** Dispatch a continuation that runs once this task has finished.
+                \param[in] func Function to execute.
+                \return Handle to the continuation task.
+            */
+            Task then(const std::function<void(void)>& func);
+
         private:
-            Task();
+            Task(std::shared_ptr<State> pState) : mpState(std::move(pState)) {}
+
+            std::shared_ptr<State> mpState;
             friend class Threading;
         };
 
         /** Initializes the global thread pool
-            \param[in] threadCount Number of threads in the pool
+            \param[in] threadCount Number of threads in the pool. If zero, getLogicalThreadCount() threads are used.
         */
-        static void start(uint32_t threadCount = kDefaultThreadCount);
+        static void start(uint32_t threadCount = 0);
 
-        /** Waits for all currently executing threads to finish
+        /** Waits for all currently dispatched tasks to finish.
+            Must not be called from within a task.
         */
         static void finish();
 
-        /** Waits for all currently executing threads to finish and shuts down the thread pool
+        /** Waits for all currently dispatched tasks to finish and shuts down the thread pool
         */
         static void shutdown();
 
         /** Returns the maximum number of concurrent threads supported by the hardware
         */
-        static uint32_t getLogicalThreadCount() { return std::thread::hardware_concurrency(); }
+        static uint32_t getLogicalThreadCount() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+        /** Returns the number of worker threads in the pool (starts the pool if necessary).
+        */
+        static uint32_t getThreadCount();
 
         /** Starts a task on an available thread.
             \return Handle to the task
         */
         static Task dispatchTask(const std::function<void(void)>& func);
+
+        /** Executes func(i) for all i in [begin, end) in parallel.
+            The range is split into chunks of grainSize elements which are distributed over the worker threads.
+            The calling thread participates in the work, so it is safe to call this from within a task.
+            \param[in] begin First index.
+            \param[in] end One past the last index.
+            \param[in] func Function to execute for each index.
+            \param[in] grainSize Number of indices per chunk, or zero to pick a chunk size based on the thread count.
+        */
+        template<typename T, typename Func>
+        static void parallelFor(T begin, T end, Func&& func, size_t grainSize = 0)
+        {
+            if (end <= begin) return;
+            const size_t count = size_t(end - begin);
+            const size_t chunkSize = getChunkSize(count, grainSize);
+            const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+            dispatchChunks(chunkCount, [&](size_t chunk)
+            {
+                const T first = begin + T(chunk * chunkSize);
+                const T last = begin + T(std::min(count, (chunk + 1) * chunkSize));
+                for (T i = first; i < last; ++i) func(i);
+            });
+        }
+
+        /** Reduces the range [begin, end) in parallel.
+            Each chunk is processed by rangeFunc(first, last, identity), which returns the partial result for [first, last).
+            Partial results are combined with reduceFunc(a, b) in index order, so the result is deterministic for a fixed grain size.
+            \param[in] begin First index.
+            \param[in] end One past the last index.
+            \param[in] identity Identity value of the reduction.
+            \param[in] rangeFunc Function computing the partial result of a sub-range.
+            \param[in] reduceFunc Function combining two partial results.
+            \param[in] grainSize Number of indices per chunk, or zero to pick a chunk size based on the thread count.
+            \return The reduced value.
+        */
+        template<typename T, typename Value, typename RangeFunc, typename ReduceFunc>
+        static Value parallelReduce(T begin, T end, const Value& identity, RangeFunc&& rangeFunc, ReduceFunc&& reduceFunc, size_t grainSize = 0)
+        {
+            if (end <= begin) return identity;
+            const size_t count = size_t(end - begin);
+            const size_t chunkSize = getChunkSize(count, grainSize);
+            const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+            std::vector<Value> partials(chunkCount, identity);
+            dispatchChunks(chunkCount, [&](size_t chunk)
+            {
+                const T first = begin + T(chunk * chunkSize);
+                const T last = begin + T(std::min(count, (chunk + 1) * chunkSize));
+                partials[chunk] = rangeFunc(first, last, identity);
+            });
+            Value result = identity;
+            for (const auto& partial : partials) result = reduceFunc(result, partial);
+            return result;
+        }
+
+    private:
+        static size_t getChunkSize(size_t count, size_t grainSize);
+        static void dispatchChunks(size_t chunkCount, const std::function<void(size_t)>& func);
     };
 
     /** Simple thread barrier class.
@@ -0,0 +1,450 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "stdafx.h"
+#include "CaptureQueue.h"
+#include <filesystem>
+
+namespace Mogwai
+{
+    namespace
+    {
+        double secondsSince(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    pybind11::dict CaptureQueue::Stats::toPython() const
+    {
+        pybind11::dict d;
+        d["framesWritten"] = framesWritten;
+        d["imagesWritten"] = imagesWritten;
+        d["bytesWritten"] = bytesWritten;
+        d["pendingImages"] = pendingImages;
+        d["pendingBytes"] = pendingBytes;
+        d["activeTime"] = activeTime;
+        d["framesPerSecond"] = framesPerSecond;
+        d["bytesPerSecond"] = bytesPerSecond;
+        return d;
+    }
+
+    CaptureQueue::UniquePtr CaptureQueue::create(uint32_t encoderThreadCount, uint64_t memoryBudget)
+    {
+        return UniquePtr(new CaptureQueue(encoderThreadCount, memoryBudget));
+    }
+
+    CaptureQueue::CaptureQueue(uint32_t encoderThreadCount, uint64_t memoryBudget)
+        : mMemoryBudget(memoryBudget)
+    {
+        startThreads(encoderThreadCount);
+    }
+
+    CaptureQueue::~CaptureQueue()
+    {
+        flush();
+        stopThreads();
+    }
+
+    void CaptureQueue::enqueue(RenderContext* pContext, const Texture::SharedPtr& pTexture, const std::string& filename, Bitmap::FileFormat format, bool endOfFrame)
+    {
+        assert(pContext && pTexture);
+        if (format == Bitmap::FileFormat::DdsFile) throw std::exception("CaptureQueue does not support saving to DDS.");
+        if (pTexture->getType() != Texture::Type::Texture2D) throw std::exception("CaptureQueue can only capture 2D textures.");
+
+        auto pJob = std::make_shared<Job>();
+        pJob->filename = filename;
+        pJob->format = format;
+        pJob->width = pTexture->getWidth();
+        pJob->height = pTexture->getHeight();
+        pJob->endOfFrame = endOfFrame;
+
+        // HDR textures with less than 3 channels are converted to RGBA32Float before readback (see Texture::captureToFile()).
+        ResourceFormat resourceFormat = pTexture->getFormat();
+        bool convert = getFormatType(resourceFormat) == FormatType::Float && getFormatChannelCount(resourceFormat) < 3;
+        if (convert) resourceFormat = ResourceFormat::RGBA32Float;
+        pJob->resourceFormat = resourceFormat;
+        pJob->size = uint64_t(pJob->width) * pJob->height * getFormatBytesPerBlock(resourceFormat);
+
+        reserve(pJob);
+
+        // Record the readback. The copy is submitted to the GPU but not waited for.
+        const Texture* pSource = pTexture.get();
+        if (convert)
+        {
+            pJob->blitTextures.push_back(blitToRGBA32Float(pContext, pTexture));
+            pSource = pJob->blitTextures.back().get();
+        }
+        submit(pContext, pJob, { { pSource, pSource->getSubresourceIndex(0, 0) } });
+    }
+
+    void CaptureQueue::enqueueMultiPart(RenderContext* pContext, const std::vector<Part>& parts, const std::string& filename, ExrWriter::Compression compression)
+    {
+        assert(pContext);
+        if (parts.empty()) return;
+
+        auto pJob = std::make_shared<Job>();
+        pJob->filename = filename;
+        pJob->format = Bitmap::FileFormat::ExrFile;
+        pJob->endOfFrame = true;
+        pJob->compression = compression;
+
+        std::vector<bool> convert;
+        for (const auto& part : parts)
+        {
+            assert(part.pTexture);
+            if (part.pTexture->getType() != Texture::Type::Texture2D) throw std::exception("CaptureQueue can only capture 2D textures.");
+            ResourceFormat resourceFormat = part.pTexture->getFormat();
+            convert.push_back(!ExrWriter::isFormatSupported(resourceFormat));
+            if (convert.back()) resourceFormat = ResourceFormat::RGBA32Float;
+            pJob->partNames.push_back(part.name);
+            pJob->size += uint64_t(part.pTexture->getWidth()) * part.pTexture->getHeight() * getFormatBytesPerBlock(resourceFormat);
+        }
+
+        reserve(pJob);
+
+        // Record the readback of all parts into one staging buffer.
+        std::vector<CopyContext::ReadTextureTask::Subresource> subresources;
+        for (size_t i = 0; i < parts.size(); i++)
+        {
+            const Texture* pSource = parts[i].pTexture.get();
+            if (convert[i])
+            {
+                pJob->blitTextures.push_back(blitToRGBA32Float(pContext, parts[i].pTexture));
+                pSource = pJob->blitTextures.back().get();
+            }
+            subresources.push_back({ pSource, pSource->getSubresourceIndex(0, 0) });
+        }
+        submit(pContext, pJob, subresources);
+    }
+
+    Texture::SharedPtr CaptureQueue::blitToRGBA32Float(RenderContext* pContext, const Texture::SharedPtr& pTexture)
+    {
+        auto pBlitTexture = Texture::create2D(pTexture->getWidth(), pTexture->getHeight(), ResourceFormat::RGBA32Float, 1, 1, nullptr, ResourceBindFlags::RenderTarget | ResourceBindFlags::ShaderResource);
+        pContext->blit(pTexture->getSRV(0, 1, 0, 1), pBlitTexture->getRTV(0, 0, 1));
+        return pBlitTexture;
+    }
+
+    void CaptureQueue::reserve(const std::shared_ptr<Job>& pJob)
+    {
+        releaseRetiredJobs();
+
+        // Wait for older captures to complete if the memory budget is exhausted.
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobCompleted.wait(lock, [&] { return mJobs.empty() || mPendingBytes + pJob->size <= mMemoryBudget; });
+            if (mJobs.empty()) mActiveStart = std::chrono::steady_clock::now();
+            pJob->tempFilename = pJob->filename + "." + std::to_string(mNextSequence++) + ".tmp";
+            mPendingBytes += pJob->size;
+            mJobs.push_back(pJob);
+        }
+        releaseRetiredJobs();
+    }
+
+    void CaptureQueue::submit(RenderContext* pContext, const std::shared_ptr<Job>& pJob, const std::vector<CopyContext::ReadTextureTask::Subresource>& subresources)
+    {
+        // Record the readback. The copies are submitted to the GPU but not waited for.
+        Buffer::SharedPtr pStagingBuffer;
+        try
+        {
+            pStagingBuffer = acquireStagingBuffer(CopyContext::ReadTextureTask::getStagingBufferSize(subresources));
+            pJob->pReadTask = CopyContext::ReadTextureTask::create(pContext, subresources, pStagingBuffer);
+        }
+        catch (...)
+        {
+            // Complete the job without output so it doesn't block later captures.
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                pJob->encoded = true;
+                pJob->failed = true;
+            }
+            completeJobs();
+            mJobCompleted.notify_all();
+            throw;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            // Return the staging buffer to the ring if it was too small to be used.
+            if (pStagingBuffer && pJob->pReadTask->getStagingBuffer() != pStagingBuffer)
+            {
+                mStagingBuffers.push_back(pStagingBuffer);
+                mStagingBytes += pStagingBuffer->getSize();
+            }
+            mEncodeQueue.push_back(pJob);
+        }
+        mJobAvailable.notify_one();
+    }
+
+    void CaptureQueue::flush()
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mJobCompleted.wait(lock, [this] { return mJobs.empty(); });
+        }
+        releaseRetiredJobs();
+    }
+
+    CaptureQueue::Stats CaptureQueue::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Stats stats = mStats;
+        stats.pendingImages = (uint32_t)mJobs.size();
+        stats.pendingBytes = mPendingBytes;
+        if (!mJobs.empty()) stats.activeTime += secondsSince(mActiveStart);
+        if (stats.activeTime > 0.0)
+        {
+            stats.framesPerSecond = stats.framesWritten / stats.activeTime;
+            stats.bytesPerSecond = stats.bytesWritten / stats.activeTime;
+        }
+        return stats;
+    }
+
+    void CaptureQueue::resetStats()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats = {};
+        mActiveStart = std::chrono::steady_clock::now();
+    }
+
+    void CaptureQueue::setEncoderThreadCount(uint32_t count)
+    {
+        if (count == getEncoderThreadCount()) return;
+        flush();
+        stopThreads();
+        startThreads(count);
+    }
+
+    void CaptureQueue::setMemoryBudget(uint64_t bytes)
+    {
+        std::vector<Buffer::SharedPtr> released;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mMemoryBudget = bytes;
+            while (mStagingBytes > mMemoryBudget)
+            {
+                mStagingBytes -= mStagingBuffers.back()->getSize();
+                released.push_back(std::move(mStagingBuffers.back()));
+                mStagingBuffers.pop_back();
+            }
+        }
+        mJobCompleted.notify_all();
+    }
+
+    void CaptureQueue::startThreads(uint32_t count)
+    {
+        assert(mThreads.empty());
+        count = std::max(count, 1u);
+        for (uint32_t i = 0; i < count; i++) mThreads.emplace_back(&CaptureQueue::encoderThread, this);
+    }
+
+    void CaptureQueue::stopThreads()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTerminate = true;
+        }
+        mJobAvailable.notify_all();
+        for (auto& thread : mThreads) thread.join();
+        mThreads.clear();
+        mTerminate = false;
+    }
+
+    void CaptureQueue::encoderThread()
+    {
+        while (true)
+        {
+            std::shared_ptr<Job> pJob;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mJobAvailable.wait(lock, [this] { return mTerminate || !mEncodeQueue.empty(); });
+                if (mEncodeQueue.empty()) return;
+                pJob = mEncodeQueue.front();
+                mEncodeQueue.pop_front();
+            }
+
+            try
+            {
+                encode(*pJob);
+            }
+            catch (const std::exception& e)
+            {
+                logError("Failed to encode capture '" + pJob->filename + "': " + e.what());
+                pJob->failed = true;
+            }
+
+            // Return the staging buffer to the ring.
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                const auto& pBuffer = pJob->pReadTask->getStagingBuffer();
+                if (mStagingBytes + pBuffer->getSize() <= mMemoryBudget)
+                {
+                    mStagingBuffers.push_back(pBuffer);
+                    mStagingBytes += pBuffer->getSize();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                pJob->encoded = true;
+                // Drop this thread's reference while holding the lock, so the job's GPU resources are always released on the main thread.
+                pJob.reset();
+            }
+            completeJobs();
+            mJobCompleted.notify_all();
+        }
+    }
+
+    void CaptureQueue::encode(Job& job)
+    {
+        if (job.partNames.empty())
+        {
+            // Single image. The data is copied out of the staging buffer, so the buffer can be reused before encoding.
+            std::vector<uint8_t> data = job.pReadTask->getData();
+            Bitmap::saveImage(job.tempFilename, job.width, job.height, job.format, Bitmap::ExportFlags::None, job.resourceFormat, true, data.data());
+            return;
+        }
+
+        // Multi-part EXR. The parts are encoded directly from the mapped staging buffer.
+        const auto& layouts = job.pReadTask->getLayouts();
+        const uint8_t* pData = job.pReadTask->map();
+        std::vector<ExrWriter::Part> parts(layouts.size());
+        for (size_t i = 0; i < layouts.size(); i++)
+        {
+            const auto& layout = layouts[i];
+            parts[i].name = job.partNames[i];
+            parts[i].width = layout.rowSize / getFormatBytesPerBlock(layout.format);
+            parts[i].height = layout.rowCount;
+
+            ExrWriter::Layer layer;
+            layer.format = layout.format;
+            layer.pData = pData + layout.offset;
+            layer.rowPitch = layout.rowPitch;
+            layer.storeIntegers = true;
+            parts[i].layers.push_back(layer);
+        }
+
+        try
+        {
+            ExrWriter::writeMultiPart(job.tempFilename, parts, job.compression);
+        }
+        catch (...)
+        {
+            job.pReadTask->unmap();
+            throw;
+        }
+        job.pReadTask->unmap();
+    }
+
+    void CaptureQueue::completeJobs()
+    {
+        // Called without the mutex held. Completes encoded jobs in submission order.
+        // The files are renamed outside the mutex, so enqueue() and the other encoder threads are not blocked by the filesystem.
+        // The jobs stay in the queue until their files are in place, so flush() doesn't return early.
+        std::lock_guard<std::mutex> completeLock(mCompleteMutex);
+
+        std::vector<std::shared_ptr<Job>> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for (const auto& pJob : mJobs)
+            {
+                if (!pJob->encoded) break;
+                jobs.push_back(pJob);
+            }
+        }
+        if (jobs.empty()) return;
+
+        uint64_t imagesWritten = 0;
+        uint64_t bytesWritten = 0;
+        for (const auto& pJob : jobs)
+        {
+            std::error_code ec;
+            if (pJob->failed)
+            {
+                // The error was already logged, only remove a partially written file.
+                std::filesystem::remove(pJob->tempFilename, ec);
+                continue;
+            }
+
+            std::filesystem::rename(pJob->tempFilename, pJob->filename, ec);
+            if (ec)
+            {
+                logError("Failed to write capture '" + pJob->filename + "': " + ec.message());
+                std::filesystem::remove(pJob->tempFilename, ec);
+            }
+            else
+            {
+                imagesWritten++;
+                auto fileSize = std::filesystem::file_size(pJob->filename, ec);
+                if (!ec) bytesWritten += fileSize;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStats.imagesWritten += imagesWritten;
+        mStats.bytesWritten += bytesWritten;
+        for (auto& pJob : jobs)
+        {
+            // Only this function removes jobs from the queue, so the collected jobs are still at its front.
+            assert(mJobs.front() == pJob);
+            mJobs.pop_front();
+            if (pJob->endOfFrame) mStats.framesWritten++;
+            mPendingBytes -= pJob->size;
+            mRetiredJobs.push_back(std::move(pJob));
+        }
+        if (mJobs.empty()) mStats.activeTime += secondsSince(mActiveStart);
+        // Drop the remaining references while holding the lock, so the jobs' GPU resources are always released on the main thread.
+        jobs.clear();
+    }
+
+    void CaptureQueue::releaseRetiredJobs()
+    {
+        // Readback tasks and temporary textures are released here on the main thread, not on the encoder threads.
+        std::vector<std::shared_ptr<Job>> retiredJobs;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            retiredJobs.swap(mRetiredJobs);
+        }
+    }
+
+    Buffer::SharedPtr CaptureQueue::acquireStagingBuffer(uint64_t size)
+    {
+        // Pick the smallest free staging buffer that can hold the data.
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto best = mStagingBuffers.end();
+        for (auto it = mStagingBuffers.begin(); it != mStagingBuffers.end(); ++it)
+        {
+            if ((*it)->getSize() >= size && (best == mStagingBuffers.end() || (*it)->getSize() < (*best)->getSize())) best = it;
+        }
+        if (best == mStagingBuffers.end()) return nullptr;
+
+        Buffer::SharedPtr pBuffer = std::move(*best);
+        mStagingBuffers.erase(best);
+        mStagingBytes -= pBuffer->getSize();
+        return pBuffer;
+    }
+}
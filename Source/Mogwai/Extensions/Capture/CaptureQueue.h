@@ -0,0 +1,187 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#pragma once
+#include "../../Mogwai.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace Mogwai
+{
+    /** Asynchronous queue for writing textures to image files.
+
+        Enqueuing a texture records a copy to a readback buffer and returns without waiting for the GPU.
+        A pool of encoder threads waits for the copies, encodes the images and writes them to disk.
+        Readback buffers are recycled through a ring of staging buffers.
+
+        The memory held by pending captures is bounded by a budget. When a capture would exceed it,
+        enqueue() blocks until older captures have been written (back-pressure).
+
+        Files are completed in the order they were enqueued. Each image is first written to a temporary
+        file, and the temporary files are renamed to their final names in submission order.
+
+        Several textures can be captured into one multi-part EXR file. They are read back with a single
+        batched copy into one staging buffer and encoded directly from the mapped buffer.
+    */
+    class CaptureQueue
+    {
+    public:
+        using UniquePtr = std::unique_ptr<CaptureQueue>;
+
+        struct Stats
+        {
+            uint64_t framesWritten = 0;     ///< Number of frames with all their images written.
+            uint64_t imagesWritten = 0;     ///< Number of image files written.
+            uint64_t bytesWritten = 0;      ///< Total size of the written files in bytes.
+            uint32_t pendingImages = 0;     ///< Number of images waiting for readback or encoding.
+            uint64_t pendingBytes = 0;      ///< Memory held by pending images in bytes.
+            double activeTime = 0.0;        ///< Time in seconds during which captures were pending.
+            double framesPerSecond = 0.0;   ///< Frames written per second of active time.
+            double bytesPerSecond = 0.0;    ///< Bytes written per second of active time.
+
+            pybind11::dict toPython() const;
+        };
+
+        /** Texture captured as a part of a multi-part EXR file.
+        */
+        struct Part
+        {
+            std::string name;               ///< Part name. Must be unique within the file.
+            Texture::SharedPtr pTexture;    ///< 2D texture to capture. The first mip level of the first array slice is captured.
+        };
+
+        /** Create a capture queue.
+            \param[in] encoderThreadCount Number of encoder threads.
+            \param[in] memoryBudget Maximum memory held by pending captures in bytes.
+        */
+        static UniquePtr create(uint32_t encoderThreadCount, uint64_t memoryBudget);
+
+        /** Destructor. Waits for all pending captures to be written.
+        */
+        ~CaptureQueue();
+
+        /** Enqueue a texture to be written to an image file.
+            The texture is copied on the GPU timeline, so its content at the time of the call is captured.
+            Blocks if the memory budget is exhausted until enough pending captures have been written.
+            \param[in] pContext Render context to record the copy on.
+            \param[in] pTexture 2D texture to capture. The first mip level of the first array slice is captured.
+            \param[in] filename Output filename.
+            \param[in] format File format.
+            \param[in] endOfFrame True if this is the last image captured for a frame. Used for the frame statistics.
+        */
+        void enqueue(RenderContext* pContext, const Texture::SharedPtr& pTexture, const std::string& filename, Bitmap::FileFormat format, bool endOfFrame = true);
+
+        /** Enqueue several textures to be written as the parts of one multi-part EXR file.
+            Textures in formats that can't be stored in EXR files are converted to RGBA32Float before readback.
+            Integer textures are stored as 32-bit unsigned integers, all other textures as 16-bit floats.
+            Blocks if the memory budget is exhausted until enough pending captures have been written.
+            \param[in] pContext Render context to record the copies on.
+            \param[in] parts Textures to capture.
+            \param[in] filename Output filename.
+            \param[in] compression EXR compression method.
+        */
+        void enqueueMultiPart(RenderContext* pContext, const std::vector<Part>& parts, const std::string& filename, ExrWriter::Compression compression = ExrWriter::Compression::ZIP);
+
+        /** Wait for all pending captures to be written.
+        */
+        void flush();
+
+        /** Get the capture statistics.
+        */
+        Stats getStats() const;
+
+        /** Reset the capture statistics.
+        */
+        void resetStats();
+
+        /** Set the number of encoder threads. Waits for all pending captures to be written.
+        */
+        void setEncoderThreadCount(uint32_t count);
+        uint32_t getEncoderThreadCount() const { return (uint32_t)mThreads.size(); }
+
+        /** Set the maximum memory held by pending captures in bytes.
+            A single capture larger than the budget is still processed, but only when no other capture is pending.
+        */
+        void setMemoryBudget(uint64_t bytes);
+        uint64_t getMemoryBudget() const { return mMemoryBudget; }
+
+    private:
+        CaptureQueue(uint32_t encoderThreadCount, uint64_t memoryBudget);
+
+        struct Job
+        {
+            std::string filename;
+            std::string tempFilename;
+            Bitmap::FileFormat format;
+            ResourceFormat resourceFormat;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint64_t size = 0;                              ///< Memory reserved from the budget.
+            bool endOfFrame = false;
+            std::vector<std::string> partNames;             ///< Part names if the job writes a multi-part EXR file.
+            ExrWriter::Compression compression = ExrWriter::Compression::ZIP;
+            CopyContext::ReadTextureTask::SharedPtr pReadTask;
+            std::vector<Texture::SharedPtr> blitTextures;   ///< Temporary textures for formats that need conversion before readback.
+            bool encoded = false;
+            bool failed = false;                            ///< True if the readback or encoding failed. No file is written.
+        };
+
+        Texture::SharedPtr blitToRGBA32Float(RenderContext* pContext, const Texture::SharedPtr& pTexture);
+        void reserve(const std::shared_ptr<Job>& pJob);
+        void submit(RenderContext* pContext, const std::shared_ptr<Job>& pJob, const std::vector<CopyContext::ReadTextureTask::Subresource>& subresources);
+        void startThreads(uint32_t count);
+        void stopThreads();
+        void encoderThread();
+        void encode(Job& job);
+        void completeJobs();
+        void releaseRetiredJobs();
+        Buffer::SharedPtr acquireStagingBuffer(uint64_t size);
+
+        std::vector<std::thread> mThreads;
+        mutable std::mutex mMutex;
+        std::mutex mCompleteMutex;                          ///< Serializes completing jobs, so files are renamed in submission order. Acquired before mMutex.
+        std::condition_variable mJobAvailable;
+        std::condition_variable mJobCompleted;
+        bool mTerminate = false;
+
+        std::deque<std::shared_ptr<Job>> mJobs;             ///< Pending jobs in submission order.
+        std::deque<std::shared_ptr<Job>> mEncodeQueue;      ///< Jobs not yet picked up by an encoder thread.
+        std::vector<std::shared_ptr<Job>> mRetiredJobs;     ///< Completed jobs whose GPU resources are released on the main thread.
+        std::vector<Buffer::SharedPtr> mStagingBuffers;     ///< Free staging buffers.
+        uint64_t mStagingBytes = 0;                         ///< Size of the free staging buffers.
+        uint64_t mNextSequence = 0;
+
+        uint64_t mMemoryBudget = 0;
+        uint64_t mPendingBytes = 0;
+
+        Stats mStats;
+        std::chrono::steady_clock::time_point mActiveStart;
+    };
+}
@@ -28,6 +28,7 @@
 #include "stdafx.h"
 #include "FrameCapture.h"
 #include <filesystem>
+#include <iomanip>
 
 namespace Mogwai
 {
@@ -40,6 +41,14 @@ namespace Mogwai
         const std::string kUI = "ui";
         const std::string kOutputs = "outputs";
         const std::string kCapture = "capture";
+        const std::string kFlush = "flush";
+        const std::string kStats = "stats";
+        const std::string kResetStats = "resetStats";
+        const std::string kEncoderThreads = "encoderThreads";
+        const std::string kMemoryBudgetMB = "memoryBudgetMB";
+        const std::string kMultiPartExr = "multiPartExr";
+
+        const uint64_t kDefaultMemoryBudget = 1ull << 30;
 
         template<typename T>
         std::vector<typename T::value_type::first_type> getFirstOfPair(const T& pair)
@@ -53,6 +62,13 @@ namespace Mogwai
 
     MOGWAI_EXTENSION(FrameCapture);
 
+    FrameCapture::FrameCapture(Renderer* pRenderer)
+        : CaptureTrigger(pRenderer, "Frame Capture")
+    {
+        uint32_t encoderThreadCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+        mpCaptureQueue = CaptureQueue::create(encoderThreadCount, kDefaultMemoryBudget);
+    }
+
     FrameCapture::UniquePtr FrameCapture::create(Renderer* pRenderer)
     {
         return UniquePtr(new FrameCapture(pRenderer));
@@ -69,7 +85,30 @@ namespace Mogwai
             w.checkbox("Capture All Outputs", mCaptureAllOutputs);
             w.tooltip("Capture all available outputs instead of the marked ones only.");
 
+            w.checkbox("Capture to Multi-Part EXR", mMultiPartExr);
+            w.tooltip("Write all captured outputs of a frame as the parts of a single EXR file instead of one file per output.");
+
             if (w.button("Capture Current Frame")) capture();
+
+            w.separator();
+
+            uint32_t encoderThreadCount = mpCaptureQueue->getEncoderThreadCount();
+            if (w.var("Encoder Threads", encoderThreadCount, 1u, 64u)) mpCaptureQueue->setEncoderThreadCount(encoderThreadCount);
+            w.tooltip("Number of threads encoding and writing captured images.");
+
+            uint32_t memoryBudgetMB = uint32_t(mpCaptureQueue->getMemoryBudget() >> 20);
+            if (w.var("Memory Budget (MB)", memoryBudgetMB, 1u)) mpCaptureQueue->setMemoryBudget(uint64_t(memoryBudgetMB) << 20);
+            w.tooltip("Maximum memory held by captures waiting to be written. Capturing blocks the render loop when the budget is exhausted.");
+
+            auto stats = mpCaptureQueue->getStats();
+            std::ostringstream oss;
+            oss << "Pending: " << stats.pendingImages << " images (" << formatByteSize(stats.pendingBytes) << ")\n"
+                << "Written: " << stats.framesWritten << " frames, " << stats.imagesWritten << " images (" << formatByteSize(stats.bytesWritten) << ")\n"
+                << "Throughput: " << std::fixed << std::setprecision(2) << stats.framesPerSecond << " frames/s, " << stats.bytesPerSecond / (1 << 20) << " MB/s";
+            w.text(oss.str());
+
+            if (w.button("Reset Stats")) mpCaptureQueue->resetStats();
+            if (w.button("Flush", true)) flush();
         }
     }
 
@@ -86,6 +125,8 @@ namespace Mogwai
         auto printGraph = [](FrameCapture* pFC, RenderGraph* pGraph) { pybind11::print(pFC->graphFramesStr(pGraph)); };
         frameCapture.def(kPrintFrames.c_str(), printGraph, "graph"_a);
         frameCapture.def(kCapture.c_str(), &FrameCapture::capture, "addFrameSuffix"_a=true);
+        frameCapture.def(kFlush.c_str(), &FrameCapture::flush);
+        frameCapture.def(kResetStats.c_str(), [](FrameCapture* pFC) { pFC->mpCaptureQueue->resetStats(); });
         auto printAllGraphs = [](FrameCapture* pFC)
         {
             std::string s;
@@ -98,6 +139,21 @@ namespace Mogwai
         auto getUI = [](FrameCapture* pFC) { return pFC->mShowUI; };
         auto setUI = [](FrameCapture* pFC, bool show) { pFC->mShowUI = show; };
         frameCapture.def_property(kUI.c_str(), getUI, setUI);
+
+        auto getMultiPartExr = [](FrameCapture* pFC) { return pFC->mMultiPartExr; };
+        auto setMultiPartExr = [](FrameCapture* pFC, bool enable) { pFC->mMultiPartExr = enable; };
+        frameCapture.def_property(kMultiPartExr.c_str(), getMultiPartExr, setMultiPartExr);
+
+        auto getEncoderThreads = [](FrameCapture* pFC) { return pFC->mpCaptureQueue->getEncoderThreadCount(); };
+        auto setEncoderThreads = [](FrameCapture* pFC, uint32_t count) { pFC->mpCaptureQueue->setEncoderThreadCount(count); };
+        frameCapture.def_property(kEncoderThreads.c_str(), getEncoderThreads, setEncoderThreads);
+
+        auto getMemoryBudgetMB = [](FrameCapture* pFC) { return uint32_t(pFC->mpCaptureQueue->getMemoryBudget() >> 20); };
+        auto setMemoryBudgetMB = [](FrameCapture* pFC, uint32_t budget) { pFC->mpCaptureQueue->setMemoryBudget(uint64_t(budget) << 20); };
+        frameCapture.def_property(kMemoryBudgetMB.c_str(), getMemoryBudgetMB, setMemoryBudgetMB);
+
+        auto getStats = [](FrameCapture* pFC) { return pFC->mpCaptureQueue->getStats().toPython(); };
+        frameCapture.def_property_readonly(kStats.c_str(), getStats);
     }
 
     std::string FrameCapture::getScriptVar() const
@@ -111,6 +167,7 @@ namespace Mogwai
 
         s += "# Frame Capture\n";
         s += CaptureTrigger::getScript(var);
+        if (mMultiPartExr) s += ScriptWriter::makeSetProperty(var, kMultiPartExr, mMultiPartExr);
 
         for (const auto& g : mGraphRanges)
         {
@@ -131,15 +188,30 @@ namespace Mogwai
             pGraph->execute(pCtx);
         }
 
-        for (uint32_t i = 0 ; i < pGraph->getOutputCount() ; i++)
+        if (mMultiPartExr)
         {
-            Texture* pTex = pGraph->getOutput(i)->asTexture().get();
-            assert(pTex);
-            auto ext = Bitmap::getFileExtFromResourceFormat(pTex->getFormat());
-            auto format = Bitmap::getFormatFromFileExtension(ext);
-            std::string filename = addFrameSuffix ? getOutputNamePrefix(pGraph->getOutputName(i)) + std::to_string(gpFramework->getGlobalClock().getFrame()) + "." + ext :
-                                                    getOutputNamePrefix(pGraph->getOutputName(i)) + ext;
-            pTex->captureToFile(0, 0, filename, format);
+            std::vector<CaptureQueue::Part> parts;
+            for (uint32_t i = 0; i < pGraph->getOutputCount(); i++)
+            {
+                Texture::SharedPtr pTex = pGraph->getOutput(i)->asTexture();
+                assert(pTex);
+                parts.push_back({ pGraph->getOutputName(i), pTex });
+            }
+            std::string filename = mBaseFilename + (addFrameSuffix ? "." + std::to_string(gpFramework->getGlobalClock().getFrame()) : "") + ".exr";
+            mpCaptureQueue->enqueueMultiPart(pCtx, parts, (getOutputPath() / filename).string());
+        }
+        else
+        {
+            for (uint32_t i = 0 ; i < pGraph->getOutputCount() ; i++)
+            {
+                Texture::SharedPtr pTex = pGraph->getOutput(i)->asTexture();
+                assert(pTex);
+                auto ext = Bitmap::getFileExtFromResourceFormat(pTex->getFormat());
+                auto format = Bitmap::getFormatFromFileExtension(ext);
+                std::string filename = addFrameSuffix ? getOutputNamePrefix(pGraph->getOutputName(i)) + std::to_string(gpFramework->getGlobalClock().getFrame()) + "." + ext :
+                                                        getOutputNamePrefix(pGraph->getOutputName(i)) + ext;
+                mpCaptureQueue->enqueue(pCtx, pTex, filename, format, i + 1 == pGraph->getOutputCount());
+            }
         }
 
         if (mCaptureAllOutputs && !unmarkedOutputs.empty())
@@ -176,4 +248,9 @@ namespace Mogwai
         uint64_t frameID = gpFramework->getGlobalClock().getFrame();
         triggerFrame(gpDevice->getRenderContext(), pGraph, frameID, addFrameSuffix);
     }
+
+    void FrameCapture::flush()
+    {
+        mpCaptureQueue->flush();
+    }
 }
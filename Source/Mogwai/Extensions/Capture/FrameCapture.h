@@ -28,6 +28,7 @@
 #pragma once
 #include "../../Mogwai.h"
 #include "CaptureTrigger.h"
+#include "CaptureQueue.h"
 
 namespace Mogwai
 {
@@ -41,13 +42,19 @@ namespace Mogwai
         virtual std::string getScript(const std::string& var) const override;
         virtual void triggerFrame(RenderContext* pCtx, RenderGraph* pGraph, uint64_t frameID, bool addFrameSuffix = true) override;
         void capture(bool addFrameSuffix = true);
+
+        /** Wait for all pending captures to be written to disk.
+        */
+        void flush();
     private:
-        FrameCapture(Renderer* pRenderer) : CaptureTrigger(pRenderer, "Frame Capture") {}
+        FrameCapture(Renderer* pRenderer);
         using uint64_vec = std::vector<uint64_t>;
         void addFrames(const RenderGraph* pGraph, const uint64_vec& frames);
         void addFrames(const std::string& graphName, const uint64_vec& frames);
         std::string graphFramesStr(const RenderGraph* pGraph);
 
         bool mCaptureAllOutputs = false;
+        bool mMultiPartExr = false;                 ///< Capture all outputs into one multi-part EXR file per frame.
+        CaptureQueue::UniquePtr mpCaptureQueue;     ///< Queue for asynchronous readback and encoding of the captured outputs.
     };
 }
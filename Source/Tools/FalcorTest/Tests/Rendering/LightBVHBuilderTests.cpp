@@ -0,0 +1,211 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Rendering/Lights/LightBVHBuilder.h"
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        using MeshLightTriangle = LightCollection::MeshLightTriangle;
+
+        /** Generates a synthetic set of emissive triangles scattered in clusters, similar to emissive signage.
+        */
+        std::vector<MeshLightTriangle> generateTriangles(uint32_t triangleCount, uint32_t seed)
+        {
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> u(0.f, 1.f);
+
+            std::vector<MeshLightTriangle> triangles(triangleCount);
+            float3 clusterCenter = float3(0.f);
+            for (uint32_t i = 0; i < triangleCount; i++)
+            {
+                if (i % 1024 == 0) clusterCenter = float3(u(rng), u(rng), u(rng)) * 100.f;
+
+                auto& tri = triangles[i];
+                float3 p = clusterCenter + float3(u(rng), u(rng), u(rng)) * 5.f;
+                tri.vtx[0].pos = p;
+                tri.vtx[1].pos = p + float3(u(rng), u(rng), 0.f) * 0.1f;
+                tri.vtx[2].pos = p + float3(0.f, u(rng), u(rng)) * 0.1f;
+                float3 n = glm::cross(tri.vtx[1].pos - tri.vtx[0].pos, tri.vtx[2].pos - tri.vtx[0].pos);
+                tri.area = 0.5f * glm::length(n);
+                tri.normal = tri.area > 0.f ? glm::normalize(n) : float3(0.f, 0.f, 1.f);
+                tri.flux = u(rng) < 0.1f ? 0.f : u(rng) * tri.area;
+            }
+            return triangles;
+        }
+
+        /** Generates degenerate point-sized triangles evenly spaced along a line.
+            All split costs evaluate to zero, so each split only peels off the first bin and the tree becomes much deeper than the supported maximum.
+        */
+        std::vector<MeshLightTriangle> generateDegenerateTriangles(uint32_t triangleCount)
+        {
+            std::vector<MeshLightTriangle> triangles(triangleCount);
+            for (uint32_t i = 0; i < triangleCount; i++)
+            {
+                auto& tri = triangles[i];
+                for (auto& vtx : tri.vtx) vtx.pos = float3((float)i, 0.f, 0.f);
+                tri.area = 0.f;
+                tri.normal = float3(0.f, 0.f, 1.f);
+                tri.flux = 1.f;
+            }
+            return triangles;
+        }
+
+        struct BuildOutput
+        {
+            std::vector<PackedNode> nodes;
+            std::vector<uint32_t> triangleIndices;
+            std::vector<uint64_t> triangleBitmasks;
+        };
+
+        BuildOutput build(const std::vector<MeshLightTriangle>& triangles, LightBVHBuilder::Options options, bool parallel, double* pTimeMs = nullptr)
+        {
+            options.useParallelBuild = parallel;
+            auto pBuilder = LightBVHBuilder::create(options);
+
+            BuildOutput output;
+            auto t0 = CpuTimer::getCurrentTimePoint();
+            pBuilder->buildNodes(triangles, output.nodes, output.triangleIndices, output.triangleBitmasks);
+            if (pTimeMs) *pTimeMs = CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint());
+            return output;
+        }
+
+        bool isIdentical(const BuildOutput& a, const BuildOutput& b)
+        {
+            return a.nodes.size() == b.nodes.size() &&
+                std::memcmp(a.nodes.data(), b.nodes.data(), a.nodes.size() * sizeof(PackedNode)) == 0 &&
+                a.triangleIndices == b.triangleIndices &&
+                a.triangleBitmasks == b.triangleBitmasks;
+        }
+    }
+
+    CPU_TEST(LightBVHBuilderParallelDeterministic)
+    {
+        const auto triangles = generateTriangles(200000, 1);
+
+        for (auto heuristic : { LightBVHBuilder::SplitHeuristic::Equal, LightBVHBuilder::SplitHeuristic::BinnedSAH, LightBVHBuilder::SplitHeuristic::BinnedSAOH })
+        {
+            LightBVHBuilder::Options options;
+            options.splitHeuristicSelection = heuristic;
+
+            BuildOutput serial = build(triangles, options, false);
+            BuildOutput parallel = build(triangles, options, true);
+            EXPECT(!serial.nodes.empty());
+            EXPECT(isIdentical(serial, parallel)) << "heuristic = " << (uint32_t)heuristic;
+        }
+    }
+
+    CPU_TEST(LightBVHBuilderMaxDepth)
+    {
+        // The root split is large enough to build its right subtree as a parallel task, and both subtrees exceed the maximum depth.
+        const auto triangles = generateDegenerateTriangles(65536);
+
+        for (bool parallel : { false, true })
+        {
+            bool threw = false;
+            try
+            {
+                build(triangles, LightBVHBuilder::Options(), parallel);
+            }
+            catch (const std::exception&)
+            {
+                threw = true;
+            }
+            EXPECT(threw) << "parallel = " << parallel;
+        }
+
+        // The builder and thread pool should still be usable after the failed builds.
+        const auto validTriangles = generateTriangles(20000, 5);
+        EXPECT(isIdentical(build(validTriangles, LightBVHBuilder::Options(), false), build(validTriangles, LightBVHBuilder::Options(), true)));
+    }
+
+    CPU_TEST(LightBVHBuilderBenchmark, "Benchmark, run manually")
+    {
+        const uint32_t triangleCount = 1 << 20;
+        const auto triangles = generateTriangles(triangleCount, 2);
+        const double millions = triangleCount / 1e6;
+
+        LightBVHBuilder::Options options;
+        double serialTime = 0.0, parallelTime = 0.0;
+        BuildOutput serial = build(triangles, options, false, &serialTime);
+        BuildOutput parallel = build(triangles, options, true, &parallelTime);
+        EXPECT(isIdentical(serial, parallel));
+
+        logInfo("LightBVHBuilder (" + std::to_string(Threading::getThreadCount()) + " threads): serial " + std::to_string(serialTime / millions) +
+            " ms/Mtri, parallel " + std::to_string(parallelTime / millions) + " ms/Mtri, speedup " + std::to_string(serialTime / parallelTime) + "x");
+    }
+
+    CPU_TEST(LightBVHBuilderSIMDBinning)
+    {
+        const auto triangles = generateTriangles(200000, 3);
+
+        for (auto heuristic : { LightBVHBuilder::SplitHeuristic::BinnedSAH, LightBVHBuilder::SplitHeuristic::BinnedSAOH })
+        {
+            for (bool splitAlongLargest : { false, true })
+            {
+                LightBVHBuilder::Options options;
+                options.splitHeuristicSelection = heuristic;
+                options.splitAlongLargest = splitAlongLargest;
+
+                options.useSIMDBinning = false;
+                BuildOutput scalar = build(triangles, options, true);
+                options.useSIMDBinning = true;
+                BuildOutput simd = build(triangles, options, true);
+                EXPECT(!simd.nodes.empty());
+                EXPECT(isIdentical(scalar, simd)) << "heuristic = " << (uint32_t)heuristic << ", splitAlongLargest = " << splitAlongLargest;
+            }
+        }
+    }
+
+    CPU_TEST(LightBVHBuilderSIMDBinningBenchmark, "Benchmark, run manually")
+    {
+        const uint32_t triangleCount = 1 << 20;
+        const auto triangles = generateTriangles(triangleCount, 4);
+        const double millions = triangleCount / 1e6;
+
+        for (auto heuristic : { LightBVHBuilder::SplitHeuristic::BinnedSAH, LightBVHBuilder::SplitHeuristic::BinnedSAOH })
+        {
+            LightBVHBuilder::Options options;
+            options.splitHeuristicSelection = heuristic;
+
+            // Serial builds to measure the binning itself.
+            double scalarTime = 0.0, simdTime = 0.0;
+            options.useSIMDBinning = false;
+            BuildOutput scalar = build(triangles, options, false, &scalarTime);
+            options.useSIMDBinning = true;
+            BuildOutput simd = build(triangles, options, false, &simdTime);
+            EXPECT(isIdentical(scalar, simd));
+
+            logInfo(std::string("LightBVHBuilder ") + (heuristic == LightBVHBuilder::SplitHeuristic::BinnedSAH ? "BinnedSAH" : "BinnedSAOH") +
+                ": scalar binning " + std::to_string(scalarTime / millions) + " ms/Mtri, SIMD binning " + std::to_string(simdTime / millions) +
+                " ms/Mtri, speedup " + std::to_string(scalarTime / simdTime) + "x");
+        }
+    }
+}
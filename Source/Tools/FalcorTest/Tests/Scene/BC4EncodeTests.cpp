@@ -0,0 +1,168 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Scene/Volume/BC4Encode.h"
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        const size_t kBlockCount = 1 << 16;
+
+        /** Generates blocks covering the cases the encoder distinguishes: noise, constant, two-valued, containing 0/255, gradients and low-contrast noise.
+        */
+        std::vector<uint8_t> generateTiles(size_t blockCount, uint32_t seed)
+        {
+            std::mt19937 rng(seed);
+            std::vector<uint8_t> tiles(blockCount * 16);
+            for (size_t i = 0; i < blockCount; i++)
+            {
+                const int base = rng() % 256;
+                const int amplitude = rng() % 64;
+                uint8_t* tile = &tiles[i * 16];
+                for (int j = 0; j < 16; j++)
+                {
+                    int v = 0;
+                    switch (i % 6)
+                    {
+                    case 0: v = rng() % 256; break;
+                    case 1: v = base; break;
+                    case 2: v = (j & 1) ? base : (base + amplitude) % 256; break;
+                    case 3: v = (j % 4 == 0) ? 0 : (j % 4 == 1) ? 255 : base; break;
+                    case 4: v = base + j * amplitude / 16 - 32; break;
+                    default: v = base + int(rng() % 9) - 4; break;
+                    }
+                    tile[j] = (uint8_t)std::clamp(v, 0, 255);
+                }
+            }
+            return tiles;
+        }
+
+        void decodeBlock(uint64_t block, uint8_t texels[16])
+        {
+            int palette[8];
+            palette[0] = int(block & 0xff);
+            palette[1] = int((block >> 8) & 0xff);
+            if (palette[0] > palette[1])
+            {
+                for (int i = 2; i < 8; i++) palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+            }
+            else
+            {
+                for (int i = 2; i < 6; i++) palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5;
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+            for (int i = 0; i < 16; i++) texels[i] = (uint8_t)palette[(block >> (16 + 3 * i)) & 7];
+        }
+
+        uint64_t computeSquaredError(const uint8_t* tile, uint64_t block)
+        {
+            uint8_t texels[16];
+            decodeBlock(block, texels);
+            uint64_t error = 0;
+            for (int i = 0; i < 16; i++) error += (texels[i] - tile[i]) * (texels[i] - tile[i]);
+            return error;
+        }
+
+        double computePSNR(const std::vector<uint8_t>& tiles, const std::vector<uint64_t>& blocks)
+        {
+            uint64_t error = 0;
+            for (size_t i = 0; i < blocks.size(); i++) error += computeSquaredError(&tiles[i * 16], blocks[i]);
+            if (error == 0) return std::numeric_limits<double>::infinity();
+            const double mse = double(error) / double(tiles.size());
+            return 10.0 * std::log10(255.0 * 255.0 / mse);
+        }
+
+        std::vector<uint64_t> encodeScalar(std::vector<uint8_t>& tiles)
+        {
+            std::vector<uint64_t> blocks(tiles.size() / 16);
+            for (size_t i = 0; i < blocks.size(); i++) CompressAlphaDxt5(&tiles[i * 16], &blocks[i]);
+            return blocks;
+        }
+
+        std::vector<uint64_t> encode(const std::vector<uint8_t>& tiles, BC4Encoder::Quality quality)
+        {
+            std::vector<uint64_t> blocks(tiles.size() / 16);
+            BC4Encoder::encode(tiles.data(), blocks.data(), blocks.size(), quality);
+            return blocks;
+        }
+    }
+
+    CPU_TEST(BC4EncodeReference)
+    {
+        auto tiles = generateTiles(kBlockCount, 1);
+        auto reference = encodeScalar(tiles);
+        auto blocks = encode(tiles, BC4Encoder::Quality::Reference);
+
+        size_t mismatches = 0;
+        for (size_t i = 0; i < blocks.size(); i++) mismatches += blocks[i] != reference[i];
+        EXPECT_EQ(mismatches, 0u);
+    }
+
+    CPU_TEST(BC4EncodeQuality)
+    {
+        auto tiles = generateTiles(kBlockCount, 2);
+        auto reference = encode(tiles, BC4Encoder::Quality::Reference);
+        auto fast = encode(tiles, BC4Encoder::Quality::Fast);
+        auto exhaustive = encode(tiles, BC4Encoder::Quality::Exhaustive);
+
+        // Exhaustive search includes the reference endpoints, so it is never worse on any block.
+        size_t worseBlocks = 0;
+        for (size_t i = 0; i < tiles.size() / 16; i++) worseBlocks += computeSquaredError(&tiles[i * 16], exhaustive[i]) > computeSquaredError(&tiles[i * 16], reference[i]);
+        EXPECT_EQ(worseBlocks, 0u);
+
+        const double psnrReference = computePSNR(tiles, reference);
+        const double psnrFast = computePSNR(tiles, fast);
+        const double psnrExhaustive = computePSNR(tiles, exhaustive);
+        EXPECT_GE(psnrExhaustive, psnrReference);
+        EXPECT_GE(psnrFast, psnrReference - 3.0);
+        logInfo("BC4Encoder PSNR: fast " + std::to_string(psnrFast) + " dB, reference " + std::to_string(psnrReference) + " dB, exhaustive " + std::to_string(psnrExhaustive) + " dB");
+    }
+
+    CPU_TEST(BC4EncodeBenchmark, "Benchmark, run manually")
+    {
+        auto tiles = generateTiles(kBlockCount, 3);
+        const double megabytes = double(tiles.size()) / (1024.0 * 1024.0);
+
+        auto t0 = CpuTimer::getCurrentTimePoint();
+        encodeScalar(tiles);
+        const double scalarTime = CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint());
+        std::string msg = "BC4Encoder throughput: scalar " + std::to_string(megabytes / scalarTime * 1000.0) + " MB/s";
+
+        for (auto [quality, name] : { std::make_pair(BC4Encoder::Quality::Fast, "fast"), std::make_pair(BC4Encoder::Quality::Reference, "reference"), std::make_pair(BC4Encoder::Quality::Exhaustive, "exhaustive") })
+        {
+            t0 = CpuTimer::getCurrentTimePoint();
+            encode(tiles, quality);
+            const double time = CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint());
+            msg += std::string(", ") + name + " " + std::to_string(megabytes / time * 1000.0) + " MB/s";
+        }
+        logInfo(msg);
+    }
+}
@@ -28,6 +28,7 @@
 #include "Testing/UnitTest.h"
 #include "Scene/Lights/EnvMap.h"
 #include "Rendering/Lights/EnvMapSampler.h"
+#include <random>
 
 namespace Falcor
 {
@@ -35,6 +36,50 @@ namespace Falcor
     {
         // This file is located in the Media/ directory fetched by packman.
         const char kEnvMapFile[] = "LightProbes/20050806-03_hd.hdr";
+
+        /** Read back all mip levels of an importance map texture, tightly packed.
+        */
+        std::vector<float> readImportanceMap(RenderContext* pRenderContext, const Texture::SharedPtr& pTexture)
+        {
+            std::vector<float> data;
+            for (uint32_t mip = 0; mip < pTexture->getMipCount(); mip++)
+            {
+                auto texels = pRenderContext->readTextureSubresource(pTexture.get(), pTexture->getSubresourceIndex(0, mip));
+                const float* pTexels = reinterpret_cast<const float*>(texels.data());
+                data.insert(data.end(), pTexels, pTexels + texels.size() / sizeof(float));
+            }
+            return data;
+        }
+
+        /** Check that sampling an importance map produces the distribution given by a reference importance map.
+            Samples are binned on a coarse grid and the bin frequencies are compared to the reference probabilities.
+        */
+        void testSampleDistribution(UnitTestContext& ctx, const EnvMapImportanceMap& importanceMap, const EnvMapImportanceMap& reference)
+        {
+            const uint32_t kBinMip = 4;
+            const uint32_t kSampleCount = 1 << 18;
+            const uint32_t binDim = importanceMap.getDimension() >> kBinMip;
+
+            std::vector<uint32_t> bins(binDim * binDim, 0);
+            std::mt19937 rng(1234);
+            std::uniform_real_distribution<float> u(0.f, 1.f);
+            for (uint32_t i = 0; i < kSampleCount; i++)
+            {
+                float pdf;
+                float2 p = importanceMap.sample(float2(u(rng), u(rng)), pdf);
+                uint2 bin = glm::min(uint2(p * float(binDim)), uint2(binDim - 1));
+                bins[bin.y * binDim + bin.x]++;
+            }
+
+            const float* pReferenceBins = reference.getMip(kBinMip);
+            float total = reference.getMip(reference.getMipCount() - 1)[0] * binDim * binDim;
+            for (uint32_t i = 0; i < bins.size(); i++)
+            {
+                float p = pReferenceBins[i] / total;
+                float frequency = bins[i] / float(kSampleCount);
+                EXPECT_LE(std::abs(frequency - p), 5.f * std::sqrt(p / kSampleCount) + 1e-4f) << "bin = " << i;
+            }
+        }
     }
 
     GPU_TEST(EnvMap)
@@ -64,4 +109,92 @@ namespace Falcor
         EXPECT_EQ(w, h);
         EXPECT_EQ(w, 1 << (mipCount - 1));
     }
+
+    CPU_TEST(EnvMapImportanceMap)
+    {
+        // Constant env map with a bright spot.
+        const uint32_t width = 128, height = 64;
+        std::vector<float> texels(width * height * 4, 1.f);
+        for (uint32_t y = 16; y < 20; y++)
+        {
+            for (uint32_t x = 40; x < 44; x++)
+            {
+                for (uint32_t c = 0; c < 3; c++) texels[(y * width + x) * 4 + c] = 1000.f;
+            }
+        }
+        auto pBitmap = Bitmap::create(width, height, ResourceFormat::RGBA32Float, reinterpret_cast<const uint8_t*>(texels.data()));
+        auto pImportanceMap = EnvMapImportanceMap::create(*pBitmap, 64, 16);
+        EXPECT_EQ(pImportanceMap->getMipCount(), 7u);
+
+        // Each mip level holds the average of the previous one.
+        for (uint32_t mip = 1; mip < pImportanceMap->getMipCount(); mip++)
+        {
+            uint32_t dim = 64 >> mip;
+            double sum = 0.0, prevSum = 0.0;
+            for (uint32_t i = 0; i < dim * dim; i++) sum += pImportanceMap->getMip(mip)[i];
+            for (uint32_t i = 0; i < 4 * dim * dim; i++) prevSum += pImportanceMap->getMip(mip - 1)[i];
+            EXPECT_LE(std::abs(sum * 4.0 - prevSum), 1e-4 * prevSum) << "mip = " << mip;
+        }
+
+        // The pdf returned by sample() must be consistent with the sample distribution.
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> u(0.f, 1.f);
+        double invPdfSum = 0.0;
+        const uint32_t sampleCount = 1 << 16;
+        for (uint32_t i = 0; i < sampleCount; i++)
+        {
+            float pdf;
+            float2 p = pImportanceMap->sample(float2(u(rng), u(rng)), pdf);
+            EXPECT(p.x >= 0.f && p.x <= 1.f && p.y >= 0.f && p.y <= 1.f);
+            EXPECT_GT(pdf, 0.f);
+            invPdfSum += 1.0 / pdf;
+        }
+        EXPECT_LE(std::abs(invPdfSum / sampleCount - 1.0), 0.02);
+        testSampleDistribution(ctx, *pImportanceMap, *pImportanceMap);
+
+        // Constant env maps have a constant importance map.
+        std::fill(texels.begin(), texels.end(), 2.f);
+        pBitmap = Bitmap::create(width, height, ResourceFormat::RGBA32Float, reinterpret_cast<const uint8_t*>(texels.data()));
+        pImportanceMap = EnvMapImportanceMap::create(*pBitmap, 32, 4);
+        for (uint32_t i = 0; i < 32 * 32; i++) EXPECT_LE(std::abs(pImportanceMap->getMip(0)[i] - 2.f), 1e-5f) << "i = " << i;
+    }
+
+    GPU_TEST(EnvMapImportanceMapMatchesGPU)
+    {
+        EnvMap::SharedPtr pEnvMap = EnvMap::create(kEnvMapFile);
+        EXPECT_NE(pEnvMap, nullptr);
+        if (pEnvMap == nullptr) return;
+
+        // Build the importance map on the GPU.
+        EXPECT(pEnvMap->getImportanceMap() == nullptr);
+        auto pGpuSampler = EnvMapSampler::create(ctx.getRenderContext(), pEnvMap);
+        auto pGpuTexture = pGpuSampler->getImportanceMap();
+        auto pGpuMap = EnvMapImportanceMap::create(pGpuTexture->getWidth(), EnvMapImportanceMap::kDefaultSamples, readImportanceMap(ctx.getRenderContext(), pGpuTexture));
+
+        // Build the importance map on the CPU.
+        EXPECT(pEnvMap->buildImportanceMap());
+        auto pCpuMap = pEnvMap->getImportanceMap();
+        EXPECT_NE(pCpuMap, nullptr);
+        if (pCpuMap == nullptr) return;
+        EXPECT_EQ(pCpuMap->getDimension(), pGpuMap->getDimension());
+
+        // The GPU filters with reduced precision, so individual texels differ slightly. The coarse mip levels must match closely.
+        for (uint32_t mip = 4; mip < pCpuMap->getMipCount(); mip++)
+        {
+            uint32_t dim = pCpuMap->getDimension() >> mip;
+            for (uint32_t i = 0; i < dim * dim; i++)
+            {
+                float cpu = pCpuMap->getMip(mip)[i], gpu = pGpuMap->getMip(mip)[i];
+                EXPECT_LE(std::abs(cpu - gpu), 1e-3f * std::max(gpu, 1e-3f)) << "mip = " << mip << ", i = " << i;
+            }
+        }
+
+        // Samples drawn from the CPU importance map follow the distribution of the GPU importance map.
+        testSampleDistribution(ctx, *pCpuMap, *pGpuMap);
+
+        // The sampler uploads the CPU importance map as-is.
+        auto pCpuSampler = EnvMapSampler::create(ctx.getRenderContext(), pEnvMap);
+        auto uploaded = readImportanceMap(ctx.getRenderContext(), pCpuSampler->getImportanceMap());
+        EXPECT(uploaded == pCpuMap->getData());
+    }
 }
@@ -0,0 +1,125 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "../TestUtils.h"
+#include "Scene/Volume/GridCache.h"
+#pragma warning(disable:4146 4244 4267 4275 4996)
+#include <nanovdb/util/IO.h>
+#pragma warning(default:4146 4244 4267 4275 4996)
+#include <fstream>
+
+namespace Falcor
+{
+    namespace
+    {
+        bool isEqual(const Grid& a, const Grid& b)
+        {
+            const auto& bufferA = a.getGridHandle().buffer();
+            const auto& bufferB = b.getGridHandle().buffer();
+            if (bufferA.size() != bufferB.size() || std::memcmp(bufferA.data(), bufferB.data(), bufferA.size()) != 0) return false;
+
+            const auto& dataA = a.getBrickedGridData();
+            const auto& dataB = b.getBrickedGridData();
+            return dataA.leafDim == dataB.leafDim && dataA.atlasSize == dataB.atlasSize && dataA.atlasFormat == dataB.atlasFormat &&
+                dataA.rangeData == dataB.rangeData && dataA.indirectionData == dataB.indirectionData && dataA.atlasData == dataB.atlasData;
+        }
+    }
+
+    CPU_TEST(GridCache)
+    {
+        const auto directory = createTempDirectory();
+
+        // Write a grid file to load through the cache.
+        const std::string path = (directory / "sphere.nvdb").string();
+        auto pSource = Grid::createSphere(40.f, 1.f, 2.f, false);
+        const std::string gridname = pSource->getGridHandle().gridMetaData()->gridName();
+        nanovdb::io::writeGrid(path, pSource->getGridHandle());
+
+        GridCache::Options options;
+        options.directory = (directory / "Cache").string();
+        auto pCache = GridCache::create(options);
+
+        auto key = pCache->computeKey(path, gridname);
+        EXPECT(key.has_value());
+        EXPECT(!pCache->hasGrid(*key));
+        EXPECT(pCache->computeKey(path, gridname + "2") != key);
+
+        // The first load converts the grid and adds it to the cache.
+        auto t0 = CpuTimer::getCurrentTimePoint();
+        auto pConverted = pCache->loadGrid(path, gridname, false);
+        const double convertTime = CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint());
+        EXPECT(pConverted != nullptr);
+        EXPECT(pCache->hasGrid(*key));
+
+        // The second load reads the cache file and must produce the same grid.
+        t0 = CpuTimer::getCurrentTimePoint();
+        auto pCached = pCache->loadGrid(path, gridname, false);
+        const double cachedTime = CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint());
+        EXPECT(pCached != nullptr);
+        EXPECT(pConverted && pCached && isEqual(*pConverted, *pCached));
+        logInfo("GridCache: convert " + std::to_string(convertTime) + " ms, cached " + std::to_string(cachedTime) + " ms");
+
+        // A corrupted cache file is replaced by converting the grid again.
+        {
+            std::ofstream fs(pCache->getCachePath(*key), std::ios_base::binary | std::ios_base::trunc);
+            fs << "invalid";
+        }
+        auto pReconverted = pCache->loadGrid(path, gridname, false);
+        EXPECT(pConverted && pReconverted && isEqual(*pConverted, *pReconverted));
+        auto pRecached = pCache->loadGrid(path, gridname, false);
+        EXPECT(pConverted && pRecached && isEqual(*pConverted, *pRecached));
+
+        // Clearing the cache removes the cache file, the grid is converted again on the next load.
+        pCache->clear();
+        EXPECT(!pCache->hasGrid(*key));
+        EXPECT(std::filesystem::is_empty(options.directory));
+        auto pCleared = pCache->loadGrid(path, gridname, false);
+        EXPECT(pConverted && pCleared && isEqual(*pConverted, *pCleared));
+        EXPECT(pCache->hasGrid(*key));
+
+        // Rewriting the grid file changes its size and last write time. The reference file of the new file stamp
+        // resolves to a new key and the entry of the old content is not returned.
+        auto pModified = Grid::createSphere(30.f, 1.f, 2.f, false);
+        nanovdb::io::writeGrid(path, pModified->getGridHandle());
+        std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(10));
+        auto modifiedKey = pCache->computeKey(path, gridname);
+        EXPECT(modifiedKey.has_value());
+        EXPECT(modifiedKey != key);
+        EXPECT(!pCache->hasGrid(*modifiedKey));
+
+        auto pModifiedConverted = pCache->loadGrid(path, gridname, false);
+        EXPECT(pModifiedConverted && pConverted && !isEqual(*pModifiedConverted, *pConverted));
+        EXPECT(pCache->hasGrid(*modifiedKey));
+        EXPECT(pCache->hasGrid(*key));
+
+        auto pModifiedCached = pCache->loadGrid(path, gridname, false);
+        EXPECT(pModifiedConverted && pModifiedCached && isEqual(*pModifiedConverted, *pModifiedCached));
+
+        std::filesystem::remove_all(directory);
+    }
+}
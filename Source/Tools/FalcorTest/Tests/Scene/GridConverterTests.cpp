@@ -0,0 +1,162 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Scene/Volume/GridConverter.h"
+#pragma warning(disable:4244 4267)
+#include <nanovdb/util/GridBuilder.h>
+#pragma warning(default:4244 4267)
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Generates a synthetic sparse fog volume: small noisy puffs scattered in a large bounding box, similar to a breaking-up cloud.
+        */
+        nanovdb::GridHandle<nanovdb::HostBuffer> generateSparseGrid(uint32_t puffCount, int extent, uint32_t seed)
+        {
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> u(0.f, 1.f);
+            std::uniform_int_distribution<int> position(-extent, extent);
+
+            nanovdb::GridBuilder<float> builder(0.f, nanovdb::GridClass::FogVolume);
+            auto acc = builder.getAccessor();
+            for (uint32_t i = 0; i < puffCount; i++)
+            {
+                const nanovdb::Coord center(position(rng), position(rng), position(rng));
+                const int radius = 4 + int(u(rng) * 12.f);
+                for (int z = -radius; z <= radius; z++)
+                {
+                    for (int y = -radius; y <= radius; y++)
+                    {
+                        for (int x = -radius; x <= radius; x++)
+                        {
+                            const float d = std::sqrt(float(x * x + y * y + z * z)) / radius;
+                            if (d < 1.f) acc.setValue(center + nanovdb::Coord(x, y, z), (1.f - d) * (0.5f + 0.5f * u(rng)));
+                        }
+                    }
+                }
+            }
+            return builder.getHandle<>(1.0, nanovdb::Vec3d(0.0), "density");
+        }
+
+        /** Get the texels of a brick from the atlas as raw bytes.
+        */
+        std::vector<uint8_t> getBrick(const BrickedGridData& data, uint32_t ptr)
+        {
+            const uint32_t bytesPerBlock = getFormatBytesPerBlock(data.atlasFormat);
+            const uint32_t blockWidth = getFormatWidthCompressionRatio(data.atlasFormat);
+            const uint32_t blockHeight = getFormatHeightCompressionRatio(data.atlasFormat);
+            const uint3 brick = uint3(ptr & 0xff, (ptr >> 8) & 0xff, ptr >> 16) * 8u;
+            const size_t rowPitch = data.atlasSize.x / blockWidth * bytesPerBlock;
+            const size_t slicePitch = data.atlasSize.y / blockHeight * rowPitch;
+
+            std::vector<uint8_t> texels;
+            for (uint32_t z = 0; z < 8; z++)
+            {
+                for (uint32_t y = 0; y < 8; y += blockHeight)
+                {
+                    const size_t offset = (brick.z + z) * slicePitch + (brick.y + y) / blockHeight * rowPitch + brick.x / blockWidth * bytesPerBlock;
+                    texels.insert(texels.end(), data.atlasData.begin() + offset, data.atlasData.begin() + offset + 8 / blockWidth * bytesPerBlock);
+                }
+            }
+            return texels;
+        }
+
+        /** Check that two conversions are identical up to the placement of the bricks in the atlas.
+        */
+        bool isEquivalent(const BrickedGridData& a, const BrickedGridData& b)
+        {
+            if (a.rangeData != b.rangeData || a.indirectionData.size() != b.indirectionData.size() || a.atlasSize != b.atlasSize) return false;
+            for (size_t i = 0; i < a.indirectionData.size(); i++)
+            {
+                const bool isConstant = (a.rangeData[i] & 0xffff) == (a.rangeData[i] >> 16);
+                if (!isConstant && getBrick(a, a.indirectionData[i]) != getBrick(b, b.indirectionData[i])) return false;
+            }
+            return true;
+        }
+
+        template<typename Converter>
+        void testSparseConversion(CPUUnitTestContext& ctx, const nanovdb::FloatGrid* pGrid, const std::string& name)
+        {
+            Converter dense(pGrid);
+            Converter sparse(pGrid);
+            BrickedGridData denseData = dense.convertToData(false);
+            BrickedGridData sparseData = sparse.convertToData(true);
+            EXPECT_GT(sparse.getBrickCount(), 0u) << name;
+            EXPECT_EQ(dense.getBrickCount(), sparse.getBrickCount()) << name;
+            EXPECT(isEquivalent(denseData, sparseData)) << name;
+
+            // The sparse conversion assigns bricks in leaf order, so the atlas is deterministic.
+            Converter sparse2(pGrid);
+            EXPECT(sparse2.convertToData(true).atlasData == sparseData.atlasData) << name;
+        }
+
+        template<typename Converter>
+        void benchmarkConversion(const nanovdb::FloatGrid* pGrid, const std::string& name)
+        {
+            double times[2];
+            uint64_t peakMemory[2];
+            for (bool sparse : { false, true })
+            {
+                Converter converter(pGrid);
+                auto t0 = CpuTimer::getCurrentTimePoint();
+                converter.convertToData(sparse);
+                times[sparse] = CpuTimer::calcDuration(t0, CpuTimer::getCurrentTimePoint());
+                peakMemory[sparse] = converter.getPeakMemoryUsage();
+            }
+            logInfo("NanoVDBToBricksConverter " + name + ": dense " + std::to_string(times[0]) + " ms (peak " + formatByteSize(peakMemory[0]) +
+                "), sparse " + std::to_string(times[1]) + " ms (peak " + formatByteSize(peakMemory[1]) + "), speedup " + std::to_string(times[0] / times[1]) + "x");
+        }
+    }
+
+    CPU_TEST(GridConverterSparse)
+    {
+        auto handle = generateSparseGrid(64, 256, 1);
+        const nanovdb::FloatGrid* pGrid = handle.grid<float>();
+        EXPECT(pGrid != nullptr);
+
+        testSparseConversion<NanoVDBConverterBC4>(ctx, pGrid, "BC4");
+        testSparseConversion<NanoVDBConverterUNORM8>(ctx, pGrid, "UNORM8");
+        testSparseConversion<NanoVDBConverterUNORM16>(ctx, pGrid, "UNORM16");
+    }
+
+    CPU_TEST(GridConverterBenchmark, "Benchmark, run manually")
+    {
+        for (uint32_t puffCount : { 256u, 1024u })
+        {
+            auto handle = generateSparseGrid(puffCount, 1024, 2);
+            const nanovdb::FloatGrid* pGrid = handle.grid<float>();
+            const std::string leaves = " (" + std::to_string(pGrid->tree().nodeCount(0)) + " leaves)";
+
+            benchmarkConversion<NanoVDBConverterBC4>(pGrid, "BC4" + leaves);
+            benchmarkConversion<NanoVDBConverterUNORM8>(pGrid, "UNORM8" + leaves);
+            benchmarkConversion<NanoVDBConverterUNORM16>(pGrid, "UNORM16" + leaves);
+        }
+    }
+}
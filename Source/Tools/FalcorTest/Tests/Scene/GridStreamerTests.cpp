@@ -0,0 +1,293 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Scene/Volume/GridStreamer.h"
+#include "Utils/Threading.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+
+namespace Falcor
+{
+    namespace
+    {
+        const uint32_t kFrameCount = 32;
+        const double kFrameRate = 100.0;
+        const double kFrameTime = 1000.0 / kFrameRate; // Time between frames in ms.
+        const uint32_t kPlaybackFrames = 100;
+        const double kLoadTime = 30.0; // Load time in ms, longer than the time between frames.
+
+        // Simulated time in ms. Each thread has its own time, so load times don't depend on the scheduling of the worker threads.
+        thread_local double tSimulatedTime = 0.0;
+
+        double getSimulatedTime()
+        {
+            return tSimulatedTime;
+        }
+
+        /** Load function simulating file IO. Creates equally sized spheres without GPU resources.
+        */
+        Grid::SharedPtr loadFrame(uint32_t frame)
+        {
+            tSimulatedTime += kLoadTime;
+            return Grid::createSphere(1.f, 0.1f, 2.f, false);
+        }
+
+        // Time at which the last load on this thread completed, until the load task reads the clock.
+        thread_local std::optional<double> tLoadEndTime;
+
+        /** Simulates playback in real time with a clock shared by the main thread and the load tasks.
+            The main thread advances the clock by the time between frames. A load completes kLoadTime ms
+            after it started, so it blocks until the clock reaches its deadline. While the main thread waits
+            for a frame, it cannot advance the clock, so the load it waits for advances the clock to its deadline.
+        */
+        class PlaybackClock
+        {
+        public:
+            double getTime()
+            {
+                // A load task reads the clock before and after the load. After the load, it sees the time the load
+                // completed, not the current time, which the main thread may have advanced in the meantime.
+                if (tLoadEndTime)
+                {
+                    const double time = *tLoadEndTime;
+                    tLoadEndTime.reset();
+                    return time;
+                }
+
+                std::lock_guard<std::mutex> lock(mMutex);
+
+                // The streamer reads the clock on the main thread while selecting a frame only when it has to wait for the frame.
+                if (std::this_thread::get_id() == mMainThread && mRequestedFrame != kNoFrame)
+                {
+                    mStalled = true;
+                    mCondition.notify_all();
+                }
+                return mTime;
+            }
+
+            Grid::SharedPtr load(uint32_t frame)
+            {
+                auto pGrid = Grid::createSphere(1.f, 0.1f, 2.f, false);
+
+                std::unique_lock<std::mutex> lock(mMutex);
+                const double deadline = mTime + kLoadTime;
+                auto it = mDeadlines.insert(deadline);
+                mStartedLoads++;
+                mCondition.notify_all();
+
+                const bool isMainThread = std::this_thread::get_id() == mMainThread;
+                mCondition.wait(lock, [&] () { return mTime >= deadline || isMainThread || (frame == mRequestedFrame && mStalled); });
+                mTime = std::max(mTime, deadline);
+                mDeadlines.erase(it);
+                tLoadEndTime = deadline;
+                mCondition.notify_all();
+                return pGrid;
+            }
+
+            /** Advance the clock and wait for the loads that complete until the new time.
+            */
+            void advance(double time)
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mTime += time;
+                mCondition.notify_all();
+                mCondition.wait(lock, [this] () { return mDeadlines.empty() || *mDeadlines.begin() > mTime; });
+            }
+
+            /** Let the running loads complete. The streamer waits for them when it is destroyed.
+            */
+            void finishLoads(GridStreamer& streamer)
+            {
+                advance(kLoadTime);
+                streamer.finishPendingLoads();
+            }
+
+            /** Select a frame and wait for the loads dispatched by the streamer to start, so that their
+                deadlines don't depend on the scheduling of the worker threads.
+            */
+            Grid::SharedPtr setFrame(GridStreamer& streamer, uint32_t frame)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mRequestedFrame = frame;
+                    mStalled = false;
+                }
+                auto pGrid = streamer.setFrame(frame);
+                {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mRequestedFrame = kNoFrame;
+                }
+
+                const auto stats = streamer.getStats();
+                const uint64_t dispatchedLoads = stats.loadedFrames + stats.pendingLoads;
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCondition.wait(lock, [&] () { return mStartedLoads == dispatchedLoads || mDeadlines.size() >= Threading::getThreadCount(); });
+                return pGrid;
+            }
+
+        private:
+            static const uint32_t kNoFrame = std::numeric_limits<uint32_t>::max();
+
+            std::mutex mMutex;
+            std::condition_variable mCondition;
+            const std::thread::id mMainThread = std::this_thread::get_id();
+            double mTime = 0.0;
+            uint32_t mRequestedFrame = kNoFrame;
+            bool mStalled = false;                  ///< True once the main thread waits for the requested frame.
+            uint64_t mStartedLoads = 0;
+            std::multiset<double> mDeadlines;       ///< Deadlines of the running loads.
+        };
+
+        /** Plays back the sequence from frame 1 at the simulated frame rate, after the first frame and its prefetched frames are loaded.
+        */
+        void playback(CPUUnitTestContext& ctx, PlaybackClock& clock, GridStreamer& streamer, const GridStreamer::Options& options)
+        {
+            auto pGrid = clock.setFrame(streamer, 0);
+            EXPECT(pGrid != nullptr);
+            EXPECT(!pGrid->hasResources());
+            EXPECT_EQ(streamer.getStats().prefetchMisses, 1ull);
+            EXPECT_EQ(streamer.getStats().stallTime, kLoadTime);
+            clock.advance(kLoadTime);
+
+            for (uint32_t i = 1; i <= kPlaybackFrames; i++)
+            {
+                clock.advance(kFrameTime);
+                uint32_t frame = i % kFrameCount;
+                pGrid = clock.setFrame(streamer, frame);
+                EXPECT(pGrid != nullptr);
+                EXPECT_EQ(streamer.getFrame(), frame);
+                EXPECT_LE(streamer.getStats().residentBytes, options.memoryBudget);
+            }
+        }
+    }
+
+    CPU_TEST(GridStreamerPlayback)
+    {
+        // Hiding the load time requires running the loads of the prefetch window in parallel.
+        if (Threading::getThreadCount() < 4) throw SkippingTestException("Test requires at least 4 worker threads");
+
+        const uint64_t frameSize = loadFrame(0)->getGridSizeInBytes();
+        EXPECT_GT(frameSize, 0ull);
+
+        PlaybackClock clock;
+        GridStreamer::Options options;
+        options.prefetchFrames = 1;
+        options.memoryBudget = 8 * frameSize;
+        auto pStreamer = GridStreamer::create(kFrameCount, [&clock](uint32_t frame) { return clock.load(frame); }, options, [&clock]() { return clock.getTime(); });
+        pStreamer->setFrameRate(kFrameRate);
+
+        // The prefetch window is extended to hide the load time: ceil(30 ms * 100 fps) + 1 = 4 frames.
+        // With it, every frame is loaded before it is selected and playback never waits for a frame.
+        playback(ctx, clock, *pStreamer, options);
+
+        auto stats = pStreamer->getStats();
+        EXPECT_EQ(stats.prefetchWindow, (uint32_t)std::ceil(kLoadTime / kFrameTime) + 1);
+        EXPECT_EQ(stats.frameRequests, (uint64_t)kPlaybackFrames + 1);
+        EXPECT_EQ(stats.prefetchHits + stats.prefetchMisses, stats.frameRequests);
+        EXPECT_EQ(stats.stallTime, kLoadTime); // Only the first frame stalled.
+        EXPECT_GT(stats.evictedFrames, 0ull);
+        EXPECT_LE(stats.residentFrames, 8u);
+
+        clock.finishLoads(*pStreamer);
+    }
+
+    CPU_TEST(GridStreamerPlaybackStalls)
+    {
+        const uint64_t frameSize = loadFrame(0)->getGridSizeInBytes();
+
+        PlaybackClock clock;
+        GridStreamer::Options options;
+        options.prefetchFrames = 1;
+        options.memoryBudget = 2 * frameSize;
+        options.adaptivePrefetch = false;
+        auto pStreamer = GridStreamer::create(kFrameCount, [&clock](uint32_t frame) { return clock.load(frame); }, options, [&clock]() { return clock.getTime(); });
+        pStreamer->setFrameRate(kFrameRate);
+
+        // Without extending the prefetch window, each frame after the first prefetched one is requested one frame time
+        // after its load started and playback waits for the rest of the load time.
+        playback(ctx, clock, *pStreamer, options);
+
+        auto stats = pStreamer->getStats();
+        EXPECT_EQ(stats.prefetchWindow, 1u);
+        EXPECT_GE(stats.prefetchMisses, (uint64_t)kPlaybackFrames);
+        EXPECT_GT(stats.stallTime, kLoadTime);
+        EXPECT_EQ(stats.stallTime, kLoadTime + (kPlaybackFrames - 1) * (kLoadTime - kFrameTime));
+
+        clock.finishLoads(*pStreamer);
+    }
+
+    CPU_TEST(GridStreamerSkipFrames)
+    {
+        GridStreamer::Options options;
+        options.prefetchFrames = 2;
+        auto pStreamer = GridStreamer::create(kFrameCount, loadFrame, options, getSimulatedTime);
+        pStreamer->setFrameRate(kFrameRate);
+
+        // Play back every third frame. The step is predicted after the first frame change.
+        pStreamer->setFrame(0);
+        pStreamer->finishPendingLoads();
+        pStreamer->setFrame(3);
+        pStreamer->finishPendingLoads();
+        pStreamer->resetStats();
+
+        for (uint32_t frame = 6; frame < kFrameCount; frame += 3)
+        {
+            pStreamer->finishPendingLoads();
+            pStreamer->setFrame(frame);
+        }
+
+        auto stats = pStreamer->getStats();
+        EXPECT_EQ(stats.prefetchMisses, 0ull);
+        EXPECT_GE(stats.prefetchWindow, 2u);
+    }
+
+    CPU_TEST(GridStreamerFailedLoad)
+    {
+        std::atomic<uint32_t> loadCount = 0;
+        auto loadFunc = [&loadCount](uint32_t frame) -> Grid::SharedPtr
+        {
+            loadCount++;
+            if (frame == 1) throw std::exception("Cannot load frame");
+            return nullptr;
+        };
+        GridStreamer::Options options;
+        options.prefetchFrames = 0;
+        auto pStreamer = GridStreamer::create(2, loadFunc, options);
+
+        // Failed frames are kept as empty frames and are not loaded again.
+        EXPECT(pStreamer->setFrame(1) == nullptr);
+        EXPECT(pStreamer->setFrame(0) == nullptr);
+        EXPECT(pStreamer->setFrame(1) == nullptr);
+        EXPECT_EQ(loadCount.load(), 2u);
+        EXPECT_EQ(pStreamer->getStats().loadedFrames, 0ull);
+    }
+}
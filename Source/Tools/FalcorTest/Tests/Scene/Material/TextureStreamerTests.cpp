@@ -0,0 +1,154 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Scene/Material/TextureStreamer.h"
+#include "../../TestUtils.h"
+#include <filesystem>
+#include <thread>
+
+namespace Falcor
+{
+    namespace
+    {
+        const uint32_t kSize = 256;
+        const uint32_t kInitialResolution = 64;
+        const uint64_t kMip0Size = kSize * kSize * 4;
+        const uint64_t kMip1Size = kMip0Size / 4;
+
+        std::string writeImage(const std::filesystem::path& directory, const std::string& name, uint8_t seed)
+        {
+            std::vector<uint8_t> pixels(kSize * kSize * 4);
+            for (uint32_t i = 0; i < kSize * kSize; i++)
+            {
+                pixels[i * 4 + 0] = (uint8_t)(i % kSize + seed);
+                pixels[i * 4 + 1] = (uint8_t)(i / kSize);
+                pixels[i * 4 + 2] = seed;
+                pixels[i * 4 + 3] = 255;
+            }
+            const std::string path = (directory / name).string();
+            Bitmap::saveImage(path, kSize, kSize, Bitmap::FileFormat::PngFile, Bitmap::ExportFlags::ExportAlpha, ResourceFormat::RGBA8Unorm, true, pixels.data());
+            return path;
+        }
+
+        /** Run streamer updates until all pending loads are finished.
+        */
+        void finishLoads(RenderContext* pRenderContext, TextureStreamer& streamer, TextureStreamer::FeedbackSource& feedback)
+        {
+            for (uint32_t i = 0; i < 10000 && streamer.getStats().pendingLoads > 0; i++)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                streamer.update(pRenderContext, &feedback);
+            }
+        }
+    }
+
+    GPU_TEST(TextureStreamer)
+    {
+        RenderContext* pRenderContext = ctx.getRenderContext();
+        const auto directory = createTempDirectory();
+        const std::string pathA = writeImage(directory, "a.png", 0);
+        const std::string pathB = writeImage(directory, "b.png", 64);
+
+        TextureCache::Options cacheOptions;
+        cacheOptions.directory = directory.string();
+        auto pCache = TextureCache::create(cacheOptions);
+
+        // Budget for the streamed mip levels of a single texture.
+        TextureStreamer::Options options;
+        options.initialResolution = kInitialResolution;
+        options.memoryBudget = kMip0Size + kMip1Size;
+        auto pStreamer = TextureStreamer::create(pCache, options);
+
+        Texture::SharedPtr pTextureA, pTextureB;
+        auto idA = pStreamer->addTexture(pathA, false, [&](const Texture::SharedPtr& pTexture) { pTextureA = pTexture; });
+        auto idB = pStreamer->addTexture(pathB, false, [&](const Texture::SharedPtr& pTexture) { pTextureB = pTexture; });
+        EXPECT_EQ(pStreamer->addTexture(pathA, false, nullptr), idA);
+        EXPECT_EQ(pStreamer->getTextureCount(), 2u);
+
+        // Only the mip tails are loaded up front.
+        pStreamer->finishInitialLoads();
+        EXPECT(pTextureA != nullptr && pTextureB != nullptr);
+        if (!pTextureA || !pTextureB) return;
+        EXPECT_EQ(pStreamer->getMipCount(idA), 9u);
+        EXPECT_EQ(pStreamer->getResidentMip(idA), 2u);
+        EXPECT_EQ(pTextureA->getWidth(), kInitialResolution);
+        EXPECT_EQ(pTextureA->getMipCount(), 7u);
+        EXPECT(pStreamer->isStreamed(pTextureA));
+        EXPECT_EQ(pStreamer->getStats().residentMemoryInBytes, 0ull);
+
+        // Without requests no mip levels are streamed in.
+        pStreamer->update(pRenderContext, nullptr);
+        EXPECT_EQ(pStreamer->getStats().pendingLoads, 0u);
+        EXPECT_EQ(pStreamer->getResidentMip(idA), 2u);
+
+        auto pReferenceA = pCache->loadTexture(pathA, true, false);
+        auto pReferenceB = pCache->loadTexture(pathB, true, false);
+
+        // Stream in texture A.
+        auto pFeedback = TextureStreamer::EmulatedFeedback::create();
+        pFeedback->requestMip(idA, 0);
+        pStreamer->update(pRenderContext, pFeedback.get());
+        finishLoads(pRenderContext, *pStreamer, *pFeedback);
+        EXPECT_EQ(pStreamer->getResidentMip(idA), 0u);
+        EXPECT_EQ(pTextureA->getWidth(), kSize);
+        EXPECT_EQ(pTextureA->getMipCount(), 9u);
+        EXPECT_EQ(pStreamer->getStats().residentMemoryInBytes, kMip0Size + kMip1Size);
+        EXPECT(pRenderContext->readTextureSubresource(pTextureA.get(), 0) == pRenderContext->readTextureSubresource(pReferenceA.get(), 0));
+
+        // Streaming in texture B evicts the least recently used mip levels of texture A.
+        pFeedback->requestMip(idB, 0);
+        pStreamer->update(pRenderContext, pFeedback.get());
+        finishLoads(pRenderContext, *pStreamer, *pFeedback);
+        EXPECT_EQ(pStreamer->getResidentMip(idA), 2u);
+        EXPECT_EQ(pStreamer->getResidentMip(idB), 0u);
+        EXPECT_EQ(pTextureA->getWidth(), kInitialResolution);
+        EXPECT_EQ(pTextureB->getWidth(), kSize);
+        EXPECT_EQ(pStreamer->getStats().residentMemoryInBytes, kMip0Size + kMip1Size);
+        EXPECT_EQ(pStreamer->getStats().evictedBytes, kMip0Size + kMip1Size);
+        EXPECT(pRenderContext->readTextureSubresource(pTextureA.get(), 0) == pRenderContext->readTextureSubresource(pReferenceA.get(), 2));
+        EXPECT(pRenderContext->readTextureSubresource(pTextureB.get(), 0) == pRenderContext->readTextureSubresource(pReferenceB.get(), 0));
+
+        // Mip levels used in the same frame are not evicted, so texture A cannot be streamed in.
+        pFeedback->requestMip(idA, 0);
+        pFeedback->requestMip(idB, 0);
+        pStreamer->update(pRenderContext, pFeedback.get());
+        EXPECT_EQ(pStreamer->getStats().pendingLoads, 0u);
+        EXPECT_EQ(pStreamer->getResidentMip(idA), 2u);
+        EXPECT_EQ(pStreamer->getResidentMip(idB), 0u);
+
+        // Lowering the budget evicts the most detailed mip levels first.
+        options.memoryBudget = kMip1Size;
+        pStreamer->setOptions(options);
+        pStreamer->update(pRenderContext, pFeedback.get());
+        EXPECT_EQ(pStreamer->getResidentMip(idB), 1u);
+        EXPECT_EQ(pTextureB->getWidth(), kSize / 2);
+        EXPECT_EQ(pStreamer->getStats().residentMemoryInBytes, kMip1Size);
+
+        std::filesystem::remove_all(directory);
+    }
+}
@@ -0,0 +1,143 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Scene/MeshOptimizer.h"
+#include <numeric>
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Generates a grid with size x size quads and returns its indices with the triangles in random order.
+        */
+        std::vector<uint32_t> createShuffledGrid(uint32_t size, std::vector<float3>& positions)
+        {
+            const uint32_t rowLength = size + 1;
+            positions.clear();
+            for (uint32_t i = 0; i < rowLength * rowLength; i++) positions.push_back(float3(i % rowLength, i / rowLength, 0.f));
+
+            std::vector<uint32_t> triangles;
+            for (uint32_t y = 0; y < size; y++)
+            {
+                for (uint32_t x = 0; x < size; x++)
+                {
+                    uint32_t i = y * rowLength + x;
+                    for (uint32_t index : { i, i + 1, i + rowLength, i + 1, i + rowLength + 1, i + rowLength }) triangles.push_back(index);
+                }
+            }
+
+            std::vector<uint32_t> order(triangles.size() / 3);
+            std::iota(order.begin(), order.end(), 0);
+            std::shuffle(order.begin(), order.end(), std::mt19937(1));
+
+            std::vector<uint32_t> indices;
+            for (uint32_t t : order)
+            {
+                for (uint32_t k = 0; k < 3; k++) indices.push_back(triangles[t * 3 + k]);
+            }
+            return indices;
+        }
+
+        /** Returns the triangles as sorted list of index triples with the smallest index first.
+        */
+        std::vector<uint3> getSortedTriangles(const std::vector<uint32_t>& indices)
+        {
+            std::vector<uint3> triangles;
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                uint3 t(indices[i], indices[i + 1], indices[i + 2]);
+                // Rotate so the smallest index is first, which preserves the winding.
+                while (t.x > t.y || t.x > t.z) t = uint3(t.y, t.z, t.x);
+                triangles.push_back(t);
+            }
+            std::sort(triangles.begin(), triangles.end(), [](const uint3& a, const uint3& b) { return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z); });
+            return triangles;
+        }
+    }
+
+    CPU_TEST(MeshOptimizerCacheStats)
+    {
+        // A single triangle transforms three vertices.
+        auto stats = MeshOptimizer::computeCacheStats({ 0, 1, 2 }, 3);
+        EXPECT_EQ(stats.triangleCount, 1);
+        EXPECT_EQ(stats.vertexCount, 3);
+        EXPECT_EQ(stats.missCount, 3);
+
+        // With a cache size of three, the second triangle reuses two vertices.
+        stats = MeshOptimizer::computeCacheStats({ 0, 1, 2, 2, 1, 3 }, 4, 3);
+        EXPECT_EQ(stats.missCount, 4);
+        EXPECT_EQ(stats.getACMR(), 2.f);
+        EXPECT_EQ(stats.getATVR(), 1.f);
+
+        // With a cache size of one, only immediately repeated vertices hit.
+        stats = MeshOptimizer::computeCacheStats({ 0, 1, 2, 2, 1, 3 }, 4, 1);
+        EXPECT_EQ(stats.missCount, 5);
+    }
+
+    CPU_TEST(MeshOptimizerVertexCache)
+    {
+        std::vector<float3> positions;
+        const auto indices = createShuffledGrid(128, positions);
+        const uint32_t vertexCount = (uint32_t)positions.size();
+        const auto triangles = getSortedTriangles(indices);
+        const auto statsBefore = MeshOptimizer::computeCacheStats(indices, vertexCount);
+
+        // Tipsify on the whole mesh.
+        auto optimized = MeshOptimizer::optimizeVertexCache(indices, vertexCount);
+        auto stats = MeshOptimizer::computeCacheStats(optimized, vertexCount);
+        EXPECT(getSortedTriangles(optimized) == triangles);
+        EXPECT_LT(stats.getACMR(), 0.7f);
+        EXPECT_LT(stats.getACMR(), statsBefore.getACMR());
+        EXPECT_LT(stats.getATVR(), 1.4f);
+
+        // Morton-ordered meshlets.
+        auto sorted = indices;
+        MeshOptimizer::sortTrianglesMorton(sorted, positions);
+        EXPECT(getSortedTriangles(sorted) == triangles);
+        optimized = MeshOptimizer::optimizeVertexCache(sorted, vertexCount, MeshOptimizer::kDefaultCacheSize, 128);
+        stats = MeshOptimizer::computeCacheStats(optimized, vertexCount);
+        EXPECT(getSortedTriangles(optimized) == triangles);
+        EXPECT_LT(stats.getACMR(), 1.f);
+    }
+
+    CPU_TEST(MeshOptimizerVertexFetch)
+    {
+        std::vector<uint32_t> indices = { 5, 3, 0, 3, 5, 2 };
+        const auto original = indices;
+        auto remap = MeshOptimizer::optimizeVertexFetch(indices, 6);
+
+        // Vertices are numbered in order of first use, unused vertices go last.
+        EXPECT(indices == std::vector<uint32_t>({ 0, 1, 2, 1, 0, 3 }));
+        EXPECT_EQ(remap[5], 0);
+        EXPECT_EQ(remap[3], 1);
+        EXPECT_EQ(remap[1], 4);
+        EXPECT_EQ(remap[4], 5);
+        for (size_t i = 0; i < indices.size(); i++) EXPECT_EQ(indices[i], remap[original[i]]);
+    }
+}
@@ -0,0 +1,185 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Scene/SDFs/SDFGrid.h"
+#include "Scene/SDFs/SparseBrickSet/SDFSBS.h"
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        const float kHalfCheeseExtent = 0.3f;
+        const uint32_t kHoleCount = 16;
+
+        /** Analytic SDF of a box with spherical holes, similar to SDFGrid.createCheeseSDFGrid() in python.
+        */
+        struct Cheese
+        {
+            float4 holes[kHoleCount];
+
+            Cheese(uint32_t seed)
+            {
+                std::mt19937 rng(seed);
+                std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+                for (uint32_t s = 0; s < kHoleCount; s++)
+                {
+                    float3 p = 2.0f * kHalfCheeseExtent * float3(dist(rng), dist(rng), dist(rng)) - float3(kHalfCheeseExtent);
+                    holes[s] = float4(p, dist(rng) * 0.1f + 0.02f);
+                }
+            }
+
+            float eval(const float3& p) const
+            {
+                float3 d = glm::abs(p) - float3(kHalfCheeseExtent);
+                float sd = glm::length(glm::max(d, float3(0.0f))) + std::min(std::max(std::max(d.x, d.y), d.z), 0.0f);
+
+                for (const float4& hole : holes)
+                {
+                    sd = std::max(sd, -(glm::length(p - float3(hole)) - hole.w));
+                }
+
+                return glm::clamp(sd, -glm::root_three<float>(), glm::root_three<float>());
+            }
+
+            std::vector<float> createCornerValues(uint32_t gridWidth) const
+            {
+                uint32_t gridWidthInValues = gridWidth + 1;
+                std::vector<float> cornerValues(gridWidthInValues * gridWidthInValues * gridWidthInValues);
+
+                for (uint32_t z = 0; z < gridWidthInValues; z++)
+                {
+                    for (uint32_t y = 0; y < gridWidthInValues; y++)
+                    {
+                        for (uint32_t x = 0; x < gridWidthInValues; x++)
+                        {
+                            cornerValues[x + gridWidthInValues * (y + gridWidthInValues * z)] = eval(float3(x, y, z) / float(gridWidth) - 0.5f);
+                        }
+                    }
+                }
+
+                return cornerValues;
+            }
+        };
+
+        SDFGrid::SharedPtr createGrid(SDFGrid::Type type, const std::vector<float>& cornerValues, uint32_t gridWidth, float narrowBandThickness)
+        {
+            SDFGrid::SharedPtr pSDFGrid = SDFGrid::create(type);
+            if (pSDFGrid && !pSDFGrid->setValues(cornerValues, gridWidth, narrowBandThickness)) return nullptr;
+            return pSDFGrid;
+        }
+    }
+
+    CPU_TEST(SDFSBSMatchesDenseGrid)
+    {
+        const uint32_t kGridWidth = 128;
+        const float kNarrowBandThickness = 2.0f;
+        const uint32_t kRayCount = 4096;
+
+        Cheese cheese(7);
+        std::vector<float> cornerValues = cheese.createCornerValues(kGridWidth);
+
+        SDFGrid::SharedPtr pDense = createGrid(SDFGrid::Type::NormalizedDenseGrid, cornerValues, kGridWidth, kNarrowBandThickness);
+        SDFGrid::SharedPtr pSparse = createGrid(SDFGrid::Type::SparseBrickSet, cornerValues, kGridWidth, kNarrowBandThickness);
+        EXPECT(pDense != nullptr);
+        EXPECT(pSparse != nullptr);
+        if (!pDense || !pSparse) return;
+
+        EXPECT(pSparse->getType() == SDFGrid::Type::SparseBrickSet);
+
+        // The sparse grid stores only a fraction of the bricks, and uses less memory than the dense grid.
+        const SDFSBS* pSBS = static_cast<const SDFSBS*>(pSparse.get());
+        const uint32_t brickGridWidth = pSBS->getBrickGridWidth();
+        EXPECT_EQ(brickGridWidth, (kGridWidth + SDFSBS::kBrickWidthInVoxels - 1) / SDFSBS::kBrickWidthInVoxels);
+        EXPECT_GT(pSBS->getBrickCount(), 0u);
+        EXPECT_LT(pSBS->getBrickCount(), brickGridWidth * brickGridWidth * brickGridWidth / 2);
+        EXPECT_LT(pSparse->getSize(), pDense->getSize());
+
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+
+        // Skipped bricks must evaluate to exactly the same distances as the dense grid.
+        for (uint32_t i = 0; i < kRayCount; i++)
+        {
+            float3 p = float3(dist(rng), dist(rng), dist(rng)) - 0.5f;
+            EXPECT_EQ(pSparse->evalDistance(p), pDense->evalDistance(p)) << "p = " << to_string(p);
+        }
+
+        // Sphere trace rays from outside the grid towards the cheese.
+        uint32_t hitCount = 0;
+        for (uint32_t i = 0; i < kRayCount; i++)
+        {
+            float3 origin = glm::normalize(float3(dist(rng), dist(rng), dist(rng)) - 0.5f);
+            float3 target = (float3(dist(rng), dist(rng), dist(rng)) - 0.5f) * 0.8f;
+            float3 dir = target - origin;
+
+            float tDense = 0.0f;
+            float tSparse = 0.0f;
+            bool hitDense = pDense->intersectRay(origin, dir, 0.0f, 1.0f, tDense);
+            bool hitSparse = pSparse->intersectRay(origin, dir, 0.0f, 1.0f, tSparse);
+
+            EXPECT_EQ(hitSparse, hitDense) << "origin = " << to_string(origin) << ", dir = " << to_string(dir);
+            if (!hitDense || !hitSparse) continue;
+
+            hitCount++;
+            EXPECT_LE(std::abs(tSparse - tDense), 1e-6f);
+
+            // The hit must lie on the surface, up to the quantization and interpolation error of the grid.
+            EXPECT_LE(std::abs(cheese.eval(origin + tSparse * dir)), 1.0f / kGridWidth);
+        }
+
+        // Most rays are aimed at the cheese.
+        EXPECT_GT(hitCount, kRayCount / 2);
+    }
+
+    CPU_TEST(SDFSBSEmptyGrid)
+    {
+        const uint32_t kGridWidth = 32;
+
+        // A grid where all values lie outside the narrow band has no bricks, but can still be traced.
+        uint32_t gridWidthInValues = kGridWidth + 1;
+        std::vector<float> cornerValues(gridWidthInValues * gridWidthInValues * gridWidthInValues, 1.0f);
+
+        SDFGrid::SharedPtr pSparse = createGrid(SDFGrid::Type::SparseBrickSet, cornerValues, kGridWidth, 1.0f);
+        EXPECT(pSparse != nullptr);
+        if (!pSparse) return;
+
+        const SDFSBS* pSBS = static_cast<const SDFSBS*>(pSparse.get());
+        EXPECT_EQ(pSBS->getBrickCount(), 0u);
+
+        float t = 0.0f;
+        EXPECT(!pSparse->intersectRay(float3(-1.0f, 0.0f, 0.0f), float3(1.0f, 0.0f, 0.0f), 0.0f, 2.0f, t));
+
+        // The same grid fully inside the surface reports a hit at the ray origin.
+        std::fill(cornerValues.begin(), cornerValues.end(), -1.0f);
+        pSparse = createGrid(SDFGrid::Type::SparseBrickSet, cornerValues, kGridWidth, 1.0f);
+        EXPECT_EQ(static_cast<const SDFSBS*>(pSparse.get())->getBrickCount(), 0u);
+        EXPECT(pSparse->intersectRay(float3(0.0f), float3(1.0f, 0.0f, 0.0f), 0.0f, 2.0f, t));
+    }
+}
@@ -0,0 +1,317 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "../TestUtils.h"
+#include "Scene/SceneBuilder.h"
+#include "Utils/Threading.h"
+#include <filesystem>
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Synthetic grid mesh. Holds the attribute data referenced by the mesh description.
+        */
+        struct GridMesh
+        {
+            std::vector<uint32_t> indices;
+            std::vector<float3> positions;
+            std::vector<float3> normals;
+            std::vector<float4> tangents;
+            std::vector<float2> texCrds;
+            SceneBuilder::Mesh mesh;
+            uint32_t gridVertexCount = 0;   ///< Number of unique vertices in the grid.
+        };
+
+        /** Generates a grid mesh with size x size quads.
+            \param[in] size Number of quads along each side.
+            \param[in] soup If true, each face uses its own copies of the positions (unwelded triangle soup).
+            \param[in] jitter Max offset added to the positions of the soup. Each corner of a grid vertex gets a different positive offset.
+        */
+        std::unique_ptr<GridMesh> createGridMesh(uint32_t size, bool soup, float jitter = 0.f)
+        {
+            auto pGrid = std::make_unique<GridMesh>();
+            const uint32_t rowLength = size + 1;
+            pGrid->gridVertexCount = rowLength * rowLength;
+
+            std::vector<uint32_t> gridIndices;
+            for (uint32_t y = 0; y < size; y++)
+            {
+                for (uint32_t x = 0; x < size; x++)
+                {
+                    uint32_t i = y * rowLength + x;
+                    for (uint32_t index : { i, i + 1, i + rowLength, i + 1, i + rowLength + 1, i + rowLength }) gridIndices.push_back(index);
+                }
+            }
+
+            // All attributes are face-varying but identical for all corners referencing the same grid vertex.
+            for (size_t i = 0; i < gridIndices.size(); i++)
+            {
+                const uint32_t index = gridIndices[i];
+                float2 p = float2(index % rowLength, index / rowLength) * 0.5f;
+                if (soup) pGrid->positions.push_back(float3(p + jitter * float(i % 6 + 1) / 6.f, 0.f));
+                pGrid->normals.push_back(glm::normalize(float3(std::sin(p.x), std::cos(p.y), 1.f)));
+                pGrid->tangents.push_back(float4(1.f, 0.f, 0.f, 1.f));
+                pGrid->texCrds.push_back(p / float(size));
+            }
+
+            if (soup)
+            {
+                pGrid->indices.resize(gridIndices.size());
+                for (uint32_t i = 0; i < gridIndices.size(); i++) pGrid->indices[i] = i;
+            }
+            else
+            {
+                pGrid->indices = std::move(gridIndices);
+                for (uint32_t i = 0; i < pGrid->gridVertexCount; i++) pGrid->positions.push_back(float3(float2(i % rowLength, i / rowLength) * 0.5f, 0.f));
+            }
+
+            auto& mesh = pGrid->mesh;
+            mesh.name = "Grid";
+            mesh.faceCount = size * size * 2;
+            mesh.vertexCount = (uint32_t)pGrid->positions.size();
+            mesh.indexCount = (uint32_t)pGrid->indices.size();
+            mesh.pIndices = pGrid->indices.data();
+            mesh.topology = Vao::Topology::TriangleList;
+            mesh.pMaterial = StandardMaterial::create("Grid");
+            mesh.positions = { pGrid->positions.data(), SceneBuilder::Mesh::AttributeFrequency::Vertex };
+            mesh.normals = { pGrid->normals.data(), SceneBuilder::Mesh::AttributeFrequency::FaceVarying };
+            mesh.tangents = { pGrid->tangents.data(), SceneBuilder::Mesh::AttributeFrequency::FaceVarying };
+            mesh.texCrds = { pGrid->texCrds.data(), SceneBuilder::Mesh::AttributeFrequency::FaceVarying };
+            mesh.useOriginalTangentSpace = true;
+
+            return pGrid;
+        }
+
+        /** Checks that the processed mesh reproduces the input attributes at every corner.
+        */
+        bool isSameGeometry(const SceneBuilder::Mesh& mesh, const SceneBuilder::ProcessedMesh& processed)
+        {
+            if (processed.indexData.size() != mesh.indexCount) return false;
+            for (uint32_t face = 0; face < mesh.faceCount; face++)
+            {
+                for (uint32_t vert = 0; vert < 3; vert++)
+                {
+                    const auto& s = processed.staticData[processed.indexData[face * 3 + vert]];
+                    const auto v = mesh.getVertex(face, vert);
+                    if (s.position != v.position || s.normal != v.normal || s.texCrd != v.texCrd) return false;
+                }
+            }
+            return true;
+        }
+
+        /** Reads back the contents of a GPU buffer.
+        */
+        std::vector<uint8_t> readBuffer(const Buffer::SharedPtr& pBuffer)
+        {
+            if (!pBuffer) return {};
+            const uint8_t* pData = static_cast<const uint8_t*>(pBuffer->map(Buffer::MapType::Read));
+            std::vector<uint8_t> data(pData, pData + pBuffer->getSize());
+            pBuffer->unmap();
+            return data;
+        }
+    }
+
+    GPU_TEST(SceneBuilderVertexWelding)
+    {
+        const auto flags = SceneBuilder::Flags::Force32BitIndices | SceneBuilder::Flags::UseOriginalTangentSpace;
+        auto pListBuilder = SceneBuilder::create(flags);
+        auto pHashBuilder = SceneBuilder::create(flags | SceneBuilder::Flags::HashVertexWelding);
+
+        // Indexed mesh. Both paths produce one vertex per grid vertex.
+        {
+            auto pGrid = createGridMesh(64, false);
+            auto listMesh = pListBuilder->processMesh(pGrid->mesh);
+            auto hashMesh = pHashBuilder->processMesh(pGrid->mesh);
+            EXPECT_EQ(listMesh.staticData.size(), pGrid->gridVertexCount);
+            EXPECT_EQ(hashMesh.staticData.size(), pGrid->gridVertexCount);
+            EXPECT(isSameGeometry(pGrid->mesh, listMesh));
+            EXPECT(isSameGeometry(pGrid->mesh, hashMesh));
+        }
+
+        // Triangle soup. Only the hashed path welds vertices across the original vertex indices.
+        {
+            auto pGrid = createGridMesh(64, true);
+            SceneBuilder::MeshAttributeIndices attributeIndices;
+            auto listMesh = pListBuilder->processMesh(pGrid->mesh);
+            auto hashMesh = pHashBuilder->processMesh(pGrid->mesh, &attributeIndices);
+            EXPECT_EQ(listMesh.staticData.size(), pGrid->mesh.indexCount);
+            EXPECT_EQ(hashMesh.staticData.size(), pGrid->gridVertexCount);
+            EXPECT_EQ(attributeIndices.size(), hashMesh.staticData.size());
+            EXPECT(isSameGeometry(pGrid->mesh, hashMesh));
+        }
+
+        // Jittered triangle soup. Vertices are only welded with a large enough tolerance.
+        {
+            auto pGrid = createGridMesh(64, true, 1e-4f);
+            pHashBuilder->setVertexWeldTolerance(0.f);
+            EXPECT_EQ(pHashBuilder->processMesh(pGrid->mesh).staticData.size(), pGrid->mesh.indexCount);
+            pHashBuilder->setVertexWeldTolerance(0.01f);
+            EXPECT_EQ(pHashBuilder->processMesh(pGrid->mesh).staticData.size(), pGrid->gridVertexCount);
+        }
+    }
+
+    GPU_TEST(SceneBuilderVertexWeldingBenchmark, "Benchmark, run manually")
+    {
+        const auto flags = SceneBuilder::Flags::Force32BitIndices | SceneBuilder::Flags::UseOriginalTangentSpace;
+        auto pListBuilder = SceneBuilder::create(flags);
+        auto pHashBuilder = SceneBuilder::create(flags | SceneBuilder::Flags::HashVertexWelding);
+        auto pToleranceBuilder = SceneBuilder::create(flags | SceneBuilder::Flags::HashVertexWelding);
+        pToleranceBuilder->setVertexWeldTolerance(0.01f);
+
+        struct Mode
+        {
+            const char* name;
+            SceneBuilder::SharedPtr pBuilder;
+        };
+        const Mode modes[] = { { "list", pListBuilder }, { "hash", pHashBuilder }, { "hash+tolerance", pToleranceBuilder } };
+
+        // 2M faces, 6M input vertices.
+        for (bool soup : { false, true })
+        {
+            auto pGrid = createGridMesh(1024, soup, soup ? 1e-4f : 0.f);
+
+            for (const auto& mode : modes)
+            {
+                auto startTime = CpuTimer::getCurrentTimePoint();
+                auto processed = mode.pBuilder->processMesh(pGrid->mesh);
+                double ms = CpuTimer::calcDuration(startTime, CpuTimer::getCurrentTimePoint());
+
+                double verticesPerSecond = pGrid->mesh.indexCount / (ms * 1e-3);
+                logInfo(std::string("Vertex welding (") + (soup ? "soup" : "indexed") + ", " + mode.name + "): " + std::to_string(ms) + " ms, " +
+                    std::to_string(verticesPerSecond * 1e-6) + " M vertices/s, " + std::to_string(pGrid->mesh.indexCount) + " -> " + std::to_string(processed.staticData.size()) + " vertices" +
+                    " (" + std::to_string(Threading::getThreadCount()) + " threads)");
+            }
+        }
+    }
+
+    GPU_TEST(SceneBuilderDeferredMeshes)
+    {
+        auto pBuilder = SceneBuilder::create();
+        auto pDeferredBuilder = SceneBuilder::create();
+
+        for (uint32_t i = 0; i < 32; i++)
+        {
+            // The grid goes out of scope after submission, which verifies that deferred meshes own their data.
+            auto pGrid = createGridMesh(1 + i % 8, i % 2 == 1);
+            pGrid->mesh.name = "Grid" + std::to_string(i);
+
+            uint32_t meshID = pBuilder->addMesh(pGrid->mesh);
+            uint32_t deferredMeshID = pDeferredBuilder->addMeshDeferred(pGrid->mesh);
+            EXPECT_EQ(meshID, i);
+            EXPECT_EQ(deferredMeshID, i);
+
+            SceneBuilder::Node node = { pGrid->mesh.name, glm::identity<glm::mat4>(), glm::identity<glm::mat4>() };
+            pBuilder->addMeshInstance(pBuilder->addNode(node), meshID);
+            pDeferredBuilder->addMeshInstance(pDeferredBuilder->addNode(node), deferredMeshID);
+        }
+
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            auto pTriangleMesh = i % 2 == 0 ? TriangleMesh::createSphere(0.5f, 8 + i, 4 + i) : TriangleMesh::createCube(float3(1.f + i));
+            auto pMaterial = StandardMaterial::create("TriangleMesh" + std::to_string(i));
+
+            uint32_t meshID = pBuilder->addTriangleMesh(pTriangleMesh, pMaterial);
+            uint32_t deferredMeshID = pDeferredBuilder->addTriangleMeshDeferred(pTriangleMesh, pMaterial);
+            EXPECT_EQ(meshID, 32 + i);
+            EXPECT_EQ(deferredMeshID, 32 + i);
+
+            SceneBuilder::Node node = { "TriangleMesh" + std::to_string(i), glm::identity<glm::mat4>(), glm::identity<glm::mat4>() };
+            pBuilder->addMeshInstance(pBuilder->addNode(node), meshID);
+            pDeferredBuilder->addMeshInstance(pDeferredBuilder->addNode(node), deferredMeshID);
+        }
+
+        auto pScene = pBuilder->getScene();
+        auto pDeferredScene = pDeferredBuilder->getScene();
+        EXPECT_EQ(pScene->getMeshCount(), pDeferredScene->getMeshCount());
+
+        for (uint32_t meshID = 0; meshID < std::min(pScene->getMeshCount(), pDeferredScene->getMeshCount()); meshID++)
+        {
+            const auto& mesh = pScene->getMesh(meshID);
+            const auto& deferredMesh = pDeferredScene->getMesh(meshID);
+            EXPECT_EQ(pScene->getMeshName(meshID), pDeferredScene->getMeshName(meshID));
+            EXPECT_EQ(mesh.vbOffset, deferredMesh.vbOffset) << "meshID = " << meshID;
+            EXPECT_EQ(mesh.ibOffset, deferredMesh.ibOffset) << "meshID = " << meshID;
+            EXPECT_EQ(mesh.vertexCount, deferredMesh.vertexCount) << "meshID = " << meshID;
+            EXPECT_EQ(mesh.indexCount, deferredMesh.indexCount) << "meshID = " << meshID;
+            EXPECT_EQ(mesh.flags, deferredMesh.flags) << "meshID = " << meshID;
+            EXPECT_EQ(mesh.materialID, deferredMesh.materialID) << "meshID = " << meshID;
+        }
+
+        // The global vertex and index buffers hold the processed meshes in ID order, so they are identical if all meshes were processed the same way.
+        const auto& pVao = pScene->getVao();
+        const auto& pDeferredVao = pDeferredScene->getVao();
+        EXPECT(readBuffer(pVao->getIndexBuffer()) == readBuffer(pDeferredVao->getIndexBuffer()));
+        EXPECT_EQ(pVao->getVertexBuffersCount(), pDeferredVao->getVertexBuffersCount());
+        for (uint32_t i = 0; i < std::min(pVao->getVertexBuffersCount(), pDeferredVao->getVertexBuffersCount()); i++)
+        {
+            EXPECT(readBuffer(pVao->getVertexBuffer(i)) == readBuffer(pDeferredVao->getVertexBuffer(i))) << "vertex buffer = " << i;
+        }
+    }
+
+    GPU_TEST(SceneBuilderDuplicateTextures)
+    {
+        std::string fullPath;
+        EXPECT(findFileInDataDirectories("texture4.png", fullPath));
+
+        // Create copies of the same image under different names.
+        const std::filesystem::path directory = createTempDirectory();
+        std::filesystem::create_directories(directory / "sub");
+        const std::string copyA = (directory / "a.png").string();
+        const std::string copyB = (directory / "sub" / "b.png").string();
+        std::filesystem::copy_file(fullPath, copyA);
+        std::filesystem::copy_file(fullPath, copyB);
+
+        std::vector<Material::SharedPtr> materials;
+        for (uint32_t i = 0; i < 5; i++) materials.push_back(StandardMaterial::create("Material" + std::to_string(i)));
+
+        auto pBuilder = SceneBuilder::create();
+        pBuilder->loadMaterialTexture(materials[0], Material::TextureSlot::BaseColor, fullPath);
+        pBuilder->loadMaterialTexture(materials[1], Material::TextureSlot::BaseColor, copyA);
+        pBuilder->loadMaterialTexture(materials[2], Material::TextureSlot::BaseColor, copyB);
+        pBuilder->loadMaterialTexture(materials[3], Material::TextureSlot::Specular, copyB);
+        pBuilder->loadMaterialTexture(materials[4], Material::TextureSlot::BaseColor, "texture1.png");
+        pBuilder->waitForMaterialTextureLoading();
+
+        auto pTexture = materials[0]->getTexture(Material::TextureSlot::BaseColor);
+        EXPECT(pTexture != nullptr);
+        EXPECT_EQ(pTexture->getSourceFilename(), fullPath);
+
+        // Copies share the texture of the first file, the recorded source is the first file.
+        EXPECT(materials[1]->getTexture(Material::TextureSlot::BaseColor) == pTexture);
+        EXPECT(materials[2]->getTexture(Material::TextureSlot::BaseColor) == pTexture);
+
+        // Textures loaded with different settings or with different content are not shared.
+        auto pSpecular = materials[3]->getTexture(Material::TextureSlot::Specular);
+        EXPECT(pSpecular != nullptr && pSpecular != pTexture);
+        auto pOther = materials[4]->getTexture(Material::TextureSlot::BaseColor);
+        EXPECT(pOther != nullptr && pOther != pTexture);
+
+        std::filesystem::remove_all(directory);
+    }
+}
@@ -0,0 +1,375 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "../TestUtils.h"
+#include "Scene/SceneCache.h"
+#include "Scene/Material/StandardMaterial.h"
+#include "Utils/Threading.h"
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <thread>
+
+namespace Falcor
+{
+    namespace
+    {
+        /** Generates synthetic scene data with the given number of vertices.
+        */
+        Scene::SceneData generateSceneData(uint32_t vertexCount)
+        {
+            std::mt19937 rng(1);
+            std::uniform_real_distribution<float> u(0.f, 1.f);
+
+            Scene::SceneData sceneData;
+            sceneData.filename = "SceneCacheTest";
+            sceneData.meshDrawCount = 1;
+            sceneData.has32BitIndices = true;
+
+            sceneData.meshStaticData.resize(vertexCount);
+            for (auto& v : sceneData.meshStaticData)
+            {
+                v.position = float3(u(rng), u(rng), u(rng));
+                v.packedNormalTangent = float3(u(rng), u(rng), u(rng));
+                v.texCrd = float2(u(rng), u(rng));
+            }
+
+            sceneData.meshIndexData.resize(vertexCount * 2);
+            for (size_t i = 0; i < sceneData.meshIndexData.size(); i++) sceneData.meshIndexData[i] = (uint32_t)((i * 7919) % vertexCount);
+
+            sceneData.meshDynamicData.resize(vertexCount / 16);
+            for (size_t i = 0; i < sceneData.meshDynamicData.size(); i++) sceneData.meshDynamicData[i].staticIndex = (uint32_t)(i * 16);
+
+            MeshDesc meshDesc = {};
+            meshDesc.vertexCount = vertexCount;
+            meshDesc.indexCount = (uint32_t)sceneData.meshIndexData.size();
+            sceneData.meshDesc.push_back(meshDesc);
+            sceneData.meshNames.push_back("Mesh");
+            sceneData.meshBBs.push_back(AABB(float3(0.f), float3(1.f)));
+            sceneData.meshInstanceData.push_back({});
+            sceneData.meshIdToInstanceIds.push_back({ 0 });
+            sceneData.meshGroups.push_back({ { 0 }, true, false });
+
+            return sceneData;
+        }
+
+        SceneCache::Key getKey(const std::string& name)
+        {
+            std::string keyName = "SceneCacheTests" + name;
+            return SHA1::compute(keyName.data(), keyName.size());
+        }
+
+        SceneCache::Key getKey(SceneCache::Format format)
+        {
+            return getKey(std::to_string((uint32_t)format));
+        }
+
+        std::vector<uint8_t> readFile(const std::filesystem::path& path)
+        {
+            std::ifstream fs(path, std::ios_base::binary);
+            return std::vector<uint8_t>(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+        }
+
+        void writeFile(const std::filesystem::path& path, const std::string& content)
+        {
+            std::ofstream fs(path, std::ios_base::binary);
+            fs.write(content.data(), content.size());
+        }
+
+        /** Moves the last write time of a file forward, so the change is detected regardless of the file system's timestamp resolution.
+        */
+        void touchFile(const std::filesystem::path& path)
+        {
+            std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::seconds(10));
+        }
+
+        /** Writes a small constant color RGBA8 image.
+        */
+        void writeTexture(const std::filesystem::path& path, uint32_t color)
+        {
+            std::vector<uint32_t> texels(4 * 4, color);
+            Bitmap::saveImage(path.string(), 4, 4, Bitmap::FileFormat::PngFile, Bitmap::ExportFlags::None, ResourceFormat::RGBA8Unorm, true, texels.data());
+            touchFile(path);
+        }
+
+        /** Writes a 4x4 RGBA8 image including its alpha channel.
+        */
+        void writeTexture(const std::filesystem::path& path, std::vector<uint32_t> texels)
+        {
+            assert(texels.size() == 4 * 4);
+            Bitmap::saveImage(path.string(), 4, 4, Bitmap::FileFormat::PngFile, Bitmap::ExportFlags::ExportAlpha, ResourceFormat::RGBA8Unorm, true, texels.data());
+            touchFile(path);
+        }
+
+        template<typename T>
+        bool isEqual(const ArrayView<T>& a, const std::vector<T>& b)
+        {
+            return a.size() == b.size() && std::memcmp(a.data(), b.data(), b.size() * sizeof(T)) == 0;
+        }
+
+        /** Returns views of the mesh data, similar to how the scene consumes it.
+        */
+        void getMeshData(const Scene::SceneData& sceneData, ArrayView<uint32_t>& indexData, ArrayView<PackedStaticVertexData>& staticData, ArrayView<DynamicVertexData>& dynamicData)
+        {
+            const bool isMapped = sceneData.pMappedMeshData != nullptr;
+            indexData = isMapped ? sceneData.mappedMeshIndexData : sceneData.meshIndexData;
+            staticData = isMapped ? sceneData.mappedMeshStaticData : sceneData.meshStaticData;
+            dynamicData = isMapped ? sceneData.mappedMeshDynamicData : sceneData.meshDynamicData;
+        }
+
+        /** Samples the working set of the process on a background thread and records the largest value seen while it is alive.
+            Unlike the process peak working set, this only reflects the phase being measured.
+        */
+        class WorkingSetMonitor
+        {
+        public:
+            WorkingSetMonitor()
+                : mPeak(getProcessWorkingSetSize())
+                , mThread([this]()
+                {
+                    while (!mStop)
+                    {
+                        uint64_t workingSet = getProcessWorkingSetSize();
+                        uint64_t peak = mPeak;
+                        while (workingSet > peak && !mPeak.compare_exchange_weak(peak, workingSet)) {}
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    }
+                })
+            {}
+
+            /** Stops sampling and returns the largest working set seen.
+            */
+            uint64_t stop()
+            {
+                if (mThread.joinable())
+                {
+                    mStop = true;
+                    mThread.join();
+                }
+                return mPeak;
+            }
+
+            ~WorkingSetMonitor() { stop(); }
+
+        private:
+            std::atomic<bool> mStop{ false };
+            std::atomic<uint64_t> mPeak;
+            std::thread mThread;
+        };
+    }
+
+    GPU_TEST(SceneCacheFormats)
+    {
+        const auto sceneData = generateSceneData(100000);
+
+        for (auto format : { SceneCache::Format::Compressed, SceneCache::Format::Mapped })
+        {
+            auto key = getKey(format);
+            SceneCache::writeCache(sceneData, key, {}, false, format);
+            EXPECT(SceneCache::hasValidCache(key));
+
+            {
+                auto loaded = SceneCache::readCache(key);
+                EXPECT_EQ(loaded.pMappedMeshData != nullptr, format == SceneCache::Format::Mapped);
+
+                ArrayView<uint32_t> indexData;
+                ArrayView<PackedStaticVertexData> staticData;
+                ArrayView<DynamicVertexData> dynamicData;
+                getMeshData(loaded, indexData, staticData, dynamicData);
+                EXPECT(isEqual(indexData, sceneData.meshIndexData)) << "format = " << (uint32_t)format;
+                EXPECT(isEqual(staticData, sceneData.meshStaticData)) << "format = " << (uint32_t)format;
+                EXPECT(isEqual(dynamicData, sceneData.meshDynamicData)) << "format = " << (uint32_t)format;
+
+                EXPECT_EQ(loaded.filename, sceneData.filename);
+                EXPECT_EQ(loaded.meshDrawCount, sceneData.meshDrawCount);
+                EXPECT_EQ(loaded.meshDesc.size(), sceneData.meshDesc.size());
+                EXPECT_EQ(loaded.meshGroups.size(), sceneData.meshGroups.size());
+            }
+
+            SceneCache::deleteCache(key);
+            EXPECT(!SceneCache::hasValidCache(key));
+        }
+    }
+
+    GPU_TEST(SceneCacheDependencies)
+    {
+        const auto directory = createTempDirectory();
+        const auto scenePath = directory / "Scene.txt";
+        const auto texturePath = directory / "Texture.png";
+        writeFile(scenePath, "Scene");
+        writeTexture(texturePath, 0xff0000ff);
+
+        auto sceneData = generateSceneData(1000);
+        auto pMaterial = StandardMaterial::create("Material");
+        pMaterial->setBaseColorTexture(Texture::createFromFile(texturePath.string(), false, true));
+        EXPECT_NE(pMaterial->getBaseColorTexture(), nullptr);
+        sceneData.materials.push_back(pMaterial);
+
+        const auto key = getKey("Dependencies");
+        const std::vector<std::string> dependencies = { scenePath.string() };
+
+        // A change to a dependency that is not reloaded invalidates the cache.
+        SceneCache::writeCache(sceneData, key, dependencies);
+        EXPECT(SceneCache::hasValidCache(key));
+        writeFile(scenePath, "Changed scene");
+        touchFile(scenePath);
+        EXPECT(!SceneCache::hasValidCache(key));
+
+        // A change to a texture that is reloaded keeps the cache valid.
+        SceneCache::writeCache(sceneData, key, dependencies);
+        writeTexture(texturePath, 0xff00ff00);
+        EXPECT(SceneCache::hasValidCache(key));
+
+        // Reading the cache reloads the changed texture and updates its recorded file stamp in place.
+        const auto cacheFileBefore = readFile(SceneCache::getCachePath(key));
+        {
+            auto loaded = SceneCache::readCache(key);
+            EXPECT_EQ(loaded.materials.size(), 1);
+            auto pTexture = loaded.materials.empty() ? nullptr : loaded.materials[0]->getTexture(Material::TextureSlot::BaseColor);
+            EXPECT_NE(pTexture, nullptr);
+            if (pTexture)
+            {
+                auto texels = ctx.getRenderContext()->readTextureSubresource(pTexture.get(), 0);
+                EXPECT_GE(texels.size(), sizeof(uint32_t));
+                if (texels.size() >= sizeof(uint32_t)) EXPECT_EQ(*reinterpret_cast<const uint32_t*>(texels.data()), 0xff00ff00);
+            }
+        }
+        const auto cacheFileAfter = readFile(SceneCache::getCachePath(key));
+        EXPECT_EQ(cacheFileAfter.size(), cacheFileBefore.size());
+        EXPECT(cacheFileAfter != cacheFileBefore);
+        EXPECT(SceneCache::hasValidCache(key));
+
+        // A second read finds the updated stamps and leaves the cache file untouched.
+        SceneCache::readCache(key);
+        EXPECT(readFile(SceneCache::getCachePath(key)) == cacheFileAfter);
+
+        // Touching a dependency without changing its content invalidates the cache, unless content hashes are stored.
+        SceneCache::writeCache(sceneData, key, dependencies);
+        writeFile(scenePath, "Changed scene");
+        touchFile(scenePath);
+        EXPECT(!SceneCache::hasValidCache(key));
+
+        SceneCache::writeCache(sceneData, key, dependencies, true);
+        writeFile(scenePath, "Changed scene");
+        touchFile(scenePath);
+        EXPECT(SceneCache::hasValidCache(key));
+
+        SceneCache::deleteCache(key);
+        std::filesystem::remove_all(directory);
+    }
+
+    GPU_TEST(SceneCacheTextureAnalysis)
+    {
+        const auto directory = createTempDirectory();
+        const auto texturePath = directory / "Texture.png";
+
+        // Texture with varying color and opaque alpha.
+        std::vector<uint32_t> texels(4 * 4);
+        for (uint32_t i = 0; i < texels.size(); i++) texels[i] = 0xff000000 | (i * 0x10);
+        writeTexture(texturePath, texels);
+
+        auto sceneData = generateSceneData(1000);
+        auto pMaterial = StandardMaterial::create("Material");
+        pMaterial->setBaseColorTexture(Texture::createFromFile(texturePath.string(), false, true));
+        EXPECT_NE(pMaterial->getBaseColorTexture(), nullptr);
+        if (!pMaterial->getBaseColorTexture()) return;
+        sceneData.materials.push_back(pMaterial);
+
+        // The analysis result stored in the cache finds the alpha channel to be constant.
+        TextureAnalyzer::Result analysis = {};
+        analysis.mask = (uint32_t)TextureChannelFlags::RGB;
+        analysis.value = float4(0.f, 0.f, 0.f, 1.f);
+        analysis.minValue = float4(0.f, 0.f, 0.f, 1.f);
+        analysis.maxValue = float4(1.f);
+        sceneData.materialTextureAnalysis[Material::getTextureAnalysisKey(*pMaterial->getBaseColorTexture())] = analysis;
+
+        const auto key = getKey("TextureAnalysis");
+        auto isOpaque = [&]()
+        {
+            auto loaded = SceneCache::readCache(key);
+            EXPECT_EQ(loaded.materials.size(), 1);
+            return !loaded.materials.empty() && loaded.materials[0]->isOpaque();
+        };
+
+        // The stored analysis is applied to the unchanged texture, which disables the alpha test.
+        SceneCache::writeCache(sceneData, key, {});
+        EXPECT(isOpaque());
+
+        // After the texture gets a varying alpha channel, the stored analysis no longer applies.
+        // This also holds for later reads, after the recorded file stamp of the texture has been updated.
+        for (uint32_t i = 0; i < texels.size(); i += 2) texels[i] &= 0x00ffffff;
+        writeTexture(texturePath, texels);
+        EXPECT(!isOpaque());
+        EXPECT(!isOpaque());
+
+        SceneCache::deleteCache(key);
+        std::filesystem::remove_all(directory);
+    }
+
+    GPU_TEST(SceneCacheBenchmark, "Benchmark, run manually")
+    {
+        // About 400 MB of mesh data.
+        const auto sceneData = generateSceneData(8 << 20);
+
+        for (auto format : { SceneCache::Format::Compressed, SceneCache::Format::Mapped })
+        {
+            auto key = getKey(format);
+            auto writeStartTime = CpuTimer::getCurrentTimePoint();
+            SceneCache::writeCache(sceneData, key, {}, false, format);
+            double writeTime = CpuTimer::calcDuration(writeStartTime, CpuTimer::getCurrentTimePoint());
+
+            const uint64_t workingSetBefore = getProcessWorkingSetSize();
+            WorkingSetMonitor monitor;
+            auto startTime = CpuTimer::getCurrentTimePoint();
+
+            uint64_t checksum = 0;
+            {
+                auto loaded = SceneCache::readCache(key);
+
+                // Touch all mesh data once, like the upload to the GPU does.
+                ArrayView<uint32_t> indexData;
+                ArrayView<PackedStaticVertexData> staticData;
+                ArrayView<DynamicVertexData> dynamicData;
+                getMeshData(loaded, indexData, staticData, dynamicData);
+                for (uint32_t index : indexData) checksum += index;
+                for (const auto& v : staticData) checksum += (uint64_t)v.texCrd.x;
+                for (const auto& v : dynamicData) checksum += v.staticIndex;
+            }
+
+            double loadTime = CpuTimer::calcDuration(startTime, CpuTimer::getCurrentTimePoint());
+            const uint64_t peakDuringLoad = monitor.stop();
+            const uint64_t workingSetAfter = getProcessWorkingSetSize();
+            EXPECT_NE(checksum, 0ull);
+
+            logInfo(std::string("SceneCache ") + (format == SceneCache::Format::Mapped ? "mapped" : "compressed") + " format (" + std::to_string(Threading::getThreadCount()) + " threads): write " + std::to_string(writeTime) + " ms, load " + std::to_string(loadTime) + " ms, " +
+                "peak RSS during load +" + std::to_string(((int64_t)peakDuringLoad - (int64_t)workingSetBefore) / (1 << 20)) + " MB, RSS after load " + std::to_string(((int64_t)workingSetAfter - (int64_t)workingSetBefore) / (1 << 20)) + " MB");
+
+            SceneCache::deleteCache(key);
+        }
+    }
+}
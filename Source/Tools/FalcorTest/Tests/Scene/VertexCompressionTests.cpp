@@ -0,0 +1,125 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Scene/VertexCompression.h"
+#include <random>
+
+namespace Falcor
+{
+    namespace
+    {
+        std::vector<StaticVertexData> generateVertices(size_t count, const AABB& bounds)
+        {
+            std::mt19937 rng(1);
+            std::uniform_real_distribution<float> u(0.f, 1.f);
+            auto randomDirection = [&]()
+            {
+                float z = 1.f - 2.f * u(rng);
+                float r = std::sqrt(std::max(0.f, 1.f - z * z));
+                float phi = 2.f * (float)M_PI * u(rng);
+                return float3(r * std::cos(phi), r * std::sin(phi), z);
+            };
+
+            std::vector<StaticVertexData> vertices(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                auto& v = vertices[i];
+                v.position = bounds.minPoint + float3(u(rng), u(rng), u(rng)) * bounds.extent();
+                v.normal = randomDirection();
+                // Every third vertex has an invalid (zero) tangent.
+                v.tangent = i % 3 == 2 ? float4(0.f) : float4(randomDirection(), i % 3 == 0 ? -1.f : 1.f);
+                v.texCrd = float2(u(rng), u(rng)) * 4.f - 2.f;
+            }
+            return vertices;
+        }
+
+        float angleBetween(const float3& a, const float3& b)
+        {
+            return 2.f * std::asin(std::min(1.f, glm::length(a - b) * 0.5f));
+        }
+    }
+
+    CPU_TEST(VertexCompressionRoundTrip)
+    {
+        const AABB bounds(float3(-100.f, 5.f, -3.f), float3(250.f, 7.f, 1000.f));
+        const auto vertices = generateVertices(100000, bounds);
+
+        for (auto format : { VertexCompression::PositionFormat::Unorm16, VertexCompression::PositionFormat::Float16 })
+        {
+            const auto params = VertexCompression::computeParams(bounds, format);
+
+            // Position error bound per axis.
+            const float3 unormBound = bounds.extent() / (2.f * 65535.f) * 1.001f;
+
+            for (const auto& v : vertices)
+            {
+                const auto d = VertexCompression::decompress(VertexCompression::compress(v, params), params);
+
+                const float3 positionError = glm::abs(d.position - v.position);
+                const float3 float16Bound = glm::abs(v.position - bounds.center()) * std::ldexp(1.f, -11) + 1e-4f;
+                const float3 bound = format == VertexCompression::PositionFormat::Unorm16 ? unormBound : float16Bound;
+                EXPECT(glm::all(glm::lessThanEqual(positionError, bound))) << "format = " << (uint32_t)format << ", error = " << to_string(positionError);
+
+                EXPECT_LE(angleBetween(d.normal, v.normal), VertexCompression::kMaxDirectionError);
+                if (v.tangent.w != 0.f) EXPECT_LE(angleBetween(float3(d.tangent), float3(v.tangent)), VertexCompression::kMaxDirectionError);
+                else EXPECT(d.tangent == float4(0.f));
+                EXPECT_EQ(d.tangent.w, v.tangent.w);
+
+                const float2 texCrdError = glm::abs(d.texCrd - v.texCrd);
+                EXPECT(glm::all(glm::lessThanEqual(texCrdError, glm::abs(v.texCrd) * std::ldexp(1.f, -11)))) << "error = " << to_string(texCrdError);
+            }
+        }
+    }
+
+    CPU_TEST(VertexCompressionStats)
+    {
+        const AABB bounds(float3(0.f), float3(1.f, 2.f, 0.f));
+        const auto vertices = generateVertices(1000, bounds);
+        std::vector<PackedStaticVertexData> packed(vertices.begin(), vertices.end());
+        std::vector<CompressedStaticVertexData> compressed(packed.size());
+
+        // Flat meshes have a zero extent along one axis. Invalid tangents don't contribute to the tangent error.
+        const auto params = VertexCompression::computeParams(bounds);
+        VertexCompression::Stats stats;
+        VertexCompression::compress(packed.data(), packed.size(), params, compressed.data(), stats);
+
+        EXPECT_EQ(stats.vertexCount, packed.size());
+        EXPECT_EQ(stats.getCompressedSize(), packed.size() * 20);
+        EXPECT_EQ(stats.getUncompressedSize(), packed.size() * 32);
+        EXPECT_LE(stats.maxPositionError, glm::length(bounds.extent()) / 65535.f);
+        EXPECT_LE(stats.maxNormalError, VertexCompression::kMaxDirectionError);
+        EXPECT_LE(stats.maxTangentError, VertexCompression::kMaxDirectionError);
+        EXPECT_LE(stats.maxTexCrdError, 2.f * std::ldexp(1.f, -11));
+
+        for (size_t i = 0; i < packed.size(); i++)
+        {
+            const auto d = VertexCompression::decompress(compressed[i], params);
+            EXPECT_EQ(d.position.z, 0.f);
+        }
+    }
+}
@@ -0,0 +1,125 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Utils/AsyncTextureLoader.h"
+
+namespace Falcor
+{
+    GPU_TEST(AsyncTextureLoader)
+    {
+        const uint32_t kRequestCount = 8;
+
+        std::vector<std::future<Texture::SharedPtr>> futures;
+        AsyncTextureLoader::Stats stats;
+        {
+            // Use a queue size of one to exercise the back-pressure.
+            AsyncTextureLoader loader(2, 1);
+            for (uint32_t i = 0; i < kRequestCount; i++)
+            {
+                auto priority = AsyncTextureLoader::Priority(i % (uint32_t)AsyncTextureLoader::Priority::Count);
+                futures.push_back(loader.loadFromFile("texture4.png", true, false, Resource::BindFlags::ShaderResource, nullptr, priority));
+            }
+
+            for (auto& future : futures)
+            {
+                auto pTexture = future.get();
+                EXPECT(pTexture != nullptr);
+            }
+
+            stats = loader.getStats();
+        }
+
+        EXPECT_EQ(stats.requestCount, kRequestCount);
+        EXPECT_EQ(stats.loadedCount, kRequestCount);
+        EXPECT_EQ(stats.failedCount, 0ull);
+        EXPECT_EQ(stats.cancelledCount, 0ull);
+        EXPECT_EQ(stats.queueDepth, 0ull);
+        EXPECT_LE(stats.maxQueueDepth, 1ull);
+        EXPECT_GT(stats.uploadedBytes, 0ull);
+        EXPECT_GT(stats.busyTime, 0.0);
+    }
+
+    GPU_TEST(AsyncTextureLoaderCancel)
+    {
+        AsyncTextureLoader loader(1);
+
+        // Requests with a cancelled token are not loaded.
+        AsyncTextureLoader::CancellationToken token;
+        auto copy = token;
+        copy.cancel();
+        EXPECT(token.isCancelled());
+
+        auto future = loader.loadFromFile("texture4.png", true, false, Resource::BindFlags::ShaderResource, nullptr, AsyncTextureLoader::Priority::High, token);
+        EXPECT(future.get() == nullptr);
+
+        // Requests with another token are unaffected.
+        auto other = loader.loadFromFile("texture4.png", true, false);
+        EXPECT(other.get() != nullptr);
+
+        auto stats = loader.getStats();
+        EXPECT_EQ(stats.requestCount, 2ull);
+        EXPECT_EQ(stats.cancelledCount, 1ull);
+        EXPECT_EQ(stats.loadedCount, 1ull);
+    }
+
+    GPU_TEST(AsyncTextureLoaderAnalyze)
+    {
+        AsyncTextureLoader loader(2);
+        using AnalysisMode = AsyncTextureLoader::AnalysisMode;
+
+        // Constant textures are collapsed to a single texel.
+        auto constant = loader.loadAndAnalyzeFromFile("texture1.png", true, false, AnalysisMode::CollapseConstant).get();
+        EXPECT(constant.pTexture != nullptr);
+        EXPECT(constant.analysis.has_value());
+        if (constant.pTexture && constant.analysis)
+        {
+            EXPECT(constant.analysis->isConstant(TextureChannelFlags::RGBA));
+            EXPECT_EQ(constant.pTexture->getWidth(), 1u);
+            EXPECT_EQ(constant.pTexture->getHeight(), 1u);
+        }
+
+        // Without collapsing, the texture keeps its size.
+        auto analyzed = loader.loadAndAnalyzeFromFile("texture1.png", true, false, AnalysisMode::Analyze).get();
+        EXPECT(analyzed.pTexture != nullptr && analyzed.analysis.has_value());
+        if (analyzed.pTexture) EXPECT_GT(analyzed.pTexture->getWidth(), 1u);
+
+        // Varying textures are not collapsed.
+        auto varying = loader.loadAndAnalyzeFromFile("texture4.png", true, false, AnalysisMode::CollapseConstant).get();
+        EXPECT(varying.pTexture != nullptr && varying.analysis.has_value());
+        if (varying.pTexture && varying.analysis)
+        {
+            EXPECT(!varying.analysis->isConstant(TextureChannelFlags::RGB));
+            EXPECT_GT(varying.pTexture->getWidth(), 1u);
+        }
+
+        // No analysis is returned when it is not requested.
+        auto plain = loader.loadAndAnalyzeFromFile("texture4.png", true, false, AnalysisMode::None).get();
+        EXPECT(plain.pTexture != nullptr);
+        EXPECT(!plain.analysis.has_value());
+    }
+}
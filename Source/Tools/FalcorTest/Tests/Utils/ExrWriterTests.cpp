@@ -0,0 +1,319 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Utils/Image/Bitmap.h"
+#include "Utils/Image/ExrWriter.h"
+#include <filesystem>
+#include <fstream>
+
+namespace Falcor
+{
+    namespace
+    {
+        const uint32_t kWidth = 67;
+        const uint32_t kHeight = 35; // Not a multiple of the 16 scanlines per ZIP chunk.
+
+        std::vector<float> createImage()
+        {
+            std::vector<float> data(kWidth * kHeight * 4);
+            for (uint32_t y = 0; y < kHeight; y++)
+            {
+                for (uint32_t x = 0; x < kWidth; x++)
+                {
+                    float* pPixel = &data[(y * kWidth + x) * 4];
+                    pPixel[0] = x / float(kWidth);
+                    pPixel[1] = y * 0.25f;
+                    pPixel[2] = (x / 4) % 2 ? 1.f : 0.f; // Long runs of equal values for RLE.
+                    pPixel[3] = 0.5f;
+                }
+            }
+            return data;
+        }
+
+        void testRoundTrip(CPUUnitTestContext& ctx, const std::string& filename, const std::vector<float>& reference, float tolerance)
+        {
+            auto pBitmap = Bitmap::createFromFile(filename, true);
+            EXPECT(pBitmap != nullptr);
+            if (!pBitmap) return;
+            EXPECT_EQ(pBitmap->getWidth(), kWidth);
+            EXPECT_EQ(pBitmap->getHeight(), kHeight);
+            EXPECT_EQ(pBitmap->getFormat(), ResourceFormat::RGBA32Float);
+            if (pBitmap->getFormat() != ResourceFormat::RGBA32Float) return;
+
+            const float* pData = reinterpret_cast<const float*>(pBitmap->getData());
+            for (size_t i = 0; i < reference.size(); i++)
+            {
+                EXPECT_LE(std::abs(pData[i] - reference[i]), tolerance) << "i = " << i;
+            }
+        }
+
+        /** Read a 32-bit float channel from an uncompressed single-part scanline EXR file.
+            Bitmap only reads the default layer, so the channels of other layers are read directly from the file.
+            \return Channel values in top-down order, or an empty vector if the file or channel can't be read.
+        */
+        std::vector<float> readExrChannel(const std::string& filename, const std::string& channelName)
+        {
+            std::ifstream file(filename, std::ios::binary);
+            auto readString = [&]()
+            {
+                std::string str;
+                std::getline(file, str, '\0');
+                return str;
+            };
+            auto read = [&](auto& value) { file.read(reinterpret_cast<char*>(&value), sizeof(value)); };
+
+            int32_t magic = 0, version = 0;
+            read(magic);
+            read(version);
+            if (magic != 20000630 || (version & 0xff) != 2) return {};
+
+            // Parse the header for the channel list, compression and data window.
+            std::vector<std::pair<std::string, int32_t>> channels;
+            uint8_t compression = 0xff;
+            int32_t window[4] = {};
+            while (file.good())
+            {
+                const std::string name = readString();
+                if (name.empty()) break;
+                const std::string type = readString();
+                int32_t size = 0;
+                read(size);
+                std::vector<char> value(size);
+                file.read(value.data(), size);
+
+                if (name == "channels")
+                {
+                    for (const char* pEntry = value.data(); *pEntry != 0;)
+                    {
+                        std::string channel(pEntry);
+                        pEntry += channel.size() + 1;
+                        int32_t pixelType;
+                        std::memcpy(&pixelType, pEntry, sizeof(pixelType));
+                        channels.emplace_back(channel, pixelType);
+                        pEntry += 16;
+                    }
+                }
+                else if (name == "compression") compression = uint8_t(value[0]);
+                else if (name == "dataWindow") std::memcpy(window, value.data(), sizeof(window));
+            }
+            if (!file.good() || compression != uint8_t(ExrWriter::Compression::None)) return {};
+
+            const uint32_t width = uint32_t(window[2] - window[0] + 1);
+            const uint32_t height = uint32_t(window[3] - window[1] + 1);
+            size_t channelOffset = 0;
+            bool found = false;
+            for (const auto& [name, pixelType] : channels)
+            {
+                if (name == channelName)
+                {
+                    found = pixelType == 2;
+                    break;
+                }
+                channelOffset += width * (pixelType == 1 ? 2 : 4);
+            }
+            if (!found) return {};
+
+            // Uncompressed files store one scanline per chunk. Skip the offset table.
+            file.seekg(height * sizeof(uint64_t), std::ios::cur);
+            std::vector<float> values(width * height);
+            for (uint32_t i = 0; i < height; i++)
+            {
+                int32_t y = 0, size = 0;
+                read(y);
+                read(size);
+                std::vector<char> data(size);
+                file.read(data.data(), size);
+                if (!file.good() || y < window[1] || y > window[3] || channelOffset + width * sizeof(float) > data.size()) return {};
+                std::memcpy(&values[(y - window[1]) * width], data.data() + channelOffset, width * sizeof(float));
+            }
+            return values;
+        }
+
+        /** Check the RGB channels of an 8-bit BGRA test image with the given channel name prefix.
+            The image stores x in blue and y in green, with the rows in bottom-up order.
+        */
+        void testBgraChannels(CPUUnitTestContext& ctx, const std::string& filename, const std::string& prefix)
+        {
+            const auto r = readExrChannel(filename, prefix + "R");
+            const auto g = readExrChannel(filename, prefix + "G");
+            const auto b = readExrChannel(filename, prefix + "B");
+            EXPECT_EQ(r.size(), size_t(kWidth * kHeight));
+            EXPECT_EQ(g.size(), size_t(kWidth * kHeight));
+            EXPECT_EQ(b.size(), size_t(kWidth * kHeight));
+            if (r.size() != kWidth * kHeight || g.size() != kWidth * kHeight || b.size() != kWidth * kHeight) return;
+
+            for (uint32_t y = 0; y < kHeight; y++)
+            {
+                for (uint32_t x = 0; x < kWidth; x++)
+                {
+                    const uint32_t i = y * kWidth + x;
+                    EXPECT_EQ(r[i], 1.f) << "x = " << x << ", y = " << y;
+                    EXPECT_EQ(g[i], (kHeight - 1 - y) / 255.f) << "x = " << x << ", y = " << y;
+                    EXPECT_EQ(b[i], x / 255.f) << "x = " << x << ", y = " << y;
+                }
+            }
+        }
+    }
+
+    CPU_TEST(ExrWriterCompression)
+    {
+        const auto image = createImage();
+        const std::string filename = getTempFilename() + ".exr";
+
+        for (auto compression : { Bitmap::ExrCompression::None, Bitmap::ExrCompression::RLE, Bitmap::ExrCompression::ZIPS, Bitmap::ExrCompression::ZIP })
+        {
+            Bitmap::SaveOptions options;
+            options.exrCompression = compression;
+
+            // 32-bit float images are stored losslessly.
+            Bitmap::saveImage(filename, kWidth, kHeight, Bitmap::FileFormat::ExrFile, Bitmap::ExportFlags::ExportAlpha | Bitmap::ExportFlags::Uncompressed, ResourceFormat::RGBA32Float, true, image.data(), options);
+            testRoundTrip(ctx, filename, image, 0.f);
+
+            // 16-bit float images are stored with half precision.
+            Bitmap::saveImage(filename, kWidth, kHeight, Bitmap::FileFormat::ExrFile, Bitmap::ExportFlags::ExportAlpha, ResourceFormat::RGBA32Float, true, image.data(), options);
+            testRoundTrip(ctx, filename, image, 1e-2f);
+        }
+
+        std::filesystem::remove(filename);
+    }
+
+    CPU_TEST(ExrWriterLayers)
+    {
+        const auto image = createImage();
+        const std::string filename = getTempFilename() + ".exr";
+
+        // Bottom-up 8-bit layer in BGRA order with padded rows.
+        const uint32_t rowPitch = (kWidth + 5) * 4;
+        std::vector<uint8_t> albedo(rowPitch * kHeight);
+        for (uint32_t y = 0; y < kHeight; y++)
+        {
+            for (uint32_t x = 0; x < kWidth; x++)
+            {
+                uint8_t* pPixel = &albedo[y * rowPitch + x * 4];
+                pPixel[0] = uint8_t(x);
+                pPixel[1] = uint8_t(y);
+                pPixel[2] = 255;
+                pPixel[3] = 255;
+            }
+        }
+
+        std::vector<ExrWriter::Layer> layers(2);
+        layers[0].format = ResourceFormat::RGBA32Float;
+        layers[0].pData = image.data();
+        layers[1].name = "albedo";
+        layers[1].format = ResourceFormat::BGRA8Unorm;
+        layers[1].pData = albedo.data();
+        layers[1].rowPitch = rowPitch;
+        layers[1].channelCount = 3;
+        layers[1].isTopDown = false;
+        ExrWriter::write(filename, kWidth, kHeight, layers, ExrWriter::Compression::ZIP, ExrWriter::PixelType::Float);
+
+        // The default layer is unaffected by the additional layer.
+        testRoundTrip(ctx, filename, image, 0.f);
+
+        // The albedo layer is stored in RGB order and flipped to top-down.
+        ExrWriter::write(filename, kWidth, kHeight, layers, ExrWriter::Compression::None, ExrWriter::PixelType::Float);
+        testRoundTrip(ctx, filename, image, 0.f);
+        testBgraChannels(ctx, filename, "albedo.");
+
+        // Bitmap passes bottom-up BGRA images to ExrWriter as the default layer.
+        std::vector<uint8_t> packedAlbedo(kWidth * kHeight * 4);
+        for (uint32_t y = 0; y < kHeight; y++) std::memcpy(&packedAlbedo[y * kWidth * 4], &albedo[y * rowPitch], kWidth * 4);
+        Bitmap::saveImage(filename, kWidth, kHeight, Bitmap::FileFormat::ExrFile, Bitmap::ExportFlags::Uncompressed, ResourceFormat::BGRA8Unorm, false, packedAlbedo.data());
+        testBgraChannels(ctx, filename, "");
+
+        // Channel names must be unique.
+        layers[1].name.clear();
+        bool threw = false;
+        try
+        {
+            ExrWriter::write(filename, kWidth, kHeight, layers, ExrWriter::Compression::ZIP);
+        }
+        catch (const std::exception&)
+        {
+            threw = true;
+        }
+        EXPECT(threw);
+
+        std::filesystem::remove(filename);
+    }
+
+    CPU_TEST(ExrWriterMultiPart)
+    {
+        const auto image = createImage();
+        const std::string filename = getTempFilename() + ".exr";
+
+        // Integer part at a different resolution than the color part.
+        const uint32_t idWidth = kWidth / 2, idHeight = kHeight / 2;
+        std::vector<uint32_t> ids(idWidth * idHeight);
+        for (size_t i = 0; i < ids.size(); i++) ids[i] = 0x10000u + uint32_t(i);
+        EXPECT(ExrWriter::isFormatSupported(ResourceFormat::R32Uint));
+
+        std::vector<ExrWriter::Part> parts(2);
+        parts[0].name = "color";
+        parts[0].width = kWidth;
+        parts[0].height = kHeight;
+        parts[0].layers.resize(1);
+        parts[0].layers[0].format = ResourceFormat::RGBA32Float;
+        parts[0].layers[0].pData = image.data();
+        parts[1].name = "instanceID";
+        parts[1].width = idWidth;
+        parts[1].height = idHeight;
+        parts[1].layers.resize(1);
+        parts[1].layers[0].format = ResourceFormat::R32Uint;
+        parts[1].layers[0].pData = ids.data();
+        parts[1].layers[0].storeIntegers = true;
+        ExrWriter::writeMultiPart(filename, parts, ExrWriter::Compression::ZIP);
+
+        // Check the magic number and the multi-part flag of the version field.
+        {
+            std::ifstream file(filename, std::ios::binary);
+            int32_t header[2] = {};
+            file.read(reinterpret_cast<char*>(header), sizeof(header));
+            EXPECT(file.good());
+            EXPECT_EQ(header[0], 20000630);
+            EXPECT_EQ(header[1] & 0xff, 2);
+            EXPECT_NE(header[1] & 0x1000, 0);
+        }
+
+        // Part names must be unique.
+        parts[1].name = parts[0].name;
+        bool threw = false;
+        try
+        {
+            ExrWriter::writeMultiPart(filename, parts, ExrWriter::Compression::ZIP);
+        }
+        catch (const std::exception&)
+        {
+            threw = true;
+        }
+        EXPECT(threw);
+
+        std::filesystem::remove(filename);
+    }
+}
@@ -103,6 +103,37 @@ namespace Falcor
                 float4(0.f, 0.f, 0.f, 1 / 256.f),
             },
         };
+
+        std::string getTestFilename(size_t i)
+        {
+            return "texture" + std::to_string(i + 1) + (i < kNumPNGs ? ".png" : ".exr");
+        }
+
+        void verifyResult(UnitTestContext& ctx, const TextureAnalyzer::Result& result, size_t i)
+        {
+            EXPECT_EQ(result.mask, kExpectedResult[i].mask) << "i = " << i;
+
+            uint32_t rangeFlags = 0;
+            for (int c = 0; c < 4; c++)
+            {
+                bool isConstant = (kExpectedResult[i].mask & (1u << c)) == 0;
+                rangeFlags |= kExpectedResult[i].mask >> (4 + 4 * c);
+
+                EXPECT_EQ(result.isConstant(1u << c), isConstant) << " c = " << c;
+                EXPECT_EQ(result.minValue[c], kExpectedResult[i].minValue[c]) << "i = " << i << " c = " << c;
+                EXPECT_EQ(result.maxValue[c], kExpectedResult[i].maxValue[c]) << "i = " << i << " c = " << c;
+
+                if (isConstant)
+                {
+                    EXPECT_EQ(result.value[c], kExpectedResult[i].value[c]) << "i = " << i << " c = " << c;
+                }
+            }
+
+            EXPECT_EQ(result.isPos(TextureChannelFlags::RGBA), (rangeFlags & (uint32_t)TextureAnalyzer::Result::RangeFlags::Pos) != 0) << "i = " << i;
+            EXPECT_EQ(result.isNeg(TextureChannelFlags::RGBA), (rangeFlags & (uint32_t)TextureAnalyzer::Result::RangeFlags::Neg) != 0) << "i = " << i;
+            EXPECT_EQ(result.isInf(TextureChannelFlags::RGBA), (rangeFlags & (uint32_t)TextureAnalyzer::Result::RangeFlags::Inf) != 0) << "i = " << i;
+            EXPECT_EQ(result.isNaN(TextureChannelFlags::RGBA), (rangeFlags & (uint32_t)TextureAnalyzer::Result::RangeFlags::NaN) != 0) << "i = " << i;
+        }
     }
 
     GPU_TEST(TextureAnalyzer)
@@ -114,7 +145,7 @@ namespace Falcor
         std::vector<Texture::SharedPtr> textures(kNumTests);
         for (size_t i = 0; i < kNumTests; i++)
         {
-            std::string fn = "texture" + std::to_string(i + 1) + (i < kNumPNGs ? ".png" : ".exr");
+            std::string fn = getTestFilename(i);
             textures[i] = Texture::createFromFile(fn, false, false);
             if (!textures[i]) throw std::runtime_error("Failed to load " + fn);
         }
@@ -131,33 +162,8 @@ namespace Falcor
 
         auto verify = [&ctx](Buffer::SharedPtr pResult)
         {
-            // Verify results.
             const TextureAnalyzer::Result* result = static_cast<const TextureAnalyzer::Result*>(pResult->map(Buffer::MapType::Read));
-            for (size_t i = 0; i < kNumTests; i++)
-            {
-                EXPECT_EQ(result[i].mask, kExpectedResult[i].mask) << "i = " << i;
-
-                uint32_t rangeFlags = 0;
-                for (int c = 0; c < 4; c++)
-                {
-                    bool isConstant = (kExpectedResult[i].mask & (1u << c)) == 0;
-                    rangeFlags |= kExpectedResult[i].mask >> (4 + 4 * c);
-
-                    EXPECT_EQ(result[i].isConstant(1u << c), isConstant) << " c = " << c;
-                    EXPECT_EQ(result[i].minValue[c], kExpectedResult[i].minValue[c]) << "i = " << i << " c = " << c;
-                    EXPECT_EQ(result[i].maxValue[c], kExpectedResult[i].maxValue[c]) << "i = " << i << " c = " << c;
-
-                    if (isConstant)
-                    {
-                        EXPECT_EQ(result[i].value[c], kExpectedResult[i].value[c]) << "i = " << i << " c = " << c;
-                    }
-                }
-
-                EXPECT_EQ(result[i].isPos(TextureChannelFlags::RGBA), (rangeFlags & (uint32_t)TextureAnalyzer::Result::RangeFlags::Pos) != 0) << "i = " << i;
-                EXPECT_EQ(result[i].isNeg(TextureChannelFlags::RGBA), (rangeFlags & (uint32_t)TextureAnalyzer::Result::RangeFlags::Neg) != 0) << "i = " << i;
-                EXPECT_EQ(result[i].isInf(TextureChannelFlags::RGBA), (rangeFlags & (uint32_t)TextureAnalyzer::Result::RangeFlags::Inf) != 0) << "i = " << i;
-                EXPECT_EQ(result[i].isNaN(TextureChannelFlags::RGBA), (rangeFlags & (uint32_t)TextureAnalyzer::Result::RangeFlags::NaN) != 0) << "i = " << i;
-            }
+            for (size_t i = 0; i < kNumTests; i++) verifyResult(ctx, result[i], i);
             pResult->unmap();
         };
 
@@ -169,4 +175,36 @@ namespace Falcor
 
         verify(pResult);
     }
+
+    CPU_TEST(TextureAnalyzerCPU)
+    {
+        // The CPU analysis should give the same results as the GPU analysis.
+        for (size_t i = 0; i < kNumTests; i++)
+        {
+            std::string fn = getTestFilename(i);
+            std::string fullPath;
+            if (!findFileInDataDirectories(fn, fullPath)) throw std::runtime_error("Failed to find " + fn);
+            auto pBitmap = Bitmap::createFromFile(fullPath, true);
+            if (!pBitmap) throw std::runtime_error("Failed to load " + fn);
+
+            auto result = TextureAnalyzer::analyze(*pBitmap, false);
+            EXPECT(result.has_value()) << "i = " << i;
+            if (result) verifyResult(ctx, *result, i);
+        }
+
+        // Test that the color channels are converted to linear space when analyzing as sRGB.
+        const uint8_t texels[] = { 64, 128, 255, 128, 64, 128, 255, 0 };
+        auto pBitmap = Bitmap::create(2, 1, ResourceFormat::RGBA8Unorm, texels);
+        auto result = TextureAnalyzer::analyze(*pBitmap, true);
+        EXPECT(result.has_value());
+        if (result)
+        {
+            EXPECT(result->isConstant(TextureChannelFlags::RGB));
+            EXPECT(!result->isConstant(TextureChannelFlags::Alpha));
+            EXPECT_EQ(result->value.b, 1.f);
+            EXPECT_LT(result->value.r, 64 / 255.f);
+            EXPECT_EQ(result->minValue.a, 0.f);
+            EXPECT_EQ(result->maxValue.a, 128 / 255.f);
+        }
+    }
 }
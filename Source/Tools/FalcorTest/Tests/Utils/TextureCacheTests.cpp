@@ -0,0 +1,119 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Utils/Image/Bitmap.h"
+#include "Utils/Image/TextureCache.h"
+#include "../TestUtils.h"
+#include <filesystem>
+
+namespace Falcor
+{
+    namespace
+    {
+        TextureCache::SharedPtr createCache(const std::filesystem::path& directory, bool compress)
+        {
+            TextureCache::Options options;
+            options.directory = directory.string();
+            options.compress = compress;
+            return TextureCache::create(options);
+        }
+    }
+
+    GPU_TEST(TextureCache)
+    {
+        const auto directory = createTempDirectory();
+        auto pCache = createCache(directory, false);
+
+        std::string fullPath;
+        EXPECT(findFileInDataDirectories("texture4.png", fullPath));
+        auto key = pCache->computeKey(fullPath, true, false);
+        EXPECT(key.has_value());
+        if (!key) return;
+        EXPECT(!pCache->hasTexture(*key));
+
+        // The first load adds the texture to the cache, the second load is served from the cache.
+        auto pReference = Texture::createFromFile(fullPath, true, false);
+        auto pMiss = pCache->loadTexture(fullPath, true, false);
+        EXPECT(pCache->hasTexture(*key));
+        auto pHit = pCache->loadTexture(fullPath, true, false);
+
+        for (const auto& pTexture : { pMiss, pHit })
+        {
+            EXPECT(pTexture != nullptr);
+            if (!pTexture) continue;
+            EXPECT_EQ(pTexture->getWidth(), pReference->getWidth());
+            EXPECT_EQ(pTexture->getHeight(), pReference->getHeight());
+            EXPECT_EQ(pTexture->getMipCount(), pReference->getMipCount());
+            EXPECT_EQ(pTexture->getFormat(), pReference->getFormat());
+            EXPECT_EQ(pTexture->getSourceFilename(), fullPath);
+
+            // The top-level mip is stored losslessly.
+            auto data = ctx.getRenderContext()->readTextureSubresource(pTexture.get(), 0);
+            auto referenceData = ctx.getRenderContext()->readTextureSubresource(pReference.get(), 0);
+            EXPECT(data == referenceData);
+        }
+
+        // Different settings use different cache entries.
+        EXPECT(*pCache->computeKey(fullPath, true, true) != *key);
+        EXPECT(*pCache->computeKey(fullPath, false, false) != *key);
+        EXPECT(*createCache(directory, true)->computeKey(fullPath, true, false) != *key);
+
+        std::filesystem::remove_all(directory);
+    }
+
+    GPU_TEST(TextureCacheCompressed)
+    {
+        const auto directory = createTempDirectory();
+        auto pCache = createCache(directory, true);
+
+        // Write a 64x64 test image.
+        const uint32_t size = 64;
+        std::vector<uint8_t> pixels(size * size * 4);
+        for (uint32_t i = 0; i < size * size; i++)
+        {
+            pixels[i * 4 + 0] = (uint8_t)(i % size * 4);
+            pixels[i * 4 + 1] = (uint8_t)(i / size * 4);
+            pixels[i * 4 + 2] = 128;
+            pixels[i * 4 + 3] = 255;
+        }
+        const std::string path = (directory / "image.png").string();
+        Bitmap::saveImage(path, size, size, Bitmap::FileFormat::PngFile, Bitmap::ExportFlags::ExportAlpha, ResourceFormat::RGBA8Unorm, true, pixels.data());
+
+        auto pLinear = pCache->loadTexture(path, true, false);
+        auto pSrgb = pCache->loadTexture(path, true, true);
+        EXPECT(pLinear != nullptr && pSrgb != nullptr);
+        if (!pLinear || !pSrgb) return;
+
+        EXPECT_EQ(pLinear->getFormat(), ResourceFormat::BC7Unorm);
+        EXPECT_EQ(pSrgb->getFormat(), ResourceFormat::BC7UnormSrgb);
+        EXPECT_EQ(pLinear->getMipCount(), 7u);
+        EXPECT_EQ(pSrgb->getMipCount(), 7u);
+
+        std::filesystem::remove_all(directory);
+    }
+}
@@ -0,0 +1,101 @@
+/***************************************************************************
+ # Copyright (c) 2015-21, NVIDIA CORPORATION. All rights reserved.
+ #
+ # Redistribution and use in source and binary forms, with or without
+ # modification, are permitted provided that the following conditions
+ # are met:
+ #  * Redistributions of source code must retain the above copyright
+ #    notice, this list of conditions and the following disclaimer.
+ #  * Redistributions in binary form must reproduce the above copyright
+ #    notice, this list of conditions and the following disclaimer in the
+ #    documentation and/or other materials provided with the distribution.
+ #  * Neither the name of NVIDIA CORPORATION nor the names of its
+ #    contributors may be used to endorse or promote products derived
+ #    from this software without specific prior written permission.
+ #
+ # THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS "AS IS" AND ANY
+ # EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ # IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ # PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ # CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ # EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ # PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ # PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ # OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ # (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ **************************************************************************/
+#include "Testing/UnitTest.h"
+#include "Utils/Threading.h"
+#include <atomic>
+
+namespace Falcor
+{
+    CPU_TEST(ThreadingTask)
+    {
+        std::atomic<uint32_t> value = 0;
+        auto task = Threading::dispatchTask([&] () { value = 1; });
+        task.finish();
+        EXPECT(!task.isRunning());
+        EXPECT_EQ(value.load(), 1u);
+
+        // Continuations run after the parent task has finished.
+        uint32_t first = 0, second = 0;
+        std::atomic<uint32_t> order = 0;
+        auto parent = Threading::dispatchTask([&] () { std::this_thread::sleep_for(std::chrono::milliseconds(5)); first = ++order; });
+        auto child = parent.then([&] () { second = ++order; });
+        child.finish();
+        EXPECT_EQ(first, 1u);
+        EXPECT_EQ(second, 2u);
+
+        // Exceptions are rethrown by finish().
+        bool caught = false;
+        auto throwing = Threading::dispatchTask([] () { throw std::runtime_error("Task failed"); });
+        try
+        {
+            throwing.finish();
+        }
+        catch (const std::runtime_error&)
+        {
+            caught = true;
+        }
+        EXPECT(caught);
+    }
+
+    CPU_TEST(ThreadingParallelFor)
+    {
+        const uint32_t n = 100000;
+        std::vector<uint32_t> data(n, 0);
+        Threading::parallelFor(0u, n, [&] (uint32_t i) { data[i] += i; });
+        for (uint32_t i = 0; i < n; ++i) EXPECT_EQ(data[i], i) << "i = " << i;
+
+        // Nested loops must not deadlock.
+        std::atomic<uint32_t> count = 0;
+        Threading::parallelFor(0, 64, [&] (int) { Threading::parallelFor(0, 100, [&] (int) { count++; }); });
+        EXPECT_EQ(count.load(), 6400u);
+    }
+
+    CPU_TEST(ThreadingParallelReduce)
+    {
+        const uint64_t n = 1000000;
+        auto sum = [] (uint64_t first, uint64_t last, uint64_t acc)
+        {
+            for (uint64_t i = first; i < last; ++i) acc += i;
+            return acc;
+        };
+        uint64_t result = Threading::parallelReduce(uint64_t(0), n, uint64_t(0), sum, std::plus<uint64_t>());
+        EXPECT_EQ(result, n * (n - 1) / 2);
+
+        // Floating-point reductions are deterministic for a fixed grain size.
+        std::vector<float> values(n);
+        for (uint64_t i = 0; i < n; ++i) values[i] = 1.f / float(i + 1);
+        auto sumFloat = [&] (size_t first, size_t last, float acc)
+        {
+            for (size_t i = first; i < last; ++i) acc += values[i];
+            return acc;
+        };
+        float a = Threading::parallelReduce(size_t(0), values.size(), 0.f, sumFloat, std::plus<float>(), 1024);
+        float b = Threading::parallelReduce(size_t(0), values.size(), 0.f, sumFloat, std::plus<float>(), 1024);
+        EXPECT_EQ(a, b);
+    }
+}
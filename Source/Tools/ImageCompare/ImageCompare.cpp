@@ -27,14 +27,27 @@
  **************************************************************************/
 #include <FreeImage.h>
 #include <args.hxx>
+#include <emmintrin.h>
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
 #include <memory>
 #include <string>
 #include <vector>
 #include <stdexcept>
 #include <map>
 #include <functional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
 
 template<typename T>
 T sqr(T x) { return x * x; }
@@ -45,6 +58,85 @@ T lerp(T a, T b, T t) { return a + t * (b - a); }
 template<typename T>
 T clamp(T x, T lo, T hi) { return std::max(lo, std::min(hi, x)); }
 
+template<typename T>
+T div_round_up(T a, T b) { return (a + b - 1) / b; }
+
+namespace
+{
+    /** Number of image rows processed as one tile.
+        Tiles are the unit of work for the worker threads. Pixel data is converted to float one tile at a time,
+        so memory use beyond the decoded images is bounded by the tile size and the number of threads.
+    */
+    const uint32_t kTileRows = 32;
+
+    /** Radius of the Gaussian window used by SSIM (11x11 window, sigma = 1.5).
+    */
+    const int kSSIMRadius = 5;
+    const float kSSIMSigma = 1.5f;
+
+    /** Runs func(index) for all indices in [0, count) on a set of worker threads.
+        Indices are handed out in increasing order. Workers stop picking up new indices once cancel is set.
+        The first exception thrown by func is rethrown on the calling thread.
+    */
+    void parallelFor(uint32_t count, uint32_t threadCount, const std::function<void(uint32_t)>& func, const std::atomic<bool>* pCancel = nullptr)
+    {
+        std::atomic<uint32_t> nextIndex = 0;
+        std::exception_ptr pException;
+        std::mutex exceptionMutex;
+
+        auto worker = [&] ()
+        {
+            try
+            {
+                for (uint32_t i = nextIndex++; i < count; i = nextIndex++)
+                {
+                    if (pCancel && *pCancel) break;
+                    func(i);
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(exceptionMutex);
+                if (!pException) pException = std::current_exception();
+                nextIndex = count;
+            }
+        };
+
+        threadCount = clamp(threadCount, 1u, std::max(count, 1u));
+        std::vector<std::thread> threads;
+        for (uint32_t i = 1; i < threadCount; ++i) threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads) thread.join();
+
+        if (pException) std::rethrow_exception(pException);
+    }
+
+    float horizontalSum(__m128 v)
+    {
+        __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        s = _mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+        return _mm_cvtss_f32(s);
+    }
+
+    /** Returns the lane mask selecting the channels included in the comparison.
+    */
+    __m128 getChannelMask(bool alpha)
+    {
+        return _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, alpha ? -1 : 0));
+    }
+
+    /** Copies a row of RGBA pixels to a buffer with radius pixels of edge replication on both sides.
+    */
+    void padRow(const float* src, int width, int radius, std::vector<__m128>& dst)
+    {
+        dst.resize(width + 2 * radius);
+        for (int x = 0; x < width + 2 * radius; ++x)
+        {
+            dst[x] = _mm_loadu_ps(src + 4 * clamp(x - radius, 0, width - 1));
+        }
+    }
+}
+
 class Image
 {
 public:
@@ -57,34 +149,6 @@ public:
 
     static SharedPtr create(uint32_t width, uint32_t height) { return SharedPtr(new Image(width, height)); }
 
-    static SharedPtr loadFromFile(const std::string& filename)
-    {
-        FREE_IMAGE_FORMAT fifFormat = FIF_UNKNOWN;
-
-        // Determine file format.
-        fifFormat = FreeImage_GetFileType(filename.c_str(), 0);
-        if (fifFormat == FIF_UNKNOWN) fifFormat = FreeImage_GetFIFFromFilename(filename.c_str());
-        if (fifFormat == FIF_UNKNOWN) throw std::runtime_error("Unknown image format");
-        if (!FreeImage_FIFSupportsReading(fifFormat)) throw std::runtime_error("Unsupported image format");
-
-        // Read image.
-        FIBITMAP* srcBitmap = FreeImage_Load(fifFormat, filename.c_str());
-        if (!srcBitmap) throw std::runtime_error("Cannot read image");
-
-        // Convert to RGBA32F.
-        FIBITMAP* floatBitmap = FreeImage_ConvertToRGBAF(srcBitmap);
-        FreeImage_Unload(srcBitmap);
-        if (!floatBitmap) throw std::runtime_error("Cannot convert to RGBA float format");
-
-        // Create image.
-        auto image = create(FreeImage_GetWidth(floatBitmap), FreeImage_GetHeight(floatBitmap));
-        int bytesPerPixel = 4 * sizeof(float);
-        FreeImage_ConvertToRawBits(reinterpret_cast<BYTE*>(image->getData()), floatBitmap, bytesPerPixel * image->getWidth(), bytesPerPixel * 8, FI_RGBA_RED_MASK, FI_RGBA_GREEN_MASK, FI_RGBA_BLUE_MASK, true);
-        FreeImage_Unload(floatBitmap);
-
-        return image;
-    }
-
     void saveToFile(const std::string& filename, bool writeAlpha = true) const
     {
         FREE_IMAGE_FORMAT fifFormat = FIF_UNKNOWN;
@@ -159,80 +223,918 @@ private:
     {}
 };
 
+/** Read-only access to a decoded image, one row at a time.
+    The image is kept in its decoded pixel format and rows are converted to RGBA float on demand,
+    so the comparison never holds a full float copy of the image. Rows can be read concurrently.
+*/
+class ImageReader
+{
+public:
+    using UniquePtr = std::unique_ptr<ImageReader>;
+
+    ~ImageReader() { FreeImage_Unload(mpBitmap); }
+
+    static UniquePtr open(const std::string& filename)
+    {
+        FREE_IMAGE_FORMAT fifFormat = FIF_UNKNOWN;
+
+        // Determine file format.
+        fifFormat = FreeImage_GetFileType(filename.c_str(), 0);
+        if (fifFormat == FIF_UNKNOWN) fifFormat = FreeImage_GetFIFFromFilename(filename.c_str());
+        if (fifFormat == FIF_UNKNOWN) throw std::runtime_error("Unknown image format");
+        if (!FreeImage_FIFSupportsReading(fifFormat)) throw std::runtime_error("Unsupported image format");
+
+        // Read image.
+        FIBITMAP* bitmap = FreeImage_Load(fifFormat, filename.c_str());
+        if (!bitmap) throw std::runtime_error("Cannot read image");
+
+        // Formats without a direct row conversion are converted to RGBA32F up front.
+        Layout layout = getLayout(bitmap);
+        if (layout == Layout::Unknown)
+        {
+            FIBITMAP* floatBitmap = FreeImage_ConvertToRGBAF(bitmap);
+            FreeImage_Unload(bitmap);
+            if (!floatBitmap) throw std::runtime_error("Cannot convert to RGBA float format");
+            bitmap = floatBitmap;
+            layout = Layout::RGBA32F;
+        }
+
+        return UniquePtr(new ImageReader(bitmap, layout));
+    }
+
+    uint32_t getWidth() const { return mWidth; }
+    uint32_t getHeight() const { return mHeight; }
+
+    /** Read a row of the image as RGBA float. Rows are numbered top-down.
+        \param[in] y Row index.
+        \param[out] dst Destination buffer holding 4 * width floats.
+    */
+    void readRow(uint32_t y, float* dst) const
+    {
+        const BYTE* src = FreeImage_GetScanLine(mpBitmap, mHeight - y - 1);
+        const float kUnorm8 = 1.f / 255.f;
+        switch (mLayout)
+        {
+        case Layout::RGBA32F:
+            std::memcpy(dst, src, mWidth * 4 * sizeof(float));
+            break;
+        case Layout::RGB32F:
+            for (uint32_t x = 0; x < mWidth; ++x, src += 3 * sizeof(float), dst += 4)
+            {
+                std::memcpy(dst, src, 3 * sizeof(float));
+                dst[3] = 1.f;
+            }
+            break;
+        case Layout::BGR8:
+        case Layout::BGRA8:
+        {
+            const bool hasAlpha = mLayout == Layout::BGRA8;
+            const uint32_t stride = hasAlpha ? 4 : 3;
+            for (uint32_t x = 0; x < mWidth; ++x, src += stride, dst += 4)
+            {
+                dst[0] = src[FI_RGBA_RED] * kUnorm8;
+                dst[1] = src[FI_RGBA_GREEN] * kUnorm8;
+                dst[2] = src[FI_RGBA_BLUE] * kUnorm8;
+                dst[3] = hasAlpha ? src[FI_RGBA_ALPHA] * kUnorm8 : 1.f;
+            }
+            break;
+        }
+        default:
+            throw std::runtime_error("Unsupported pixel layout");
+        }
+    }
+
+private:
+    enum class Layout
+    {
+        Unknown,
+        RGBA32F,
+        RGB32F,
+        BGRA8,
+        BGR8,
+    };
+
+    static Layout getLayout(FIBITMAP* bitmap)
+    {
+        switch (FreeImage_GetImageType(bitmap))
+        {
+        case FIT_RGBAF: return Layout::RGBA32F;
+        case FIT_RGBF: return Layout::RGB32F;
+        case FIT_BITMAP:
+            if (FreeImage_GetBPP(bitmap) == 32) return Layout::BGRA8;
+            if (FreeImage_GetBPP(bitmap) == 24) return Layout::BGR8;
+            return Layout::Unknown;
+        default: return Layout::Unknown;
+        }
+    }
+
+    ImageReader(FIBITMAP* bitmap, Layout layout)
+        : mpBitmap(bitmap)
+        , mLayout(layout)
+        , mWidth(FreeImage_GetWidth(bitmap))
+        , mHeight(FreeImage_GetHeight(bitmap))
+    {}
+
+    FIBITMAP* mpBitmap;
+    Layout mLayout;
+    uint32_t mWidth;
+    uint32_t mHeight;
+};
+
+enum class ToneMapper
+{
+    ACES,
+    Hable,
+    Reinhard,
+};
+
+/** Options for the FLIP metric. Defaults match FLIPPass.
+*/
+struct FLIPOptions
+{
+    bool hdr = false;                           ///< Compute HDR-FLIP instead of LDR-FLIP.
+    bool clampInput = false;                    ///< Clamp input to [0,1] for LDR-FLIP and [0,inf) for HDR-FLIP.
+    ToneMapper toneMapper = ToneMapper::ACES;   ///< Tone mapper used for HDR-FLIP.
+    uint32_t monitorWidthPixels = 3840;         ///< Horizontal resolution of the viewing monitor.
+    float monitorWidthMeters = 0.7f;            ///< Width of the viewing monitor in meters.
+    float monitorDistance = 0.7f;               ///< Distance to the viewing monitor in meters.
+};
+
+struct CompareOptions
+{
+    bool alpha = false;             ///< Include the alpha channel.
+    double threshold = 0.0;         ///< Error threshold.
+    bool earlyOut = false;          ///< Stop as soon as the error is known to exceed the threshold.
+    double trim = 0.0;              ///< Fraction of the largest per-pixel errors discarded before averaging.
+    bool errorMap = false;          ///< Return the per-pixel error map.
+    uint32_t threadCount = 1;       ///< Number of worker threads.
+    FLIPOptions flip;
+};
+
+struct CompareResult
+{
+    double error = 0.0;             ///< Mean per-pixel error. Lower bound of the error if the comparison stopped early.
+    float minError = 0.f;           ///< Smallest per-pixel error.
+    float maxError = 0.f;           ///< Largest per-pixel error.
+    bool earlyOut = false;          ///< True if the comparison stopped before all pixels were compared.
+    std::vector<float> errorMap;    ///< Per-pixel errors if requested.
+};
+
+/** Computes the per-pixel errors of rowCount rows starting at row y0 and writes them to errors.
+    Called concurrently from the worker threads, each call processing a different tile.
+*/
+using ErrorKernel = std::function<void(uint32_t y0, uint32_t rowCount, float* errors)>;
+
+// Per-channel error functions. Operate on all four RGBA channels at once.
+
 struct MSE
 {
-    double operator()(const float* a, const float* b, size_t count) const
+    static __m128 eval(__m128 a, __m128 b)
     {
-        double error = 0.0;
-        for (size_t i = 0; i < count; ++i) { error += sqr(a[i] - b[i]); }
-        return error / count;
+        __m128 d = _mm_sub_ps(a, b);
+        return _mm_mul_ps(d, d);
     }
 };
 
 struct RMSE
 {
-    double operator()(const float* a, const float* b, size_t count) const
+    static __m128 eval(__m128 a, __m128 b)
     {
-        double error = 0.0;
-        for (size_t i = 0; i < count; ++i) { error += sqr(a[i] - b[i]) / (sqr(a[i]) + 1e-3); }
-        return error / count;
+        __m128 d = _mm_sub_ps(a, b);
+        return _mm_div_ps(_mm_mul_ps(d, d), _mm_add_ps(_mm_mul_ps(a, a), _mm_set1_ps(1e-3f)));
     }
 };
 
 struct MAE
 {
-    double operator()(const float* a, const float* b, size_t count) const
+    static __m128 eval(__m128 a, __m128 b)
     {
-        double error = 0.0;
-        for (size_t i = 0; i < count; ++i) { error += std::fabs(sqr(a[i] - b[i])); }
-        return error / count;
+        return _mm_andnot_ps(_mm_set1_ps(-0.f), _mm_sub_ps(a, b));
     }
 };
 
 struct MAPE
 {
-    double operator()(const float* a, const float* b, size_t count) const
+    static __m128 eval(__m128 a, __m128 b)
     {
-        double error = 0.0;
-        for (size_t i = 0; i < count; ++i) { error += std::fabs((a[i] - b[i]) / (a[i] + 1e-3)); }
-        return 100.0 * error / count;
+        __m128 d = _mm_div_ps(_mm_sub_ps(a, b), _mm_add_ps(a, _mm_set1_ps(1e-3f)));
+        return _mm_mul_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), d), _mm_set1_ps(100.f));
     }
 };
 
+/** Computes the channel-averaged error of pixelCount RGBA pixels. Four pixels are processed per iteration.
+*/
 template<typename Metric>
-double compare(const Image& imageA, const Image& imageB, bool alpha, float* errorMap)
+void computePixelErrors(const float* a, const float* b, uint32_t pixelCount, bool alpha, float* errors)
 {
-    Metric metric;
-    double sum = 0.0;
-    const float* a = imageA.getData();
-    const float* b = imageB.getData();
-    size_t count = imageA.getWidth() * imageA.getHeight();
-    for (size_t i = 0; i < count; ++i)
-    {
-        double error = metric(a, b, alpha ? 4 : 3);
-        if (errorMap) *errorMap++ = float(error);
-        sum += error;
-        a += 4;
-        b += 4;
-    }
-    return sum / count;
+    const __m128 mask = getChannelMask(alpha);
+    const float scale = alpha ? 0.25f : 1.f / 3.f;
+    const __m128 scale4 = _mm_set1_ps(scale);
+
+    uint32_t i = 0;
+    for (; i + 4 <= pixelCount; i += 4, a += 16, b += 16)
+    {
+        __m128 e0 = _mm_and_ps(Metric::eval(_mm_loadu_ps(a + 0), _mm_loadu_ps(b + 0)), mask);
+        __m128 e1 = _mm_and_ps(Metric::eval(_mm_loadu_ps(a + 4), _mm_loadu_ps(b + 4)), mask);
+        __m128 e2 = _mm_and_ps(Metric::eval(_mm_loadu_ps(a + 8), _mm_loadu_ps(b + 8)), mask);
+        __m128 e3 = _mm_and_ps(Metric::eval(_mm_loadu_ps(a + 12), _mm_loadu_ps(b + 12)), mask);
+        _MM_TRANSPOSE4_PS(e0, e1, e2, e3);
+        __m128 sum = _mm_add_ps(_mm_add_ps(e0, e1), _mm_add_ps(e2, e3));
+        _mm_storeu_ps(errors + i, _mm_mul_ps(sum, scale4));
+    }
+    for (; i < pixelCount; ++i, a += 4, b += 4)
+    {
+        errors[i] = horizontalSum(_mm_and_ps(Metric::eval(_mm_loadu_ps(a), _mm_loadu_ps(b)), mask)) * scale;
+    }
+}
+
+template<typename Metric>
+ErrorKernel createPixelKernel(const ImageReader& imageA, const ImageReader& imageB, const CompareOptions& options)
+{
+    return [&imageA, &imageB, alpha = options.alpha] (uint32_t y0, uint32_t rowCount, float* errors)
+    {
+        const uint32_t width = imageA.getWidth();
+        thread_local std::vector<float> rowA, rowB;
+        rowA.resize(width * 4);
+        rowB.resize(width * 4);
+
+        for (uint32_t y = y0; y < y0 + rowCount; ++y)
+        {
+            imageA.readRow(y, rowA.data());
+            imageB.readRow(y, rowB.data());
+            computePixelErrors<Metric>(rowA.data(), rowB.data(), width, alpha, errors + size_t(y - y0) * width);
+        }
+    };
+}
+
+/** Structural dissimilarity (1 - SSIM) per pixel, averaged over channels.
+    Uses an 11x11 Gaussian window with sigma 1.5 and the constants K1 = 0.01, K2 = 0.03 for a dynamic range of 1.
+    Image borders are handled by edge replication, so the error map has the size of the input images.
+*/
+ErrorKernel createSSIMKernel(const ImageReader& imageA, const ImageReader& imageB, const CompareOptions& options)
+{
+    std::vector<float> weights(2 * kSSIMRadius + 1);
+    float weightSum = 0.f;
+    for (int t = -kSSIMRadius; t <= kSSIMRadius; ++t) weightSum += weights[t + kSSIMRadius] = std::exp(-float(t * t) / (2.f * kSSIMSigma * kSSIMSigma));
+    for (auto& w : weights) w /= weightSum;
+
+    return [&imageA, &imageB, weights, alpha = options.alpha] (uint32_t y0, uint32_t rowCount, float* errors)
+    {
+        // Moments stored per pixel: E[a], E[b], E[a^2], E[b^2], E[ab].
+        const int kMoments = 5;
+        const int width = (int)imageA.getWidth();
+        const int height = (int)imageA.getHeight();
+        const int r = kSSIMRadius;
+        const int extRowCount = (int)rowCount + 2 * r;
+
+        thread_local std::vector<float> rowA, rowB;
+        thread_local std::vector<__m128> paddedA, paddedB, filtered, sums;
+        rowA.resize(width * 4);
+        rowB.resize(width * 4);
+        filtered.resize(size_t(extRowCount) * width * kMoments);
+        sums.resize(size_t(width) * kMoments);
+
+        // Horizontal pass over the tile rows and the rows in the filter radius around them.
+        for (int e = 0; e < extRowCount; ++e)
+        {
+            int y = clamp((int)y0 - r + e, 0, height - 1);
+            imageA.readRow(y, rowA.data());
+            imageB.readRow(y, rowB.data());
+            padRow(rowA.data(), width, r, paddedA);
+            padRow(rowB.data(), width, r, paddedB);
+
+            __m128* dst = filtered.data() + size_t(e) * width * kMoments;
+            for (int x = 0; x < width; ++x, dst += kMoments)
+            {
+                __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps(), s4 = _mm_setzero_ps();
+                for (int t = 0; t <= 2 * r; ++t)
+                {
+                    const __m128 w = _mm_set1_ps(weights[t]);
+                    const __m128 a = paddedA[x + t];
+                    const __m128 b = paddedB[x + t];
+                    const __m128 wa = _mm_mul_ps(w, a);
+                    const __m128 wb = _mm_mul_ps(w, b);
+                    s0 = _mm_add_ps(s0, wa);
+                    s1 = _mm_add_ps(s1, wb);
+                    s2 = _mm_add_ps(s2, _mm_mul_ps(wa, a));
+                    s3 = _mm_add_ps(s3, _mm_mul_ps(wb, b));
+                    s4 = _mm_add_ps(s4, _mm_mul_ps(wa, b));
+                }
+                dst[0] = s0; dst[1] = s1; dst[2] = s2; dst[3] = s3; dst[4] = s4;
+            }
+        }
+
+        // Vertical pass and SSIM evaluation.
+        const __m128 c1 = _mm_set1_ps(sqr(0.01f));
+        const __m128 c2 = _mm_set1_ps(sqr(0.03f));
+        const __m128 two = _mm_set1_ps(2.f);
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 mask = getChannelMask(alpha);
+        const float scale = alpha ? 0.25f : 1.f / 3.f;
+
+        for (int o = 0; o < (int)rowCount; ++o)
+        {
+            std::fill(sums.begin(), sums.end(), _mm_setzero_ps());
+            for (int t = 0; t <= 2 * r; ++t)
+            {
+                const __m128 w = _mm_set1_ps(weights[t]);
+                const __m128* src = filtered.data() + size_t(o + t) * width * kMoments;
+                for (size_t i = 0; i < sums.size(); ++i) sums[i] = _mm_add_ps(sums[i], _mm_mul_ps(w, src[i]));
+            }
+
+            for (int x = 0; x < width; ++x)
+            {
+                const __m128* m = sums.data() + size_t(x) * kMoments;
+                const __m128 muAB = _mm_mul_ps(m[0], m[1]);
+                const __m128 muAA = _mm_mul_ps(m[0], m[0]);
+                const __m128 muBB = _mm_mul_ps(m[1], m[1]);
+                const __m128 varA = _mm_sub_ps(m[2], muAA);
+                const __m128 varB = _mm_sub_ps(m[3], muBB);
+                const __m128 covAB = _mm_sub_ps(m[4], muAB);
+                const __m128 num = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(two, muAB), c1), _mm_add_ps(_mm_mul_ps(two, covAB), c2));
+                const __m128 den = _mm_mul_ps(_mm_add_ps(_mm_add_ps(muAA, muBB), c1), _mm_add_ps(_mm_add_ps(varA, varB), c2));
+                const __m128 dssim = _mm_sub_ps(one, _mm_div_ps(num, den));
+                errors[size_t(o) * width + x] = horizontalSum(_mm_and_ps(dssim, mask)) * scale;
+            }
+        }
+    };
+}
+
+/** CPU implementation of FLIP matching FLIPPass (see RenderPasses/FLIPPass/FLIPPass.cs.slang and flip.hlsli).
+    The spatial and feature filters of FLIPPass are sums of separable Gaussians and are evaluated as
+    horizontal and vertical passes, which gives the same result up to floating-point rounding.
+*/
+namespace flip
+{
+    struct float3
+    {
+        float x, y, z;
+    };
+
+    float3 operator*(float3 a, float3 b) { return { a.x * b.x, a.y * b.y, a.z * b.z }; }
+    float3 operator*(float3 a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+
+    const float kPi = 3.141592653f;
+    const float kPiSquared = kPi * kPi;
+    const float kInvSqrt2 = 1.f / std::sqrt(2.f);
+
+    const float gqc = 0.7f;
+    const float gpc = 0.4f;
+    const float gpt = 0.95f;
+    const float gw = 0.082f;
+    const float gqf = 0.5f;
+
+    const float3 kD65ReferenceIlluminant = { 0.950428545f, 1.000000000f, 1.088900371f };
+    const float3 kInvD65ReferenceIlluminant = { 1.052156925f, 1.000000000f, 0.918357670f };
+
+    float3 linearRGB2XYZ(float3 c)
+    {
+        const float a11 = 10135552.f / 24577794.f;
+        const float a12 = 8788810.f / 24577794.f;
+        const float a13 = 4435075.f / 24577794.f;
+        const float a21 = 2613072.f / 12288897.f;
+        const float a22 = 8788810.f / 12288897.f;
+        const float a23 = 887015.f / 12288897.f;
+        const float a31 = 1425312.f / 73733382.f;
+        const float a32 = 8788810.f / 73733382.f;
+        const float a33 = 70074185.f / 73733382.f;
+        return { a11 * c.x + a12 * c.y + a13 * c.z, a21 * c.x + a22 * c.y + a23 * c.z, a31 * c.x + a32 * c.y + a33 * c.z };
+    }
+
+    float3 XYZ2LinearRGB(float3 c)
+    {
+        const float a11 = 3.241003275f;
+        const float a12 = -1.537398934f;
+        const float a13 = -0.498615861f;
+        const float a21 = -0.969224334f;
+        const float a22 = 1.875930071f;
+        const float a23 = 0.041554224f;
+        const float a31 = 0.055639423f;
+        const float a32 = -0.204011202f;
+        const float a33 = 1.057148933f;
+        return { a11 * c.x + a12 * c.y + a13 * c.z, a21 * c.x + a22 * c.y + a23 * c.z, a31 * c.x + a32 * c.y + a33 * c.z };
+    }
+
+    float3 XYZ2CIELab(float3 xyz)
+    {
+        float3 c = xyz * kInvD65ReferenceIlluminant;
+        const float delta = 6.f / 29.f;
+        const float deltaSquare = delta * delta;
+        const float deltaCube = delta * deltaSquare;
+        const float factor = 1.f / (3.f * deltaSquare);
+        const float term = 4.f / 29.f;
+        auto f = [&] (float v) { return v > deltaCube ? std::pow(v, 1.f / 3.f) : factor * v + term; };
+        c = { f(c.x), f(c.y), f(c.z) };
+        return { 116.f * c.y - 16.f, 500.f * (c.x - c.y), 200.f * (c.y - c.z) };
+    }
+
+    float3 XYZ2YCxCz(float3 xyz)
+    {
+        float3 c = xyz * kInvD65ReferenceIlluminant;
+        return { 116.f * c.y - 16.f, 500.f * (c.x - c.y), 200.f * (c.y - c.z) };
+    }
+
+    float3 YCxCz2XYZ(float3 ycxcz)
+    {
+        float y = (ycxcz.x + 16.f) / 116.f;
+        float x = ycxcz.y / 500.f + y;
+        float z = y - ycxcz.z / 200.f;
+        return float3{ x, y, z } * kD65ReferenceIlluminant;
+    }
+
+    float3 linearRGB2CIELab(float3 c) { return XYZ2CIELab(linearRGB2XYZ(c)); }
+    float3 linearRGB2YCxCz(float3 c) { return XYZ2YCxCz(linearRGB2XYZ(c)); }
+    float3 YCxCz2LinearRGB(float3 c) { return XYZ2LinearRGB(YCxCz2XYZ(c)); }
+
+    float linearRGB2Luminance(float3 c) { return 0.2126f * c.x + 0.7152f * c.y + 0.0722f * c.z; }
+
+    float3 clamp01(float3 c) { return { clamp(c.x, 0.f, 1.f), clamp(c.y, 0.f, 1.f), clamp(c.z, 0.f, 1.f) }; }
+
+    float3 hunt(float3 c)
+    {
+        float huntValue = 0.01f * c.x;
+        return { c.x, huntValue * c.y, huntValue * c.z };
+    }
+
+    float hyAB(float3 a, float3 b)
+    {
+        return std::abs(a.x - b.x) + std::sqrt(sqr(a.y - b.y) + sqr(a.z - b.z));
+    }
+
+    /** Rational polynomial coefficients of the tone mappers (see ToneMappers.slang).
+    */
+    void getToneMapperCoefficients(ToneMapper toneMapper, float k[6])
+    {
+        if (toneMapper == ToneMapper::ACES)
+        {
+            // Includes pre-exposure cancellation.
+            const float c[6] = { 0.6f * 0.6f * 2.51f, 0.6f * 0.03f, 0.f, 0.6f * 0.6f * 2.43f, 0.6f * 0.59f, 0.14f };
+            std::copy(c, c + 6, k);
+        }
+        else if (toneMapper == ToneMapper::Hable)
+        {
+            const float A = 0.15f, B = 0.50f, C = 0.10f, D = 0.20f, E = 0.02f, F = 0.30f;
+            k[0] = A * F - A * E;
+            k[1] = C * B * F - B * E;
+            k[2] = 0.f;
+            k[3] = A * F;
+            k[4] = B * F;
+            k[5] = D * F * F;
+
+            // Include white scale and exposure bias.
+            const float W = 11.2f;
+            const float nom = k[0] * W * W + k[1] * W + k[2];
+            const float denom = k[3] * W * W + k[4] * W + k[5];
+            const float whiteScale = denom / nom;
+            k[0] = 4.f * k[0] * whiteScale;
+            k[1] = 2.f * k[1] * whiteScale;
+            k[2] = k[2] * whiteScale;
+            k[3] = 4.f * k[3];
+            k[4] = 2.f * k[4];
+        }
+        else
+        {
+            // Reinhard expressed as the rational polynomial used for the exposure range computation.
+            const float c[6] = { 0.f, 1.f, 0.f, 0.f, 1.f, 1.f };
+            std::copy(c, c + 6, k);
+        }
+    }
+
+    float3 toneMap(float3 c, ToneMapper toneMapper, const float k[6])
+    {
+        if (toneMapper == ToneMapper::Reinhard)
+        {
+            return clamp01(c * (1.f / (linearRGB2Luminance(c) + 1.f)));
+        }
+
+        auto f = [k] (float v)
+        {
+            float nom = k[0] * v * v + k[1] * v + k[2];
+            float denom = k[3] * v * v + k[4] * v + k[5];
+            if (std::isinf(denom)) denom = 1.f; // Avoid inf / inf division.
+            return clamp(nom / denom, 0.f, 1.f);
+        };
+        return { f(c.x), f(c.y), f(c.z) };
+    }
+
+    float getMaxDistance()
+    {
+        static const float maxDistance = std::pow(hyAB(hunt(linearRGB2CIELab({ 0.f, 1.f, 0.f })), hunt(linearRGB2CIELab({ 0.f, 0.f, 1.f }))), gqc);
+        return maxDistance;
+    }
+
+    float redistributeErrors(float colorDifference, float featureDifference)
+    {
+        const float maxDistance = getMaxDistance();
+        float error = std::pow(colorDifference, gqc);
+
+        // Normalization.
+        const float perceptualCutoff = gpc * maxDistance;
+        if (error < perceptualCutoff)
+        {
+            error *= gpt / perceptualCutoff;
+        }
+        else
+        {
+            error = gpt + ((error - perceptualCutoff) / (maxDistance - perceptualCutoff)) * (1.f - gpt);
+        }
+
+        return std::pow(error, 1.f - featureDifference);
+    }
+
+    /** Separable filter taps of the CSF (color) and feature detection filters.
+        Pixels are filtered as (Y, Cx, Cz, L) vectors, where L is the normalized luminance (Y + 16) / 116.
+        Horizontal pass: H1 = sum(h1 * (Y, Cx, Cz, L)), H2 = sum(h2 * (Cz, L, L, L)).
+        Vertical pass: V1 = sum(v1 * H1) = (Y_A, Cx_RG, Cz_BY1, pointGradient.y), V2 = sum(v2 * H2) = (Cz_BY2, pointGradient.x, edgeGradient.x, edgeGradient.y).
+    */
+    struct Filter
+    {
+        int radius = 0;
+        std::vector<__m128> h1, h2, v1, v2;
+        float invSumA = 0.f;
+        float invSumRG = 0.f;
+        float invSumBY = 0.f;
+
+        explicit Filter(const FLIPOptions& options)
+        {
+            const float ppd = options.monitorDistance * (options.monitorWidthPixels / options.monitorWidthMeters) * (kPi / 180.f);
+            const float dx = 1.f / ppd;
+            radius = int(std::ceil(3.f * std::sqrt(0.04f / (2.f * kPiSquared)) * ppd));
+
+            // CSF: a * sqrt(pi / b) * exp(-pi^2 * (px^2 + py^2) / b) = a * sqrt(pi / b) * k_b(x) * k_b(y).
+            auto coef = [] (float a, float b) { return a * std::sqrt(kPi / b); };
+            const float coefA = coef(1.f, 0.0047f);
+            const float coefRG = coef(1.f, 0.0053f);
+            const float coefBY1 = coef(34.1f, 0.04f);
+            const float coefBY2 = coef(13.5f, 0.025f);
+            auto csf = [dx] (int t, float b) { float p = t * dx; return std::exp(-(p * p) * kPiSquared / b); };
+
+            // Feature detection: g = exp(-(x^2 + y^2) / (2 sigma^2)) = g1(x) * g1(y).
+            const float sigma = 0.5f * gw * ppd;
+            const float sigmaSquared = sigma * sigma;
+            auto g1 = [sigmaSquared] (int t) { return std::exp(-float(t * t) / (2.f * sigmaSquared)); };
+            auto point = [&] (int t) { return (float(t * t) / sigmaSquared - 1.f) * g1(t); };
+            auto edge = [&] (int t) { return -float(t) * g1(t); };
+
+            float sumA = 0.f, sumRG = 0.f, sumBY1 = 0.f, sumBY2 = 0.f;
+            float sumG = 0.f, sumPositive = 0.f, sumNegative = 0.f, sumEdge = 0.f;
+            for (int t = -radius; t <= radius; ++t)
+            {
+                sumA += csf(t, 0.0047f);
+                sumRG += csf(t, 0.0053f);
+                sumBY1 += csf(t, 0.04f);
+                sumBY2 += csf(t, 0.025f);
+                sumG += g1(t);
+                sumPositive += std::max(point(t), 0.f);
+                sumNegative += std::max(-point(t), 0.f);
+                sumEdge += std::max(edge(t), 0.f);
+            }
+            invSumA = 1.f / (coefA * sumA * sumA);
+            invSumRG = 1.f / (coefRG * sumRG * sumRG);
+            invSumBY = 1.f / (coefBY1 * sumBY1 * sumBY1 + coefBY2 * sumBY2 * sumBY2);
+            const float positiveKernelSum = sumPositive * sumG;
+            const float negativeKernelSum = sumNegative * sumG;
+            const float edgeKernelSum = sumEdge * sumG;
+
+            for (int t = -radius; t <= radius; ++t)
+            {
+                const float p = point(t) / (point(t) >= 0.f ? positiveKernelSum : negativeKernelSum);
+                const float e = edge(t) / edgeKernelSum;
+                h1.push_back(_mm_setr_ps(coefA * csf(t, 0.0047f), coefRG * csf(t, 0.0053f), coefBY1 * csf(t, 0.04f), g1(t)));
+                h2.push_back(_mm_setr_ps(coefBY2 * csf(t, 0.025f), p, e, g1(t)));
+                v1.push_back(_mm_setr_ps(csf(t, 0.0047f), csf(t, 0.0053f), csf(t, 0.04f), p));
+                v2.push_back(_mm_setr_ps(csf(t, 0.025f), g1(t), g1(t), e));
+            }
+        }
+    };
+
+    /** Computes the HDR-FLIP exposures from the median and maximum luminance of the reference image (see FLIPPass::computeExposureParameters()).
+    */
+    std::vector<float> computeExposures(const ImageReader& reference, const FLIPOptions& options, uint32_t threadCount)
+    {
+        const uint32_t width = reference.getWidth();
+        const uint32_t height = reference.getHeight();
+        std::vector<float> luminance(size_t(width) * height);
+        parallelFor(div_round_up(height, kTileRows), threadCount, [&] (uint32_t tile)
+        {
+            thread_local std::vector<float> row;
+            row.resize(width * 4);
+            for (uint32_t y = tile * kTileRows; y < std::min(height, (tile + 1) * kTileRows); ++y)
+            {
+                reference.readRow(y, row.data());
+                for (uint32_t x = 0; x < width; ++x) luminance[size_t(y) * width + x] = linearRGB2Luminance({ row[4 * x], row[4 * x + 1], row[4 * x + 2] });
+            }
+        });
+
+        // Median and maximum. Selection gives the same values as sorting.
+        const size_t count = luminance.size();
+        const float maxLuminance = *std::max_element(luminance.begin(), luminance.end());
+        auto middle = luminance.begin() + count / 2;
+        std::nth_element(luminance.begin(), middle, luminance.end());
+        float medianLuminance = *middle;
+        if ((count & 1) == 0) medianLuminance = (*std::max_element(luminance.begin(), middle) + medianLuminance) * 0.5f;
+
+        float k[6];
+        getToneMapperCoefficients(options.toneMapper, k);
+        const float t = 0.85f;
+        const float a = k[0] - t * k[3];
+        const float b = k[1] - t * k[4];
+        const float c = k[2] - t * k[5];
+
+        // Largest root of a * x^2 + b * x + c = 0.
+        float xMax = 0.f;
+        if (a == 0.f) xMax = -c / b;
+        else
+        {
+            float d1 = -0.5f * (b / a);
+            float d2 = std::sqrt(d1 * d1 - c / a);
+            xMax = d1 + d2;
+        }
+
+        const float startExposure = std::log2(xMax / maxLuminance);
+        const float stopExposure = std::log2(xMax / medianLuminance);
+        if (!std::isfinite(startExposure) || !std::isfinite(stopExposure))
+        {
+            throw std::runtime_error("Cannot determine HDR-FLIP exposure range of the reference image");
+        }
+
+        const uint32_t exposureCount = uint32_t(std::max(2.f, std::ceil(stopExposure - startExposure)));
+        const float exposureDelta = (stopExposure - startExposure) / (exposureCount - 1.f);
+        std::vector<float> exposures(exposureCount);
+        for (uint32_t i = 0; i < exposureCount; ++i) exposures[i] = startExposure + i * exposureDelta;
+        return exposures;
+    }
+}
+
+/** Per-pixel FLIP error of the second image (test) compared to the first image (reference).
+*/
+ErrorKernel createFLIPKernel(const ImageReader& reference, const ImageReader& test, const CompareOptions& options)
+{
+    auto pFilter = std::make_shared<const flip::Filter>(options.flip);
+    std::vector<float> exposures = options.flip.hdr ? flip::computeExposures(reference, options.flip, options.threadCount) : std::vector<float>{ 0.f };
+
+    return [&reference, &test, pFilter, exposures, flipOptions = options.flip] (uint32_t y0, uint32_t rowCount, float* errors)
+    {
+        using flip::float3;
+
+        const flip::Filter& filter = *pFilter;
+        const int width = (int)reference.getWidth();
+        const int height = (int)reference.getHeight();
+        const int r = filter.radius;
+        const int taps = 2 * r + 1;
+        const int extRowCount = (int)rowCount + 2 * r;
+        const size_t pixelCount = size_t(rowCount) * width;
+
+        float k[6];
+        flip::getToneMapperCoefficients(flipOptions.toneMapper, k);
+
+        struct Buffers
+        {
+            std::vector<float> rows;                // Input rows of the tile and its filter radius.
+            std::vector<__m128> padded, shuffled;   // One converted row with edge replication.
+            std::vector<__m128> h1, h2;             // Horizontally filtered rows.
+            std::vector<__m128> v1, v2;             // Vertically filtered output row.
+        };
+        thread_local Buffers buffers[2];
+
+        // Load the rows once, they are reused for all exposures.
+        for (int i = 0; i < 2; ++i)
+        {
+            const ImageReader& image = i == 0 ? reference : test;
+            Buffers& b = buffers[i];
+            b.rows.resize(size_t(extRowCount) * width * 4);
+            b.h1.resize(size_t(extRowCount) * width);
+            b.h2.resize(size_t(extRowCount) * width);
+            b.v1.resize(width);
+            b.v2.resize(width);
+            for (int e = 0; e < extRowCount; ++e) image.readRow(clamp((int)y0 - r + e, 0, height - 1), b.rows.data() + size_t(e) * width * 4);
+        }
+
+        for (size_t exposureIndex = 0; exposureIndex < exposures.size(); ++exposureIndex)
+        {
+            const float exposureScale = std::exp2(exposures[exposureIndex]);
+
+            // Color conversion and horizontal pass.
+            for (Buffers& b : buffers)
+            {
+                for (int e = 0; e < extRowCount; ++e)
+                {
+                    const float* src = b.rows.data() + size_t(e) * width * 4;
+                    b.padded.resize(width + 2 * r);
+                    b.shuffled.resize(width + 2 * r);
+                    for (int x = 0; x < width; ++x)
+                    {
+                        float3 c = { src[4 * x], src[4 * x + 1], src[4 * x + 2] };
+                        if (flipOptions.hdr)
+                        {
+                            if (flipOptions.clampInput) c = { std::max(c.x, 0.f), std::max(c.y, 0.f), std::max(c.z, 0.f) };
+                            c = flip::toneMap(c * exposureScale, flipOptions.toneMapper, k);
+                        }
+                        else if (flipOptions.clampInput)
+                        {
+                            c = flip::clamp01(c);
+                        }
+                        float3 ycxcz = flip::linearRGB2YCxCz(c);
+                        b.padded[x + r] = _mm_setr_ps(ycxcz.x, ycxcz.y, ycxcz.z, (ycxcz.x + 16.f) / 116.f);
+                    }
+                    for (int x = 0; x < r; ++x)
+                    {
+                        b.padded[x] = b.padded[r];
+                        b.padded[width + r + x] = b.padded[width + r - 1];
+                    }
+                    for (int x = 0; x < width + 2 * r; ++x) b.shuffled[x] = _mm_shuffle_ps(b.padded[x], b.padded[x], _MM_SHUFFLE(3, 3, 3, 2));
+
+                    __m128* h1 = b.h1.data() + size_t(e) * width;
+                    __m128* h2 = b.h2.data() + size_t(e) * width;
+                    for (int x = 0; x < width; ++x)
+                    {
+                        __m128 s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps();
+                        for (int t = 0; t < taps; ++t)
+                        {
+                            s1 = _mm_add_ps(s1, _mm_mul_ps(filter.h1[t], b.padded[x + t]));
+                            s2 = _mm_add_ps(s2, _mm_mul_ps(filter.h2[t], b.shuffled[x + t]));
+                        }
+                        h1[x] = s1;
+                        h2[x] = s2;
+                    }
+                }
+            }
+
+            // Vertical pass and FLIP evaluation.
+            for (int o = 0; o < (int)rowCount; ++o)
+            {
+                for (Buffers& b : buffers)
+                {
+                    std::fill(b.v1.begin(), b.v1.end(), _mm_setzero_ps());
+                    std::fill(b.v2.begin(), b.v2.end(), _mm_setzero_ps());
+                    for (int t = 0; t < taps; ++t)
+                    {
+                        const __m128* h1 = b.h1.data() + size_t(o + t) * width;
+                        const __m128* h2 = b.h2.data() + size_t(o + t) * width;
+                        for (int x = 0; x < width; ++x)
+                        {
+                            b.v1[x] = _mm_add_ps(b.v1[x], _mm_mul_ps(filter.v1[t], h1[x]));
+                            b.v2[x] = _mm_add_ps(b.v2[x], _mm_mul_ps(filter.v2[t], h2[x]));
+                        }
+                    }
+                }
+
+                float* dst = errors + size_t(o) * width;
+                for (int x = 0; x < width; ++x)
+                {
+                    float3 lab[2];
+                    float pointGradient[2], edgeGradient[2];
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        alignas(16) float v1[4], v2[4];
+                        _mm_store_ps(v1, buffers[i].v1[x]);
+                        _mm_store_ps(v2, buffers[i].v2[x]);
+                        float3 ycxcz = { v1[0] * filter.invSumA, v1[1] * filter.invSumRG, (v1[2] + v2[0]) * filter.invSumBY };
+                        lab[i] = flip::hunt(flip::linearRGB2CIELab(flip::clamp01(flip::YCxCz2LinearRGB(ycxcz))));
+                        pointGradient[i] = std::sqrt(v2[1] * v2[1] + v1[3] * v1[3]);
+                        edgeGradient[i] = std::sqrt(v2[2] * v2[2] + v2[3] * v2[3]);
+                    }
+
+                    const float colorDiff = flip::hyAB(lab[0], lab[1]);
+                    const float pointDifference = std::abs(pointGradient[0] - pointGradient[1]);
+                    const float edgeDifference = std::abs(edgeGradient[0] - edgeGradient[1]);
+                    const float featureDiff = std::pow(std::max(pointDifference, edgeDifference) * flip::kInvSqrt2, flip::gqf);
+                    const float value = flip::redistributeErrors(colorDiff, featureDiff);
+
+                    // HDR-FLIP is the maximum LDR-FLIP over the exposures.
+                    if (exposureIndex == 0) dst[x] = flipOptions.hdr ? (value > 0.f ? value : 0.f) : value;
+                    else if (value > dst[x]) dst[x] = value;
+                }
+            }
+        }
+
+        // Invalid values count as maximum error, as in FLIPPass.
+        for (size_t i = 0; i < pixelCount; ++i)
+        {
+            if (!(errors[i] >= 0.f && errors[i] <= 1.f)) errors[i] = 1.f;
+        }
+    };
 }
 
 struct ErrorMetric
 {
     std::string name;
     std::string desc;
-    std::function<double(const Image& imageA, const Image& imageB, bool alpha, float* errorMap)> compare;
+    std::function<ErrorKernel(const ImageReader& imageA, const ImageReader& imageB, const CompareOptions& options)> createKernel;
 };
 
 static const std::vector<ErrorMetric> errorMetrics =
 {
-    { "mse", "Mean Squared Error", compare<MSE> },
-    { "rmse", "Relative Mean Squared Error", compare<RMSE> },
-    { "mae", "Mean Absolute Error", compare<MAE> },
-    { "mape", "Mean Absolute Percentage Error", compare<MAPE> },
+    { "mse", "Mean Squared Error", createPixelKernel<MSE> },
+    { "rmse", "Relative Mean Squared Error (relMSE)", createPixelKernel<RMSE> },
+    { "mae", "Mean Absolute Error", createPixelKernel<MAE> },
+    { "mape", "Mean Absolute Percentage Error", createPixelKernel<MAPE> },
+    { "ssim", "Structural Dissimilarity (1 - SSIM)", createSSIMKernel },
+    { "flip", "Mean FLIP error (image1 is the reference)", createFLIPKernel },
 };
 
+/** Compares two images of the same size.
+    The images are processed in tiles of rows on options.threadCount threads. All supported metrics are means
+    of non-negative per-pixel errors, so with early-out enabled the comparison stops as soon as the error
+    accumulated so far exceeds the threshold.
+*/
+static CompareResult compareImages(const ImageReader& imageA, const ImageReader& imageB, const ErrorMetric& metric, const CompareOptions& options)
+{
+    const uint32_t width = imageA.getWidth();
+    const uint32_t height = imageA.getHeight();
+    const size_t pixelCount = size_t(width) * height;
+    const uint32_t tileCount = div_round_up(height, kTileRows);
+
+    ErrorKernel kernel = metric.createKernel(imageA, imageB, options);
+
+    struct TileStats
+    {
+        double sum = 0.0;
+        float minError = std::numeric_limits<float>::infinity();
+        float maxError = -std::numeric_limits<float>::infinity();
+    };
+
+    CompareResult result;
+    const bool keepErrors = options.errorMap || options.trim > 0.0;
+    if (keepErrors) result.errorMap.resize(pixelCount);
+
+    std::vector<TileStats> tileStats(tileCount);
+    std::atomic<bool> stop = false;
+    std::mutex mutex;
+    double accumulatedError = 0.0;
+    uint32_t completedTiles = 0;
+
+    parallelFor(tileCount, options.threadCount, [&] (uint32_t tile)
+    {
+        const uint32_t y0 = tile * kTileRows;
+        const uint32_t rowCount = std::min(kTileRows, height - y0);
+        const size_t count = size_t(rowCount) * width;
+
+        thread_local std::vector<float> tileErrors;
+        float* errors = nullptr;
+        if (keepErrors) errors = result.errorMap.data() + size_t(y0) * width;
+        else
+        {
+            tileErrors.resize(count);
+            errors = tileErrors.data();
+        }
+
+        kernel(y0, rowCount, errors);
+
+        TileStats& stats = tileStats[tile];
+        for (size_t i = 0; i < count; ++i)
+        {
+            stats.sum += errors[i];
+            stats.minError = std::min(stats.minError, errors[i]);
+            stats.maxError = std::max(stats.maxError, errors[i]);
+        }
+
+        if (options.earlyOut)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            accumulatedError += stats.sum;
+            completedTiles++;
+            if (!(accumulatedError <= options.threshold * pixelCount)) stop = true;
+        }
+    }, &stop);
+
+    if (options.earlyOut && completedTiles < tileCount)
+    {
+        result.error = accumulatedError / pixelCount;
+        result.earlyOut = true;
+        result.errorMap.clear();
+        return result;
+    }
+
+    // Reduce in tile order so the result does not depend on the number of threads.
+    double sum = 0.0;
+    result.minError = std::numeric_limits<float>::infinity();
+    result.maxError = -std::numeric_limits<float>::infinity();
+    for (const auto& stats : tileStats)
+    {
+        sum += stats.sum;
+        result.minError = std::min(result.minError, stats.minError);
+        result.maxError = std::max(result.maxError, stats.maxError);
+    }
+    result.error = sum / pixelCount;
+
+    // Discard the largest per-pixel errors.
+    const size_t discardCount = size_t(options.trim * pixelCount);
+    if (discardCount > 0 && std::isfinite(result.error))
+    {
+        std::vector<float> sorted(result.errorMap);
+        const size_t keepCount = pixelCount - discardCount;
+        std::nth_element(sorted.begin(), sorted.begin() + keepCount, sorted.end());
+        double trimmedSum = 0.0;
+        for (size_t i = 0; i < keepCount; ++i) trimmedSum += sorted[i];
+        result.error = trimmedSum / keepCount;
+    }
+
+    if (!options.errorMap) result.errorMap.clear();
+
+    return result;
+}
+
 static Image::SharedPtr generateHeatMap(uint32_t width, uint32_t height, const float* errorMap)
 {
     auto writeColor = [] (float t, float* dst)
@@ -264,66 +1166,204 @@ static Image::SharedPtr generateHeatMap(uint32_t width, uint32_t height, const f
     return image;
 }
 
-static bool compareImages(const std::string& filenameA, const std::string& filenameB, ErrorMetric metric, float threshold, bool alpha, const std::string& heatMapFilename)
+/** Outcome of comparing one image pair.
+*/
+struct Comparison
+{
+    std::string filenameA;
+    std::string filenameB;
+    std::string heatMapFilename;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    CompareResult result;
+    bool passed = false;
+    double seconds = 0.0;
+    std::string message;        ///< Reason the comparison could not be performed.
+};
+
+static void runComparison(Comparison& comparison, const ErrorMetric& metric, CompareOptions options)
 {
-    auto loadImage = [] (const std::string& filename)
+    auto startTime = std::chrono::steady_clock::now();
+    auto fail = [&comparison] (const std::string& message)
+    {
+        comparison.message = message;
+        comparison.result.error = std::numeric_limits<double>::quiet_NaN();
+        comparison.passed = false;
+        std::cerr << message << std::endl;
+    };
+
+    auto loadImage = [&fail] (const std::string& filename)
     {
         try
         {
-            return Image::loadFromFile(filename);
+            return ImageReader::open(filename);
         }
         catch (const std::runtime_error& e)
         {
-            std::cerr << "Cannot load image from '" << filename << "' (Error: " << e.what() << ")." << std::endl;
-            return Image::SharedPtr();
+            fail("Cannot load image from '" + filename + "' (Error: " + e.what() + ").");
+            return ImageReader::UniquePtr();
         }
     };
 
-    auto saveImage = [] (const Image& image, const std::string& filename)
+    // Load images.
+    auto imageA = loadImage(comparison.filenameA);
+    if (!imageA) return;
+    auto imageB = loadImage(comparison.filenameB);
+    if (!imageB) return;
+
+    // Check resolution.
+    if (imageA->getWidth() != imageB->getWidth() || imageA->getHeight() != imageB->getHeight())
+    {
+        fail("Cannot compare images with different resolutions.");
+        return;
+    }
+
+    comparison.width = imageA->getWidth();
+    comparison.height = imageA->getHeight();
+
+    // Compare images.
+    options.errorMap = !comparison.heatMapFilename.empty();
+    try
+    {
+        comparison.result = compareImages(*imageA, *imageB, metric, options);
+    }
+    catch (const std::exception& e)
+    {
+        fail(std::string("Cannot compare images (Error: ") + e.what() + ").");
+        return;
+    }
+
+    // Generate heat map.
+    if (!comparison.result.errorMap.empty())
     {
+        auto heatMap = generateHeatMap(comparison.width, comparison.height, comparison.result.errorMap.data());
         try
         {
-            image.saveToFile(filename);
+            heatMap->saveToFile(comparison.heatMapFilename);
         }
         catch (const std::runtime_error& e)
         {
-            std::cerr << "Cannot save image to '" << filename << "' (Error: " << e.what() << ")." << std::endl;
+            std::cerr << "Cannot save image to '" << comparison.heatMapFilename << "' (Error: " << e.what() << ")." << std::endl;
         }
-    };
+        comparison.result.errorMap.clear();
+    }
 
-    // Load images.
-    auto imageA = loadImage(filenameA);
-    if (!imageA) return false;
-    auto imageB = loadImage(filenameB);
-    if (!imageB) return false;
+    // Treat nans and infs as errors.
+    double error = comparison.result.error;
+    comparison.passed = !comparison.result.earlyOut && !std::isnan(error) && !std::isinf(error) && error <= options.threshold;
+    comparison.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
 
-    // Check resolution.
-    if (imageA->getWidth() != imageB->getWidth() || imageA->getHeight() != imageB->getHeight())
+static std::string jsonString(const std::string& str)
+{
+    std::ostringstream ss;
+    ss << '"';
+    for (char c : str)
     {
-        std::cerr << "Cannot compare images with different resolutions." << std::endl;
+        switch (c)
+        {
+        case '"': ss << "\\\""; break;
+        case '\\': ss << "\\\\"; break;
+        case '\n': ss << "\\n"; break;
+        case '\r': ss << "\\r"; break;
+        case '\t': ss << "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20) ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c);
+            else ss << c;
+        }
+    }
+    ss << '"';
+    return ss.str();
+}
+
+static std::string jsonNumber(double value)
+{
+    // JSON has no representation for nans and infs.
+    if (!std::isfinite(value)) return "null";
+    std::ostringstream ss;
+    ss << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+    return ss.str();
+}
+
+static bool writeReport(const std::string& filename, const std::vector<Comparison>& comparisons, const ErrorMetric& metric, const CompareOptions& options)
+{
+    std::ofstream file(filename);
+    if (!file)
+    {
+        std::cerr << "Cannot write report to '" << filename << "'." << std::endl;
         return false;
     }
 
-    uint32_t width = imageA->getWidth();
-    uint32_t height = imageB->getHeight();
+    bool passed = std::all_of(comparisons.begin(), comparisons.end(), [] (const Comparison& c) { return c.passed; });
+    const char* b[] = { "false", "true" };
 
-    // Compare images.
-    std::unique_ptr<float[]> errorMap = heatMapFilename.empty() ? nullptr : std::make_unique<float[]>(width * height);
-    double error = metric.compare(*imageA, *imageB, alpha, errorMap.get());
+    file << "{\n";
+    file << "    \"metric\": " << jsonString(metric.name) << ",\n";
+    file << "    \"threshold\": " << jsonNumber(options.threshold) << ",\n";
+    file << "    \"alpha\": " << b[options.alpha] << ",\n";
+    file << "    \"trim\": " << jsonNumber(options.trim) << ",\n";
+    file << "    \"earlyOut\": " << b[options.earlyOut] << ",\n";
+    file << "    \"passed\": " << b[passed] << ",\n";
+    file << "    \"comparisons\": [";
+    for (size_t i = 0; i < comparisons.size(); ++i)
+    {
+        const Comparison& c = comparisons[i];
+        file << (i == 0 ? "\n" : ",\n");
+        file << "        {\n";
+        file << "            \"image1\": " << jsonString(c.filenameA) << ",\n";
+        file << "            \"image2\": " << jsonString(c.filenameB) << ",\n";
+        if (!c.heatMapFilename.empty()) file << "            \"heatMap\": " << jsonString(c.heatMapFilename) << ",\n";
+        if (!c.message.empty()) file << "            \"message\": " << jsonString(c.message) << ",\n";
+        file << "            \"width\": " << c.width << ",\n";
+        file << "            \"height\": " << c.height << ",\n";
+        file << "            \"error\": " << jsonNumber(c.result.error) << ",\n";
+        if (c.message.empty() && !c.result.earlyOut)
+        {
+            file << "            \"minError\": " << jsonNumber(c.result.minError) << ",\n";
+            file << "            \"maxError\": " << jsonNumber(c.result.maxError) << ",\n";
+        }
+        file << "            \"earlyOut\": " << b[c.result.earlyOut] << ",\n";
+        file << "            \"seconds\": " << jsonNumber(c.seconds) << ",\n";
+        file << "            \"passed\": " << b[c.passed] << "\n";
+        file << "        }";
+    }
+    file << "\n    ]\n";
+    file << "}\n";
 
-    // Generate heat map.
-    if (errorMap)
+    return true;
+}
+
+/** Reads a batch file. Each non-empty line not starting with '#' holds the two images to compare and optionally
+    the filename of the heat map to generate, separated by whitespace. Filenames containing spaces can be quoted.
+*/
+static bool readBatchFile(const std::string& filename, std::vector<Comparison>& comparisons)
+{
+    std::ifstream file(filename);
+    if (!file)
     {
-        auto heatMap = generateHeatMap(width, height, errorMap.get());
-        saveImage(*heatMap, heatMapFilename);
+        std::cerr << "Cannot read batch file '" << filename << "'." << std::endl;
+        return false;
     }
 
-    std::cout << error << std::endl;
+    std::string line;
+    for (uint32_t lineNumber = 1; std::getline(file, line); ++lineNumber)
+    {
+        auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
 
-    // Treat nans and infs as errors.
-    if (std::isnan(error) || std::isinf(error)) return false;
+        Comparison comparison;
+        std::istringstream ss(line);
+        ss >> std::quoted(comparison.filenameA) >> std::quoted(comparison.filenameB);
+        if (!ss)
+        {
+            std::cerr << "Invalid entry in batch file '" << filename << "' on line " << lineNumber << "." << std::endl;
+            return false;
+        }
+        ss >> std::quoted(comparison.heatMapFilename);
+        comparisons.push_back(comparison);
+    }
 
-    return error <= threshold;
+    return true;
 }
 
 static void printMetrics(std::ostream &stream = std::cout)
@@ -345,8 +1385,20 @@ int main(int argc, char** argv)
     args::ValueFlag<float> thresholdFlag(parser, "threshold", "The error threshold.", {'t'});
     args::Flag alphaFlag(parser, "", "Include alpha channel.", {'a'});
     args::ValueFlag<std::string> heatMapFlag(parser, "filename", "Generate error heat map.", {'e'});
-    args::Positional<std::string> image1(parser, "image1", "The first image.", args::Options::Required);
-    args::Positional<std::string> image2(parser, "image2", "The second image.", args::Options::Required);
+    args::Flag earlyOutFlag(parser, "", "Stop comparing as soon as the error exceeds the threshold. The reported error is then a lower bound.", {"early-out"});
+    args::ValueFlag<double> trimFlag(parser, "fraction", "Discard this fraction of the largest per-pixel errors (outliers) before averaging.", {"trim"});
+    args::ValueFlag<uint32_t> threadsFlag(parser, "N", "Number of worker threads (default: number of hardware threads).", {'j', "threads"});
+    args::ValueFlag<std::string> batchFlag(parser, "filename", "Compare the image pairs listed in a file ('image1 image2 [heatmap]' per line).", {"batch"});
+    args::ValueFlag<std::string> reportFlag(parser, "filename", "Write a JSON report of all comparisons.", {"json"});
+    args::Group flipGroup(parser, "FLIP options:");
+    args::Flag hdrFlag(flipGroup, "", "Compute HDR-FLIP.", {"hdr"});
+    args::Flag clampFlag(flipGroup, "", "Clamp input to [0,1] (LDR) or [0,inf) (HDR).", {"clamp"});
+    args::ValueFlag<std::string> toneMapperFlag(flipGroup, "name", "HDR-FLIP tone mapper (aces, hable, reinhard).", {"tone-mapper"});
+    args::ValueFlag<uint32_t> monitorWidthPixelsFlag(flipGroup, "pixels", "Monitor width in pixels (default: 3840).", {"monitor-width-pixels"});
+    args::ValueFlag<float> monitorWidthMetersFlag(flipGroup, "meters", "Monitor width in meters (default: 0.7).", {"monitor-width-meters"});
+    args::ValueFlag<float> monitorDistanceFlag(flipGroup, "meters", "Distance to the monitor in meters (default: 0.7).", {"monitor-distance"});
+    args::Positional<std::string> image1(parser, "image1", "The first image.");
+    args::Positional<std::string> image2(parser, "image2", "The second image.");
     args::CompletionFlag completionFlag(parser, {"complete"});
 
     try
@@ -369,7 +1421,7 @@ int main(int argc, char** argv)
         std::cerr << parser;
         return 1;
     }
-    catch (const args::RequiredError& e)
+    catch (const args::ValidationError& e)
     {
         std::cerr << e.what() << std::endl;
         std::cerr << parser;
@@ -396,12 +1448,95 @@ int main(int argc, char** argv)
         metric = *it;
     }
 
-    return compareImages(
-        args::get(image1),
-        args::get(image2),
-        metric,
-        thresholdFlag ? args::get(thresholdFlag) : 0.f,
-        alphaFlag ? args::get(alphaFlag) : false,
-        heatMapFlag ? args::get(heatMapFlag) : ""
-    ) ? 0 : 1;
+    CompareOptions options;
+    options.threshold = thresholdFlag ? args::get(thresholdFlag) : 0.f;
+    options.alpha = alphaFlag;
+    options.earlyOut = earlyOutFlag;
+    options.trim = trimFlag ? args::get(trimFlag) : 0.0;
+    options.threadCount = threadsFlag ? args::get(threadsFlag) : std::max(1u, std::thread::hardware_concurrency());
+    options.flip.hdr = hdrFlag;
+    options.flip.clampInput = clampFlag;
+    if (monitorWidthPixelsFlag) options.flip.monitorWidthPixels = args::get(monitorWidthPixelsFlag);
+    if (monitorWidthMetersFlag) options.flip.monitorWidthMeters = args::get(monitorWidthMetersFlag);
+    if (monitorDistanceFlag) options.flip.monitorDistance = args::get(monitorDistanceFlag);
+    if (toneMapperFlag)
+    {
+        static const std::map<std::string, ToneMapper> kToneMappers = { { "aces", ToneMapper::ACES }, { "hable", ToneMapper::Hable }, { "reinhard", ToneMapper::Reinhard } };
+        auto it = kToneMappers.find(args::get(toneMapperFlag));
+        if (it == kToneMappers.end())
+        {
+            std::cerr << "Unknown tone mapper '" << args::get(toneMapperFlag) << "'." << std::endl;
+            return 1;
+        }
+        options.flip.toneMapper = it->second;
+    }
+
+    if (options.trim < 0.0 || options.trim >= 1.0)
+    {
+        std::cerr << "Trim fraction must be in [0,1)." << std::endl;
+        return 1;
+    }
+    if (options.earlyOut && (options.trim > 0.0 || heatMapFlag))
+    {
+        std::cerr << "Early-out cannot be combined with trimming or heat maps." << std::endl;
+        return 1;
+    }
+    if (options.threadCount == 0 || options.flip.monitorWidthPixels == 0 || !(options.flip.monitorWidthMeters > 0.f) || !(options.flip.monitorDistance > 0.f))
+    {
+        std::cerr << "Invalid thread count or FLIP viewing conditions." << std::endl;
+        return 1;
+    }
+
+    // Collect image pairs.
+    std::vector<Comparison> comparisons;
+    if (batchFlag)
+    {
+        if (image1 || heatMapFlag)
+        {
+            std::cerr << "Images and heat maps are given in the batch file in batch mode." << std::endl;
+            return 1;
+        }
+        if (!readBatchFile(args::get(batchFlag), comparisons)) return 1;
+        if (options.earlyOut && std::any_of(comparisons.begin(), comparisons.end(), [] (const Comparison& c) { return !c.heatMapFilename.empty(); }))
+        {
+            std::cerr << "Early-out cannot be combined with trimming or heat maps." << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        if (!image1 || !image2)
+        {
+            std::cerr << "Two images are required." << std::endl;
+            std::cerr << parser;
+            return 1;
+        }
+        Comparison comparison;
+        comparison.filenameA = args::get(image1);
+        comparison.filenameB = args::get(image2);
+        comparison.heatMapFilename = heatMapFlag ? args::get(heatMapFlag) : "";
+        comparisons.push_back(comparison);
+    }
+
+    // Compare images. Each comparison is parallelized internally.
+    bool passed = true;
+    for (auto& comparison : comparisons)
+    {
+        runComparison(comparison, metric, options);
+        passed = passed && comparison.passed;
+
+        if (!comparison.message.empty()) continue;
+        if (batchFlag)
+        {
+            std::cout << comparison.result.error << " " << (comparison.passed ? "passed" : "failed") << " " << comparison.filenameA << " " << comparison.filenameB << std::endl;
+        }
+        else
+        {
+            std::cout << comparison.result.error << std::endl;
+        }
+    }
+
+    if (reportFlag && !writeReport(args::get(reportFlag), comparisons, metric, options)) return 1;
+
+    return passed ? 0 : 1;
 }